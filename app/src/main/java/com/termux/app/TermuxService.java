@@ -584,6 +584,8 @@ public final class TermuxService extends Service implements AppShell.AppShellCli
 
         executionCommand.setShellCommandShellEnvironment = true;
         executionCommand.terminalTranscriptRows = mProperties.getTerminalTranscriptRows();
+        if (mProperties.shouldUseTerminalTranscriptFile())
+            executionCommand.terminalTranscriptFileDirectory = TermuxConstants.TERMUX_TMP_PREFIX_DIR_PATH;
 
         if (Logger.getLogLevel() >= Logger.LOG_LEVEL_VERBOSE)
             Logger.logVerboseExtended(LOG_TAG, executionCommand.toString());
@@ -0,0 +1,88 @@
+package com.termux.terminal;
+
+/**
+ * Native compact storage of {@link TerminalRow} cells, used by {@link TerminalBuffer} for transcript rows, which are
+ * rarely accessed once they have scrolled off the screen. C code is in jni/cell_store.c.
+ * <p>
+ * A packed row takes one 4-byte code point per column up to its last non-blank column, with combining characters in a
+ * side table, and runs of columns with the same style instead of a 64-bit style per column. The packed rows are
+ * allocated in a native arena owned by the store, which is freed when the store is garbage collected.
+ * <p>
+ * Packed rows which have aged further can be compressed into cold blocks of many rows, which are decompressed into a
+ * small cache of recently used blocks when one of their rows is unpacked. Handles of packed rows stay valid until freed
+ * whether compressed or not.
+ * <p>
+ * Not available without the native library, in which case rows are never packed.
+ */
+final class CellStore {
+
+    static final boolean AVAILABLE = NativeLibrary.AVAILABLE;
+
+    /** Set in the result of {@link #unpack(long, char[], long[])} if the row has chars with width != 1. */
+    static final int UNPACKED_NON_ONE_WIDTH = 1 << 30;
+    static final int UNPACKED_SPACE_USED_MASK = UNPACKED_NON_ONE_WIDTH - 1;
+
+    private long mNativeStore;
+
+    CellStore() {
+        mNativeStore = nativeCreate();
+    }
+
+    /**
+     * Pack the text of a row with a style per column. Returns the handle of the packed row, or 0 if it could not be
+     * packed, in which case the row has to be kept as it is.
+     */
+    long pack(char[] text, int spaceUsed, long[] style) {
+        return nativePack(mNativeStore, text, spaceUsed, style);
+    }
+
+    /**
+     * Compress the packed rows of the first count handles, at most {@link TerminalBuffer#COLD_BLOCK_ROWS}, into a cold
+     * block, replacing the handles. Returns false leaving the rows and handles as they are if they do not compress.
+     */
+    boolean compress(long[] handles, int count) {
+        return nativeCompress(mNativeStore, handles, count);
+    }
+
+    /**
+     * Unpack a packed row, which is left packed. Returns the number of chars of text, possibly with
+     * {@link #UNPACKED_NON_ONE_WIDTH} set, or if text is too short the negated number of chars needed.
+     */
+    int unpack(long packed, char[] text, long[] style) {
+        return nativeUnpack(mNativeStore, packed, text, style);
+    }
+
+    void free(long packed) {
+        nativeFree(mNativeStore, packed);
+    }
+
+    /** Free all packed rows. */
+    void reset() {
+        nativeReset(mNativeStore);
+    }
+
+    @Override
+    protected void finalize() throws Throwable {
+        try {
+            if (mNativeStore != 0) nativeDestroy(mNativeStore);
+            mNativeStore = 0;
+        } finally {
+            super.finalize();
+        }
+    }
+
+    private static native long nativeCreate();
+
+    private static native void nativeDestroy(long store);
+
+    private static native void nativeReset(long store);
+
+    private static native long nativePack(long store, char[] text, int textLength, long[] style);
+
+    private static native boolean nativeCompress(long store, long[] handles, int count);
+
+    private static native int nativeUnpack(long store, long packed, char[] text, long[] style);
+
+    private static native void nativeFree(long store, long packed);
+
+}
@@ -0,0 +1,99 @@
+package com.termux.terminal;
+
+/**
+ * Finds terminal output which will scroll out of the transcript before the end of the buffer it is in, so that
+ * {@link TerminalEmulator} can skip writing it to the screen while output is flooding in.
+ * <p>
+ * Output can only be known to scroll off if it does nothing but print and scroll, so the scan looks for output of
+ * printable characters, tabs, carriage returns, line feeds, bells and SGR sequences, and counts the line feeds in it.
+ * Large buffers are scanned natively, see jni/vt_scanner.c.
+ */
+final class FloodScanner {
+
+    /** Buffers shorter than this are scanned in Java. */
+    private static final int MIN_NATIVE_SCAN_LENGTH = 256;
+
+    private FloodScanner() {
+    }
+
+    /**
+     * Find output in the first length bytes of buffer which only prints and scrolls, from after the last other output
+     * to the end, and within it the line feed from which the rest of the buffer has lineFeeds line feeds.
+     *
+     * @return the index after the last other output in the upper 32 bits, and the index of the line feed in the lower,
+     * which is the same as the upper if there are fewer line feeds.
+     */
+    static long findScrolledOffOutput(byte[] buffer, int length, int lineFeeds) {
+        if (NativeLibrary.AVAILABLE && length >= MIN_NATIVE_SCAN_LENGTH)
+            return nativeFindScrolledOffOutput(buffer, length, lineFeeds);
+
+        int safeStart = 0;
+        int safeLineFeeds = 0;
+        int i = 0;
+        while (i < length) {
+            int b = buffer[i] & 0xFF;
+            if ((b >= 0x20 && b != 0x7F) || b == 7 || b == '\t' || b == '\r') {
+                i++;
+            } else if (isLineFeed(b)) {
+                safeLineFeeds++;
+                i++;
+            } else {
+                long sequence = (b == 27) ? escapeSequence(buffer, i, length) : 1;
+                int next = (sequence == 0) ? length : i + (int) sequence;
+                if (sequence <= Integer.MAX_VALUE) {
+                    safeStart = next;
+                    safeLineFeeds = 0;
+                }
+                i = next;
+            }
+        }
+
+        if (lineFeeds == 0 || safeLineFeeds < lineFeeds) return ((long) safeStart << 32) | safeStart;
+        int lineFeedsToSkip = safeLineFeeds - lineFeeds;
+        for (i = safeStart; ; i++) {
+            if (isLineFeed(buffer[i] & 0xFF) && lineFeedsToSkip-- == 0) return ((long) safeStart << 32) | i;
+        }
+    }
+
+    private static boolean isLineFeed(int b) {
+        return b == '\n' || b == 11 || b == '\f';
+    }
+
+    /**
+     * The length of the escape sequence starting with the ESC at buffer[i], or 0 if it is incomplete. A CSI sequence
+     * setting graphic rendition has bit 32 set.
+     */
+    private static long escapeSequence(byte[] buffer, int i, int length) {
+        int j = i + 1;
+        if (j >= length) return 0;
+        int b = buffer[j];
+        if (b == '[') {
+            boolean digitsOnly = true;
+            for (j++; j < length; j++) {
+                b = buffer[j] & 0xFF;
+                // Control characters are executed within the sequence, so end it at them.
+                if (b < 0x20 || b > 0x7E) return j - i;
+                if (b >= 0x40) return (digitsOnly && b == 'm') ? ((1L << 32) | (j + 1 - i)) : (j + 1 - i);
+                if (!((b >= '0' && b <= '9') || b == ';' || b == ':')) digitsOnly = false;
+            }
+            return 0;
+        }
+        if (b == ']' || b == 'P' || b == '_' || b == '^' || b == 'X') {
+            // String terminated by BEL or ST.
+            for (j++; j < length; j++) {
+                if (buffer[j] == 7) return j + 1 - i;
+                if (buffer[j] == 27 && j + 1 < length && buffer[j + 1] == '\\') return j + 2 - i;
+            }
+            return 0;
+        }
+        // Intermediate bytes followed by a final byte.
+        while (b >= 0x20 && b <= 0x2F) {
+            if (++j >= length) return 0;
+            b = buffer[j];
+        }
+        return j + 1 - i;
+    }
+
+    private static native long nativeFindScrolledOffOutput(byte[] buffer, int length, int lineFeeds);
+
+}
@@ -1,5 +1,8 @@
 package com.termux.terminal;
 
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
 /**
  * Native methods for creating and managing pseudoterminal subprocesses. C code is in jni/termux.c.
  */
@@ -9,6 +12,17 @@ final class JNI {
         System.loadLibrary("termux");
     }
 
+    /** Spawn backend using fork(2), which copies the page tables of the (large) app process. */
+    public static final int SPAWN_BACKEND_FORK = 0;
+    /** Spawn backend using vfork(2), which shares the address space until the child has called exec. */
+    public static final int SPAWN_BACKEND_VFORK = 1;
+    /**
+     * Spawn backend using a small native spawn server process, which is started on first use and forks the
+     * subprocesses itself, so that the app process is not forked at all. Subprocesses that inherit file descriptors,
+     * and all subprocesses if the server executable is not available, are spawned with {@link #SPAWN_BACKEND_VFORK}.
+     */
+    public static final int SPAWN_BACKEND_SERVER = 2;
+
     /**
      * Create a subprocess. Differs from {@link ProcessBuilder} in that a pseudoterminal is used to communicate with the
      * subprocess.
@@ -19,11 +33,22 @@ final class JNI {
      * @param cwd       The current working directory for the executed command
      * @param args      An array of arguments to the command
      * @param envVars   An array of strings of the form "VAR=value" to be added to the environment of the process
-     * @param processId A one-element array to which the process ID of the started process will be written.
+     * @param inheritFds An optional array of file descriptors above 2 to be inherited by the process, for example to
+     *                  pass extra pipes to it. All other file descriptors of the app are closed in the process.
+     * @param processId An array to which the process ID of the started process will be written at index 0. If the
+     *                  array has at least two elements, the spawn backend that was used (one of the SPAWN_BACKEND_*
+     *                  constants) is written at index 1. If the array has at least three elements, a pidfd for
+     *                  the process (see {@link #openPidFd(int)}) is written at index 2, or -1 if not available.
      * @return the file descriptor resulting from opening /dev/ptmx master device. The sub process will have opened the
      * slave device counterpart (/dev/pts/$N) and have it as stdint, stdout and stderr.
      */
-    public static native int createSubprocess(String cmd, String cwd, String[] args, String[] envVars, int[] processId, int rows, int columns, int cellWidth, int cellHeight);
+    public static native int createSubprocess(String cmd, String cwd, String[] args, String[] envVars, int[] inheritFds, int[] processId, int rows, int columns, int cellWidth, int cellHeight);
+
+    /**
+     * Set the spawn backend tried first by {@link #createSubprocess}. Defaults to {@link #SPAWN_BACKEND_VFORK}, with
+     * fork(2) used as fallback if vfork(2) fails.
+     */
+    public static native void setPreferredSpawnBackend(int backend);
 
     /** Set the window size for a given pty, which allows connected programs to learn how large their screen is. */
     public static native void setPtyWindowSize(int fd, int rows, int cols, int cellWidth, int cellHeight);
@@ -31,10 +56,168 @@ final class JNI {
     /**
      * Causes the calling thread to wait for the process associated with the receiver to finish executing.
      *
-     * @return if >= 0, the exit status of the process. If < 0, the signal causing the process to stop negated.
+     * @return if >= 0, the exit status of the process. If < 0, the signal causing the process to stop negated, or
+     * {@link #PROCESS_WAIT_FAILED} if the process could not be waited for.
      */
     public static native int waitFor(int processId);
 
+    /** Returned by {@link #waitFor(int)} if waiting failed, for example since the process was already reaped. */
+    public static final int PROCESS_WAIT_FAILED = Integer.MIN_VALUE + 1;
+
+    /** Returned by {@link #waitForNoHang(int)} for a process that is still running. */
+    public static final int PROCESS_RUNNING = Integer.MIN_VALUE;
+
+    /**
+     * Collect the exit status of a process if it has exited, without blocking.
+     *
+     * @return {@link #PROCESS_RUNNING} if the process is still running, otherwise as for {@link #waitFor(int)}.
+     */
+    public static native int waitForNoHang(int processId);
+
+    /**
+     * Open a pidfd for a child process, which becomes readable when the process has exited and, unlike the process id,
+     * always refers to the same process. Callers are responsible for calling {@link #close(int)} on it.
+     *
+     * @return the pidfd, or -1 if pidfds are not supported by the device.
+     */
+    public static native int openPidFd(int processId);
+
+    /**
+     * Wait until at least one of the pidfds is readable, or until the timeout has passed. Negative values in pidFds
+     * are ignored.
+     *
+     * @param exited        Set to true at the index of each process that has exited, if any has exited.
+     * @param timeoutMillis The timeout, or -1 to wait without timeout.
+     * @return the number of processes that have exited, 0 on timeout.
+     */
+    public static native int pollPidFds(int[] pidFds, boolean[] exited, int timeoutMillis);
+
+    /**
+     * Initialize the pseudoterminal I/O reactor of {@link PtyReactor}, which calls back into it. C code is in
+     * jni/pty_reactor.c.
+     *
+     * @return false if the reactor is not available.
+     */
+    public static native boolean reactorInit();
+
+    /** Run the reactor loop on the calling thread. Does not return unless the reactor fails. */
+    public static native void reactorRun();
+
+    /**
+     * Let the reactor do the I/O for a pseudoterminal and wait for the process using it.
+     *
+     * @param pidFd The pidfd of the process from {@link #createSubprocess}, which is closed by the reactor also on
+     *              failure, or -1 for the reactor to open one from the process ID.
+     * @return the reactor session id, or -1 on failure.
+     */
+    public static native int reactorRegister(int fd, int processId, int pidFd);
+
+    /**
+     * Let the reactor watch for the exit of a process without reaping it, which signals
+     * {@link #reactorExitEventFd()}. The watch is removed after the exit.
+     *
+     * @return the reactor session id of the watch, or -1 on failure.
+     */
+    public static native int reactorWatch(int processId);
+
+    /**
+     * An eventfd signalled by the reactor whenever a session or watched process has exited, to be polled for
+     * readability and read to reset it.
+     *
+     * @return the eventfd, or -1 if the reactor is not initialized.
+     */
+    public static native int reactorExitEventFd();
+
+    /** Stop the reactor from doing I/O for a session. The file descriptor is not closed. */
+    public static native void reactorUnregister(int sessionId);
+
+    /**
+     * Set the size in bytes of the output buffer of reactor sessions registered from now on, which is clamped to
+     * between 4 KiB and 64 MiB and rounded up to a power of two. Defaults to 1 MiB.
+     */
+    public static native void reactorSetOutputBufferSize(int size);
+
+    /**
+     * Set how the output of reactor sessions is batched. Output arriving within the coalescing window (0 to 16 ms,
+     * 2 ms by default) of the previous output is notified about once the window has passed or maxBatchSize bytes
+     * (4 KiB to 64 MiB, 64 KiB by default) are buffered. Output after a pause is always notified about at once.
+     */
+    public static native void reactorSetReadBatching(int coalescingWindowMillis, int maxBatchSize);
+
+    /**
+     * Get the output counters of a reactor session: the number of bytes read from the pty, the number of reads which
+     * returned output and the number of output notifications, each of which wakes up the emulation thread.
+     *
+     * @return false if the session is unknown.
+     */
+    public static native boolean reactorOutputStats(int sessionId, long[] stats);
+
+    /**
+     * The output buffer of a reactor session, a lock-free single producer, single consumer ring which the reactor
+     * thread fills. It must only be read from by one thread at a time, and not after the session has been unregistered.
+     *
+     * @return a handle for the buffer, or 0 if the session is unknown.
+     */
+    public static native long reactorOutput(int sessionId);
+
+    /**
+     * Read process output from the output buffer of a reactor session without blocking.
+     *
+     * @return the number of bytes read, or -1 if the process side has been closed and all output has been read.
+     */
+    public static native int reactorRead(long output, byte[] buffer);
+
+    /**
+     * The storage of the output buffer of a reactor session, as a direct {@link ByteBuffer} whose capacity is
+     * that of the buffer, to read output in place with {@link #reactorPeekOutput(long)}.
+     */
+    public static native ByteBuffer reactorOutputBuffer(long output);
+
+    /**
+     * The readable output in the storage of an output buffer, which is only part of it if it wraps around. Returns
+     * zero length when there is no output, after which the reactor notifies again about new output.
+     *
+     * @return the offset of the output in the upper 32 bits, and its length in the lower.
+     */
+    public static native long reactorPeekOutput(long output);
+
+    /** Release count bytes of output read in place after {@link #reactorPeekOutput(long)}. */
+    public static native void reactorConsumeOutput(long output, int count);
+
+    /**
+     * Write data to the process of a reactor session, blocking while the input buffer of the session is full.
+     *
+     * @return the number of bytes written, or -1 if the session is unknown or cannot be written to.
+     */
+    public static native int reactorWrite(int sessionId, byte[] data, int offset, int count);
+
+    /** The maximum number of buffers of {@link #readvInto(int, ByteBuffer[], int[], int[])}. */
+    static final int READV_MAX_BUFFERS = 16;
+
+    /**
+     * Read from a file descriptor straight into a direct buffer, without the copy through a Java array that a
+     * {@link java.io.FileInputStream} makes. The position and limit of the buffer are neither used nor updated.
+     *
+     * @return the number of bytes read, -1 at end of file (which a pseudoterminal master reports as EIO once the
+     * slave side has been closed) or 0 if nothing is available on a non-blocking file descriptor.
+     */
+    public static native int readInto(int fd, ByteBuffer buffer, int offset, int length) throws IOException;
+
+    /**
+     * Read from a file descriptor into up to {@link #READV_MAX_BUFFERS} direct buffers with a single readv(2) call,
+     * such as the two free regions of a ring buffer. Returns as {@link #readInto(int, ByteBuffer, int, int)}.
+     */
+    public static native int readvInto(int fd, ByteBuffer[] buffers, int[] offsets, int[] lengths) throws IOException;
+
+    /**
+     * Write to a file descriptor straight from a direct buffer. The position and limit of the buffer are neither used
+     * nor updated.
+     *
+     * @return the number of bytes written, which may be less than length, or 0 if a non-blocking file descriptor
+     * cannot be written to right now.
+     */
+    public static native int writeFrom(int fd, ByteBuffer buffer, int offset, int length) throws IOException;
+
     /** Close a file descriptor through the close(2) system call. */
     public static native void close(int fileDescriptor);
 
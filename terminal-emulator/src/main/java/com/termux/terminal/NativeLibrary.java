@@ -0,0 +1,24 @@
+package com.termux.terminal;
+
+/**
+ * Optional use of the native library by the emulator, which also has to work without it, such as in unit tests where
+ * {@link JNI} cannot be loaded.
+ */
+final class NativeLibrary {
+
+    /** If the native library could be loaded. */
+    static final boolean AVAILABLE = load();
+
+    private NativeLibrary() {
+    }
+
+    private static boolean load() {
+        try {
+            System.loadLibrary("termux");
+            return true;
+        } catch (UnsatisfiedLinkError e) {
+            return false;
+        }
+    }
+
+}
@@ -0,0 +1,64 @@
+package com.termux.terminal;
+
+/**
+ * Finds runs of printable ASCII (0x20-0x7E) in terminal output, which {@link TerminalEmulator} writes to the screen in
+ * bulk instead of one code point at a time when outside of escape sequences.
+ * <p>
+ * Large buffers are scanned natively with SIMD, see jni/vt_scanner.c. The Java implementation is used for small
+ * buffers, where the JNI call would cost more than the scan, and when the native library is not available, such as
+ * in unit tests.
+ */
+final class PrintableRunScanner {
+
+    /** Runs shorter than this are not worth the bulk write and are processed byte by byte. */
+    static final int MIN_RUN_LENGTH = 8;
+
+    /** Buffers shorter than this are scanned in Java. */
+    private static final int MIN_NATIVE_SCAN_LENGTH = 256;
+
+    private PrintableRunScanner() {
+    }
+
+    /** The size of the runs array needed by {@link #findRuns(byte[], int, int[])} for a buffer of the given length. */
+    static int runsArrayLength(int length) {
+        // Runs are separated by at least one byte.
+        return 2 * (length / (MIN_RUN_LENGTH + 1) + 1);
+    }
+
+    /**
+     * Find the runs of at least {@link #MIN_RUN_LENGTH} printable ASCII bytes in the first length bytes of buffer.
+     *
+     * @param runs Filled with the start (inclusive) and end (exclusive) index of each run.
+     * @return the number of runs found.
+     */
+    static int findRuns(byte[] buffer, int length, int[] runs) {
+        if (NativeLibrary.AVAILABLE && length >= MIN_NATIVE_SCAN_LENGTH)
+            return nativeFindRuns(buffer, length, MIN_RUN_LENGTH, runs);
+
+        int runCount = 0;
+        int maxRuns = runs.length / 2;
+        int i = 0;
+        while (i < length && runCount < maxRuns) {
+            if (!isPrintableAscii(buffer[i])) {
+                i++;
+                continue;
+            }
+            int end = i + 1;
+            while (end < length && isPrintableAscii(buffer[end])) end++;
+            if (end - i >= MIN_RUN_LENGTH) {
+                runs[2 * runCount] = i;
+                runs[2 * runCount + 1] = end;
+                runCount++;
+            }
+            i = end;
+        }
+        return runCount;
+    }
+
+    static boolean isPrintableAscii(byte b) {
+        return b >= 0x20 && b <= 0x7E;
+    }
+
+    private static native int nativeFindRuns(byte[] buffer, int length, int minRunLength, int[] runs);
+
+}
@@ -0,0 +1,77 @@
+package com.termux.terminal;
+
+/**
+ * Watching child processes for exit from a single thread, instead of blocking a thread per process in
+ * {@link JNI#waitFor(int)}.
+ * <p>
+ * Processes are referred to by pidfds from {@link #openPidFd(int)}, which unlike process ids cannot be reused while
+ * open, and many of them can be waited for at once with {@link #poll(int[], boolean[], int)}. On devices without pidfd
+ * support, {@link #getExitEventFd()} can instead be polled after {@link #watch(int)}, and the exit status of each
+ * process is collected with {@link #waitForNoHang(int)}.
+ */
+public final class ProcessWatcher {
+
+    /** Returned by {@link #waitForNoHang(int)} for a process that is still running. */
+    public static final int PROCESS_RUNNING = JNI.PROCESS_RUNNING;
+
+    private ProcessWatcher() {
+    }
+
+    /**
+     * Open a pidfd for a child process of the app. Must be called before the exit status of the process has been
+     * collected. The pidfd must be closed with {@link #closeFd(int)}.
+     *
+     * @return the pidfd, or -1 if pidfds are not supported by the device.
+     */
+    public static int openPidFd(int processId) {
+        return JNI.openPidFd(processId);
+    }
+
+    /**
+     * Wait until at least one of the processes of the pidfds has exited, or until the timeout has passed. Negative
+     * values in pidFds are ignored.
+     *
+     * @param exited        Set to true at the index of each process that has exited, if any has exited.
+     * @param timeoutMillis The timeout, or -1 to wait without timeout.
+     * @return the number of processes that have exited, 0 on timeout.
+     */
+    public static int poll(int[] pidFds, boolean[] exited, int timeoutMillis) {
+        return JNI.pollPidFds(pidFds, exited, timeoutMillis);
+    }
+
+    /**
+     * Collect the exit status of a child process if it has exited, without blocking.
+     *
+     * @return {@link #PROCESS_RUNNING} if the process is still running, otherwise the exit status if >= 0 or the
+     * signal causing the process to stop negated.
+     */
+    public static int waitForNoHang(int processId) {
+        return JNI.waitForNoHang(processId);
+    }
+
+    /**
+     * Signal the fd from {@link #getExitEventFd()} when the process exits. The process is not reaped, so its exit
+     * status is still to be collected with {@link #waitForNoHang(int)}.
+     *
+     * @return true if the process is being watched.
+     */
+    public static boolean watch(int processId) {
+        return PtyReactor.start() && JNI.reactorWatch(processId) >= 0;
+    }
+
+    /**
+     * An eventfd that becomes readable whenever a terminal session process or a process passed to
+     * {@link #watch(int)} has exited. It is owned by the watcher and must not be closed.
+     *
+     * @return the eventfd, or -1 if not available.
+     */
+    public static int getExitEventFd() {
+        return PtyReactor.start() ? JNI.reactorExitEventFd() : -1;
+    }
+
+    /** Close a pidfd from {@link #openPidFd(int)}. */
+    public static void closeFd(int fd) {
+        JNI.close(fd);
+    }
+
+}
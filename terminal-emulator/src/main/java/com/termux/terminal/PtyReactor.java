@@ -0,0 +1,86 @@
+package com.termux.terminal;
+
+import java.util.HashMap;
+import java.util.Map;
+
+/**
+ * A single thread doing the pseudoterminal I/O and waiting for the processes of all sessions, instead of each session
+ * having its own reader, writer and waiter threads. C code is in jni/pty_reactor.c.
+ * <p>
+ * Process output is buffered natively and {@link TerminalSession#onReactorOutputAvailable()} is called when the
+ * buffer of a session goes from empty to non-empty, after which the session reads it on its emulation thread with
+ * {@link JNI#reactorRead(long, byte[])}, without taking locks shared with the reactor thread.
+ */
+final class PtyReactor {
+
+    private static final Map<Integer, TerminalSession> sSessions = new HashMap<>();
+
+    private static boolean sStarted;
+    private static boolean sAvailable;
+
+    /** Start the reactor thread if not already done. Returns false if the reactor is not available. */
+    static synchronized boolean start() {
+        if (!sStarted) {
+            sStarted = true;
+            sAvailable = JNI.reactorInit();
+            if (sAvailable) {
+                Thread reactorThread = new Thread("TermSessionReactor") {
+                    @Override
+                    public void run() {
+                        JNI.reactorRun();
+                    }
+                };
+                reactorThread.setDaemon(true);
+                reactorThread.start();
+            }
+        }
+        return sAvailable;
+    }
+
+    /**
+     * Let the reactor do the I/O for the pseudoterminal of a session. The pidfd of the process, if any, is always
+     * closed by this.
+     *
+     * @return the reactor session id, or -1 if the session has to do its I/O itself.
+     */
+    static int register(TerminalSession session, int fd, int processId, int pidFd) {
+        if (!start()) {
+            if (pidFd >= 0) JNI.close(pidFd);
+            return -1;
+        }
+        // Hold the lock while registering, so that callbacks for the new id wait until the session is known.
+        synchronized (sSessions) {
+            int sessionId = JNI.reactorRegister(fd, processId, pidFd);
+            if (sessionId >= 0) sSessions.put(sessionId, session);
+            return sessionId;
+        }
+    }
+
+    static void unregister(int sessionId) {
+        synchronized (sSessions) {
+            sSessions.remove(sessionId);
+        }
+        JNI.reactorUnregister(sessionId);
+    }
+
+    private static TerminalSession getSession(int sessionId) {
+        synchronized (sSessions) {
+            return sSessions.get(sessionId);
+        }
+    }
+
+    /** Called from the reactor thread when the output buffer of a session is no longer empty. */
+    @SuppressWarnings("unused")
+    private static void onOutputAvailable(int sessionId) {
+        TerminalSession session = getSession(sessionId);
+        if (session != null) session.onReactorOutputAvailable();
+    }
+
+    /** Called from the reactor thread when the process of a session has exited. */
+    @SuppressWarnings("unused")
+    private static void onProcessExited(int sessionId, int exitCode) {
+        TerminalSession session = getSession(sessionId);
+        if (session != null) session.onReactorProcessExited(exitCode);
+    }
+
+}
@@ -19,6 +19,63 @@ public final class TerminalBuffer {
     private int mActiveTranscriptRows = 0;
     /** The index in the circular buffer where the visible screen starts. */
     private int mScreenFirstRow = 0;
+    /**
+     * Set while processing output which is known to scroll out of the transcript before it can be seen, during which
+     * characters are not written and rows scrolled in are not blanked, see {@link TerminalEmulator#setFloodMode(boolean)}.
+     */
+    boolean mDiscardingRows;
+
+    /** Rows which have scrolled this far into the transcript are packed into {@link #mCellStore}. */
+    static final int PACKING_DELAY_ROWS = 64;
+    /** The number of transcript rows unpacked on access which are kept unpacked before being packed again. */
+    private static final int MAX_UNPACKED_ROWS = 512;
+    /** Rows which have scrolled this far into the transcript are compressed, in blocks of {@link #COLD_BLOCK_ROWS}. */
+    static final int COLD_DELAY_ROWS = 256;
+    static final int COLD_BLOCK_ROWS = 256;
+    /** The number of text and style arrays of packed rows kept for reuse. */
+    private static final int MAX_SPARE_ARRAYS = 16;
+
+    /** Store of the packed transcript rows, created when the first row is packed. */
+    private CellStore mCellStore;
+    /** The internal index and row of transcript rows unpacked on access, to be packed again in turn. */
+    private final int[] mUnpackedRowIndices = new int[MAX_UNPACKED_ROWS];
+    private final TerminalRow[] mUnpackedRows = new TerminalRow[MAX_UNPACKED_ROWS];
+    private int mNextUnpackedRow;
+    /** Text and style arrays of packed rows, for reuse when rows are unpacked. */
+    private final char[][] mSpareTexts = new char[MAX_SPARE_ARRAYS][];
+    private final long[][] mSpareStyles = new long[MAX_SPARE_ARRAYS][];
+    private int mSpareArrays;
+    /** The number of rows packed since the last block of rows was compressed. */
+    private int mRowsSinceColdBlock;
+    private long[] mColdBlockHandles;
+    /**
+     * The internal index and row of rows past the cold delay which were packed again after having been unpacked on
+     * access, to be compressed together once there are {@link #COLD_BLOCK_ROWS} of them.
+     */
+    private final int[] mRepackedColdRowIndices = new int[COLD_BLOCK_ROWS];
+    private final TerminalRow[] mRepackedColdRows = new TerminalRow[COLD_BLOCK_ROWS];
+    private int mRepackedColdRowCount;
+
+    /** The file rows are spilled to when they scroll out of the transcript, or null. See {@link #getHistoryRows()}. */
+    TranscriptFile mTranscriptFile;
+    /** The number of rows dropped from the top of the history, see {@link #getDroppedHistoryRows()}. */
+    private long mDroppedHistoryRows;
+    /** See {@link #getHistoryGeneration()}. */
+    private int mHistoryGeneration;
+    /** Rows read from {@link #mTranscriptFile}, and unpacked to be written to it. */
+    private TerminalRow mHistoryRow, mSpillRow;
+    /** The rows and their line wrap flags being moved by {@link #scrollRows(int, int, int, long)}. */
+    private TerminalRow[] mRotatedRows;
+    private boolean[] mRotatedLineWraps;
+
+    /** The transcript left by the last resize which is still to be reflowed, or null. See {@link #reflowHistory(int)}. */
+    private ReflowSource mReflowSource;
+    /** The rows a line of {@link #mReflowSource} has been reflowed into. */
+    private TerminalRow[] mReflowedRows = new TerminalRow[8];
+
+    /** A bit set of the screen rows changed since {@link #takeDamagedRows(long[])}, unless {@link #mAllRowsDamaged}. */
+    private long[] mDamagedRows;
+    private boolean mAllRowsDamaged = true;
 
     /**
      * Create a transcript screen.
@@ -33,19 +90,23 @@ public final class TerminalBuffer {
         mTotalRows = totalRows;
         mScreenRows = screenRows;
         mLines = new TerminalRow[totalRows];
+        mDamagedRows = new long[(screenRows + 63) / 64];
 
         blockSet(0, 0, columns, screenRows, ' ', TextStyle.NORMAL);
     }
 
     public String getTranscriptText() {
+        finishReflow();
         return getSelectedText(0, -getActiveTranscriptRows(), mColumns, mScreenRows).trim();
     }
 
     public String getTranscriptTextWithoutJoinedLines() {
+        finishReflow();
         return getSelectedText(0, -getActiveTranscriptRows(), mColumns, mScreenRows, false).trim();
     }
 
     public String getTranscriptTextWithFullLinesJoined() {
+        finishReflow();
         return getSelectedText(0, -getActiveTranscriptRows(), mColumns, mScreenRows, true, true).trim();
     }
 
@@ -61,7 +122,7 @@ public final class TerminalBuffer {
         final StringBuilder builder = new StringBuilder();
         final int columns = mColumns;
 
-        if (selY1 < -getActiveTranscriptRows()) selY1 = -getActiveTranscriptRows();
+        if (selY1 < -getHistoryRows()) selY1 = -getHistoryRows();
         if (selY2 >= mScreenRows) selY2 = mScreenRows - 1;
 
         for (int row = selY1; row <= selY2; row++) {
@@ -73,7 +134,7 @@ public final class TerminalBuffer {
             } else {
                 x2 = columns;
             }
-            TerminalRow lineObject = mLines[externalToInternalRow(row)];
+            TerminalRow lineObject = getHistoryRow(row);
             int x1Index = lineObject.findStartOfColumn(x1);
             int x2Index = (x2 < mColumns) ? lineObject.findStartOfColumn(x2) : lineObject.getSpaceUsed();
             if (x2Index == x1Index) {
@@ -83,7 +144,7 @@ public final class TerminalBuffer {
             char[] line = lineObject.mText;
             int lastPrintingCharIndex = -1;
             int i;
-            boolean rowLineWrap = getLineWrap(row);
+            boolean rowLineWrap = lineObject.mLineWrap;
             if (rowLineWrap && x2 == columns) {
                 // If the line was wrapped, we shouldn't lose trailing space:
                 lastPrintingCharIndex = x2Index - 1;
@@ -148,6 +209,50 @@ public final class TerminalBuffer {
         return mActiveTranscriptRows;
     }
 
+    /**
+     * The number of rows above the screen which can be read with {@link #getHistoryRow(int)}, which besides the
+     * transcript are the rows in the transcript file if there is one.
+     */
+    public int getHistoryRows() {
+        return mActiveTranscriptRows + (mTranscriptFile == null ? 0 : mTranscriptFile.getRowCount());
+    }
+
+    /**
+     * Get a row to read from, which may also be one of the rows in the transcript file above the transcript. Those are
+     * read into the same row each time, which is only valid until the next call.
+     */
+    public TerminalRow getHistoryRow(int externalRow) {
+        if (mTranscriptFile == null || externalRow >= -mActiveTranscriptRows)
+            return allocateFullLineIfNecessary(externalToInternalRow(externalRow));
+        if (mHistoryRow == null || mHistoryRow.getColumns() != mColumns) mHistoryRow = new TerminalRow(mColumns, TextStyle.NORMAL);
+        mTranscriptFile.read(mTranscriptFile.getRowCount() + mActiveTranscriptRows + externalRow, mHistoryRow);
+        return mHistoryRow;
+    }
+
+    /**
+     * The number of rows dropped from the top of the history so far, which scrolled out of a full transcript without
+     * being kept in a transcript file. Rows counted from the top of the history move up by one for each dropped row.
+     */
+    long getDroppedHistoryRows() {
+        return mDroppedHistoryRows;
+    }
+
+    /**
+     * Changed whenever rows counted from the top of the history are renumbered other than by dropping rows, which is
+     * by a resize or by clearing the transcript.
+     */
+    int getHistoryGeneration() {
+        return mHistoryGeneration;
+    }
+
+    /**
+     * Set the file to keep rows in which scroll out of the transcript, instead of dropping them, or null. See
+     * {@link TranscriptFile}.
+     */
+    public void setTranscriptFile(TranscriptFile transcriptFile) {
+        mTranscriptFile = transcriptFile;
+    }
+
     public int getActiveRows() {
         return mActiveTranscriptRows + mScreenRows;
     }
@@ -201,6 +306,9 @@ public final class TerminalBuffer {
      * @param cursor     An int[2] containing the (column, row) cursor location.
      */
     public void resize(int newColumns, int newRows, int newTotalRows, int[] cursor, long currentStyle, boolean altScreen) {
+        mHistoryGeneration++;
+        mDamagedRows = new long[(newRows + 63) / 64];
+        mAllRowsDamaged = true;
         // newRows > mTotalRows should not normally happen since mTotalRows is TRANSCRIPT_ROWS (10000):
         if (newColumns == mColumns && newRows <= mTotalRows) {
             // Fast resize where just the rows changed.
@@ -216,6 +324,7 @@ public final class TerminalBuffer {
                 }
             } else if (shiftDownOfTopRow < 0) {
                 // Negative shift down = expanding. Only move screen up if there is transcript to show:
+                reflowHistory(Integer.MAX_VALUE, -shiftDownOfTopRow, false);
                 int actualShift = Math.max(shiftDownOfTopRow, -mActiveTranscriptRows);
                 if (shiftDownOfTopRow != actualShift) {
                     // The new lines revealed by the resizing are not all from the transcript. Blank the below ones.
@@ -230,17 +339,23 @@ public final class TerminalBuffer {
             mActiveTranscriptRows = altScreen ? 0 : Math.max(0, mActiveTranscriptRows + shiftDownOfTopRow);
             cursor[1] -= shiftDownOfTopRow;
             mScreenRows = newRows;
+            // Rows revealed from the transcript are screen rows now, which are accessed without being unpacked.
+            for (int i = 0; i < mScreenRows; i++) {
+                TerminalRow line = mLines[externalToInternalRow(i)];
+                if (line != null && line.mPacked != 0) unpackRow(line);
+            }
         } else {
-            // Copy away old state and update new:
-            TerminalRow[] oldLines = mLines;
+            // Copy away old state and update new. The packed rows of the old state are unpacked from the old store
+            // while copying them, so that new rows can be packed into a new one.
+            finishReflow();
+            final ReflowSource source = new ReflowSource(mLines, mCellStore, mScreenFirstRow, mTotalRows, -mActiveTranscriptRows, currentStyle);
+            mCellStore = null;
+            forgetUnpackedAndSpareRows();
             mLines = new TerminalRow[newTotalRows];
-            for (int i = 0; i < newTotalRows; i++)
+            for (int i = 0; i < Math.min(newRows, newTotalRows); i++)
                 mLines[i] = new TerminalRow(newColumns, currentStyle);
 
-            final int oldActiveTranscriptRows = mActiveTranscriptRows;
-            final int oldScreenFirstRow = mScreenFirstRow;
             final int oldScreenRows = mScreenRows;
-            final int oldTotalRows = mTotalRows;
             mTotalRows = newTotalRows;
             mScreenRows = newRows;
             mActiveTranscriptRows = mScreenFirstRow = 0;
@@ -259,12 +374,15 @@ public final class TerminalBuffer {
             // Blank lines should be skipped only if at end of transcript (just as is done in the "fast" resize), so we
             // keep track how many blank lines we have skipped if we later on find a non-blank line.
             int skippedBlankLines = 0;
-            for (int externalOldRow = -oldActiveTranscriptRows; externalOldRow < oldScreenRows; externalOldRow++) {
-                // Do what externalToInternalRow() does but for the old state:
-                int internalOldRow = oldScreenFirstRow + externalOldRow;
-                internalOldRow = (internalOldRow < 0) ? (oldTotalRows + internalOldRow) : (internalOldRow % oldTotalRows);
-
-                TerminalRow oldLine = oldLines[internalOldRow];
+            // Only the lines on the screen are reflowed now. The transcript above them is reflowed later, from the
+            // bottom up, by reflowHistory(), unless rows are spilled to a transcript file which has to be in order:
+            int firstOldRow = source.mFirstRow;
+            if (mTranscriptFile == null) {
+                firstOldRow = 0;
+                while (firstOldRow > source.mFirstRow && source.isLineWrap(firstOldRow - 1)) firstOldRow--;
+            }
+            for (int externalOldRow = firstOldRow; externalOldRow < oldScreenRows; externalOldRow++) {
+                TerminalRow oldLine = source.getLine(externalOldRow);
                 boolean cursorAtThisRow = externalOldRow == oldCursorRow;
                 // The cursor may only be on a non-null line, which we should not skip:
                 if (oldLine == null || (!(!newCursorPlaced && cursorAtThisRow)) && oldLine.isBlank()) {
@@ -345,6 +463,19 @@ public final class TerminalBuffer {
                 }
             }
 
+            source.mNextRow = firstOldRow - 1;
+            mReflowSource = source;
+            if (mActiveTranscriptRows == 0) {
+                // The lines on the screen did not fill it, so move it up over the end of the transcript:
+                int rowsToShow = mScreenRows - 1 - Math.max(currentOutputExternalRow, newCursorRow);
+                reflowHistory(Integer.MAX_VALUE, rowsToShow, false);
+                int shift = Math.min(rowsToShow, mActiveTranscriptRows);
+                mScreenFirstRow = (mScreenFirstRow - shift + mTotalRows) % mTotalRows;
+                mActiveTranscriptRows -= shift;
+                if (newCursorRow >= 0) newCursorRow += shift;
+            }
+            if (mReflowSource != null && mReflowSource.mNextRow < mReflowSource.mFirstRow) discardReflow();
+
             cursor[0] = newCursorColumn;
             cursor[1] = newCursorRow;
         }
@@ -384,6 +515,15 @@ public final class TerminalBuffer {
     public void scrollDownOneLine(int topMargin, int bottomMargin, long style) {
         if (topMargin > bottomMargin - 1 || topMargin < 0 || bottomMargin > mScreenRows)
             throw new IllegalArgumentException("topMargin=" + topMargin + ", bottomMargin=" + bottomMargin + ", mScreenRows=" + mScreenRows);
+        markRowsDamaged(topMargin, bottomMargin);
+
+        // The transcript left to reflow is older than the oldest transcript row, which is about to be reused if full:
+        if (mReflowSource != null && mActiveTranscriptRows == mTotalRows - mScreenRows) discardReflow();
+        // The oldest transcript row is about to be reused if the transcript is full, so keep it in the file:
+        if (mActiveTranscriptRows == mTotalRows - mScreenRows) {
+            boolean spilled = mTranscriptFile != null && mActiveTranscriptRows > 0 && spillRow(externalToInternalRow(-mActiveTranscriptRows));
+            if (!spilled) mDroppedHistoryRows++;
+        }
 
         // Copy the fixed topMargin lines one line down so that they remain on screen in same position:
         blockCopyLinesDown(mScreenFirstRow, topMargin);
@@ -398,10 +538,16 @@ public final class TerminalBuffer {
 
         // Blank the newly revealed line above the bottom margin:
         int blankRow = externalToInternalRow(bottomMargin - 1);
-        if (mLines[blankRow] == null) {
-            mLines[blankRow] = new TerminalRow(mColumns, style);
-        } else {
-            mLines[blankRow].clear(style);
+        if (mLines[blankRow] == null || mLines[blankRow].mPacked != 0 || !mDiscardingRows) clearRow(blankRow, style);
+
+        // Pack the row which has now been in the transcript for a while, after which it is rarely accessed:
+        if (CellStore.AVAILABLE && !mDiscardingRows && mActiveTranscriptRows > PACKING_DELAY_ROWS) {
+            packRow(externalToInternalRow(-PACKING_DELAY_ROWS - 1));
+            // Every block of rows which has now scrolled past the cold delay is compressed together:
+            if (++mRowsSinceColdBlock >= COLD_BLOCK_ROWS && mActiveTranscriptRows >= COLD_DELAY_ROWS + COLD_BLOCK_ROWS) {
+                mRowsSinceColdBlock = 0;
+                compressColdBlock();
+            }
         }
     }
 
@@ -421,6 +567,7 @@ public final class TerminalBuffer {
         if (w == 0) return;
         if (sx < 0 || sx + w > mColumns || sy < 0 || sy + h > mScreenRows || dx < 0 || dx + w > mColumns || dy < 0 || dy + h > mScreenRows)
             throw new IllegalArgumentException();
+        markRowsDamaged(dy, dy + h);
         boolean copyingUp = sy > dy;
         for (int y = 0; y < h; y++) {
             int y2 = copyingUp ? y : (h - (y + 1));
@@ -439,22 +586,255 @@ public final class TerminalBuffer {
             throw new IllegalArgumentException(
                 "Illegal arguments! blockSet(" + sx + ", " + sy + ", " + w + ", " + h + ", " + val + ", " + mColumns + ", " + mScreenRows + ")");
         }
+        markRowsDamaged(sy, sy + h);
+        if (val == ' ' && sx == 0 && w == mColumns) {
+            // Whole rows are cleared lazily, without writing their cells:
+            if (mDiscardingRows) return;
+            for (int y = 0; y < h; y++)
+                clearRow(externalToInternalRow(sy + y), style);
+            return;
+        }
         for (int y = 0; y < h; y++)
             for (int x = 0; x < w; x++)
                 setChar(sx + x, sy + y, val, style);
     }
 
+    /**
+     * Move the rows from top to bottom (exclusive) of the screen up by count rows, or down for a negative count, and
+     * blank the rows left behind. This is the same as a {@link #blockCopy(int, int, int, int, int, int)} of whole rows
+     * followed by a {@link #blockSet(int, int, int, int, int, long)} of blanks, but the rows are moved by rotating them
+     * in the ring buffer instead of copying their cells. Line wrap flags stay in place as they would with a copy.
+     */
+    public void scrollRows(int top, int bottom, int count, long style) {
+        if (top < 0 || top > bottom || bottom > mScreenRows)
+            throw new IllegalArgumentException("top=" + top + ", bottom=" + bottom + ", mScreenRows=" + mScreenRows);
+        final int rows = bottom - top;
+        if (count == 0 || rows == 0) return;
+        markRowsDamaged(top, bottom);
+        if (Math.abs(count) >= rows) {
+            blockSet(0, top, mColumns, rows, ' ', style);
+            return;
+        }
+
+        if (mRotatedRows == null || mRotatedRows.length < mScreenRows) {
+            mRotatedRows = new TerminalRow[mScreenRows];
+            mRotatedLineWraps = new boolean[mScreenRows];
+        }
+        for (int i = 0; i < rows; i++) {
+            TerminalRow line = mLines[externalToInternalRow(top + i)];
+            mRotatedRows[i] = line;
+            mRotatedLineWraps[i] = line != null && line.mLineWrap;
+        }
+        // Row i is now the row which was at i + count, wrapping around to the rows which are blanked:
+        final int shift = (count > 0) ? count : rows + count;
+        for (int i = 0; i < rows; i++) {
+            int internalRow = externalToInternalRow(top + i);
+            TerminalRow line = mRotatedRows[(i + shift) % rows];
+            mLines[internalRow] = line;
+            boolean revealed = (count > 0) ? (i >= rows - count) : (i < -count);
+            if (revealed && !mDiscardingRows) line = clearRow(internalRow, style);
+            if (line != null) line.mLineWrap = mRotatedLineWraps[i];
+        }
+        Arrays.fill(mRotatedRows, 0, rows, null);
+    }
+
     public TerminalRow allocateFullLineIfNecessary(int row) {
-        return (mLines[row] == null) ? (mLines[row] = new TerminalRow(mColumns, 0)) : mLines[row];
+        TerminalRow line = mLines[row];
+        if (line == null) return mLines[row] = new TerminalRow(mColumns, 0);
+        if (line.mPacked != 0) unpackTranscriptRow(row, line);
+        else line.applyPendingClear();
+        return line;
+    }
+
+    /** Blank the row at the internal index with a style, lazily unless it has to be allocated. */
+    private TerminalRow clearRow(int internalRow, long style) {
+        TerminalRow line = mLines[internalRow];
+        if (line == null) return mLines[internalRow] = new TerminalRow(mColumns, style);
+        if (line.mPacked != 0) releasePackedRow(line);
+        line.clearLazily(style);
+        return line;
+    }
+
+    /** Convert a row in the internal coordinate system to the external, see {@link #externalToInternalRow(int)}. */
+    private int internalToExternalRow(int internalRow) {
+        int externalRow = internalRow - mScreenFirstRow;
+        if (externalRow < 0) externalRow += mTotalRows;
+        return (externalRow >= mScreenRows) ? (externalRow - mTotalRows) : externalRow;
+    }
+
+    /** Pack the row at the internal index into the cell store, unless already packed or it cannot be. */
+    private void packRow(int internalRow) {
+        TerminalRow line = mLines[internalRow];
+        if (line == null || line.mPacked != 0) return;
+        line.applyPendingClear();
+        if (mCellStore == null) mCellStore = new CellStore();
+        long packed = mCellStore.pack(line.mText, line.getSpaceUsed(), line.mStyle);
+        if (packed == 0) return;
+        if (mSpareArrays < MAX_SPARE_ARRAYS) {
+            mSpareTexts[mSpareArrays] = line.mText;
+            mSpareStyles[mSpareArrays++] = line.mStyle;
+        }
+        line.setPacked(packed);
+    }
+
+    /** Append a transcript row to the transcript file, returning false if it could not be. */
+    private boolean spillRow(int internalRow) {
+        TerminalRow line = mLines[internalRow];
+        if (line == null) {
+            line = (mSpillRow != null && mSpillRow.getColumns() == mColumns) ? mSpillRow : new TerminalRow(mColumns, TextStyle.NORMAL);
+            line.clear(TextStyle.NORMAL);
+            mSpillRow = line;
+        } else if (line.mPacked != 0) {
+            line = mSpillRow = unpackCopy(mCellStore, line, mSpillRow);
+        } else {
+            line.applyPendingClear();
+        }
+        return mTranscriptFile.append(line);
+    }
+
+    /** Compress the packed rows of the {@link #COLD_BLOCK_ROWS} rows before row -{@link #COLD_DELAY_ROWS}. */
+    private void compressColdBlock() {
+        if (mColdBlockHandles == null) mColdBlockHandles = new long[COLD_BLOCK_ROWS];
+        int count = 0;
+        for (int row = -COLD_DELAY_ROWS - COLD_BLOCK_ROWS; row < -COLD_DELAY_ROWS; row++) {
+            TerminalRow line = mLines[externalToInternalRow(row)];
+            if (line != null && line.mPacked != 0) mColdBlockHandles[count++] = line.mPacked;
+        }
+        if (count == 0 || !mCellStore.compress(mColdBlockHandles, count)) return;
+        count = 0;
+        for (int row = -COLD_DELAY_ROWS - COLD_BLOCK_ROWS; row < -COLD_DELAY_ROWS; row++) {
+            TerminalRow line = mLines[externalToInternalRow(row)];
+            if (line != null && line.mPacked != 0) line.mPacked = mColdBlockHandles[count++];
+        }
+    }
+
+    /** Compress the rows past the cold delay which have been packed again, see {@link #mRepackedColdRows}. */
+    private void compressRepackedColdRows() {
+        if (mColdBlockHandles == null) mColdBlockHandles = new long[COLD_BLOCK_ROWS];
+        int count = 0;
+        for (int i = 0; i < mRepackedColdRowCount; i++) {
+            int row = mRepackedColdRowIndices[i];
+            TerminalRow line = mRepackedColdRows[i];
+            mRepackedColdRows[i] = null;
+            // Leave out rows which have been unpacked, replaced or taken twice since.
+            if (row >= mTotalRows || mLines[row] != line || line.mPacked == 0) continue;
+            boolean taken = false;
+            for (int j = 0; j < count && !taken; j++) taken = mRepackedColdRows[j] == line;
+            if (taken) continue;
+            mRepackedColdRows[count] = line;
+            mColdBlockHandles[count++] = line.mPacked;
+        }
+        mRepackedColdRowCount = 0;
+        if (count > 0 && mCellStore.compress(mColdBlockHandles, count)) {
+            for (int i = 0; i < count; i++) mRepackedColdRows[i].mPacked = mColdBlockHandles[i];
+        }
+        Arrays.fill(mRepackedColdRows, 0, count, null);
+    }
+
+    /** Unpack a transcript row being accessed, and pack the row unpacked the longest ago again if still unused. */
+    private void unpackTranscriptRow(int internalRow, TerminalRow line) {
+        unpackRow(line);
+
+        final int slot = mNextUnpackedRow;
+        TerminalRow evictedLine = mUnpackedRows[slot];
+        int evictedRow = mUnpackedRowIndices[slot];
+        mUnpackedRows[slot] = line;
+        mUnpackedRowIndices[slot] = internalRow;
+        mNextUnpackedRow = (slot + 1) % MAX_UNPACKED_ROWS;
+
+        if (evictedLine != null && evictedRow < mTotalRows && mLines[evictedRow] == evictedLine) {
+            int externalRow = internalToExternalRow(evictedRow);
+            if (externalRow < -PACKING_DELAY_ROWS && externalRow >= -mActiveTranscriptRows) {
+                packRow(evictedRow);
+                // Rows packed again past the cold delay are compressed again too, once there is a block of them.
+                if (externalRow < -COLD_DELAY_ROWS && evictedLine.mPacked != 0) {
+                    mRepackedColdRowIndices[mRepackedColdRowCount] = evictedRow;
+                    mRepackedColdRows[mRepackedColdRowCount++] = evictedLine;
+                    if (mRepackedColdRowCount == COLD_BLOCK_ROWS) compressRepackedColdRows();
+                }
+            }
+        }
+    }
+
+    private void unpackRow(TerminalRow line) {
+        char[] text = takeSpareText(line.getColumns());
+        long[] style = takeSpareStyle(line.getColumns());
+        int result = mCellStore.unpack(line.mPacked, text, style);
+        if (result < 0) {
+            text = new char[-result + line.getColumns()];
+            result = mCellStore.unpack(line.mPacked, text, style);
+        }
+        mCellStore.free(line.mPacked);
+        line.setUnpacked(text, style, result & CellStore.UNPACKED_SPACE_USED_MASK, (result & CellStore.UNPACKED_NON_ONE_WIDTH) != 0);
+    }
+
+    /** Unpack a copy of a packed row from the given store, into copy if it is not null. */
+    private static TerminalRow unpackCopy(CellStore cellStore, TerminalRow line, TerminalRow copy) {
+        if (copy == null || copy.getColumns() != line.getColumns()) copy = new TerminalRow(line.getColumns(), TextStyle.NORMAL);
+        char[] text = copy.mText;
+        int result = cellStore.unpack(line.mPacked, text, copy.mStyle);
+        if (result < 0) {
+            text = new char[-result + line.getColumns()];
+            result = cellStore.unpack(line.mPacked, text, copy.mStyle);
+        }
+        copy.setUnpacked(text, copy.mStyle, result & CellStore.UNPACKED_SPACE_USED_MASK, (result & CellStore.UNPACKED_NON_ONE_WIDTH) != 0);
+        copy.mLineWrap = line.mLineWrap;
+        return copy;
+    }
+
+    /** Free the cells of a packed row which is to be overwritten, giving it arrays to be cleared. */
+    private void releasePackedRow(TerminalRow line) {
+        mCellStore.free(line.mPacked);
+        line.setUnpacked(takeSpareText(line.getColumns()), takeSpareStyle(line.getColumns()), 0, false);
+    }
+
+    private char[] takeSpareText(int columns) {
+        if (mSpareArrays > 0 && mSpareStyles[mSpareArrays - 1].length == columns) {
+            char[] text = mSpareTexts[mSpareArrays - 1];
+            mSpareTexts[mSpareArrays - 1] = null;
+            return text;
+        }
+        return new char[columns + columns / 2];
+    }
+
+    /** Take the style array of the spare arrays whose text was taken by {@link #takeSpareText(int)}, if any. */
+    private long[] takeSpareStyle(int columns) {
+        if (mSpareArrays > 0 && mSpareTexts[mSpareArrays - 1] == null) {
+            long[] style = mSpareStyles[--mSpareArrays];
+            mSpareStyles[mSpareArrays] = null;
+            return style;
+        }
+        return new long[columns];
+    }
+
+    private void forgetUnpackedAndSpareRows() {
+        Arrays.fill(mUnpackedRows, null);
+        Arrays.fill(mSpareTexts, null);
+        Arrays.fill(mSpareStyles, null);
+        mSpareArrays = 0;
+        mRowsSinceColdBlock = 0;
+        Arrays.fill(mRepackedColdRows, null);
+        mRepackedColdRowCount = 0;
     }
 
     public void setChar(int column, int row, int codePoint, long style) {
         if (row  < 0 || row >= mScreenRows || column < 0 || column >= mColumns)
             throw new IllegalArgumentException("TerminalBuffer.setChar(): row=" + row + ", column=" + column + ", mScreenRows=" + mScreenRows + ", mColumns=" + mColumns);
+        if (mDiscardingRows) return;
+        mDamagedRows[row >> 6] |= 1L << row;
         row = externalToInternalRow(row);
         allocateFullLineIfNecessary(row).setChar(column, codePoint, style);
     }
 
+    /** Set count printable ASCII characters from chars, starting at the given column. All must fit on the row. */
+    public void setPrintableAsciiChars(int column, int row, byte[] chars, int offset, int count, long style) {
+        if (row < 0 || row >= mScreenRows || column < 0 || column + count > mColumns)
+            throw new IllegalArgumentException("TerminalBuffer.setPrintableAsciiChars(): row=" + row + ", column=" + column + ", count=" + count + ", mScreenRows=" + mScreenRows + ", mColumns=" + mColumns);
+        if (mDiscardingRows) return;
+        mDamagedRows[row >> 6] |= 1L << row;
+        allocateFullLineIfNecessary(externalToInternalRow(row)).setPrintableAsciiChars(column, chars, offset, count, style);
+    }
+
     public long getStyleAt(int externalRow, int column) {
         return allocateFullLineIfNecessary(externalToInternalRow(externalRow)).getStyle(column);
     }
@@ -462,8 +842,9 @@ public final class TerminalBuffer {
     /** Support for http://vt100.net/docs/vt510-rm/DECCARA and http://vt100.net/docs/vt510-rm/DECCARA */
     public void setOrClearEffect(int bits, boolean setOrClear, boolean reverse, boolean rectangular, int leftMargin, int rightMargin, int top, int left,
                                  int bottom, int right) {
+        markRowsDamaged(top, bottom);
         for (int y = top; y < bottom; y++) {
-            TerminalRow line = mLines[externalToInternalRow(y)];
+            TerminalRow line = allocateFullLineIfNecessary(externalToInternalRow(y));
             int startOfLine = (rectangular || y == top) ? left : leftMargin;
             int endOfLine = (rectangular || y + 1 == bottom) ? right : rightMargin;
             for (int x = startOfLine; x < endOfLine; x++) {
@@ -484,7 +865,134 @@ public final class TerminalBuffer {
         }
     }
 
+    /**
+     * Reflow about maxRows more rows of the transcript left by a resize which changed the number of columns, above the
+     * current transcript. Rows are reflowed a line at a time, from the bottom up, so rows already in the transcript
+     * keep their external rows. The emulator monitor has to be held.
+     *
+     * @return true if there are rows left to reflow.
+     */
+    boolean reflowHistory(int maxRows) {
+        return reflowHistory(maxRows, Integer.MAX_VALUE, true);
+    }
+
+    /** Reflow all of the transcript left by a resize, for when the whole transcript is needed. */
+    void finishReflow() {
+        reflowHistory(Integer.MAX_VALUE);
+    }
+
+    /** Reflow lines until maxOldRows old rows are reflowed or there are minTranscriptRows transcript rows. */
+    private boolean reflowHistory(int maxOldRows, int minTranscriptRows, boolean pack) {
+        final ReflowSource source = mReflowSource;
+        if (source == null) return false;
+        while (source.mNextRow >= source.mFirstRow && maxOldRows > 0 && mActiveTranscriptRows < minTranscriptRows) {
+            final int endRow = source.mNextRow;
+            int startRow = endRow;
+            while (startRow > source.mFirstRow && source.isLineWrap(startRow - 1)) startRow--;
+            for (int i = reflowLine(source, startRow, endRow) - 1; i >= 0; i--) {
+                if (mActiveTranscriptRows >= mTotalRows - mScreenRows) {
+                    // The older rows would not have fitted in the transcript either.
+                    discardReflow();
+                    return false;
+                }
+                int internalRow = externalToInternalRow(-mActiveTranscriptRows - 1);
+                mLines[internalRow] = mReflowedRows[i];
+                mReflowedRows[i] = null;
+                mActiveTranscriptRows++;
+                if (pack && CellStore.AVAILABLE && mActiveTranscriptRows > PACKING_DELAY_ROWS) packRow(internalRow);
+            }
+            maxOldRows -= endRow - startRow + 1;
+            source.mNextRow = startRow - 1;
+        }
+        if (source.mNextRow < source.mFirstRow) discardReflow();
+        return mReflowSource != null;
+    }
+
+    /** Reflow the old rows of a line into {@link #mReflowedRows}, returning the number of rows. */
+    private int reflowLine(ReflowSource source, int startRow, int endRow) {
+        int rows = 0;
+        TerminalRow output = new TerminalRow(mColumns, source.mStyle);
+        int outputColumn = 0;
+        for (int oldRow = startRow; oldRow <= endRow; oldRow++) {
+            TerminalRow oldLine = source.getLine(oldRow);
+            if (oldLine == null) continue;
+            // Trailing spaces are only kept if the line continues on the next row, as in resize():
+            int end = oldLine.getSpaceUsed();
+            if (!oldLine.mLineWrap) while (end > 0 && oldLine.mText[end - 1] == ' ') end--;
+
+            int oldColumn = 0;
+            long styleAtColumn = 0;
+            for (int i = 0; i < end; i++) {
+                char c = oldLine.mText[i];
+                int codePoint = (Character.isHighSurrogate(c)) ? Character.toCodePoint(c, oldLine.mText[++i]) : c;
+                int displayWidth = WcWidth.width(codePoint);
+                if (displayWidth > 0) styleAtColumn = oldLine.getStyle(oldColumn);
+                if (outputColumn + displayWidth > mColumns) {
+                    output.mLineWrap = true;
+                    if (rows == mReflowedRows.length) mReflowedRows = Arrays.copyOf(mReflowedRows, 2 * rows);
+                    mReflowedRows[rows++] = output;
+                    output = new TerminalRow(mColumns, source.mStyle);
+                    outputColumn = 0;
+                }
+                output.setChar(outputColumn - ((displayWidth <= 0 && outputColumn > 0) ? 1 : 0), codePoint, styleAtColumn);
+                if (displayWidth > 0) {
+                    oldColumn += displayWidth;
+                    outputColumn += displayWidth;
+                }
+            }
+        }
+        if (rows == mReflowedRows.length) mReflowedRows = Arrays.copyOf(mReflowedRows, 2 * rows);
+        mReflowedRows[rows++] = output;
+        return rows;
+    }
+
+    private void discardReflow() {
+        if (mReflowSource == null) return;
+        if (mReflowSource.mCellStore != null) mReflowSource.mCellStore.reset();
+        mReflowSource = null;
+    }
+
+    /** Mark the screen rows from fromRow to toRow (exclusive) as changed, see {@link #takeDamagedRows(long[])}. */
+    void markRowsDamaged(int fromRow, int toRow) {
+        for (int row = Math.max(0, fromRow), end = Math.min(mScreenRows, toRow); row < end; row++)
+            mDamagedRows[row >> 6] |= 1L << row;
+    }
+
+    void markAllRowsDamaged() {
+        mAllRowsDamaged = true;
+    }
+
+    /**
+     * Add the screen rows changed since the previous call to a bit set of screen rows, and reset them.
+     *
+     * @return true if all rows have to be considered changed, such as after a resize, in which case the bit set is
+     * not updated.
+     */
+    boolean takeDamagedRows(long[] damagedRows) {
+        boolean allRowsDamaged = mAllRowsDamaged;
+        if (!allRowsDamaged) {
+            for (int i = 0; i < mDamagedRows.length && i < damagedRows.length; i++)
+                damagedRows[i] |= mDamagedRows[i];
+        }
+        Arrays.fill(mDamagedRows, 0);
+        mAllRowsDamaged = false;
+        return allRowsDamaged;
+    }
+
     public void clearTranscript() {
+        mHistoryGeneration++;
+        discardReflow();
+        if (mTranscriptFile != null) mTranscriptFile.clear();
+        if (mCellStore != null) {
+            for (int row = -mActiveTranscriptRows; row < 0; row++) {
+                TerminalRow line = mLines[externalToInternalRow(row)];
+                if (line != null && line.mPacked != 0) mCellStore.free(line.mPacked);
+            }
+            Arrays.fill(mUnpackedRows, null);
+            mRowsSinceColdBlock = 0;
+            Arrays.fill(mRepackedColdRows, null);
+            mRepackedColdRowCount = 0;
+        }
         if (mScreenFirstRow < mActiveTranscriptRows) {
             Arrays.fill(mLines, mTotalRows + mScreenFirstRow - mActiveTranscriptRows, mTotalRows, null);
             Arrays.fill(mLines, 0, mScreenFirstRow, null);
@@ -494,4 +1002,50 @@ public final class TerminalBuffer {
         mActiveTranscriptRows = 0;
     }
 
+    /** The rows of a buffer before a resize which changed the number of columns, to reflow them from. */
+    private static final class ReflowSource {
+
+        final TerminalRow[] mLines;
+        /** The store of the packed rows of {@link #mLines}, which is reset once all have been reflowed. */
+        final CellStore mCellStore;
+        final int mScreenFirstRow;
+        final int mTotalRows;
+        /** The first transcript row, as an external row of the old state. */
+        final int mFirstRow;
+        /** The style of the blank rows to reflow into. */
+        final long mStyle;
+        /** The last row left to reflow, as an external row of the old state, or above {@link #mFirstRow} if none. */
+        int mNextRow;
+        private TerminalRow mUnpackedLine;
+
+        ReflowSource(TerminalRow[] lines, CellStore cellStore, int screenFirstRow, int totalRows, int firstRow, long style) {
+            mLines = lines;
+            mCellStore = cellStore;
+            mScreenFirstRow = screenFirstRow;
+            mTotalRows = totalRows;
+            mFirstRow = firstRow;
+            mStyle = style;
+        }
+
+        /** Do what externalToInternalRow() does but for the old state. */
+        private int internalRow(int externalRow) {
+            int internalRow = mScreenFirstRow + externalRow;
+            return (internalRow < 0) ? (mTotalRows + internalRow) : (internalRow % mTotalRows);
+        }
+
+        /** The row, or an unpacked copy of it which is valid until the next call, or null. */
+        TerminalRow getLine(int externalRow) {
+            TerminalRow line = mLines[internalRow(externalRow)];
+            if (line != null && line.mPacked != 0) return mUnpackedLine = unpackCopy(mCellStore, line, mUnpackedLine);
+            if (line != null) line.applyPendingClear();
+            return line;
+        }
+
+        boolean isLineWrap(int externalRow) {
+            TerminalRow line = mLines[internalRow(externalRow)];
+            return line != null && line.mLineWrap;
+        }
+
+    }
+
 }
@@ -129,6 +129,11 @@ public final class TerminalEmulator {
     private static final int DECSET_BIT_LEFTRIGHT_MARGIN_MODE = 1 << 11;
     /** Not really DECSET bit... - http://www.vt100.net/docs/vt510-rm/DECSACE */
     private static final int DECSET_BIT_RECTANGULAR_CHANGEATTRIBUTE = 1 << 12;
+    /** DECSET 2026 - synchronized output, see {@link #getSynchronizedUpdateMillisLeft()}. */
+    private static final int DECSET_BIT_SYNCHRONIZED_UPDATE = 1 << 13;
+
+    /** How long a synchronized update may hold back showing the screen, in case it is never ended. */
+    public static final int SYNCHRONIZED_UPDATE_TIMEOUT_MILLIS = 150;
 
 
     private String mTitle;
@@ -268,6 +273,14 @@ public final class TerminalEmulator {
     private byte mUtf8ToFollow, mUtf8Index;
     private final byte[] mUtf8InputBuffer = new byte[4];
     private int mLastEmittedCodePoint = -1;
+    /** Start and end indices of the printable ASCII runs in the buffer being appended, see {@link #append(byte[], int)}. */
+    private int[] mPrintableRuns = new int[0];
+    /** Output of {@link Utf8Decoder#decode(byte[], int, int, int[])}, see {@link #processBytes(byte[], int, int)}. */
+    private int[] mDecoded = new int[0];
+    /** If output is flooding in, see {@link #setFloodMode(boolean)}. */
+    private boolean mFloodMode;
+    /** When the current synchronized update was started, in {@link System#nanoTime()}. */
+    private long mSynchronizedUpdateStartNanos;
 
     public final TerminalColors mColors = new TerminalColors();
 
@@ -319,6 +332,8 @@ public final class TerminalEmulator {
                 return DECSET_BIT_MOUSE_PROTOCOL_SGR;
             case 2004:
                 return DECSET_BIT_BRACKETED_PASTE_MODE;
+            case 2026:
+                return DECSET_BIT_SYNCHRONIZED_UPDATE;
             default:
                 return -1;
             // throw new IllegalArgumentException("Unsupported decset: " + decsetBit);
@@ -348,6 +363,21 @@ public final class TerminalEmulator {
         return mScreen;
     }
 
+    /** Keep the rows which scroll out of the transcript of the main buffer in a file, see {@link TranscriptFile}. */
+    public void setTranscriptFile(TranscriptFile transcriptFile) {
+        mMainBuffer.setTranscriptFile(transcriptFile);
+    }
+
+    /**
+     * Reflow about maxRows more rows of the history of the main buffer which was left to be reflowed by a resize, see
+     * {@link TerminalBuffer#resize(int, int, int, int[], long, boolean)}.
+     *
+     * @return true if there are rows left to reflow.
+     */
+    public boolean reflowHistory(int maxRows) {
+        return mMainBuffer.reflowHistory(maxRows);
+    }
+
     public boolean isAlternateBufferActive() {
         return mScreen == mAltBuffer;
     }
@@ -471,6 +501,11 @@ public final class TerminalEmulator {
         this.mCursorBlinkState = cursorBlinkState;
     }
 
+    /** If the cursor is not hidden by blinking. The blink state is only used by the UI thread. */
+    boolean isCursorInVisibleBlinkState() {
+        return !mCursorBlinkingEnabled || mCursorBlinkState;
+    }
+
 
 
     public boolean isKeypadApplicationMode() {
@@ -481,6 +516,17 @@ public final class TerminalEmulator {
         return isDecsetInternalBitSet(DECSET_BIT_APPLICATION_CURSOR_KEYS);
     }
 
+    /**
+     * The time left in milliseconds for which the screen should not be shown, since the application is in the middle
+     * of updating it between "CSI ? 2026 h" and "CSI ? 2026 l", or 0 if it should be shown. An update which is not
+     * ended within {@link #SYNCHRONIZED_UPDATE_TIMEOUT_MILLIS} no longer holds back the screen.
+     */
+    public long getSynchronizedUpdateMillisLeft() {
+        if (!isDecsetInternalBitSet(DECSET_BIT_SYNCHRONIZED_UPDATE)) return 0;
+        long elapsedMillis = (System.nanoTime() - mSynchronizedUpdateStartNanos) / 1000000;
+        return Math.max(0, SYNCHRONIZED_UPDATE_TIMEOUT_MILLIS - elapsedMillis);
+    }
+
     /** If mouse events are being sent as escape codes to the terminal. */
     public boolean isMouseTrackingActive() {
         return isDecsetInternalBitSet(DECSET_BIT_MOUSE_TRACKING_PRESS_RELEASE) || isDecsetInternalBitSet(DECSET_BIT_MOUSE_TRACKING_BUTTON_EVENT);
@@ -498,10 +544,126 @@ public final class TerminalEmulator {
      * @param length the number of bytes in the array to process
      */
     public void append(byte[] buffer, int length) {
-        for (int i = 0; i < length; i++)
+        int runsArrayLength = PrintableRunScanner.runsArrayLength(length);
+        if (mPrintableRuns.length < runsArrayLength) mPrintableRuns = new int[runsArrayLength];
+        final int[] runs = mPrintableRuns;
+        final int runCount = PrintableRunScanner.findRuns(buffer, length, runs);
+
+        if (mFloodMode) {
+            // Output followed by as many line feeds as the screen has rows, including the transcript, will have
+            // scrolled out of it by the end of the buffer, as long as the output in between only prints and scrolls.
+            long scrolledOff = FloodScanner.findScrolledOffOutput(buffer, length, mScreen.mTotalRows);
+            int scrolledOffStart = (int) (scrolledOff >>> 32);
+            int scrolledOffEnd = (int) scrolledOff;
+            if (scrolledOffEnd > scrolledOffStart) {
+                int run = appendRange(buffer, 0, scrolledOffStart, runs, runCount, 0);
+                mScreen.mDiscardingRows = canDiscardScrolledOffRows();
+                try {
+                    run = appendRange(buffer, scrolledOffStart, scrolledOffEnd, runs, runCount, run);
+                } finally {
+                    mScreen.mDiscardingRows = false;
+                }
+                appendRange(buffer, scrolledOffEnd, length, runs, runCount, run);
+                return;
+            }
+        }
+        appendRange(buffer, 0, length, runs, runCount, 0);
+    }
+
+    /**
+     * Process the bytes from start (inclusive) to end (exclusive), writing the parts of the printable runs from
+     * firstRun in the range in bulk.
+     *
+     * @return the index of the first run not completely processed.
+     */
+    private int appendRange(byte[] buffer, int start, int end, int[] runs, int runCount, int firstRun) {
+        int i = start;
+        int run = firstRun;
+        for (; run < runCount && runs[2 * run] < end; run++) {
+            final int runStart = Math.max(runs[2 * run], i);
+            final int runEnd = Math.min(runs[2 * run + 1], end);
+            processBytes(buffer, i, runStart);
+            i = runStart;
+            // A run may start inside an escape sequence, such as "[31m" after ESC, so process it byte by byte until
+            // back in the ground state, from where the rest of it is printable text.
+            while (i < runEnd) {
+                if (mUtf8ToFollow == 0 && mEscapeState == ESC_NONE) {
+                    emitPrintableAsciiRun(buffer, i, runEnd);
+                    i = runEnd;
+                } else {
+                    processByte(buffer[i++]);
+                }
+            }
+            if (runs[2 * run + 1] > end) break;
+        }
+        processBytes(buffer, i, end);
+        return run;
+    }
+
+    /**
+     * Set if output is arriving faster than it can be seen. Output which {@link FloodScanner} finds to scroll out of
+     * the transcript before the end of the buffer passed to {@link #append(byte[], int)} is then parsed without
+     * writing it to the screen.
+     */
+    void setFloodMode(boolean floodMode) {
+        mFloodMode = floodMode;
+    }
+
+    /**
+     * If output which only prints and scrolls, processed from the current state, can only change the cursor row and
+     * rows scrolled in below it. Otherwise rows that remain visible could be written to. Rows are never discarded with
+     * a transcript file, which is to keep all of them.
+     */
+    private boolean canDiscardScrolledOffRows() {
+        return mEscapeState == ESC_NONE && !mInsertMode && mTopMargin == 0 && mBottomMargin == mRows
+            && mLeftMargin == 0 && mRightMargin == mColumns && mScreen.mTranscriptFile == null;
+    }
+
+    /** Process the bytes from start (inclusive) to end (exclusive), decoding them natively if worthwhile. */
+    private void processBytes(byte[] buffer, int start, int end) {
+        int i = start;
+        if (end - start >= Utf8Decoder.MIN_NATIVE_DECODE_LENGTH && NativeLibrary.AVAILABLE) {
+            // The native decoder starts without a sequence in progress, so first complete one split from earlier input.
+            while (i < end && mUtf8ToFollow > 0)
+                processByte(buffer[i++]);
+            if (mDecoded.length < end - i) mDecoded = new int[end - i];
+            long result = Utf8Decoder.decode(buffer, i, end - i, mDecoded);
+            processDecoded(mDecoded, (int) result);
+            // An incomplete sequence at the end is left for processByte(), to be completed by the next input.
+            i += (int) (result >>> 32);
+        }
+        for (; i < end; i++)
             processByte(buffer[i]);
     }
 
+    /** Process code points from {@link Utf8Decoder}, as {@link #processByte(byte)} does once it has decoded one. */
+    private void processDecoded(int[] decoded, int count) {
+        for (int i = 0; i < count; i++) {
+            final int value = decoded[i];
+            int codePoint = value & Utf8Decoder.CODE_POINT_MASK;
+            int displayWidth = (value >>> Utf8Decoder.WIDTH_SHIFT) & Utf8Decoder.WIDTH_MASK;
+            if ((value & Utf8Decoder.FLAG_EMIT) != 0) {
+                emitCodePoint(codePoint, displayWidth);
+                continue;
+            }
+            if (codePoint >= 0x80) {
+                switch (Character.getType(codePoint)) {
+                    case Character.UNASSIGNED:
+                    case Character.SURROGATE:
+                        codePoint = UNICODE_REPLACEMENT_CHAR;
+                        displayWidth = WcWidth.width(codePoint);
+                }
+            }
+            if (mEscapeState == ESC_NONE && codePoint >= 32) {
+                // What processCodePoint() does in the ground state, but with the width already known.
+                mContinueSequence = false;
+                emitCodePoint(codePoint, displayWidth);
+            } else {
+                processCodePoint(codePoint);
+            }
+        }
+    }
+
     private void processByte(byte byteToProcess) {
         if (mUtf8ToFollow > 0) {
             if ((byteToProcess & 0b11000000) == 0b10000000) {
@@ -1185,6 +1347,9 @@ public final class TerminalEmulator {
 
     public void doDecSetOrReset(boolean setting, int externalBit) {
         int internalBit = mapDecSetBitToInternalBit(externalBit);
+        // The timeout of a synchronized update is from its start, not from the last time it was set:
+        if (internalBit == DECSET_BIT_SYNCHRONIZED_UPDATE && setting && !isDecsetInternalBitSet(internalBit))
+            mSynchronizedUpdateStartNanos = System.nanoTime();
         if (internalBit != -1) {
             setDecsetinternalBit(internalBit, setting);
         }
@@ -1217,8 +1382,7 @@ public final class TerminalEmulator {
             case 9: // X10 mouse reporting - outdated. Do not implement.
             case 12: // Control cursor blinking - ignore.
             case 25: // Hide/show cursor - no action needed, renderer will check with shouldCursorBeVisible().
-                if (mClient != null)
-                    mClient.onTerminalCursorStateChange(setting);
+                mSession.onTerminalCursorStateChange(setting);
                 break;
             case 40: // Allow 80 => 132 Mode, ignore.
             case 45: // TODO: Reverse wrap-around. Implement???
@@ -1256,6 +1420,7 @@ public final class TerminalEmulator {
                     boolean resized = !(newScreen.mColumns == mColumns && newScreen.mScreenRows == mRows);
                     if (setting) saveCursor();
                     mScreen = newScreen;
+                    mScreen.markAllRowsDamaged();
                     if (!setting) {
                         int col = mSavedStateMain.mSavedCursorCol;
                         int row = mSavedStateMain.mSavedCursorRow;
@@ -1277,6 +1442,9 @@ public final class TerminalEmulator {
             case 2004:
                 // Bracketed paste mode - setting bit is enough.
                 break;
+            case 2026:
+                // Synchronized output - setting bit is enough, see getSynchronizedUpdateMillisLeft().
+                break;
             default:
                 unknownParameter(externalBit);
                 break;
@@ -1462,8 +1630,12 @@ public final class TerminalEmulator {
                 // http://www.vt100.net/docs/vt100-ug/chapter3.html: "Move the active position to the same horizontal
                 // position on the preceding line. If the active position is at the top margin, a scroll down is performed".
                 if (mCursorRow <= mTopMargin) {
-                    mScreen.blockCopy(mLeftMargin, mTopMargin, mRightMargin - mLeftMargin, mBottomMargin - (mTopMargin + 1), mLeftMargin, mTopMargin + 1);
-                    blockClear(mLeftMargin, mTopMargin, mRightMargin - mLeftMargin);
+                    if (mLeftMargin == 0 && mRightMargin == mColumns) {
+                        mScreen.scrollRows(mTopMargin, mBottomMargin, -1, getStyle());
+                    } else {
+                        mScreen.blockCopy(mLeftMargin, mTopMargin, mRightMargin - mLeftMargin, mBottomMargin - (mTopMargin + 1), mLeftMargin, mTopMargin + 1);
+                        blockClear(mLeftMargin, mTopMargin, mRightMargin - mLeftMargin);
+                    }
                 } else {
                     mCursorRow--;
                 }
@@ -1627,9 +1799,7 @@ public final class TerminalEmulator {
             {
                 int linesAfterCursor = mBottomMargin - mCursorRow;
                 int linesToInsert = Math.min(getArg0(1), linesAfterCursor);
-                int linesToMove = linesAfterCursor - linesToInsert;
-                mScreen.blockCopy(0, mCursorRow, mColumns, linesToMove, 0, mCursorRow + linesToInsert);
-                blockClear(0, mCursorRow, mColumns, linesToInsert);
+                if (linesToInsert > 0) mScreen.scrollRows(mCursorRow, mBottomMargin, -linesToInsert, getStyle());
             }
             break;
             case 'M': // "${CSI}${N}M" - delete N lines (DL).
@@ -1637,9 +1807,7 @@ public final class TerminalEmulator {
                 mAboutToAutoWrap = false;
                 int linesAfterCursor = mBottomMargin - mCursorRow;
                 int linesToDelete = Math.min(getArg0(1), linesAfterCursor);
-                int linesToMove = linesAfterCursor - linesToDelete;
-                mScreen.blockCopy(0, mCursorRow + linesToDelete, mColumns, linesToMove, 0, mCursorRow);
-                blockClear(0, mCursorRow + linesToMove, mColumns, linesToDelete);
+                if (linesToDelete > 0) mScreen.scrollRows(mCursorRow, mBottomMargin, linesToDelete, getStyle());
             }
             break;
             case 'P': // "${CSI}{N}P" - delete ${N} characters (DCH).
@@ -1672,8 +1840,12 @@ public final class TerminalEmulator {
                     final int linesToScrollArg = getArg0(1);
                     final int linesBetweenTopAndBottomMargins = mBottomMargin - mTopMargin;
                     final int linesToScroll = Math.min(linesBetweenTopAndBottomMargins, linesToScrollArg);
-                    mScreen.blockCopy(mLeftMargin, mTopMargin, mRightMargin - mLeftMargin, linesBetweenTopAndBottomMargins - linesToScroll, mLeftMargin, mTopMargin + linesToScroll);
-                    blockClear(mLeftMargin, mTopMargin, mRightMargin - mLeftMargin, linesToScroll);
+                    if (mLeftMargin == 0 && mRightMargin == mColumns) {
+                        mScreen.scrollRows(mTopMargin, mBottomMargin, -linesToScroll, getStyle());
+                    } else {
+                        mScreen.blockCopy(mLeftMargin, mTopMargin, mRightMargin - mLeftMargin, linesBetweenTopAndBottomMargins - linesToScroll, mLeftMargin, mTopMargin + linesToScroll);
+                        blockClear(mLeftMargin, mTopMargin, mRightMargin - mLeftMargin, linesToScroll);
+                    }
                 } else {
                     // "${CSI}${func};${startx};${starty};${firstrow};${lastrow}T" - initiate highlight mouse tracking.
                     unimplementedSequence(b);
@@ -2346,8 +2518,20 @@ public final class TerminalEmulator {
      * @param codePoint The code point of the character to display
      */
     private void emitCodePoint(int codePoint) {
+        emitCodePoint(codePoint, -1);
+    }
+
+    /**
+     * Send a Unicode code point to the screen.
+     *
+     * @param codePoint    The code point of the character to display
+     * @param displayWidth The {@link WcWidth#width(int)} of the code point if already known, or -1
+     */
+    private void emitCodePoint(int codePoint, int displayWidth) {
         mLastEmittedCodePoint = codePoint;
         if (mUseLineDrawingUsesG0 ? mUseLineDrawingG0 : mUseLineDrawingG1) {
+            // The width of the replacement character is looked up below.
+            displayWidth = -1;
             // http://www.vt100.net/docs/vt102-ug/table5-15.html.
             switch (codePoint) {
                 case '_':
@@ -2453,7 +2637,7 @@ public final class TerminalEmulator {
         }
 
         final boolean autoWrap = isDecsetInternalBitSet(DECSET_BIT_AUTOWRAP);
-        final int displayWidth = WcWidth.width(codePoint);
+        if (displayWidth < 0) displayWidth = WcWidth.width(codePoint);
         final boolean cursorInLastColumn = mCursorCol == mRightMargin - 1;
 
         if (autoWrap) {
@@ -2495,6 +2679,38 @@ public final class TerminalEmulator {
         mCursorCol = Math.min(mCursorCol + displayWidth, mRightMargin - 1);
     }
 
+    /**
+     * Send a run of printable ASCII to the screen, with the same result as calling {@link #emitCodePoint(int)} for
+     * each byte, but writing the part of the run that fits on the current line at once.
+     */
+    private void emitPrintableAsciiRun(byte[] buffer, int start, int end) {
+        mContinueSequence = false;
+        mLastEmittedCodePoint = buffer[end - 1];
+        if (mInsertMode || (mUseLineDrawingUsesG0 ? mUseLineDrawingG0 : mUseLineDrawingG1)) {
+            for (int i = start; i < end; i++)
+                emitCodePoint(buffer[i]);
+            return;
+        }
+
+        final boolean autoWrap = isDecsetInternalBitSet(DECSET_BIT_AUTOWRAP);
+        final long style = getStyle();
+        int i = start;
+        while (i < end) {
+            final int lastColumn = mRightMargin - 1;
+            if (mCursorCol >= lastColumn) {
+                // Wrapping, or overwriting the last column without autowrap.
+                emitCodePoint(buffer[i++]);
+                continue;
+            }
+            final int count = Math.min(end - i, mRightMargin - mCursorCol);
+            mScreen.setPrintableAsciiChars(mCursorCol, mCursorRow, buffer, i, count, style);
+            i += count;
+            final int lastColumnWritten = mCursorCol + count - 1;
+            if (autoWrap) mAboutToAutoWrap = (lastColumnWritten == lastColumn);
+            mCursorCol = Math.min(lastColumnWritten + 1, lastColumn);
+        }
+    }
+
     private void setCursorRow(int row) {
         mCursorRow = row;
         mAboutToAutoWrap = false;
@@ -29,4 +29,7 @@ public abstract class TerminalOutput {
 
     public abstract void onColorsChanged();
 
+    /** Notify the terminal client that the cursor has been enabled or disabled. */
+    public abstract void onTerminalCursorStateChange(boolean state);
+
 }
@@ -6,6 +6,9 @@ import java.util.Arrays;
  * A row in a terminal, composed of a fixed number of cells.
  * <p>
  * The text in the row is stored in a char[] array, {@link #mText}, for quick access during rendering.
+ * <p>
+ * Rows in the transcript may be packed into a {@link CellStore} by their {@link TerminalBuffer}, which unpacks them
+ * again before they are accessed. Likewise rows may be cleared lazily, see {@link #clearLazily(long)}.
  */
 public final class TerminalRow {
 
@@ -46,9 +49,15 @@ public final class TerminalRow {
     /** If this row has been line wrapped due to text output at the end of line. */
     boolean mLineWrap;
     /** The style bits of each cell in the row. See {@link TextStyle}. */
-    final long[] mStyle;
+    long[] mStyle;
     /** If this row might contain chars with width != 1, used for deactivating fast path */
     boolean mHasNonOneWidthOrSurrogateChars;
+    /** The {@link CellStore} handle of the row while packed, when {@link #mText} and {@link #mStyle} are null, else 0. */
+    long mPacked;
+    /** If the row has been cleared by {@link #clearLazily(long)} and its cells are yet to be written. */
+    boolean mClearPending;
+    /** The style the row is to be cleared with while {@link #mClearPending}. */
+    private long mClearStyle;
 
     /** Construct a blank row (containing only whitespace, ' ') with a specified style. */
     public TerminalRow(int columns, long style) {
@@ -88,6 +97,48 @@ public final class TerminalRow {
         return mSpaceUsed;
     }
 
+    int getColumns() {
+        return mColumns;
+    }
+
+    /** Mark the row as packed, after which its text and style arrays are no longer used by it. */
+    void setPacked(long packed) {
+        mPacked = packed;
+        mText = null;
+        mStyle = null;
+    }
+
+    /** Give a packed row its cells back, as unpacked by {@link CellStore#unpack(long, char[], long[])}. */
+    void setUnpacked(char[] text, long[] style, int spaceUsed, boolean hasNonOneWidthOrSurrogateChars) {
+        mPacked = 0;
+        mClearPending = false;
+        mText = text;
+        mStyle = style;
+        mSpaceUsed = (short) spaceUsed;
+        mHasNonOneWidthOrSurrogateChars = hasNonOneWidthOrSurrogateChars;
+    }
+
+    /**
+     * Make this row a copy of a row with the same number of columns. The source must not be packed, since only its
+     * {@link TerminalBuffer} can unpack it, so transcript rows are to be taken from
+     * {@link TerminalBuffer#getHistoryRow(int)}, which unpacks them.
+     */
+    void copyFrom(TerminalRow source) {
+        if (source.mPacked != 0)
+            throw new IllegalArgumentException("TerminalRow.copyFrom(): source row is packed");
+        if (source.mClearPending) {
+            clear(source.mClearStyle);
+            mLineWrap = source.mLineWrap;
+            return;
+        }
+        if (mText.length < source.mSpaceUsed) mText = new char[source.mText.length];
+        System.arraycopy(source.mText, 0, mText, 0, source.mSpaceUsed);
+        System.arraycopy(source.mStyle, 0, mStyle, 0, mColumns);
+        mSpaceUsed = source.mSpaceUsed;
+        mLineWrap = source.mLineWrap;
+        mHasNonOneWidthOrSurrogateChars = source.mHasNonOneWidthOrSurrogateChars;
+    }
+
     /** Note that the column may end of second half of wide character. */
     public int findStartOfColumn(int column) {
         if (column == mColumns) return getSpaceUsed();
@@ -146,6 +197,21 @@ public final class TerminalRow {
         Arrays.fill(mStyle, style);
         mSpaceUsed = (short) mColumns;
         mHasNonOneWidthOrSurrogateChars = false;
+        mClearPending = false;
+    }
+
+    /**
+     * Mark the row as cleared with a style without writing its cells, which {@link #applyPendingClear()} does before
+     * the row is next accessed. A row which is cleared again or scrolled away before then is never written at all.
+     */
+    void clearLazily(long style) {
+        mClearPending = true;
+        mClearStyle = style;
+    }
+
+    /** Write the cells of a row cleared by {@link #clearLazily(long)}, if not done yet. */
+    void applyPendingClear() {
+        if (mClearPending) clear(mClearStyle);
     }
 
     // https://github.com/steven676/Android-Terminal-Emulator/commit/9a47042620bec87617f0b4f5d50568535668fe26
@@ -270,14 +336,29 @@ public final class TerminalRow {
         }
     }
 
+    /** Set count printable ASCII characters, which all have width 1, starting at the given column. */
+    public void setPrintableAsciiChars(int startColumn, byte[] chars, int offset, int count, long style) {
+        if (mHasNonOneWidthOrSurrogateChars) {
+            for (int i = 0; i < count; i++)
+                setChar(startColumn + i, chars[offset + i], style);
+            return;
+        }
+        // Fast path as in setChar(), where each column is one java char at the index of the column.
+        Arrays.fill(mStyle, startColumn, startColumn + count, style);
+        final char[] text = mText;
+        for (int i = 0; i < count; i++)
+            text[startColumn + i] = (char) chars[offset + i];
+    }
+
     boolean isBlank() {
+        if (mClearPending) return true;
         for (int charIndex = 0, charLen = getSpaceUsed(); charIndex < charLen; charIndex++)
             if (mText[charIndex] != ' ') return false;
         return true;
     }
 
     public final long getStyle(int column) {
-        return mStyle[column];
+        return mClearPending ? mClearStyle : mStyle[column];
     }
 
 }
@@ -2,27 +2,34 @@ package com.termux.terminal;
 
 import android.annotation.SuppressLint;
 import android.os.Handler;
+import android.os.HandlerThread;
+import android.os.Looper;
 import android.os.Message;
+import android.os.SystemClock;
 import android.system.ErrnoException;
 import android.system.Os;
 import android.system.OsConstants;
+import android.view.Choreographer;
 
 import java.io.File;
-import java.io.FileDescriptor;
-import java.io.FileInputStream;
-import java.io.FileOutputStream;
 import java.io.IOException;
-import java.io.InputStream;
-import java.lang.reflect.Field;
+import java.nio.ByteBuffer;
 import java.nio.charset.StandardCharsets;
 import java.util.UUID;
+import java.util.concurrent.atomic.AtomicReference;
 
 /**
  * A terminal session, consisting of a process coupled to a terminal interface.
  * <p>
  * The subprocess will be executed by the constructor, and when the size is made known by a call to
- * {@link #updateSize(int, int, int, int)} terminal emulation will begin and threads will be spawned to handle the subprocess I/O.
- * All terminal emulation and callback methods will be performed on the main thread.
+ * {@link #updateSize(int, int, int, int)} terminal emulation will begin and the subprocess I/O is handed to the
+ * {@link PtyReactor} thread shared by all sessions, or to threads spawned for the session if it is not available.
+ * <p>
+ * Process output is emulated on an emulation thread shared by all sessions, so that output floods do not compete
+ * with input handling and drawing on the main thread. The emulation thread holds the monitor of the
+ * {@link TerminalEmulator} while changing it, which has to be held as well when accessing its screen from other
+ * threads, and publishes {@link TerminalSnapshot}s of the screen for drawing, see {@link #getScreenSnapshot(int)}.
+ * Callback methods are performed on the main thread.
  * <p>
  * The child process may be exited forcefully by using the {@link #finishIfRunning()} method.
  * <p>
@@ -32,14 +39,32 @@ public final class TerminalSession extends TerminalOutput {
 
     private static final int MSG_NEW_INPUT = 1;
     private static final int MSG_PROCESS_EXITED = 4;
+    private static final int MSG_UPDATE_SNAPSHOT = 5;
+    private static final int MSG_SCREEN_UPDATED = 6;
+    private static final int MSG_SESSION_FINISHED = 7;
+
+    /** The number of rows searched at a time by {@link #searchTranscript(TranscriptSearch, Runnable)}. */
+    static final int SEARCH_CHUNK_ROWS = 2000;
+    /** The number of rows of history reflowed at a time after a resize, see {@link #mReflowHistory}. */
+    static final int REFLOW_CHUNK_ROWS = 2000;
+    /**
+     * The delay before the pty is informed of a size change following another one, so that a burst of resizes sends
+     * the shell a SIGWINCH for its first and its last size only.
+     */
+    static final int PTY_RESIZE_DELAY_MILLIS = 100;
+
+    private static HandlerThread sEmulationThread;
+
+    /** The output rate in bytes per second from which sessions are in flood mode, see {@link #setFloodModeThreshold(int)}. */
+    private static volatile int sFloodModeThreshold = 1024 * 1024;
 
     public final String mHandle = UUID.randomUUID().toString();
 
     TerminalEmulator mEmulator;
 
     /**
-     * A queue written to from a separate thread when the process outputs, and read by main thread to process by
-     * terminal emulator.
+     * A queue written to from a separate thread when the process outputs, and read by the emulation thread to process
+     * by terminal emulator.
      */
     final ByteQueue mProcessToTerminalIOQueue = new ByteQueue(4096);
     /**
@@ -56,12 +81,27 @@ public final class TerminalSession extends TerminalOutput {
     /** The pid of the shell process. 0 if not started and -1 if finished running. */
     int mShellPid;
 
+    /** The spawn backend used to start the shell process, one of the SPAWN_BACKEND_* constants. -1 if not started. */
+    private int mSpawnBackend = -1;
+
+    /** The {@link PtyReactor} session id if the reactor does the subprocess I/O, or -1 if the session threads do it. */
+    private int mReactorSessionId = -1;
+    /** The {@link JNI#reactorOutput(int)} buffer while the reactor does the subprocess I/O, otherwise 0. */
+    private long mReactorOutput;
+    /** Output counters of the session reader thread, which are kept natively for reactor sessions. */
+    private volatile long mReaderOutputBytes, mReaderOutputWakeups;
+
+    /** Extra file descriptors to be inherited by the shell process, or null if none. */
+    private int[] mInheritFds;
+    /** The directory to create the transcript file of the session in, or null for none. See {@link TranscriptFile}. */
+    private String mTranscriptFileDirectory;
+
     /** The exit status of the shell process. Only valid if ${@link #mShellPid} is -1. */
     int mShellExitStatus;
 
     /**
      * The file descriptor referencing the master half of a pseudo-terminal pair, resulting from calling
-     * {@link JNI#createSubprocess(String, String, String[], String[], int[], int, int, int, int)}.
+     * {@link JNI#createSubprocess(String, String, String[], String[], int[], int[], int, int, int, int)}.
      */
     private int mTerminalFileDescriptor;
 
@@ -69,6 +109,54 @@ public final class TerminalSession extends TerminalOutput {
     public String mSessionName;
 
     final Handler mMainThreadHandler = new MainThreadHandler();
+    /** Handler on the emulation thread, which processes the process output. */
+    final Handler mEmulationHandler = new EmulationHandler(getEmulationLooper());
+
+    /**
+     * Screen snapshots, of which one is drawn by the main thread, one may be published and waiting to be taken by it,
+     * and one may be spare to capture the next one into.
+     */
+    private final AtomicReference<TerminalSnapshot> mPublishedSnapshot = new AtomicReference<>();
+    private final AtomicReference<TerminalSnapshot> mSpareSnapshot = new AtomicReference<>();
+    /** The snapshot taken by the main thread, only accessed by it. */
+    private TerminalSnapshot mDrawnSnapshot;
+    /**
+     * If the screen has changed since the last snapshot was captured. Only changed with the emulator monitor held, and
+     * volatile so that the main thread can check it without.
+     */
+    private volatile boolean mSnapshotOutdated;
+    /** If process output is arriving faster than the flood mode threshold, set by the emulation thread. */
+    private volatile boolean mFloodMode;
+
+    /** The size to set on the pty by {@link #mPtyResize}, only accessed by the main thread. */
+    private int mPtyColumns, mPtyRows, mPtyCellWidthPixels, mPtyCellHeightPixels;
+    /** When {@link #updateSize(int, int, int, int)} last changed the size, only accessed by the main thread. */
+    private long mLastSizeUpdateUptimeMillis = Long.MIN_VALUE / 2;
+    private final Runnable mPtyResize = () -> {
+        // The pty is closed by cleanupResources() on the emulation thread only after the session has stopped running,
+        // which waits for the lock held here.
+        synchronized (TerminalSession.this) {
+            if (isRunning())
+                JNI.setPtyWindowSize(mTerminalFileDescriptor, mPtyRows, mPtyColumns, mPtyCellWidthPixels, mPtyCellHeightPixels);
+        }
+    };
+
+    /**
+     * Reflows the history left by a resize on the emulation thread, {@link #REFLOW_CHUNK_ROWS} rows at a time so that
+     * output keeps being processed in between, reposting itself until done.
+     */
+    private final Runnable mReflowHistory = new Runnable() {
+        @Override
+        public void run() {
+            boolean more;
+            synchronized (mEmulator) {
+                more = mEmulator.reflowHistory(REFLOW_CHUNK_ROWS);
+                mSnapshotOutdated = true;
+            }
+            publishScreenSnapshot();
+            if (more) mEmulationHandler.post(this);
+        }
+    };
 
     private final String mShellPath;
     private final String mCwd;
@@ -79,6 +167,44 @@ public final class TerminalSession extends TerminalOutput {
 
     private static final String LOG_TAG = "TerminalSession";
 
+    /** Spawn backends for {@link #setPreferredSpawnBackend(int)}, see the JNI.SPAWN_BACKEND_* constants. */
+    public static final int SPAWN_BACKEND_FORK = JNI.SPAWN_BACKEND_FORK;
+    public static final int SPAWN_BACKEND_VFORK = JNI.SPAWN_BACKEND_VFORK;
+    public static final int SPAWN_BACKEND_SERVER = JNI.SPAWN_BACKEND_SERVER;
+
+    /** Set the spawn backend tried first when starting the shell of new sessions. */
+    public static void setPreferredSpawnBackend(int spawnBackend) {
+        JNI.setPreferredSpawnBackend(spawnBackend);
+    }
+
+    /**
+     * Set the size in bytes of the buffer for process output not yet processed by new sessions, between 4 KiB and
+     * 64 MiB. The process is stopped from writing more while it is full. Defaults to 1 MiB.
+     */
+    public static void setOutputBufferSize(int size) {
+        JNI.reactorSetOutputBufferSize(size);
+    }
+
+    /**
+     * Set how process output is batched before waking up the emulation thread. Output arriving within the coalescing
+     * window of the previous output is held back until the window has passed or maxBatchSize bytes are buffered,
+     * while output after a pause, such as the echo of a key press, is processed at once. A window of 0 processes all
+     * output at once. Defaults to a 2 ms window and 64 KiB batches.
+     */
+    public static void setOutputBatching(int coalescingWindowMillis, int maxBatchSize) {
+        JNI.reactorSetReadBatching(coalescingWindowMillis, maxBatchSize);
+    }
+
+    /**
+     * Set the rate of process output in bytes per second from which sessions are in flood mode, such as while cat-ing a
+     * large file. In flood mode the screen is updated at most once per display frame, and output which scrolls out of
+     * the transcript before the end of the output processed at once is parsed without being written to the screen.
+     * A threshold of 0 disables flood mode. Defaults to 1 MiB per second.
+     */
+    public static void setFloodModeThreshold(int bytesPerSecond) {
+        sFloodModeThreshold = Math.max(0, bytesPerSecond);
+    }
+
     public TerminalSession(String shellPath, String cwd, String[] args, String[] env, Integer transcriptRows, TerminalSessionClient client) {
         this.mShellPath = shellPath;
         this.mCwd = cwd;
@@ -99,13 +225,73 @@ public final class TerminalSession extends TerminalOutput {
             mEmulator.updateTerminalSessionClient(client);
     }
 
-    /** Inform the attached pty of the new size and reflow or initialize the emulator. */
+    /**
+     * Set extra file descriptors, for example pipes, to be inherited by the shell process besides the pseudoterminal
+     * used for stdin, stdout and stderr. All other file descriptors of the app are closed in the shell process.
+     * Must be called before the emulator is initialized.
+     */
+    public void setInheritFileDescriptors(int... fds) {
+        mInheritFds = fds;
+    }
+
+    /**
+     * Keep the rows which scroll out of the transcript in a file in the given directory, such as $TMPDIR, so that
+     * history is not limited by the transcript rows. The file is deleted from the directory as soon as it is created.
+     * Must be called before the emulator is initialized.
+     */
+    public void setTranscriptFileDirectory(String directory) {
+        mTranscriptFileDirectory = directory;
+    }
+
+    /**
+     * Run a search of the transcript on the emulation thread, {@link #SEARCH_CHUNK_ROWS} rows at a time so that output
+     * keeps being processed in between, running onProgress on the main thread after each chunk until the search is
+     * finished or cancelled.
+     */
+    public void searchTranscript(final TranscriptSearch search, final Runnable onProgress) {
+        if (mEmulator == null) return;
+        mEmulationHandler.post(new Runnable() {
+            @Override
+            public void run() {
+                boolean done;
+                synchronized (mEmulator) {
+                    done = search.search(mEmulator.getScreen(), SEARCH_CHUNK_ROWS);
+                }
+                runOnMainThread(onProgress);
+                if (!done) mEmulationHandler.post(this);
+            }
+        });
+    }
+
+    /**
+     * Reflow or initialize the emulator with the new size, and inform the attached pty of it. The first size change
+     * after the size has been settled is set on the pty right away, while further ones are only set once the size has
+     * settled for {@link #PTY_RESIZE_DELAY_MILLIS}, so that a resize gesture does not make the process redraw for
+     * every step.
+     */
     public void updateSize(int columns, int rows, int cellWidthPixels, int cellHeightPixels) {
         if (mEmulator == null) {
             initializeEmulator(columns, rows, cellWidthPixels, cellHeightPixels);
         } else {
-            JNI.setPtyWindowSize(mTerminalFileDescriptor, rows, columns, cellWidthPixels, cellHeightPixels);
-            mEmulator.resize(columns, rows, cellWidthPixels, cellHeightPixels);
+            mPtyColumns = columns;
+            mPtyRows = rows;
+            mPtyCellWidthPixels = cellWidthPixels;
+            mPtyCellHeightPixels = cellHeightPixels;
+            mMainThreadHandler.removeCallbacks(mPtyResize);
+            long now = SystemClock.uptimeMillis();
+            if (now - mLastSizeUpdateUptimeMillis >= PTY_RESIZE_DELAY_MILLIS) {
+                mPtyResize.run();
+            } else {
+                mMainThreadHandler.postDelayed(mPtyResize, PTY_RESIZE_DELAY_MILLIS);
+            }
+            mLastSizeUpdateUptimeMillis = now;
+            synchronized (mEmulator) {
+                mEmulator.resize(columns, rows, cellWidthPixels, cellHeightPixels);
+                updateScreenSnapshotOnMainThread();
+            }
+            // Only the rows needed for the screen were reflowed by the resize.
+            mEmulationHandler.removeCallbacks(mReflowHistory);
+            mEmulationHandler.post(mReflowHistory);
         }
     }
 
@@ -122,24 +308,53 @@ public final class TerminalSession extends TerminalOutput {
      */
     public void initializeEmulator(int columns, int rows, int cellWidthPixels, int cellHeightPixels) {
         mEmulator = new TerminalEmulator(this, columns, rows, cellWidthPixels, cellHeightPixels, mTranscriptRows, mClient);
+        if (mTranscriptFileDirectory != null) {
+            try {
+                mEmulator.setTranscriptFile(TranscriptFile.create(new File(mTranscriptFileDirectory)));
+            } catch (IOException e) {
+                Logger.logWarn(mClient, LOG_TAG, "Failed creating transcript file: " + e.getMessage());
+            }
+        }
 
-        int[] processId = new int[1];
-        mTerminalFileDescriptor = JNI.createSubprocess(mShellPath, mCwd, mArgs, mEnv, processId, rows, columns, cellWidthPixels, cellHeightPixels);
+        int[] processId = new int[3];
+        long spawnStartTime = System.nanoTime();
+        mTerminalFileDescriptor = JNI.createSubprocess(mShellPath, mCwd, mArgs, mEnv, mInheritFds, processId, rows, columns, cellWidthPixels, cellHeightPixels);
+        long spawnTimeMicros = (System.nanoTime() - spawnStartTime) / 1000;
         mShellPid = processId[0];
+        mSpawnBackend = processId[1];
+        Logger.logDebug(mClient, LOG_TAG, "Spawned pid " + mShellPid + " using " + getSpawnBackendName(mSpawnBackend) +
+            " in " + spawnTimeMicros + "us");
         mClient.setTerminalShellPid(this, mShellPid);
 
-        final FileDescriptor terminalFileDescriptorWrapped = wrapFileDescriptor(mTerminalFileDescriptor, mClient);
+        // The pidfd opened when the process was created, which cannot refer to another process reusing its pid.
+        mReactorSessionId = PtyReactor.register(this, mTerminalFileDescriptor, mShellPid, processId[2]);
+        if (mReactorSessionId >= 0) {
+            mReactorOutput = JNI.reactorOutput(mReactorSessionId);
+            return;
+        }
+
+        final int terminalFileDescriptor = mTerminalFileDescriptor;
 
         new Thread("TermSessionInputReader[pid=" + mShellPid + "]") {
             @Override
             public void run() {
-                try (InputStream termIn = new FileInputStream(terminalFileDescriptorWrapped)) {
-                    final byte[] buffer = new byte[4096];
+                // Read straight into a direct buffer. On Android it is backed by an array, which can then be handed
+                // to the queue without another copy.
+                final ByteBuffer buffer = ByteBuffer.allocateDirect(4096);
+                final byte[] bytes = buffer.hasArray() ? buffer.array() : new byte[buffer.capacity()];
+                final int bytesOffset = buffer.hasArray() ? buffer.arrayOffset() : 0;
+                try {
                     while (true) {
-                        int read = termIn.read(buffer);
+                        int read = JNI.readInto(terminalFileDescriptor, buffer, 0, buffer.capacity());
                         if (read == -1) return;
-                        if (!mProcessToTerminalIOQueue.write(buffer, 0, read)) return;
-                        mMainThreadHandler.sendEmptyMessage(MSG_NEW_INPUT);
+                        if (!buffer.hasArray()) {
+                            buffer.clear();
+                            buffer.get(bytes, 0, read);
+                        }
+                        if (!mProcessToTerminalIOQueue.write(bytes, bytesOffset, read)) return;
+                        mEmulationHandler.sendEmptyMessage(MSG_NEW_INPUT);
+                        mReaderOutputBytes += read;
+                        mReaderOutputWakeups++;
                     }
                 } catch (Exception e) {
                     // Ignore, just shutting down.
@@ -150,12 +365,17 @@ public final class TerminalSession extends TerminalOutput {
         new Thread("TermSessionOutputWriter[pid=" + mShellPid + "]") {
             @Override
             public void run() {
-                final byte[] buffer = new byte[4096];
-                try (FileOutputStream termOut = new FileOutputStream(terminalFileDescriptorWrapped)) {
+                final byte[] bytes = new byte[4096];
+                final ByteBuffer buffer = ByteBuffer.allocateDirect(bytes.length);
+                try {
                     while (true) {
-                        int bytesToWrite = mTerminalToProcessIOQueue.read(buffer, true);
+                        int bytesToWrite = mTerminalToProcessIOQueue.read(bytes, true);
                         if (bytesToWrite == -1) return;
-                        termOut.write(buffer, 0, bytesToWrite);
+                        buffer.clear();
+                        buffer.put(bytes, 0, bytesToWrite);
+                        int written = 0;
+                        while (written < bytesToWrite)
+                            written += JNI.writeFrom(terminalFileDescriptor, buffer, written, bytesToWrite - written);
                     }
                 } catch (IOException e) {
                     // Ignore.
@@ -167,7 +387,7 @@ public final class TerminalSession extends TerminalOutput {
             @Override
             public void run() {
                 int processExitCode = JNI.waitFor(mShellPid);
-                mMainThreadHandler.sendMessage(mMainThreadHandler.obtainMessage(MSG_PROCESS_EXITED, processExitCode));
+                mEmulationHandler.sendMessage(mEmulationHandler.obtainMessage(MSG_PROCESS_EXITED, processExitCode));
             }
         }.start();
 
@@ -176,7 +396,23 @@ public final class TerminalSession extends TerminalOutput {
     /** Write data to the shell process. */
     @Override
     public void write(byte[] data, int offset, int count) {
-        if (mShellPid > 0) mTerminalToProcessIOQueue.write(data, offset, count);
+        if (mShellPid > 0) {
+            if (mReactorSessionId >= 0) {
+                JNI.reactorWrite(mReactorSessionId, data, offset, count);
+            } else {
+                mTerminalToProcessIOQueue.write(data, offset, count);
+            }
+        }
+    }
+
+    /** Called from the {@link PtyReactor} thread when process output has been buffered. */
+    void onReactorOutputAvailable() {
+        mEmulationHandler.sendEmptyMessage(MSG_NEW_INPUT);
+    }
+
+    /** Called from the {@link PtyReactor} thread when the process has exited. */
+    void onReactorProcessExited(int exitCode) {
+        mEmulationHandler.sendMessage(mEmulationHandler.obtainMessage(MSG_PROCESS_EXITED, exitCode));
     }
 
     /** Write the Unicode code point to the terminal encoded in UTF-8. */
@@ -227,10 +463,120 @@ public final class TerminalSession extends TerminalOutput {
 
     /** Reset state for terminal emulator state. */
     public void reset() {
-        mEmulator.reset();
+        synchronized (mEmulator) {
+            mEmulator.reset();
+            updateScreenSnapshotOnMainThread();
+        }
+        notifyScreenUpdate();
+    }
+
+    /** Reset the colors of the emulator to those of the current color scheme. */
+    public void resetColors() {
+        synchronized (mEmulator) {
+            mEmulator.mColors.reset();
+            updateScreenSnapshotOnMainThread();
+        }
         notifyScreenUpdate();
     }
 
+    /**
+     * Get a snapshot of the screen from topRow to draw on the main thread, which is the latest one published by the
+     * emulation thread, or is captured now with the emulator monitor held if that does not show the rows from topRow
+     * of the current screen size or the emulator has been changed from the main thread since. The emulator monitor is
+     * not taken otherwise, so drawing does not wait for output being emulated. During a synchronized update of the
+     * screen the last snapshot is kept unless the size has changed, so it may show other rows than from topRow and is
+     * drawn from its {@link TerminalSnapshot#mTopRow}.
+     * <p>
+     * The returned snapshot stays unchanged until the next call. Must only be called from the main thread.
+     */
+    public TerminalSnapshot getScreenSnapshot(int topRow) {
+        takePublishedScreenSnapshot();
+        if (mDrawnSnapshot == null) mDrawnSnapshot = new TerminalSnapshot();
+
+        // The size of the emulator is only changed from the main thread, so it can be checked without the lock.
+        if (!mDrawnSnapshot.covers(topRow, mEmulator.mRows, mEmulator.mColumns)) {
+            synchronized (mEmulator) {
+                if (!keepSnapshotDuringSynchronizedUpdate()) mDrawnSnapshot.capture(mEmulator, topRow);
+            }
+        } else if (mSnapshotOutdated && !mEmulationHandler.hasMessages(MSG_UPDATE_SNAPSHOT)) {
+            // Output has been emulated since the snapshot was published.
+            mEmulationHandler.sendEmptyMessage(MSG_UPDATE_SNAPSHOT);
+        }
+        return mDrawnSnapshot;
+    }
+
+    private void takePublishedScreenSnapshot() {
+        TerminalSnapshot published = mPublishedSnapshot.getAndSet(null);
+        if (published == null) return;
+        if (mDrawnSnapshot != null) {
+            // Lines scrolled in a snapshot which was not drawn have still to be scrolled.
+            published.addScrollCounter(mDrawnSnapshot.takeScrollCounter());
+            published.addDamage(mDrawnSnapshot);
+            mSpareSnapshot.set(mDrawnSnapshot);
+        }
+        mDrawnSnapshot = published;
+    }
+
+    /**
+     * Recapture the snapshot drawn by the main thread after changing the emulator from it, instead of waiting for the
+     * emulation thread. Must be called from the main thread with the emulator monitor held.
+     */
+    private void updateScreenSnapshotOnMainThread() {
+        takePublishedScreenSnapshot();
+        if (mDrawnSnapshot == null || keepSnapshotDuringSynchronizedUpdate()) return;
+        mDrawnSnapshot.capture(mEmulator, mDrawnSnapshot.mTopRow);
+        mSnapshotOutdated = false;
+    }
+
+    /**
+     * If the drawn snapshot should be kept instead of capturing the screen on the main thread, since the application is
+     * in the middle of a synchronized update and the size has not changed. A snapshot is then published by the
+     * emulation thread when the update ends, see {@link #publishScreenSnapshot()}. Must be called from the main thread
+     * with the emulator monitor held.
+     */
+    private boolean keepSnapshotDuringSynchronizedUpdate() {
+        if (mEmulator.getSynchronizedUpdateMillisLeft() <= 0) return false;
+        if (!mDrawnSnapshot.covers(mDrawnSnapshot.mTopRow, mEmulator.mRows, mEmulator.mColumns)) return false;
+        mSnapshotOutdated = true;
+        if (!mEmulationHandler.hasMessages(MSG_UPDATE_SNAPSHOT)) mEmulationHandler.sendEmptyMessage(MSG_UPDATE_SNAPSHOT);
+        return true;
+    }
+
+    /**
+     * Capture a snapshot of the screen on the emulation thread if the main thread has taken the previous one, so
+     * that at most one snapshot is captured per screen update handled by the main thread. Nothing is captured during
+     * a synchronized update of the screen by the application, see
+     * {@link TerminalEmulator#getSynchronizedUpdateMillisLeft()}, so the changes of a frame are shown together.
+     */
+    private void publishScreenSnapshot() {
+        synchronized (mEmulator) {
+            if (!mSnapshotOutdated || mPublishedSnapshot.get() != null) return;
+            long synchronizedUpdateMillisLeft = mEmulator.getSynchronizedUpdateMillisLeft();
+            if (synchronizedUpdateMillisLeft > 0) {
+                // Published when the update ends, or by this message if it times out first.
+                if (!mEmulationHandler.hasMessages(MSG_UPDATE_SNAPSHOT))
+                    mEmulationHandler.sendEmptyMessageDelayed(MSG_UPDATE_SNAPSHOT, synchronizedUpdateMillisLeft);
+                return;
+            }
+            TerminalSnapshot snapshot = mSpareSnapshot.getAndSet(null);
+            if (snapshot == null) snapshot = new TerminalSnapshot();
+            snapshot.resetScrollCounter();
+            snapshot.clearDamage();
+            snapshot.capture(mEmulator, 0);
+            mSnapshotOutdated = false;
+            mPublishedSnapshot.set(snapshot);
+        }
+        if (!mMainThreadHandler.hasMessages(MSG_SCREEN_UPDATED)) mMainThreadHandler.sendEmptyMessage(MSG_SCREEN_UPDATED);
+    }
+
+    private static synchronized Looper getEmulationLooper() {
+        if (sEmulationThread == null) {
+            sEmulationThread = new HandlerThread("TermSessionEmulation");
+            sEmulationThread.start();
+        }
+        return sEmulationThread.getLooper();
+    }
+
     /** Finish this terminal session by sending SIGKILL to the shell. */
     public void finishIfRunning() {
         if (isRunning()) {
@@ -249,6 +595,12 @@ public final class TerminalSession extends TerminalOutput {
             mShellExitStatus = exitStatus;
         }
 
+        if (mReactorSessionId >= 0) {
+            // The output buffer is freed when unregistering, so stop reading from it first.
+            mReactorOutput = 0;
+            PtyReactor.unregister(mReactorSessionId);
+        }
+
         // Stop the reader and writer threads, and close the I/O streams
         mTerminalToProcessIOQueue.close();
         mProcessToTerminalIOQueue.close();
@@ -257,7 +609,7 @@ public final class TerminalSession extends TerminalOutput {
 
     @Override
     public void titleChanged(String oldTitle, String newTitle) {
-        mClient.onTitleChanged(this);
+        runOnMainThread(() -> mClient.onTitleChanged(this));
     }
 
     public synchronized boolean isRunning() {
@@ -271,28 +623,76 @@ public final class TerminalSession extends TerminalOutput {
 
     @Override
     public void onCopyTextToClipboard(String text) {
-        mClient.onCopyTextToClipboard(this, text);
+        runOnMainThread(() -> mClient.onCopyTextToClipboard(this, text));
     }
 
     @Override
     public void onPasteTextFromClipboard() {
-        mClient.onPasteTextFromClipboard(this);
+        runOnMainThread(() -> mClient.onPasteTextFromClipboard(this));
     }
 
     @Override
     public void onBell() {
-        mClient.onBell(this);
+        runOnMainThread(() -> mClient.onBell(this));
     }
 
     @Override
     public void onColorsChanged() {
-        mClient.onColorsChanged(this);
+        runOnMainThread(() -> mClient.onColorsChanged(this));
+    }
+
+    @Override
+    public void onTerminalCursorStateChange(boolean state) {
+        runOnMainThread(() -> mClient.onTerminalCursorStateChange(state));
+    }
+
+    /** Run a client callback on the main thread, as the emulator calls back on the emulation thread. */
+    private void runOnMainThread(Runnable callback) {
+        if (Looper.myLooper() == mMainThreadHandler.getLooper()) {
+            callback.run();
+        } else {
+            mMainThreadHandler.post(callback);
+        }
     }
 
     public int getPid() {
         return mShellPid;
     }
 
+    private static String getSpawnBackendName(int spawnBackend) {
+        switch (spawnBackend) {
+            case SPAWN_BACKEND_FORK:
+                return "fork";
+            case SPAWN_BACKEND_VFORK:
+                return "vfork";
+            case SPAWN_BACKEND_SERVER:
+                return "spawn server";
+            default:
+                return "unknown backend";
+        }
+    }
+
+    /** Returns the spawn backend used to start the shell, one of the SPAWN_BACKEND_* constants, or -1 if not started. */
+    public int getSpawnBackend() {
+        return mSpawnBackend;
+    }
+
+    /**
+     * Returns how many times the emulation thread has been woken up to process output per MiB of output while the
+     * process is running, to tell how well output is batched, or 0 if there has been no output.
+     */
+    public double getOutputWakeupsPerMegabyte() {
+        long bytes = mReaderOutputBytes, wakeups = mReaderOutputWakeups;
+        int reactorSessionId = mReactorSessionId;
+        if (reactorSessionId >= 0) {
+            long[] stats = new long[3];
+            if (!JNI.reactorOutputStats(reactorSessionId, stats)) return 0;
+            bytes = stats[0];
+            wakeups = stats[2];
+        }
+        return bytes == 0 ? 0 : wakeups * (1024.0 * 1024.0) / bytes;
+    }
+
     /** Returns the shell's working directory or null if it was unavailable. */
     public String getCwd() {
         if (mShellPid < 1) {
@@ -314,36 +714,37 @@ public final class TerminalSession extends TerminalOutput {
         return null;
     }
 
-    private static FileDescriptor wrapFileDescriptor(int fileDescriptor, TerminalSessionClient client) {
-        FileDescriptor result = new FileDescriptor();
-        try {
-            Field descriptorField;
-            try {
-                descriptorField = FileDescriptor.class.getDeclaredField("descriptor");
-            } catch (NoSuchFieldException e) {
-                // For desktop java:
-                descriptorField = FileDescriptor.class.getDeclaredField("fd");
-            }
-            descriptorField.setAccessible(true);
-            descriptorField.set(result, fileDescriptor);
-        } catch (NoSuchFieldException | IllegalAccessException | IllegalArgumentException e) {
-            Logger.logStackTraceWithMessage(client, LOG_TAG, "Error accessing FileDescriptor#descriptor private field", e);
-            System.exit(1);
-        }
-        return result;
-    }
+    /** Processes process output and exit on the emulation thread. */
+    class EmulationHandler extends Handler {
 
-    @SuppressLint("HandlerLeak")
-    class MainThreadHandler extends Handler {
+        /** The interval over which the output rate is measured to enter or leave flood mode. */
+        static final int FLOOD_RATE_INTERVAL_MILLIS = 100;
 
         final byte[] mReceiveBuffer = new byte[4 * 1024];
+        /**
+         * Larger buffer read into in flood mode, so that more of the output is found to scroll out of the transcript
+         * before it is shown, see {@link TerminalEmulator#setFloodMode(boolean)}. Allocated on first use.
+         */
+        byte[] mFloodReceiveBuffer;
+        /** Start time and output of the current interval of measuring the output rate. */
+        long mRateIntervalStart, mRateIntervalBytes;
+
+        EmulationHandler(Looper looper) {
+            super(looper);
+        }
 
         @Override
         public void handleMessage(Message msg) {
-            int bytesRead = mProcessToTerminalIOQueue.read(mReceiveBuffer, false);
-            if (bytesRead > 0) {
-                mEmulator.append(mReceiveBuffer, bytesRead);
-                notifyScreenUpdate();
+            if (msg.what == MSG_UPDATE_SNAPSHOT) {
+                publishScreenSnapshot();
+                return;
+            }
+
+            if (mReactorSessionId >= 0) {
+                readReactorOutput(msg.what == MSG_PROCESS_EXITED);
+            } else {
+                int bytesRead = mProcessToTerminalIOQueue.read(mReceiveBuffer, false);
+                if (bytesRead > 0) append(mReceiveBuffer, bytesRead);
             }
 
             if (msg.what == MSG_PROCESS_EXITED) {
@@ -354,6 +755,8 @@ public final class TerminalSession extends TerminalOutput {
                 if (exitCode > 0) {
                     // Non-zero process exit.
                     exitDescription += " (code " + exitCode + ")";
+                } else if (exitCode == JNI.PROCESS_WAIT_FAILED) {
+                    exitDescription += " (exit status unknown)";
                 } else if (exitCode < 0) {
                     // Negated signal.
                     exitDescription += " (signal " + (-exitCode) + ")";
@@ -361,10 +764,88 @@ public final class TerminalSession extends TerminalOutput {
                 exitDescription += " - press Enter]";
 
                 byte[] bytesToWrite = exitDescription.getBytes(StandardCharsets.UTF_8);
-                mEmulator.append(bytesToWrite, bytesToWrite.length);
-                notifyScreenUpdate();
+                append(bytesToWrite, bytesToWrite.length);
 
-                mClient.onSessionFinished(TerminalSession.this);
+                mMainThreadHandler.sendEmptyMessage(MSG_SESSION_FINISHED);
+            }
+
+            publishScreenSnapshot();
+        }
+
+        private void append(byte[] buffer, int length) {
+            updateFloodMode(length);
+            synchronized (mEmulator) {
+                mEmulator.setFloodMode(mFloodMode);
+                mEmulator.append(buffer, length);
+                mSnapshotOutdated = true;
+            }
+        }
+
+        /**
+         * Process output buffered by the {@link PtyReactor}. One buffer is processed per message so that snapshots of
+         * the screen can be published in between, unless all output has to be processed before the exit of the
+         * process is shown.
+         */
+        private void readReactorOutput(boolean readAll) {
+            if (mReactorOutput == 0) return;
+            byte[] buffer = mReceiveBuffer;
+            if (mFloodMode) {
+                if (mFloodReceiveBuffer == null) mFloodReceiveBuffer = new byte[256 * 1024];
+                buffer = mFloodReceiveBuffer;
+            }
+            int bytesRead;
+            while ((bytesRead = JNI.reactorRead(mReactorOutput, buffer)) > 0) {
+                append(buffer, bytesRead);
+                if (!readAll) {
+                    // The reactor only notifies again after the buffer has been emptied.
+                    if (bytesRead == buffer.length) sendEmptyMessage(MSG_NEW_INPUT);
+                    break;
+                }
+            }
+        }
+
+        /** Account for output about to be processed, and enter or leave flood mode at the end of each interval. */
+        private void updateFloodMode(int length) {
+            mRateIntervalBytes += length;
+            long now = SystemClock.uptimeMillis();
+            long elapsed = now - mRateIntervalStart;
+            if (elapsed < FLOOD_RATE_INTERVAL_MILLIS) return;
+            int threshold = sFloodModeThreshold;
+            mFloodMode = threshold > 0 && mRateIntervalBytes * 1000 / elapsed >= threshold;
+            mRateIntervalStart = now;
+            mRateIntervalBytes = 0;
+        }
+
+    }
+
+    @SuppressLint("HandlerLeak")
+    class MainThreadHandler extends Handler {
+
+        /** If a screen update has been deferred to the next display frame in flood mode. */
+        boolean mScreenUpdatePending;
+        final Choreographer.FrameCallback mScreenUpdateFrameCallback = frameTimeNanos -> {
+            mScreenUpdatePending = false;
+            notifyScreenUpdate();
+        };
+
+        @Override
+        public void handleMessage(Message msg) {
+            switch (msg.what) {
+                case MSG_SCREEN_UPDATED:
+                    if (mFloodMode) {
+                        // Snapshots may be published more often than they can be drawn, so update once per frame.
+                        if (!mScreenUpdatePending) {
+                            mScreenUpdatePending = true;
+                            Choreographer.getInstance().postFrameCallback(mScreenUpdateFrameCallback);
+                        }
+                    } else {
+                        notifyScreenUpdate();
+                    }
+                    break;
+                case MSG_SESSION_FINISHED:
+                    notifyScreenUpdate();
+                    mClient.onSessionFinished(TerminalSession.this);
+                    break;
             }
         }
 
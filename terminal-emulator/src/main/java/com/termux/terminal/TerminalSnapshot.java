@@ -0,0 +1,134 @@
+package com.termux.terminal;
+
+import java.util.Arrays;
+
+/**
+ * A copy of what is needed to draw a window of rows of a {@link TerminalEmulator}, so that it can be drawn while the
+ * emulator keeps processing output on another thread.
+ * <p>
+ * Snapshots are captured with the emulator monitor held, see {@link TerminalSession#getScreenSnapshot(int)}, and are
+ * reused for later captures once they have been replaced, so they must not be kept after that.
+ */
+public final class TerminalSnapshot {
+
+    /** The emulator the snapshot was captured from. */
+    TerminalEmulator mEmulator;
+
+    /** The size of the screen at the time of the capture. */
+    public int mRows, mColumns;
+    /** The external row index of the first row in the snapshot, see {@link TerminalBuffer#externalToInternalRow(int)}. */
+    public int mTopRow;
+    /** The rows of the snapshot, from {@link #mTopRow}. */
+    private TerminalRow[] mLines = new TerminalRow[0];
+
+    public int mCursorRow, mCursorCol;
+    private boolean mCursorEnabled;
+    public int mCursorStyle;
+    public boolean mReverseVideo;
+    /** The current colors, see {@link TerminalColors#mCurrentColors}. */
+    public final int[] mPalette = new int[TextStyle.NUM_INDEXED_COLORS];
+
+    /** The number of rows above the screen, including those in the transcript file, see {@link TerminalBuffer#getHistoryRows()}. */
+    public int mActiveTranscriptRows;
+    public boolean mAutoScrollDisabled;
+    public boolean mAlternateBufferActive;
+    /** The number of lines scrolled since the previous snapshot was taken, see {@link #takeScrollCounter()}. */
+    private int mScrollCounter;
+    /** A bit set of the screen rows changed since the snapshot was last drawn, see {@link #isRowDamaged(int)}. */
+    private long[] mDamagedRows = new long[0];
+    private boolean mAllRowsDamaged = true;
+
+    /**
+     * Copy the rows [topRow, topRow + rows) of the current screen and the state needed to draw them. The emulator
+     * monitor has to be held.
+     */
+    void capture(TerminalEmulator emulator, int topRow) {
+        final TerminalBuffer screen = emulator.getScreen();
+        mEmulator = emulator;
+        mRows = emulator.mRows;
+        mColumns = emulator.mColumns;
+        mActiveTranscriptRows = screen.getHistoryRows();
+        mTopRow = Math.max(-mActiveTranscriptRows, Math.min(0, topRow));
+
+        if (mLines.length != mRows || (mRows > 0 && mLines[0].getColumns() != mColumns)) {
+            mAllRowsDamaged = true;
+            mLines = new TerminalRow[mRows];
+            for (int i = 0; i < mRows; i++) mLines[i] = new TerminalRow(mColumns, TextStyle.NORMAL);
+        }
+        for (int i = 0; i < mRows; i++)
+            mLines[i].copyFrom(screen.getHistoryRow(mTopRow + i));
+        if (mDamagedRows.length != (mRows + 63) / 64) {
+            mDamagedRows = new long[(mRows + 63) / 64];
+            mAllRowsDamaged = true;
+        }
+        if (screen.takeDamagedRows(mDamagedRows)) mAllRowsDamaged = true;
+
+        mCursorRow = emulator.getCursorRow();
+        mCursorCol = emulator.getCursorCol();
+        mCursorEnabled = emulator.isCursorEnabled();
+        mCursorStyle = emulator.getCursorStyle();
+        mReverseVideo = emulator.isReverseVideo();
+        System.arraycopy(emulator.mColors.mCurrentColors, 0, mPalette, 0, mPalette.length);
+        mAutoScrollDisabled = emulator.isAutoScrollDisabled();
+        mAlternateBufferActive = emulator.isAlternateBufferActive();
+
+        mScrollCounter += emulator.getScrollCounter();
+        emulator.clearScrollCounter();
+    }
+
+    /** If the snapshot shows the rows from topRow of an emulator of the given size. */
+    public boolean covers(int topRow, int rows, int columns) {
+        return mEmulator != null && mTopRow == topRow && mRows == rows && mColumns == columns;
+    }
+
+    /** The row at the external row index, which has to be in [{@link #mTopRow}, {@link #mTopRow} + {@link #mRows}). */
+    public TerminalRow getLine(int externalRow) {
+        return mLines[externalRow - mTopRow];
+    }
+
+    /** If the cursor should be drawn, which also depends on the blink state kept by the emulator for the UI thread. */
+    public boolean shouldCursorBeVisible() {
+        return mCursorEnabled && mEmulator.isCursorInVisibleBlinkState();
+    }
+
+    /** Return and reset the number of lines scrolled by output since the previous call. */
+    public int takeScrollCounter() {
+        int scrollCounter = mScrollCounter;
+        mScrollCounter = 0;
+        return scrollCounter;
+    }
+
+    void addScrollCounter(int scrollCounter) {
+        mScrollCounter += scrollCounter;
+    }
+
+    void resetScrollCounter() {
+        mScrollCounter = 0;
+    }
+
+    /** If all rows have to be drawn, as the screen has been resized or switched since the snapshot was last drawn. */
+    public boolean isAllDamaged() {
+        return mAllRowsDamaged;
+    }
+
+    /** If a screen row, as an external row from 0, has changed since the snapshot was last drawn. */
+    public boolean isRowDamaged(int row) {
+        return mAllRowsDamaged || (row >= 0 && row < mRows && (mDamagedRows[row >> 6] & (1L << row)) != 0);
+    }
+
+    /** Mark the snapshot as drawn, after which only rows changed by later output are damaged. */
+    public void clearDamage() {
+        Arrays.fill(mDamagedRows, 0);
+        mAllRowsDamaged = false;
+    }
+
+    /** Add the damage of a snapshot which was replaced before being drawn. */
+    void addDamage(TerminalSnapshot snapshot) {
+        if (snapshot.mAllRowsDamaged || snapshot.mDamagedRows.length != mDamagedRows.length) {
+            mAllRowsDamaged = true;
+        } else {
+            for (int i = 0; i < mDamagedRows.length; i++) mDamagedRows[i] |= snapshot.mDamagedRows[i];
+        }
+    }
+
+}
@@ -0,0 +1,266 @@
+package com.termux.terminal;
+
+import java.io.Closeable;
+import java.io.File;
+import java.io.IOException;
+import java.io.RandomAccessFile;
+import java.nio.ByteBuffer;
+import java.nio.channels.FileChannel;
+import java.util.Arrays;
+
+/**
+ * An append-only file of rows which have scrolled out of the transcript of a {@link TerminalBuffer}, so that history
+ * is not limited by the transcript rows kept in memory.
+ * <p>
+ * Rows are stored as records in a data file, with an index file of the offset of each record. Both are memory mapped
+ * in segments, of which only a few are mapped at a time, so heap usage does not depend on the number of rows. The
+ * files are deleted as soon as they are opened, so they disappear with the process even if it is killed.
+ * <p>
+ * A record is the number of columns, the line wrap flag, the number of chars of text without trailing spaces and the
+ * number of style runs, followed by the chars and the runs as the column after the run and its style.
+ */
+public final class TranscriptFile implements Closeable {
+
+    /** The size of the mapped segments. Records do not cross segments. */
+    private static final int SEGMENT_SIZE = 4 * 1024 * 1024;
+    private static final int MAX_MAPPED_SEGMENTS = 4;
+    private static final int RECORD_HEADER_SIZE = 12;
+    private static final int RUN_SIZE = 10;
+    private static final int INDEX_ENTRY_SIZE = 8;
+
+    private final Segments mData;
+    private final Segments mIndex;
+    private int mRowCount;
+    private long mDataEnd;
+    /** Set when writing fails, after which rows are no longer appended. */
+    private boolean mFailed;
+
+    /** Create a transcript file in a directory, such as $TMPDIR. */
+    public static TranscriptFile create(File directory) throws IOException {
+        Segments data = Segments.create(directory, ".rows");
+        try {
+            return new TranscriptFile(data, Segments.create(directory, ".index"));
+        } catch (IOException e) {
+            data.close();
+            throw e;
+        }
+    }
+
+    private TranscriptFile(Segments data, Segments index) {
+        mData = data;
+        mIndex = index;
+    }
+
+    /** The number of rows in the file. Row 0 is the oldest. */
+    public int getRowCount() {
+        return mRowCount;
+    }
+
+    /** Append a row which is not packed. Returns false if it could not be written, which stops further appends. */
+    boolean append(TerminalRow row) {
+        if (mFailed || mRowCount == Integer.MAX_VALUE) return false;
+        final int columns = row.getColumns();
+        final char[] text = row.mText;
+        final long[] style = row.mStyle;
+
+        int charCount = row.getSpaceUsed();
+        while (charCount > 0 && text[charCount - 1] == ' ') charCount--;
+        int runCount = 1;
+        for (int i = 1; i < columns; i++)
+            if (style[i] != style[i - 1]) runCount++;
+
+        int recordSize = RECORD_HEADER_SIZE + 2 * charCount + RUN_SIZE * runCount;
+        final boolean blank = recordSize > SEGMENT_SIZE;
+        if (blank) {
+            // Only possible with absurd amounts of combining characters, so keep the row as blank.
+            charCount = 0;
+            runCount = 1;
+            recordSize = RECORD_HEADER_SIZE + RUN_SIZE;
+        }
+
+        try {
+            long offset = mDataEnd;
+            if (offset % SEGMENT_SIZE + recordSize > SEGMENT_SIZE) offset += SEGMENT_SIZE - offset % SEGMENT_SIZE;
+            ByteBuffer data = mData.get(offset);
+            int position = (int) (offset % SEGMENT_SIZE);
+            data.putShort(position, (short) columns);
+            data.putShort(position + 2, (short) (row.mLineWrap ? 1 : 0));
+            data.putInt(position + 4, charCount);
+            data.putInt(position + 8, runCount);
+            position += RECORD_HEADER_SIZE;
+            for (int i = 0; i < charCount; i++, position += 2)
+                data.putChar(position, text[i]);
+            for (int i = 1; i <= columns; i++) {
+                if (i == columns || (!blank && style[i] != style[i - 1])) {
+                    data.putShort(position, (short) i);
+                    data.putLong(position + 2, style[i - 1]);
+                    position += RUN_SIZE;
+                }
+            }
+
+            long indexOffset = (long) mRowCount * INDEX_ENTRY_SIZE;
+            mIndex.get(indexOffset).putLong((int) (indexOffset % SEGMENT_SIZE), offset);
+            mDataEnd = offset + recordSize;
+            mRowCount++;
+            return true;
+        } catch (IOException e) {
+            mFailed = true;
+            return false;
+        }
+    }
+
+    /**
+     * Read a row into a row of the current number of columns, which is cut off or padded with blanks if it was
+     * written with a different number of columns. A row which cannot be read is blanked.
+     */
+    void read(int rowIndex, TerminalRow row) {
+        if (rowIndex < 0 || rowIndex >= mRowCount)
+            throw new IllegalArgumentException("rowIndex=" + rowIndex + ", mRowCount=" + mRowCount);
+        try {
+            long indexOffset = (long) rowIndex * INDEX_ENTRY_SIZE;
+            long offset = mIndex.get(indexOffset).getLong((int) (indexOffset % SEGMENT_SIZE));
+            ByteBuffer data = mData.get(offset);
+            int position = (int) (offset % SEGMENT_SIZE);
+            int columns = data.getShort(position) & 0xFFFF;
+            boolean lineWrap = data.getShort(position + 2) != 0;
+            int charCount = data.getInt(position + 4);
+            int runCount = data.getInt(position + 8);
+            int runsPosition = position + RECORD_HEADER_SIZE + 2 * charCount;
+
+            if (columns == row.getColumns()) {
+                readSameColumns(data, position + RECORD_HEADER_SIZE, charCount, runsPosition, runCount, row);
+            } else {
+                readOtherColumns(data, position + RECORD_HEADER_SIZE, charCount, runsPosition, runCount, row);
+            }
+            row.mLineWrap = lineWrap;
+        } catch (IOException e) {
+            row.clear(TextStyle.NORMAL);
+        }
+    }
+
+    private static void readSameColumns(ByteBuffer data, int textPosition, int charCount, int runsPosition, int runCount, TerminalRow row) {
+        final int columns = row.getColumns();
+        final long[] style = row.mStyle;
+        int column = 0;
+        for (int run = 0; run < runCount; run++) {
+            int end = data.getShort(runsPosition + run * RUN_SIZE) & 0xFFFF;
+            long runStyle = data.getLong(runsPosition + run * RUN_SIZE + 2);
+            for (; column < end && column < columns; column++) style[column] = runStyle;
+        }
+
+        // Measure the columns of the text to pad it with the trailing spaces which were not stored.
+        boolean nonOneWidth = false;
+        char[] text = row.mText;
+        if (text.length < charCount + columns) text = new char[charCount + columns];
+        int usedColumns = 0;
+        for (int i = 0; i < charCount; i++) {
+            char c = data.getChar(textPosition + 2 * i);
+            text[i] = c;
+            if (nonOneWidth) continue;
+            if (Character.isSurrogate(c) || WcWidth.width(c) != 1) nonOneWidth = true;
+            else usedColumns++;
+        }
+        int spaceUsed = charCount;
+        if (nonOneWidth) {
+            usedColumns = 0;
+            for (int i = 0; i < charCount; ) {
+                int codePoint = Character.codePointAt(text, i, charCount);
+                usedColumns += Math.max(0, WcWidth.width(codePoint));
+                i += Character.charCount(codePoint);
+            }
+        }
+        for (; usedColumns < columns; usedColumns++) text[spaceUsed++] = ' ';
+        row.setUnpacked(text, style, spaceUsed, nonOneWidth);
+    }
+
+    private static void readOtherColumns(ByteBuffer data, int textPosition, int charCount, int runsPosition, int runCount, TerminalRow row) {
+        final int columns = row.getColumns();
+        row.clear(TextStyle.NORMAL);
+        int runEnd = 0;
+        long runStyle = TextStyle.NORMAL;
+        int run = 0;
+        int column = 0;
+        for (int i = 0; i < charCount && column < columns; ) {
+            char c = data.getChar(textPosition + 2 * i++);
+            int codePoint = c;
+            if (Character.isHighSurrogate(c) && i < charCount) codePoint = Character.toCodePoint(c, data.getChar(textPosition + 2 * i++));
+            int width = WcWidth.width(codePoint);
+            if (width <= 0) {
+                // Attached to the previous column, whose run is the current one. The column may be the stored
+                // number of columns if the row was full, which is past the end of the last run.
+                if (column > 0) row.setChar(column - 1, codePoint, runStyle);
+                continue;
+            }
+            while (column >= runEnd && run < runCount) {
+                runEnd = data.getShort(runsPosition + run * RUN_SIZE) & 0xFFFF;
+                runStyle = data.getLong(runsPosition + run * RUN_SIZE + 2);
+                run++;
+            }
+            if (column + width <= columns) {
+                row.setChar(column, codePoint, runStyle);
+                column += width;
+            } else {
+                break;
+            }
+        }
+    }
+
+    /** Remove all rows. */
+    public void clear() {
+        mRowCount = 0;
+        mDataEnd = 0;
+    }
+
+    @Override
+    public void close() {
+        mData.close();
+        mIndex.close();
+    }
+
+    /** A file mapped in segments, of which the most recently used are kept mapped. */
+    private static final class Segments {
+
+        private final RandomAccessFile mFile;
+        private final long[] mMappedIndices = new long[MAX_MAPPED_SEGMENTS];
+        private final ByteBuffer[] mMapped = new ByteBuffer[MAX_MAPPED_SEGMENTS];
+        private int mNextToReplace;
+
+        static Segments create(File directory, String suffix) throws IOException {
+            File file = File.createTempFile("transcript-", suffix, directory);
+            try {
+                return new Segments(new RandomAccessFile(file, "rw"));
+            } finally {
+                //noinspection ResultOfMethodCallIgnored
+                file.delete();
+            }
+        }
+
+        private Segments(RandomAccessFile file) {
+            mFile = file;
+        }
+
+        /** The segment containing the offset, which is mapped and the file grown to it if needed. */
+        ByteBuffer get(long offset) throws IOException {
+            long segment = offset / SEGMENT_SIZE;
+            for (int i = 0; i < MAX_MAPPED_SEGMENTS; i++)
+                if (mMapped[i] != null && mMappedIndices[i] == segment) return mMapped[i];
+            // Mapping read-write grows the file to the end of the segment.
+            ByteBuffer mapped = mFile.getChannel().map(FileChannel.MapMode.READ_WRITE, segment * SEGMENT_SIZE, SEGMENT_SIZE);
+            mMappedIndices[mNextToReplace] = segment;
+            mMapped[mNextToReplace] = mapped;
+            mNextToReplace = (mNextToReplace + 1) % MAX_MAPPED_SEGMENTS;
+            return mapped;
+        }
+
+        void close() {
+            Arrays.fill(mMapped, null);
+            try {
+                mFile.close();
+            } catch (IOException e) {
+                // Ignore.
+            }
+        }
+
+    }
+
+}
@@ -0,0 +1,275 @@
+package com.termux.terminal;
+
+import java.nio.CharBuffer;
+import java.util.Arrays;
+import java.util.regex.Matcher;
+import java.util.regex.Pattern;
+
+/**
+ * An incremental search of the rows of a {@link TerminalBuffer}, including any history in its transcript file, for a
+ * substring or a simple regular expression. Rows are searched a number at a time by {@link #search(TerminalBuffer, int)},
+ * from the bottom of the screen up, and the search can be cancelled from any thread in between.
+ * <p>
+ * Rows joined by line wrapping are searched as one line, so matches may span rows. Lines are copied a batch at a time
+ * into a reused buffer which is searched natively, see jni/text_search.c for the supported regular expressions, so the
+ * transcript is never built as a whole. Without the native library java.util.regex is used.
+ * <p>
+ * Matches are kept with rows counted from the top of the history, which stay the same as output scrolls in below, and
+ * are returned with external rows as of the last search. Output may be emulated between searches, so rows dropped from
+ * the top of a full transcript in between are taken into account, and the search starts over if the rows have been
+ * renumbered otherwise, see {@link TerminalBuffer#getHistoryGeneration()}.
+ */
+public final class TranscriptSearch {
+
+    public static final int FLAG_IGNORE_CASE = 1;
+    public static final int FLAG_REGEX = 2;
+
+    /** Batches of lines are searched once they have this many chars. */
+    private static final int BATCH_CHARS = 32 * 1024;
+    private static final int MAX_MATCHES_PER_CALL = 256;
+
+    private long mNativeSearch;
+    private final Pattern mPattern;
+    private volatile boolean mCancelled;
+    private boolean mFinished;
+
+    /** The row to continue searching up from, counted from the top of the history, or -1 before searching. */
+    private int mNextRow = -1;
+    /** The history rows as of the last search, to convert rows of matches to external rows. */
+    private int mHistoryRows;
+    /** The buffer searched and its history generation and dropped history rows as of the last search. */
+    private TerminalBuffer mScreen;
+    private int mHistoryGeneration;
+    private long mDroppedHistoryRows;
+
+    /** The start row and column and end row and exclusive end column of each match. */
+    private int[] mMatches = new int[4 * 16];
+    private int mMatchCount;
+
+    /** The lines of the current batch, each followed by '\n'. */
+    private char[] mText = new char[BATCH_CHARS];
+    private int mTextLength;
+    /** The offset in {@link #mText} and the row from the top of the history of each row in the batch. */
+    private int[] mRowStarts = new int[64];
+    private int[] mRows = new int[64];
+    private int mBatchRows;
+    private final int[] mFound = new int[2 * MAX_MATCHES_PER_CALL];
+
+    /**
+     * @param pattern the substring, or regular expression with {@link #FLAG_REGEX}.
+     * @throws IllegalArgumentException if the pattern is empty or not a supported regular expression.
+     */
+    public TranscriptSearch(String pattern, int flags) {
+        if (pattern.isEmpty()) throw new IllegalArgumentException("Empty search pattern");
+        if (NativeLibrary.AVAILABLE) {
+            mNativeSearch = nativeCompile(pattern.toCharArray(), flags);
+            if (mNativeSearch == 0) throw new IllegalArgumentException("Unsupported search pattern: " + pattern);
+            mPattern = null;
+        } else {
+            int patternFlags = Pattern.MULTILINE;
+            if ((flags & FLAG_IGNORE_CASE) != 0) patternFlags |= Pattern.CASE_INSENSITIVE | Pattern.UNICODE_CASE;
+            mPattern = Pattern.compile((flags & FLAG_REGEX) != 0 ? pattern : Pattern.quote(pattern), patternFlags);
+        }
+    }
+
+    /**
+     * Search up to about maxRows more rows, finishing the line being searched. The emulator monitor has to be held.
+     *
+     * @return true when the search is finished or cancelled.
+     */
+    public synchronized boolean search(TerminalBuffer screen, int maxRows) {
+        if (mFinished || mCancelled) return true;
+        if (mNextRow >= 0) {
+            if (screen != mScreen || screen.getHistoryGeneration() != mHistoryGeneration) {
+                restart();
+            } else if (screen.getDroppedHistoryRows() != mDroppedHistoryRows) {
+                dropRows(screen.getDroppedHistoryRows() - mDroppedHistoryRows);
+                // The rows left to search have all been dropped.
+                if (mNextRow < 0) mFinished = true;
+            }
+        }
+        // Rows counted from the top of the history change as history left by a resize is reflowed.
+        if (mNextRow < 0 && !mFinished) screen.finishReflow();
+        mScreen = screen;
+        mHistoryGeneration = screen.getHistoryGeneration();
+        mDroppedHistoryRows = screen.getDroppedHistoryRows();
+        mHistoryRows = screen.getHistoryRows();
+        if (mFinished) return true;
+        final int lastRow = mHistoryRows + screen.mScreenRows - 1;
+        if (mNextRow < 0 || mNextRow > lastRow) mNextRow = lastRow;
+
+        int rowsLeft = maxRows;
+        while (mNextRow >= 0 && rowsLeft > 0 && !mCancelled) {
+            // The line ending at the row starts after the closest row above it which is not wrapped.
+            final int endRow = mNextRow;
+            int startRow = endRow;
+            while (startRow > 0 && screen.getHistoryRow(startRow - 1 - mHistoryRows).mLineWrap) startRow--;
+            for (int row = startRow; row <= endRow; row++)
+                appendRow(screen.getHistoryRow(row - mHistoryRows), row, row == endRow);
+            appendChar('\n');
+            rowsLeft -= endRow - startRow + 1;
+            mNextRow = startRow - 1;
+            if (mTextLength >= BATCH_CHARS) searchBatch();
+        }
+        searchBatch();
+        if (mNextRow < 0) mFinished = true;
+        return mFinished || mCancelled;
+    }
+
+    /** Cancel the search, which may be in progress on another thread. */
+    public void cancel() {
+        mCancelled = true;
+    }
+
+    public boolean isCancelled() {
+        return mCancelled;
+    }
+
+    public synchronized boolean isFinished() {
+        return mFinished;
+    }
+
+    /** The number of matches found so far, from the bottom up and left to right within lines. */
+    public synchronized int getMatchCount() {
+        return mMatchCount;
+    }
+
+    /**
+     * Get a match as its start row and column and end row and exclusive end column. The rows are external rows as of
+     * the last {@link #search(TerminalBuffer, int)}, see {@link TerminalBuffer#externalToInternalRow(int)}.
+     */
+    public synchronized void getMatch(int index, int[] range) {
+        if (index < 0 || index >= mMatchCount) throw new IndexOutOfBoundsException("index=" + index + ", mMatchCount=" + mMatchCount);
+        range[0] = mMatches[4 * index] - mHistoryRows;
+        range[1] = mMatches[4 * index + 1];
+        range[2] = mMatches[4 * index + 2] - mHistoryRows;
+        range[3] = mMatches[4 * index + 3];
+    }
+
+    /** Free the native search. */
+    public synchronized void close() {
+        if (mNativeSearch != 0) nativeFree(mNativeSearch);
+        mNativeSearch = 0;
+    }
+
+    @Override
+    protected void finalize() throws Throwable {
+        try {
+            close();
+        } finally {
+            super.finalize();
+        }
+    }
+
+    /** Forget the rows searched and the matches found, to search all rows again. */
+    private void restart() {
+        mNextRow = -1;
+        mMatchCount = 0;
+    }
+
+    /** Move the rows searched and the matches found up by the number of rows dropped from the top of the history. */
+    private void dropRows(long droppedRows) {
+        final int dropped = (int) Math.min(droppedRows, Integer.MAX_VALUE);
+        mNextRow = (mNextRow >= dropped) ? mNextRow - dropped : -1;
+        int kept = 0;
+        for (int i = 0; i < mMatchCount; i++) {
+            // A match starting on a dropped row is gone, even if it ended on a row which is left.
+            if (mMatches[4 * i] < dropped) continue;
+            mMatches[4 * kept] = mMatches[4 * i] - dropped;
+            mMatches[4 * kept + 1] = mMatches[4 * i + 1];
+            mMatches[4 * kept + 2] = mMatches[4 * i + 2] - dropped;
+            mMatches[4 * kept + 3] = mMatches[4 * i + 3];
+            kept++;
+        }
+        mMatchCount = kept;
+    }
+
+    private void appendRow(TerminalRow row, int rowIndex, boolean lastOfLine) {
+        if (mBatchRows == mRows.length) {
+            mRows = Arrays.copyOf(mRows, 2 * mBatchRows);
+            mRowStarts = Arrays.copyOf(mRowStarts, 2 * mBatchRows);
+        }
+        mRows[mBatchRows] = rowIndex;
+        mRowStarts[mBatchRows++] = mTextLength;
+
+        int length = row.getSpaceUsed();
+        // Trailing spaces are only part of the line if it continues on the next row.
+        if (lastOfLine) while (length > 0 && row.mText[length - 1] == ' ') length--;
+        if (mTextLength + length + 1 > mText.length) mText = Arrays.copyOf(mText, Math.max(2 * mText.length, mTextLength + length + 1));
+        System.arraycopy(row.mText, 0, mText, mTextLength, length);
+        mTextLength += length;
+    }
+
+    private void appendChar(char c) {
+        if (mTextLength == mText.length) mText = Arrays.copyOf(mText, 2 * mText.length);
+        mText[mTextLength++] = c;
+    }
+
+    private void searchBatch() {
+        int start = 0;
+        while (start < mTextLength) {
+            int found = find(start);
+            for (int i = 0; i < found; i++) addMatch(mFound[2 * i], mFound[2 * i + 1]);
+            if (found < MAX_MATCHES_PER_CALL) break;
+            start = mFound[2 * found - 1];
+        }
+        mTextLength = 0;
+        mBatchRows = 0;
+    }
+
+    /** Find matches in the batch from start into {@link #mFound}, returning how many. */
+    private int find(int start) {
+        if (mPattern == null) return nativeFind(mNativeSearch, mText, mTextLength, start, mFound);
+        Matcher matcher = mPattern.matcher(CharBuffer.wrap(mText, 0, mTextLength));
+        int found = 0;
+        while (found < MAX_MATCHES_PER_CALL && start < mTextLength && matcher.find(start)) {
+            if (matcher.end() > matcher.start()) {
+                mFound[2 * found] = matcher.start();
+                mFound[2 * found + 1] = matcher.end();
+                found++;
+                start = matcher.end();
+            } else {
+                start = matcher.start() + 1;
+            }
+        }
+        return found;
+    }
+
+    private void addMatch(int start, int end) {
+        if (4 * mMatchCount == mMatches.length) mMatches = Arrays.copyOf(mMatches, 2 * mMatches.length);
+        int startRow = batchRowAt(start);
+        int endRow = batchRowAt(end - 1);
+        mMatches[4 * mMatchCount] = mRows[startRow];
+        mMatches[4 * mMatchCount + 1] = columnAt(mRowStarts[startRow], start);
+        mMatches[4 * mMatchCount + 2] = mRows[endRow];
+        mMatches[4 * mMatchCount + 3] = columnAt(mRowStarts[endRow], end);
+        mMatchCount++;
+    }
+
+    /** The index of the row in the batch containing the char at offset. */
+    private int batchRowAt(int offset) {
+        int index = Arrays.binarySearch(mRowStarts, 0, mBatchRows, offset);
+        if (index < 0) index = -index - 2;
+        // Rows without text start at the same offset as the next one.
+        while (index + 1 < mBatchRows && mRowStarts[index + 1] == offset) index++;
+        return index;
+    }
+
+    /** The column of the char at offset in the row of the batch starting at rowStart. */
+    private int columnAt(int rowStart, int offset) {
+        int column = 0;
+        for (int i = rowStart; i < offset; ) {
+            int codePoint = Character.codePointAt(mText, i, mTextLength);
+            column += Math.max(0, WcWidth.width(codePoint));
+            i += Character.charCount(codePoint);
+        }
+        return column;
+    }
+
+    private static native long nativeCompile(char[] pattern, int flags);
+
+    private static native void nativeFree(long search);
+
+    private static native int nativeFind(long search, char[] text, int length, int start, int[] matches);
+
+}
@@ -0,0 +1,38 @@
+package com.termux.terminal;
+
+/**
+ * Native decoding of terminal output from UTF-8 a whole buffer at a time, with SIMD for runs of ASCII. C code is in
+ * jni/utf8_decoder.c.
+ * <p>
+ * Malformed input is replaced as by {@link TerminalEmulator} when decoding byte by byte, except that unassigned code
+ * points are left to be replaced by the caller using {@link Character#getType(int)}. Each decoded value packs a code
+ * point with its {@link WcWidth#width(int)}, see {@link #CODE_POINT_MASK}, {@link #WIDTH_SHIFT} and
+ * {@link #FLAG_EMIT}.
+ */
+final class Utf8Decoder {
+
+    static final int CODE_POINT_MASK = 0x1FFFFF;
+    static final int WIDTH_SHIFT = 21;
+    static final int WIDTH_MASK = 0x3;
+    /**
+     * Set for the replacement character of a sequence interrupted by a byte that is not a continuation byte, which is
+     * sent directly to the screen instead of through the escape sequence state machine.
+     */
+    static final int FLAG_EMIT = 1 << 23;
+
+    /** Shorter input is decoded in Java, where the JNI call would cost more than the decoding. */
+    static final int MIN_NATIVE_DECODE_LENGTH = 64;
+
+    private Utf8Decoder() {
+    }
+
+    /**
+     * Decode length bytes of buffer from offset, starting with no sequence in progress. An incomplete sequence at the
+     * end is not consumed.
+     *
+     * @param decoded Filled with the decoded values, must have room for length values.
+     * @return the number of bytes consumed in the upper 32 bits, and the number of decoded values in the lower.
+     */
+    static native long decode(byte[] buffer, int offset, int length, int[] decoded);
+
+}
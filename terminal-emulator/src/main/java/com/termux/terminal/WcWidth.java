@@ -10,6 +10,7 @@ package com.termux.terminal;
  * https://github.com/termux/wcwidth
  * https://github.com/termux/libandroid-support
  * https://github.com/termux/termux-packages/tree/master/packages/libandroid-support
+ * jni/wcwidth.c in this module
  */
 public final class WcWidth {
 
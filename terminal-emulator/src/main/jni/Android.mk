@@ -1,5 +1,13 @@
 LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 LOCAL_MODULE:= libtermux
-LOCAL_SRC_FILES:= termux.c
+LOCAL_SRC_FILES:= termux.c subprocess.c spawn_client.c pty_reactor.c spsc_ring.c vt_scanner.c utf8_decoder.c wcwidth.c cell_store.c lz_block.c text_search.c
 include $(BUILD_SHARED_LIBRARY)
+
+# The spawn server is an executable, but is named like a shared library so that it is packaged
+# and extracted together with libtermux.so.
+include $(CLEAR_VARS)
+LOCAL_MODULE:= termux-spawn-server
+LOCAL_MODULE_FILENAME:= libtermux-spawn-server.so
+LOCAL_SRC_FILES:= spawn_server.c subprocess.c
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,441 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cell_store.h"
+#include "lz_block.h"
+#include "wcwidth.h"
+
+/** The size of the arena chunks, of which a packed row may use at most a quarter. */
+#define CELL_STORE_CHUNK_SIZE (256 * 1024)
+#define CELL_STORE_MAX_BLOCK_SIZE (CELL_STORE_CHUNK_SIZE / 4)
+/** Blocks are sized in steps of 16 bytes up to 4 KiB, and of 1 KiB above that. */
+#define CELL_STORE_SMALL_BLOCK_LIMIT 4096
+#define CELL_STORE_CLASS_COUNT (CELL_STORE_SMALL_BLOCK_LIMIT / 16 + (CELL_STORE_MAX_BLOCK_SIZE - CELL_STORE_SMALL_BLOCK_LIMIT) / 1024 + 1)
+/** The maximum number of combining characters kept per cell, as in TerminalRow. */
+#define CELL_STORE_MAX_COMBINING 15
+/** The number of decompressed cold blocks kept. */
+#define CELL_STORE_CACHED_BLOCKS 8
+
+/** Precedes each packed row, keeping 16 byte alignment of blocks and 8 byte alignment of rows. */
+struct block_header {
+    uint32_t size;
+    uint32_t reserved;
+};
+
+struct free_block {
+    struct free_block* next;
+};
+
+struct chunk {
+    struct chunk* next;
+    /* Aligns the data to 16 bytes. */
+    uint64_t padding;
+};
+
+/** The target of the handle of a cold row. */
+struct cold_row {
+    struct cold_block* block;
+    /** The offset of the packed row in the decompressed block. */
+    uint32_t offset;
+    uint32_t reserved;
+};
+
+struct cold_block {
+    struct cold_block* previous;
+    struct cold_block* next;
+    /** The number of rows in the block which have not been freed, the block being freed with the last one. */
+    uint32_t live_rows;
+    uint32_t row_count;
+    uint32_t raw_size;
+    /** The size of the block including this header. */
+    uint32_t size;
+    /* Followed by the compressed rows. */
+    struct cold_row rows[];
+};
+
+struct cached_block {
+    struct cold_block const* block;
+    uint8_t* data;
+    size_t capacity;
+    uint64_t last_use;
+};
+
+struct cell_store {
+    struct chunk* chunks;
+    uint8_t* bump;
+    size_t bump_left;
+    struct free_block* free_lists[CELL_STORE_CLASS_COUNT];
+    size_t used;
+    size_t reserved;
+    /** Scratch space for cells and combining characters while packing. */
+    uint32_t* scratch;
+    size_t scratch_capacity;
+
+    struct cold_block* cold_blocks;
+    size_t cold_size;
+    struct cached_block cache[CELL_STORE_CACHED_BLOCKS];
+    uint64_t clock;
+    /** Scratch space for the rows of a cold block before and after compression. */
+    uint8_t* raw;
+    size_t raw_capacity;
+    uint8_t* compressed;
+    size_t compressed_capacity;
+};
+
+static size_t block_size(size_t size)
+{
+    if (size <= CELL_STORE_SMALL_BLOCK_LIMIT) return (size + 15) & ~(size_t) 15;
+    return (size + 1023) & ~(size_t) 1023;
+}
+
+static size_t block_class(size_t block_size)
+{
+    if (block_size <= CELL_STORE_SMALL_BLOCK_LIMIT) return block_size / 16;
+    return CELL_STORE_SMALL_BLOCK_LIMIT / 16 + (block_size - CELL_STORE_SMALL_BLOCK_LIMIT) / 1024;
+}
+
+struct cell_store* cell_store_create(void)
+{
+    return calloc(1, sizeof(struct cell_store));
+}
+
+void cell_store_reset(struct cell_store* store)
+{
+    struct chunk* chunk = store->chunks;
+    while (chunk) {
+        struct chunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    store->chunks = NULL;
+    store->bump = NULL;
+    store->bump_left = 0;
+    memset(store->free_lists, 0, sizeof(store->free_lists));
+    store->used = 0;
+    store->reserved = 0;
+
+    struct cold_block* block = store->cold_blocks;
+    while (block) {
+        struct cold_block* next = block->next;
+        free(block);
+        block = next;
+    }
+    store->cold_blocks = NULL;
+    store->cold_size = 0;
+    for (int i = 0; i < CELL_STORE_CACHED_BLOCKS; i++) {
+        free(store->cache[i].data);
+        memset(&store->cache[i], 0, sizeof(store->cache[i]));
+    }
+}
+
+void cell_store_destroy(struct cell_store* store)
+{
+    cell_store_reset(store);
+    free(store->scratch);
+    free(store->raw);
+    free(store->compressed);
+    free(store);
+}
+
+static void* cell_store_alloc(struct cell_store* store, size_t size)
+{
+    size = block_size(size);
+    size_t class = block_class(size);
+    void* block = store->free_lists[class];
+    if (block) {
+        store->free_lists[class] = store->free_lists[class]->next;
+    } else {
+        if (store->bump_left < size) {
+            // The rest of the current chunk is abandoned, which is at most the largest block size.
+            struct chunk* chunk = malloc(sizeof(struct chunk) + CELL_STORE_CHUNK_SIZE);
+            if (!chunk) return NULL;
+            chunk->next = store->chunks;
+            store->chunks = chunk;
+            store->bump = (uint8_t*) (chunk + 1);
+            store->bump_left = CELL_STORE_CHUNK_SIZE;
+            store->reserved += CELL_STORE_CHUNK_SIZE;
+        }
+        block = store->bump;
+        store->bump += size;
+        store->bump_left -= size;
+    }
+    ((struct block_header*) block)->size = (uint32_t) size;
+    store->used += size;
+    return block;
+}
+
+static void free_cold_row(struct cell_store* store, struct cold_row* cold_row)
+{
+    struct cold_block* block = cold_row->block;
+    if (--block->live_rows > 0) return;
+    if (block->previous) block->previous->next = block->next; else store->cold_blocks = block->next;
+    if (block->next) block->next->previous = block->previous;
+    for (int i = 0; i < CELL_STORE_CACHED_BLOCKS; i++) {
+        if (store->cache[i].block == block) {
+            store->cache[i].block = NULL;
+            store->cache[i].last_use = 0;
+        }
+    }
+    store->cold_size -= block->size;
+    free(block);
+}
+
+void cell_store_free(struct cell_store* store, uintptr_t handle)
+{
+    if (cell_store_is_cold(handle)) {
+        free_cold_row(store, (struct cold_row*) (handle - 1));
+        return;
+    }
+    struct block_header* header = ((struct block_header*) handle) - 1;
+    size_t size = header->size;
+    struct free_block* block = (struct free_block*) header;
+    size_t class = block_class(size);
+    block->next = store->free_lists[class];
+    store->free_lists[class] = block;
+    store->used -= size;
+}
+
+void cell_store_usage(struct cell_store const* store, size_t* used, size_t* reserved)
+{
+    *used = store->used + store->cold_size;
+    *reserved = store->reserved + store->cold_size;
+    for (int i = 0; i < CELL_STORE_CACHED_BLOCKS; i++) *reserved += store->cache[i].capacity;
+}
+
+/** Make room for size bytes in a scratch buffer. */
+static int reserve(uint8_t** buffer, size_t* capacity, size_t size)
+{
+    if (*capacity >= size) return 0;
+    uint8_t* grown = realloc(*buffer, size);
+    if (!grown) return -1;
+    *buffer = grown;
+    *capacity = size;
+    return 0;
+}
+
+static inline size_t align8(size_t size)
+{
+    return (size + 7) & ~(size_t) 7;
+}
+
+int cell_store_compress(struct cell_store* store, uintptr_t* handles, size_t count)
+{
+    size_t row_count = 0;
+    size_t raw_size = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (cell_store_is_cold(handles[i])) continue;
+        row_count++;
+        raw_size += align8(packed_row_size((struct packed_row const*) handles[i]));
+    }
+    if (row_count == 0 || raw_size > UINT32_MAX) return -1;
+    if (reserve(&store->raw, &store->raw_capacity, raw_size)) return -1;
+    if (reserve(&store->compressed, &store->compressed_capacity, lz_block_bound(raw_size))) return -1;
+
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (cell_store_is_cold(handles[i])) continue;
+        struct packed_row const* row = (struct packed_row const*) handles[i];
+        size_t size = packed_row_size(row);
+        memcpy(store->raw + offset, row, size);
+        memset(store->raw + offset + size, 0, align8(size) - size);
+        offset += align8(size);
+    }
+    size_t compressed_size = lz_block_compress(store->raw, raw_size, store->compressed);
+    if (compressed_size >= raw_size) return -1;
+
+    size_t header_size = sizeof(struct cold_block) + row_count * sizeof(struct cold_row);
+    struct cold_block* block = malloc(header_size + compressed_size);
+    if (!block) return -1;
+    block->previous = NULL;
+    block->next = store->cold_blocks;
+    if (block->next) block->next->previous = block;
+    store->cold_blocks = block;
+    block->live_rows = block->row_count = (uint32_t) row_count;
+    block->raw_size = (uint32_t) raw_size;
+    block->size = (uint32_t) (header_size + compressed_size);
+    memcpy((uint8_t*) block + header_size, store->compressed, compressed_size);
+    store->cold_size += block->size;
+
+    offset = 0;
+    struct cold_row* cold_row = block->rows;
+    for (size_t i = 0; i < count; i++) {
+        if (cell_store_is_cold(handles[i])) continue;
+        cold_row->block = block;
+        cold_row->offset = (uint32_t) offset;
+        cold_row->reserved = 0;
+        offset += align8(packed_row_size((struct packed_row const*) handles[i]));
+        cell_store_free(store, handles[i]);
+        handles[i] = (uintptr_t) cold_row++ | 1;
+    }
+    return 0;
+}
+
+struct packed_row const* cell_store_row(struct cell_store* store, uintptr_t handle)
+{
+    if (!cell_store_is_cold(handle)) return (struct packed_row const*) handle;
+    struct cold_row const* cold_row = (struct cold_row const*) (handle - 1);
+    struct cold_block const* block = cold_row->block;
+
+    struct cached_block* cached = &store->cache[0];
+    for (int i = 0; i < CELL_STORE_CACHED_BLOCKS; i++) {
+        if (store->cache[i].block == block) {
+            cached = &store->cache[i];
+            cached->last_use = ++store->clock;
+            return (struct packed_row const*) (cached->data + cold_row->offset);
+        }
+        if (store->cache[i].last_use < cached->last_use) cached = &store->cache[i];
+    }
+
+    // Decompress into the least recently used entry.
+    cached->block = NULL;
+    cached->last_use = 0;
+    if (reserve(&cached->data, &cached->capacity, block->raw_size)) return NULL;
+    size_t header_size = sizeof(struct cold_block) + block->row_count * sizeof(struct cold_row);
+    if (lz_block_decompress((uint8_t const*) block + header_size, block->size - header_size, cached->data, block->raw_size)) return NULL;
+    cached->block = block;
+    cached->last_use = ++store->clock;
+    return (struct packed_row const*) (cached->data + cold_row->offset);
+}
+
+static inline int is_high_surrogate(uint32_t c)
+{
+    return c >= 0xD800 && c <= 0xDBFF;
+}
+
+static inline int is_low_surrogate(uint32_t c)
+{
+    return c >= 0xDC00 && c <= 0xDFFF;
+}
+
+uintptr_t cell_store_pack(struct cell_store* store, uint16_t const* text, size_t text_length, int64_t const* styles, size_t columns)
+{
+    if (columns == 0 || columns > UINT16_MAX) return 0;
+
+    // The cells are followed by the combining characters in the scratch space, of which there
+    // are less than one per java char.
+    size_t scratch_needed = columns + text_length;
+    if (store->scratch_capacity < scratch_needed) {
+        uint32_t* scratch = realloc(store->scratch, scratch_needed * sizeof(uint32_t));
+        if (!scratch) return 0;
+        store->scratch = scratch;
+        store->scratch_capacity = scratch_needed;
+    }
+    uint32_t* cells = store->scratch;
+    uint32_t* combining = cells + columns;
+    size_t combining_count = 0;
+    size_t combining_group = 0;
+
+    size_t column = 0;
+    size_t base_column = SIZE_MAX;
+    for (size_t i = 0; i < text_length;) {
+        uint32_t code_point = text[i++];
+        if (is_high_surrogate(code_point)) {
+            if (i == text_length || !is_low_surrogate(text[i])) return 0;
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) + (text[i++] - 0xDC00);
+        } else if (is_low_surrogate(code_point)) {
+            return 0;
+        }
+
+        int width = termux_wcwidth((int32_t) code_point);
+        if (width <= 0) {
+            if (base_column == SIZE_MAX) return 0;
+            if (!(cells[base_column] & CELL_COMBINING)) {
+                cells[base_column] |= CELL_COMBINING;
+                combining_group = combining_count;
+                combining[combining_count++] = 0;
+            }
+            if (combining[combining_group] == CELL_STORE_MAX_COMBINING) return 0;
+            combining[combining_group]++;
+            combining[combining_count++] = code_point;
+        } else {
+            if (column + (size_t) width > columns) return 0;
+            base_column = column;
+            cells[column++] = code_point;
+            if (width == 2) cells[column++] = CELL_WIDE_TAIL;
+        }
+    }
+    if (column != columns) return 0;
+
+    size_t cell_count = columns;
+    while (cell_count > 0 && cells[cell_count - 1] == ' ') cell_count--;
+
+    size_t run_count = 1;
+    for (size_t i = 1; i < columns; i++)
+        if (styles[i] != styles[i - 1]) run_count++;
+
+    size_t size = sizeof(struct block_header) + sizeof(struct packed_row) + run_count * sizeof(uint64_t)
+        + ((run_count + 1) & ~(size_t) 1) * sizeof(uint16_t) + (cell_count + combining_count) * sizeof(uint32_t);
+    if (size > CELL_STORE_MAX_BLOCK_SIZE) return 0;
+    struct block_header* block = cell_store_alloc(store, size);
+    if (!block) return 0;
+
+    struct packed_row* row = (struct packed_row*) (block + 1);
+    row->columns = (uint16_t) columns;
+    row->cell_count = (uint16_t) cell_count;
+    row->run_count = (uint16_t) run_count;
+    row->combining_count = (uint16_t) combining_count;
+
+    uint64_t* run_styles = (uint64_t*) packed_row_run_styles(row);
+    uint16_t* run_ends = (uint16_t*) packed_row_run_ends(row);
+    size_t run = 0;
+    for (size_t i = 1; i < columns; i++) {
+        if (styles[i] != styles[i - 1]) {
+            run_styles[run] = (uint64_t) styles[i - 1];
+            run_ends[run++] = (uint16_t) i;
+        }
+    }
+    run_styles[run] = (uint64_t) styles[columns - 1];
+    run_ends[run] = (uint16_t) columns;
+
+    memcpy((uint32_t*) packed_row_cells(row), cells, cell_count * sizeof(uint32_t));
+    memcpy((uint32_t*) packed_row_combining(row), combining, combining_count * sizeof(uint32_t));
+    return (uintptr_t) row;
+}
+
+static inline size_t put_code_point(uint16_t* text, size_t text_capacity, size_t length, uint32_t code_point)
+{
+    if (code_point >= 0x10000) {
+        if (length + 2 <= text_capacity) {
+            code_point -= 0x10000;
+            text[length] = (uint16_t) (0xD800 + (code_point >> 10));
+            text[length + 1] = (uint16_t) (0xDC00 + (code_point & 0x3FF));
+        }
+        return length + 2;
+    }
+    if (length < text_capacity) text[length] = (uint16_t) code_point;
+    return length + 1;
+}
+
+int cell_store_unpack(struct packed_row const* row, uint16_t* text, size_t text_capacity, int64_t* styles, int* non_one_width)
+{
+    uint32_t const* cells = packed_row_cells(row);
+    uint32_t const* combining = packed_row_combining(row);
+    size_t length = 0;
+    *non_one_width = 0;
+    for (size_t column = 0; column < row->cell_count; column++) {
+        uint32_t cell = cells[column];
+        if (cell & CELL_WIDE_TAIL) {
+            *non_one_width = 1;
+            continue;
+        }
+        uint32_t code_point = cell & CELL_CODE_POINT_MASK;
+        if (code_point >= 0x10000) *non_one_width = 1;
+        length = put_code_point(text, text_capacity, length, code_point);
+        if (cell & CELL_COMBINING) {
+            *non_one_width = 1;
+            uint32_t count = *combining++;
+            for (uint32_t i = 0; i < count; i++)
+                length = put_code_point(text, text_capacity, length, *combining++);
+        }
+    }
+    size_t blank_columns = row->columns - row->cell_count;
+    if (length + blank_columns > text_capacity) return -(int) (length + blank_columns);
+    for (size_t i = 0; i < blank_columns; i++) text[length++] = ' ';
+
+    uint64_t const* run_styles = packed_row_run_styles(row);
+    uint16_t const* run_ends = packed_row_run_ends(row);
+    size_t column = 0;
+    for (size_t run = 0; run < row->run_count; run++)
+        for (; column < run_ends[run]; column++) styles[column] = (int64_t) run_styles[run];
+    return (int) length;
+}
@@ -0,0 +1,123 @@
+#ifndef TERMUX_CELL_STORE_H
+#define TERMUX_CELL_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Compact storage of terminal rows which are not being written to, such as transcript rows.
+ *
+ * A packed row has one 4-byte cell per column instead of the UTF-16 text and 8-byte style per
+ * column of TerminalRow. Cells hold the code point, or mark the second column of a wide character.
+ * Combining characters are kept in a side table after the cells. Styles are stored as runs of
+ * columns with the same style, and trailing blank cells are not stored at all.
+ *
+ * Packed rows are allocated from chunks of an arena owned by the store, with free lists for
+ * reuse, so that freeing all rows at once is cheap.
+ *
+ * Rows which are not expected to be accessed again can be moved into cold blocks of many rows,
+ * compressed with lz_block.h. Cold rows are decompressed a block at a time into a cache of the
+ * most recently used blocks when accessed.
+ *
+ * Rows are referred to by handles, which for rows in the arena are their struct packed_row, and
+ * for cold rows a reference into their block with the lowest bit set.
+ */
+
+/** The cell marks the second column of the wide character in the previous cell. */
+#define CELL_WIDE_TAIL (1u << 30)
+/** The cell is followed by combining characters in the side table of the row. */
+#define CELL_COMBINING (1u << 29)
+#define CELL_CODE_POINT_MASK 0x1FFFFFu
+
+struct packed_row {
+    uint16_t columns;
+    /** The number of stored cells, the columns after which are spaces. */
+    uint16_t cell_count;
+    /** The number of style runs, which together cover all columns. */
+    uint16_t run_count;
+    /**
+     * The number of values in the combining character side table. For each cell marked with
+     * CELL_COMBINING in column order it has the number of combining characters followed by them.
+     */
+    uint16_t combining_count;
+    /*
+     * Followed by:
+     * uint64_t run_styles[run_count];
+     * uint16_t run_ends[run_count], padded to 4 bytes;
+     * uint32_t cells[cell_count];
+     * uint32_t combining[combining_count];
+     */
+};
+
+static inline uint64_t const* packed_row_run_styles(struct packed_row const* row)
+{
+    return (uint64_t const*) (row + 1);
+}
+
+static inline uint16_t const* packed_row_run_ends(struct packed_row const* row)
+{
+    return (uint16_t const*) (packed_row_run_styles(row) + row->run_count);
+}
+
+static inline uint32_t const* packed_row_cells(struct packed_row const* row)
+{
+    return (uint32_t const*) (packed_row_run_ends(row) + ((row->run_count + 1u) & ~1u));
+}
+
+static inline uint32_t const* packed_row_combining(struct packed_row const* row)
+{
+    return packed_row_cells(row) + row->cell_count;
+}
+
+static inline size_t packed_row_size(struct packed_row const* row)
+{
+    return (size_t) ((uint8_t const*) (packed_row_combining(row) + row->combining_count) - (uint8_t const*) row);
+}
+
+static inline int cell_store_is_cold(uintptr_t handle)
+{
+    return handle & 1;
+}
+
+struct cell_store;
+
+struct cell_store* cell_store_create(void);
+
+void cell_store_destroy(struct cell_store* store);
+
+/** Free all packed rows. */
+void cell_store_reset(struct cell_store* store);
+
+/**
+ * Pack a row of the given number of columns from its UTF-16 text, as in TerminalRow.mText, and
+ * its style per column. Returns the handle of the row, or 0 if the text does not have a cell for
+ * each column, if the row would be too large, or if out of memory.
+ */
+uintptr_t cell_store_pack(struct cell_store* store, uint16_t const* text, size_t text_length, int64_t const* styles, size_t columns);
+
+/** The maximum number of rows compressed into a cold block, which matches TerminalBuffer.COLD_BLOCK_ROWS. */
+#define CELL_STORE_COLD_BLOCK_ROWS 256
+
+/**
+ * Move the rows of the count handles which are not already cold into a compressed cold block,
+ * replacing their handles. Returns -1 leaving the rows as they are if there are no such rows, if
+ * they do not compress or if out of memory. At most CELL_STORE_COLD_BLOCK_ROWS handles are passed.
+ */
+int cell_store_compress(struct cell_store* store, uintptr_t* handles, size_t count);
+
+/** The packed row of a handle, or NULL if it is cold and its block could not be decompressed. */
+struct packed_row const* cell_store_row(struct cell_store* store, uintptr_t handle);
+
+/**
+ * Unpack a row into UTF-16 text and a style per column. Returns the length of the text, or if
+ * text_capacity is too small, the negated length needed. Sets *non_one_width if the row has
+ * characters which are not one java char and one column wide.
+ */
+int cell_store_unpack(struct packed_row const* row, uint16_t* text, size_t text_capacity, int64_t* styles, int* non_one_width);
+
+void cell_store_free(struct cell_store* store, uintptr_t handle);
+
+/** The number of bytes used by packed rows, and reserved for them in the arena, cold blocks and the cache. */
+void cell_store_usage(struct cell_store const* store, size_t* used, size_t* reserved);
+
+#endif
@@ -0,0 +1,111 @@
+#include <string.h>
+
+#include "lz_block.h"
+
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+
+static inline uint32_t read32(uint8_t const* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t lz_hash(uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static uint8_t* put_length(uint8_t* out, size_t length)
+{
+    for (; length >= 255; length -= 255) *out++ = 255;
+    *out++ = (uint8_t) length;
+    return out;
+}
+
+/** Write a sequence of literals followed by a match, or if match_length is 0 the last sequence. */
+static uint8_t* put_sequence(uint8_t* out, uint8_t const* literals, size_t literal_length, size_t offset, size_t match_length)
+{
+    size_t match_code = match_length ? match_length - LZ_MIN_MATCH : 0;
+    *out++ = (uint8_t) (((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15));
+    if (literal_length >= 15) out = put_length(out, literal_length - 15);
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+    if (match_length) {
+        *out++ = (uint8_t) offset;
+        *out++ = (uint8_t) (offset >> 8);
+        if (match_code >= 15) out = put_length(out, match_code - 15);
+    }
+    return out;
+}
+
+size_t lz_block_compress(uint8_t const* src, size_t length, uint8_t* dst)
+{
+    // Positions of the last four bytes seen with each hash, which are verified before use.
+    uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    uint8_t* out = dst;
+    size_t anchor = 0;
+    size_t i = 0;
+    while (i + LZ_MIN_MATCH <= length) {
+        uint32_t value = read32(src + i);
+        uint32_t hash = lz_hash(value);
+        size_t candidate = table[hash];
+        table[hash] = (uint32_t) i;
+        if (candidate < i && i - candidate <= LZ_MAX_OFFSET && read32(src + candidate) == value) {
+            size_t match_length = LZ_MIN_MATCH;
+            while (i + match_length < length && src[candidate + match_length] == src[i + match_length]) match_length++;
+            out = put_sequence(out, src + anchor, i - anchor, i - candidate, match_length);
+            i += match_length;
+            anchor = i;
+        } else {
+            i++;
+        }
+    }
+    return (size_t) (put_sequence(out, src + anchor, length - anchor, 0, 0) - dst);
+}
+
+static int get_length(uint8_t const** in, uint8_t const* end, size_t* length)
+{
+    uint8_t b;
+    do {
+        if (*in == end) return -1;
+        b = *(*in)++;
+        *length += b;
+    } while (b == 255);
+    return 0;
+}
+
+int lz_block_decompress(uint8_t const* src, size_t src_length, uint8_t* dst, size_t dst_length)
+{
+    uint8_t const* in = src;
+    uint8_t const* end = src + src_length;
+    size_t out = 0;
+    while (in < end) {
+        uint8_t token = *in++;
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && get_length(&in, end, &literal_length)) return -1;
+        if ((size_t) (end - in) < literal_length || dst_length - out < literal_length) return -1;
+        memcpy(dst + out, in, literal_length);
+        in += literal_length;
+        out += literal_length;
+        if (in == end) break;
+
+        if (end - in < 2) return -1;
+        size_t offset = in[0] | ((size_t) in[1] << 8);
+        in += 2;
+        size_t match_length = token & 15;
+        if (match_length == 15 && get_length(&in, end, &match_length)) return -1;
+        match_length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > out || dst_length - out < match_length) return -1;
+        // The match may overlap the output it is copied to, repeating it.
+        uint8_t* to = dst + out;
+        uint8_t const* from = to - offset;
+        for (size_t i = 0; i < match_length; i++) to[i] = from[i];
+        out += match_length;
+    }
+    return (out == dst_length) ? 0 : -1;
+}
@@ -0,0 +1,28 @@
+#ifndef TERMUX_LZ_BLOCK_H
+#define TERMUX_LZ_BLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A fast byte-oriented LZ77 compressor for blocks of packed transcript rows, in the style of LZ4.
+ *
+ * A compressed block is a sequence of a token byte, with the number of literals in the upper four
+ * bits and the match length minus four in the lower, the literals, a little-endian 16-bit offset
+ * back to the match and any further length bytes. Lengths of 15 and more continue in following
+ * bytes, each adding up to 255. The last sequence has only literals.
+ */
+
+/** The size of the output buffer needed to compress length bytes. */
+static inline size_t lz_block_bound(size_t length)
+{
+    return length + length / 255 + 16;
+}
+
+/** Compress length bytes of src into dst, which must have lz_block_bound(length) bytes. Returns the compressed size. */
+size_t lz_block_compress(uint8_t const* src, size_t length, uint8_t* dst);
+
+/** Decompress into exactly dst_length bytes of dst. Returns 0, or -1 if the data is corrupt. */
+int lz_block_decompress(uint8_t const* src, size_t src_length, uint8_t* dst, size_t dst_length);
+
+#endif
@@ -0,0 +1,688 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pty_reactor.h"
+#include "spawn_client.h"
+#include "spsc_ring.h"
+#include "subprocess.h"
+
+/** The default size of the buffered output per session. The pty is not read from while it is full. */
+#define DEFAULT_OUTPUT_BUFFER_SIZE (1024 * 1024)
+#define MIN_OUTPUT_BUFFER_SIZE (4 * 1024)
+#define MAX_OUTPUT_BUFFER_SIZE (64 * 1024 * 1024)
+/** Buffered input per session. Writers block while it is full, like with the ByteQueue used before. */
+#define INPUT_BUFFER_SIZE (4 * 1024)
+/**
+ * While output keeps arriving, the app is notified about it at most once per coalescing window or
+ * when a batch of this many bytes has been buffered, instead of once per read from the pty.
+ */
+#define DEFAULT_COALESCING_WINDOW_MILLIS 2
+#define MAX_COALESCING_WINDOW_MILLIS 16
+#define DEFAULT_MAX_BATCH_SIZE (64 * 1024)
+#define MIN_MAX_BATCH_SIZE (4 * 1024)
+/** How often processes without a pidfd are checked for having exited. */
+#define EXIT_POLL_INTERVAL_MILLIS 500
+#define MAX_EVENTS 32
+
+/** The epoll data of events is the session id shifted left by one, with the lowest bit telling the fd kind. */
+#define EVENT_KIND_PTY 0
+#define EVENT_KIND_PIDFD 1
+#define WAKEUP_EVENT_DATA UINT64_MAX
+
+struct byte_ring {
+    uint8_t* data;
+    size_t capacity;
+    size_t start;
+    size_t count;
+};
+
+struct reactor_session {
+    int id;
+    /** The pty master, or -1 if only the exit of the process is watched. */
+    int ptm;
+    pid_t pid;
+    /** A pidfd registered in the epoll set, or -1 if exits are detected by polling. */
+    int pidfd;
+    /**
+     * The pidfd was opened by the reactor from the pid after the process was created, so it may
+     * refer to another process which reused the pid, and the exit of the child is also polled for.
+     */
+    bool pidfd_from_pid;
+    /** The events the ptm is registered for in the epoll set, or 0 if it is not in it. */
+    uint32_t ptm_events;
+    /**
+     * Output of the process not yet read by the app, produced by the reactor thread and consumed
+     * without taking the reactor lock.
+     */
+    struct spsc_ring* output;
+    /** Input for the process not yet written to the pty. */
+    struct byte_ring input;
+    /** The pty master reached end of file, which happens when no process has the slave open anymore. */
+    bool eof;
+    bool write_failed;
+    bool exited;
+    /** The exit callback waits for the output buffer to have room for the remaining output. */
+    bool exit_pending;
+    int exit_code;
+    /** When output was last read from the pty. */
+    int64_t last_output_millis;
+    /** When the held back notification about output is due, or 0 if none is held back. */
+    int64_t notify_deadline_millis;
+    struct pty_reactor_stats stats;
+};
+
+/** A callback which the reactor thread invokes after releasing the reactor lock. */
+struct pending_callback {
+    int session_id;
+    bool exited;
+    int exit_code;
+};
+
+/** Protects all state below except the pending callbacks, which are only used by the reactor thread. */
+static pthread_mutex_t reactor_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t input_drained = PTHREAD_COND_INITIALIZER;
+
+static int epoll_fd = -1;
+static int wakeup_fd = -1;
+/** An eventfd signalled whenever the process of a session or a watched process has exited. */
+static int exit_event_fd = -1;
+static struct reactor_session** sessions = NULL;
+static int session_count = 0;
+static int session_capacity = 0;
+static int next_session_id = 0;
+static atomic_size_t output_buffer_size = DEFAULT_OUTPUT_BUFFER_SIZE;
+static atomic_int coalescing_window_millis = DEFAULT_COALESCING_WINDOW_MILLIS;
+static atomic_size_t max_batch_size = DEFAULT_MAX_BATCH_SIZE;
+
+static struct pending_callback* pending_callbacks = NULL;
+static int pending_callback_count = 0;
+static int pending_callback_capacity = 0;
+
+static int ring_init(struct byte_ring* ring, size_t capacity)
+{
+    ring->data = malloc(capacity);
+    ring->capacity = capacity;
+    ring->start = 0;
+    ring->count = 0;
+    return ring->data ? 0 : -1;
+}
+
+/** Fill iov with the (up to two) free or used regions of the ring. Returns the number of regions. */
+static int ring_regions(struct byte_ring const* ring, bool free_space, struct iovec iov[2])
+{
+    size_t position = free_space ? (ring->start + ring->count) % ring->capacity : ring->start;
+    size_t length = free_space ? ring->capacity - ring->count : ring->count;
+    if (length == 0) return 0;
+    size_t first_length = ring->capacity - position;
+    if (first_length > length) first_length = length;
+    iov[0] = (struct iovec) { .iov_base = ring->data + position, .iov_len = first_length };
+    if (first_length == length) return 1;
+    iov[1] = (struct iovec) { .iov_base = ring->data, .iov_len = length - first_length };
+    return 2;
+}
+
+static ssize_t ring_write_to(struct byte_ring* ring, int fd)
+{
+    struct iovec iov[2];
+    ssize_t bytes = writev(fd, iov, ring_regions(ring, false, iov));
+    if (bytes > 0) {
+        ring->start = (ring->start + (size_t) bytes) % ring->capacity;
+        ring->count -= (size_t) bytes;
+    }
+    return bytes;
+}
+
+static size_t ring_push(struct byte_ring* ring, uint8_t const* data, size_t size)
+{
+    struct iovec iov[2];
+    int region_count = ring_regions(ring, true, iov);
+    size_t copied = 0;
+    for (int i = 0; i < region_count && copied < size; i++) {
+        size_t length = iov[i].iov_len < size - copied ? iov[i].iov_len : size - copied;
+        memcpy(iov[i].iov_base, data + copied, length);
+        copied += length;
+    }
+    ring->count += copied;
+    return copied;
+}
+
+static int64_t monotonic_millis(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void signal_eventfd(int fd)
+{
+    uint64_t one = 1;
+    while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR);
+}
+
+static void wake_reactor(void)
+{
+    signal_eventfd(wakeup_fd);
+}
+
+static struct reactor_session* find_session(int session_id)
+{
+    for (int i = 0; i < session_count; i++) {
+        if (sessions[i]->id == session_id) return sessions[i];
+    }
+    return NULL;
+}
+
+/** Register the ptm of a session for the events it currently needs. */
+static void update_ptm_events(struct reactor_session* session)
+{
+    if (session->ptm < 0) return;
+    uint32_t events = 0;
+    if (!session->eof) {
+        if (!spsc_ring_is_paused(session->output)) events |= EPOLLIN;
+        if (session->input.count > 0 && !session->write_failed) events |= EPOLLOUT;
+    }
+    if (events == session->ptm_events) return;
+
+    struct epoll_event event = { .events = events, .data.u64 = ((uint64_t) session->id << 1) | EVENT_KIND_PTY };
+    int operation = events == 0 ? EPOLL_CTL_DEL : (session->ptm_events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD);
+    if (epoll_ctl(epoll_fd, operation, session->ptm, &event) == 0 || operation == EPOLL_CTL_DEL) {
+        session->ptm_events = events;
+    }
+}
+
+static void remove_pidfd(struct reactor_session* session)
+{
+    if (session->pidfd < 0) return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session->pidfd, NULL);
+    close(session->pidfd);
+    session->pidfd = -1;
+}
+
+static void free_session(struct reactor_session* session)
+{
+    spsc_ring_destroy(session->output);
+    free(session->input.data);
+    free(session);
+}
+
+static void add_pending_callback(int session_id, bool exited, int exit_code)
+{
+    if (pending_callback_count == pending_callback_capacity) {
+        int new_capacity = pending_callback_capacity == 0 ? MAX_EVENTS : pending_callback_capacity * 2;
+        struct pending_callback* new_callbacks = realloc(pending_callbacks, (size_t) new_capacity * sizeof(struct pending_callback));
+        // Out of memory, so the callback has to be dropped.
+        if (!new_callbacks) return;
+        pending_callbacks = new_callbacks;
+        pending_callback_capacity = new_capacity;
+    }
+    pending_callbacks[pending_callback_count++] = (struct pending_callback) { .session_id = session_id, .exited = exited, .exit_code = exit_code };
+}
+
+/**
+ * Notify the app about buffered output, unless the notification is held back to batch output
+ * which keeps arriving and is not due yet.
+ */
+static void notify_session_output(struct reactor_session* session, int64_t now)
+{
+    if (session->notify_deadline_millis != 0) {
+        bool due = now >= session->notify_deadline_millis || session->eof || session->exited
+            || spsc_ring_is_paused(session->output)
+            || spsc_ring_readable(session->output) >= atomic_load_explicit(&max_batch_size, memory_order_relaxed);
+        if (!due) return;
+        session->notify_deadline_millis = 0;
+    }
+    if (spsc_ring_should_notify(session->output)) {
+        session->stats.notifications++;
+        add_pending_callback(session->id, false, 0);
+    }
+}
+
+/** Read from the pty until it would block, end of file or the output buffer is full. */
+static void read_session_output(struct reactor_session* session)
+{
+    size_t produced = 0;
+    while (!session->eof) {
+        struct iovec iov[2];
+        int region_count = spsc_ring_free_regions(session->output, iov);
+        if (region_count == 0) {
+            if (spsc_ring_pause_if_full(session->output)) break;
+            continue;
+        }
+        ssize_t bytes = readv(session->ptm, iov, region_count);
+        if (bytes > 0) {
+            spsc_ring_produce(session->output, (size_t) bytes);
+            produced += (size_t) bytes;
+            session->stats.reads++;
+            continue;
+        }
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes < 0 && errno == EAGAIN) break;
+        // The slave side has been closed, which reading the master reports as EIO.
+        session->eof = true;
+        spsc_ring_close(session->output);
+    }
+
+    int64_t now = monotonic_millis();
+    if (produced > 0) {
+        session->stats.bytes += produced;
+        // Output after a pause, such as the echo of a key press, is passed on at once. Output arriving
+        // within the coalescing window of the previous output is held back until the window has passed.
+        int window = atomic_load_explicit(&coalescing_window_millis, memory_order_relaxed);
+        if (now - session->last_output_millis < window && session->notify_deadline_millis == 0) {
+            session->notify_deadline_millis = now + window;
+        }
+        session->last_output_millis = now;
+    }
+    notify_session_output(session, now);
+}
+
+/**
+ * Queue the exit callback of a session once all output has been buffered, so that the app gets all
+ * of it before the exit even if it did not fit in the output buffer at the time of the exit.
+ */
+static void deliver_pending_exit(struct reactor_session* session)
+{
+    if (!session->exit_pending || spsc_ring_is_paused(session->output)) return;
+    session->exit_pending = false;
+    add_pending_callback(session->id, true, session->exit_code);
+}
+
+static void write_session_input(struct reactor_session* session)
+{
+    size_t count_before = session->input.count;
+    while (session->input.count > 0) {
+        ssize_t bytes = ring_write_to(&session->input, session->ptm);
+        if (bytes > 0) continue;
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes < 0 && errno == EAGAIN) break;
+        session->write_failed = true;
+        session->input.count = 0;
+    }
+    if (session->input.count < count_before) pthread_cond_broadcast(&input_drained);
+}
+
+/**
+ * Check without blocking if the process of a session has exited. The process of a session with a
+ * pty is reaped and the exit callback is queued, while a watched process is left for its owner to
+ * reap. The exit event fd is signalled in both cases.
+ */
+static void check_session_exit(struct reactor_session* session, bool pidfd_ready)
+{
+    if (session->exited) return;
+
+    bool reap = session->ptm >= 0;
+    int status = 0;
+    int result = spawn_server_try_wait(session->pid, &status, reap);
+    if (result == 0) return;
+    if (result < 0 && reap) {
+        pid_t waited = waitpid(session->pid, &status, WNOHANG);
+        if (waited == 0) return;
+        // The process has already been reaped elsewhere if waiting fails, so its status is unknown.
+        if (waited < 0) status = 0;
+    } else if (result < 0 && !pidfd_ready) {
+        // Check for the exit without reaping, or that the process is gone if it is not our child.
+        siginfo_t info = { .si_pid = 0 };
+        int waited = waitid(P_PID, (id_t) session->pid, &info, WEXITED | WNOHANG | WNOWAIT);
+        if (waited == 0 && info.si_pid == 0) return;
+        if (waited != 0 && kill(session->pid, 0) == 0) return;
+    }
+
+    session->exited = true;
+    remove_pidfd(session);
+    signal_eventfd(exit_event_fd);
+    if (reap) {
+        // Buffer output written just before exiting, so that the app gets it before the exit.
+        session->exit_pending = true;
+        session->exit_code = exit_code_from_wait_status(status);
+        read_session_output(session);
+        update_ptm_events(session);
+        deliver_pending_exit(session);
+    }
+}
+
+/** Forget watched processes which have exited, since nobody reads from them. */
+static void remove_exited_watches(void)
+{
+    for (int i = 0; i < session_count; ) {
+        struct reactor_session* session = sessions[i];
+        if (session->ptm < 0 && session->exited) {
+            sessions[i] = sessions[--session_count];
+            free_session(session);
+        } else {
+            i++;
+        }
+    }
+}
+
+/** If the exit of the process of a session is checked for by polling, and not only by its pidfd. */
+static bool polls_exit(struct reactor_session const* session)
+{
+    return session->pidfd < 0 || (session->pidfd_from_pid && session->ptm >= 0);
+}
+
+static bool needs_exit_polling(void)
+{
+    for (int i = 0; i < session_count; i++) {
+        if (!sessions[i]->exited && polls_exit(sessions[i])) return true;
+    }
+    return false;
+}
+
+/** The earliest time a held back output notification is due, or 0 if none is held back. */
+static int64_t next_notify_deadline(void)
+{
+    int64_t deadline = 0;
+    for (int i = 0; i < session_count; i++) {
+        int64_t session_deadline = sessions[i]->notify_deadline_millis;
+        if (session_deadline != 0 && (deadline == 0 || session_deadline < deadline)) deadline = session_deadline;
+    }
+    return deadline;
+}
+
+bool pty_reactor_init(void)
+{
+    pthread_mutex_lock(&reactor_lock);
+    if (epoll_fd < 0) {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        exit_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        struct epoll_event event = { .events = EPOLLIN, .data.u64 = WAKEUP_EVENT_DATA };
+        if (epoll_fd < 0 || wakeup_fd < 0 || exit_event_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &event) != 0) {
+            if (epoll_fd >= 0) close(epoll_fd);
+            if (wakeup_fd >= 0) close(wakeup_fd);
+            if (exit_event_fd >= 0) close(exit_event_fd);
+            epoll_fd = wakeup_fd = exit_event_fd = -1;
+        } else {
+            spawn_server_set_exit_listener(wake_reactor);
+        }
+    }
+    bool initialized = epoll_fd >= 0;
+    pthread_mutex_unlock(&reactor_lock);
+    return initialized;
+}
+
+void pty_reactor_run(struct pty_reactor_callbacks const* callbacks)
+{
+    struct epoll_event events[MAX_EVENTS];
+    while (true) {
+        pthread_mutex_lock(&reactor_lock);
+        int timeout = needs_exit_polling() ? EXIT_POLL_INTERVAL_MILLIS : -1;
+        int64_t deadline = next_notify_deadline();
+        if (deadline != 0) {
+            int64_t until_deadline = deadline - monotonic_millis();
+            if (until_deadline < 0) until_deadline = 0;
+            if (timeout < 0 || until_deadline < timeout) timeout = (int) until_deadline;
+        }
+        pthread_mutex_unlock(&reactor_lock);
+
+        int event_count = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+        if (event_count < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        pthread_mutex_lock(&reactor_lock);
+        bool check_all_exits = event_count == 0;
+        for (int i = 0; i < event_count; i++) {
+            if (events[i].data.u64 == WAKEUP_EVENT_DATA) {
+                uint64_t value;
+                while (read(wakeup_fd, &value, sizeof(value)) < 0 && errno == EINTR);
+                check_all_exits = true;
+                // Resume reading output which the app has made room for.
+                for (int j = 0; j < session_count; j++) {
+                    struct reactor_session* resumed = sessions[j];
+                    if (resumed->exit_pending) read_session_output(resumed);
+                    update_ptm_events(resumed);
+                    deliver_pending_exit(resumed);
+                }
+                continue;
+            }
+
+            struct reactor_session* session = find_session((int) (events[i].data.u64 >> 1));
+            if (!session) continue;
+            if ((events[i].data.u64 & 1) == EVENT_KIND_PIDFD) {
+                // A process created by the spawn server may exit before the server reports it, in
+                // which case the exit listener wakes the reactor, with polling as fallback.
+                remove_pidfd(session);
+                check_session_exit(session, true);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) write_session_input(session);
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) read_session_output(session);
+            update_ptm_events(session);
+            deliver_pending_exit(session);
+        }
+        if (check_all_exits) {
+            for (int i = 0; i < session_count; i++) {
+                if (polls_exit(sessions[i])) check_session_exit(sessions[i], false);
+            }
+        }
+        int64_t now = monotonic_millis();
+        for (int i = 0; i < session_count; i++) {
+            if (sessions[i]->notify_deadline_millis != 0) notify_session_output(sessions[i], now);
+        }
+        remove_exited_watches();
+        pthread_mutex_unlock(&reactor_lock);
+
+        for (int i = 0; i < pending_callback_count; i++) {
+            struct pending_callback* callback = &pending_callbacks[i];
+            if (callback->exited) {
+                callbacks->process_exited(callbacks->context, callback->session_id, callback->exit_code);
+            } else {
+                callbacks->output_available(callbacks->context, callback->session_id);
+            }
+        }
+        pending_callback_count = 0;
+    }
+}
+
+/**
+ * Add a session for the process pid, with ptm as pty master or -1 if only its exit is watched. The
+ * pidfd of the process is owned by the session, or opened from the pid if -1.
+ */
+static int add_session(int ptm, pid_t pid, int pidfd)
+{
+    struct reactor_session* session = calloc(1, sizeof(struct reactor_session));
+    if (!session) {
+        if (pidfd >= 0) close(pidfd);
+        return -1;
+    }
+    session->ptm = ptm;
+    session->pid = pid;
+    session->pidfd = -1;
+
+    int flags = -1;
+    if (ptm >= 0) {
+        flags = fcntl(ptm, F_GETFL);
+        session->output = spsc_ring_create(atomic_load(&output_buffer_size));
+        if (!session->output || ring_init(&session->input, INPUT_BUFFER_SIZE) != 0 ||
+                flags < 0 || fcntl(ptm, F_SETFL, flags | O_NONBLOCK) != 0) {
+            if (pidfd >= 0) close(pidfd);
+            free_session(session);
+            return -1;
+        }
+    }
+
+    bool pidfd_from_pid = pidfd < 0;
+    if (pidfd_from_pid) pidfd = open_pidfd(pid);
+
+    pthread_mutex_lock(&reactor_lock);
+    bool added = epoll_fd >= 0;
+    if (added && session_count == session_capacity) {
+        int new_capacity = session_capacity == 0 ? 16 : session_capacity * 2;
+        struct reactor_session** new_sessions = realloc(sessions, (size_t) new_capacity * sizeof(struct reactor_session*));
+        if (new_sessions) {
+            sessions = new_sessions;
+            session_capacity = new_capacity;
+        } else {
+            added = false;
+        }
+    }
+    if (!added) {
+        pthread_mutex_unlock(&reactor_lock);
+        if (pidfd >= 0) close(pidfd);
+        if (ptm >= 0) fcntl(ptm, F_SETFL, flags);
+        free_session(session);
+        return -1;
+    }
+
+    // Ids are kept positive, and wrap around long before colliding with a still registered session.
+    next_session_id = (next_session_id % INT32_MAX) + 1;
+    session->id = next_session_id;
+    sessions[session_count++] = session;
+    update_ptm_events(session);
+
+    if (pidfd >= 0) {
+        struct epoll_event event = { .events = EPOLLIN, .data.u64 = ((uint64_t) session->id << 1) | EVENT_KIND_PIDFD };
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pidfd, &event) == 0) {
+            session->pidfd = pidfd;
+            session->pidfd_from_pid = pidfd_from_pid;
+        } else {
+            close(pidfd);
+        }
+    }
+    int session_id = session->id;
+    bool exit_polled = polls_exit(session);
+    pthread_mutex_unlock(&reactor_lock);
+
+    // Make the reactor start polling for the exit if there is no pidfd which can be relied on.
+    if (exit_polled) wake_reactor();
+    return session_id;
+}
+
+int pty_reactor_register(int ptm, pid_t pid, int pidfd)
+{
+    return add_session(ptm, pid, pidfd);
+}
+
+int pty_reactor_watch(pid_t pid)
+{
+    return add_session(-1, pid, -1);
+}
+
+int pty_reactor_exit_event_fd(void)
+{
+    return exit_event_fd;
+}
+
+void pty_reactor_unregister(int session_id)
+{
+    pthread_mutex_lock(&reactor_lock);
+    struct reactor_session* session = NULL;
+    for (int i = 0; i < session_count; i++) {
+        if (sessions[i]->id == session_id) {
+            session = sessions[i];
+            sessions[i] = sessions[--session_count];
+            break;
+        }
+    }
+    if (session) {
+        if (session->ptm_events != 0) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session->ptm, NULL);
+        remove_pidfd(session);
+        // Let blocked writers notice that the session is gone.
+        pthread_cond_broadcast(&input_drained);
+    }
+    pthread_mutex_unlock(&reactor_lock);
+
+    if (session) free_session(session);
+}
+
+void pty_reactor_set_output_buffer_size(size_t size)
+{
+    if (size < MIN_OUTPUT_BUFFER_SIZE) size = MIN_OUTPUT_BUFFER_SIZE;
+    if (size > MAX_OUTPUT_BUFFER_SIZE) size = MAX_OUTPUT_BUFFER_SIZE;
+    atomic_store(&output_buffer_size, size);
+}
+
+void pty_reactor_set_read_batching(int window_millis, size_t max_batch)
+{
+    if (window_millis < 0) window_millis = 0;
+    if (window_millis > MAX_COALESCING_WINDOW_MILLIS) window_millis = MAX_COALESCING_WINDOW_MILLIS;
+    if (max_batch < MIN_MAX_BATCH_SIZE) max_batch = MIN_MAX_BATCH_SIZE;
+    if (max_batch > MAX_OUTPUT_BUFFER_SIZE) max_batch = MAX_OUTPUT_BUFFER_SIZE;
+    atomic_store(&coalescing_window_millis, window_millis);
+    atomic_store(&max_batch_size, max_batch);
+}
+
+bool pty_reactor_stats(int session_id, struct pty_reactor_stats* stats)
+{
+    pthread_mutex_lock(&reactor_lock);
+    struct reactor_session* session = find_session(session_id);
+    if (session) *stats = session->stats;
+    pthread_mutex_unlock(&reactor_lock);
+    return session != NULL;
+}
+
+struct spsc_ring* pty_reactor_output(int session_id)
+{
+    pthread_mutex_lock(&reactor_lock);
+    struct reactor_session* session = find_session(session_id);
+    struct spsc_ring* output = session ? session->output : NULL;
+    pthread_mutex_unlock(&reactor_lock);
+    return output;
+}
+
+int pty_reactor_read(struct spsc_ring* output, void* buffer, size_t size)
+{
+    bool resume = false;
+    size_t bytes = spsc_ring_pop(output, buffer, size, &resume);
+    // Resume reading from the pty if it was paused because the buffer was full.
+    if (resume) wake_reactor();
+    return (bytes == 0 && spsc_ring_is_drained(output)) ? -1 : (int) bytes;
+}
+
+void pty_reactor_consume(struct spsc_ring* output, size_t count)
+{
+    if (spsc_ring_consume(output, count)) wake_reactor();
+}
+
+int pty_reactor_write(int session_id, void const* data, size_t size)
+{
+    uint8_t const* position = data;
+    size_t remaining = size;
+
+    pthread_mutex_lock(&reactor_lock);
+    while (true) {
+        struct reactor_session* session = find_session(session_id);
+        if (!session || session->ptm < 0 || session->write_failed || session->eof) break;
+
+        // Write directly to the pty if nothing is queued before this data.
+        while (remaining > 0 && session->input.count == 0) {
+            ssize_t bytes = write(session->ptm, position, remaining);
+            if (bytes > 0) {
+                position += bytes;
+                remaining -= (size_t) bytes;
+            } else if (bytes < 0 && errno == EINTR) {
+                continue;
+            } else if (bytes < 0 && errno == EAGAIN) {
+                break;
+            } else {
+                session->write_failed = true;
+                break;
+            }
+        }
+        if (session->write_failed) break;
+
+        size_t queued = ring_push(&session->input, position, remaining);
+        position += queued;
+        remaining -= queued;
+        update_ptm_events(session);
+        if (remaining == 0) break;
+        pthread_cond_wait(&input_drained, &reactor_lock);
+    }
+    pthread_mutex_unlock(&reactor_lock);
+
+    return remaining == 0 ? (int) size : -1;
+}
@@ -0,0 +1,107 @@
+#ifndef TERMUX_PTY_REACTOR_H
+#define TERMUX_PTY_REACTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "spsc_ring.h"
+
+/**
+ * A single epoll thread doing the I/O of all terminal sessions. It reads the output of every pty
+ * master into a per session buffer, writes buffered input to it, and detects the exit of the
+ * session processes through pidfds (or polling on devices without them).
+ */
+
+/** Callbacks from the reactor thread, which are never called with reactor locks held. */
+struct pty_reactor_callbacks {
+    /**
+     * The output buffer of the session went from empty to non-empty, which may be held back to
+     * batch output, see pty_reactor_set_read_batching().
+     */
+    void (*output_available)(void* context, int session_id);
+    /** The session process exited, after all its output readable at the time has been buffered. */
+    void (*process_exited)(void* context, int session_id, int exit_code);
+    void* context;
+};
+
+/** Output counters of a session, to tell how well output is batched. */
+struct pty_reactor_stats {
+    /** The number of bytes read from the pty. */
+    uint64_t bytes;
+    /** The number of reads from the pty which returned output. */
+    uint64_t reads;
+    /** The number of times the app has been notified about output, each waking up its main thread. */
+    uint64_t notifications;
+};
+
+/** Create the epoll and wakeup descriptors. Returns false if the reactor cannot be used. */
+bool pty_reactor_init(void);
+
+/** Run the reactor loop on the calling thread. Only returns on a fatal epoll error. */
+void pty_reactor_run(struct pty_reactor_callbacks const* callbacks);
+
+/**
+ * Start doing the I/O for the ptm pty master of the pid process. The pidfd opened when the process
+ * was created is owned by the reactor from now on, also on failure, or -1 to open one from the pid.
+ * Returns the session id, or -1 on failure.
+ */
+int pty_reactor_register(int ptm, pid_t pid, int pidfd);
+
+/**
+ * Watch for the exit of the pid process without reaping it, which signals the exit event fd. The
+ * watch is removed after the exit. Returns the session id of the watch, or -1 on failure.
+ */
+int pty_reactor_watch(pid_t pid);
+
+/**
+ * An eventfd which is signalled whenever the process of a session or a watched process has exited,
+ * or -1 if the reactor is not initialized.
+ */
+int pty_reactor_exit_event_fd(void);
+
+/** Stop doing I/O for a session or stop watching a process. The pty master is not closed. */
+void pty_reactor_unregister(int session_id);
+
+/**
+ * Set the size of the output buffer of sessions registered from now on, which is clamped to
+ * between 4 KiB and 64 MiB and rounded up to a power of two. Defaults to 1 MiB.
+ */
+void pty_reactor_set_output_buffer_size(size_t size);
+
+/**
+ * Set how output is batched. Output which keeps arriving within window_millis of the previous
+ * output is notified about once the window has passed or max_batch bytes are buffered, while output
+ * after a pause is notified about at once. The window is clamped to between 0 (notify at once) and
+ * 16 ms and defaults to 2 ms, the batch size is clamped to between 4 KiB and 64 MiB and defaults to
+ * 64 KiB.
+ */
+void pty_reactor_set_read_batching(int window_millis, size_t max_batch);
+
+/** Get the output counters of a session. Returns false if the session is unknown. */
+bool pty_reactor_stats(int session_id, struct pty_reactor_stats* stats);
+
+/**
+ * The output buffer of a session, or NULL if the session is unknown or only watched. It is read
+ * from without taking the reactor lock, and stays valid until the session is unregistered, which
+ * must not happen while it is being read from.
+ */
+struct spsc_ring* pty_reactor_output(int session_id);
+
+/**
+ * Move up to size bytes from the output buffer of a session to buffer without blocking. Returns
+ * the number of bytes moved, or -1 if the pty reached end of file and all output has been read.
+ */
+int pty_reactor_read(struct spsc_ring* output, void* buffer, size_t size);
+
+/** Release bytes which have been read in place, see spsc_ring_peek(). */
+void pty_reactor_consume(struct spsc_ring* output, size_t count);
+
+/**
+ * Write input to a session, blocking while its input buffer is full. Returns -1 if the session is
+ * unknown or its pty cannot be written to anymore.
+ */
+int pty_reactor_write(int session_id, void const* data, size_t size);
+
+#endif
@@ -0,0 +1,401 @@
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "spawn_client.h"
+#include "spawn_server.h"
+#include "subprocess.h"
+
+#define SERVER_NOT_STARTED 0
+#define SERVER_RUNNING 1
+#define SERVER_STOPPED 2
+
+/** A process created by the spawn server, which is tracked until it has been waited for. */
+struct server_child {
+    pid_t pid;
+    /** A pidfd owned by the table, to wait for the process if the server dies first, or -1. */
+    int pidfd;
+    bool exited;
+    int status;
+};
+
+/** Serializes spawn requests, so that there is at most one reply pending. */
+static pthread_mutex_t request_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Protects all state below, which is updated by the server reader thread. */
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t state_changed = PTHREAD_COND_INITIALIZER;
+
+static int server_state = SERVER_NOT_STARTED;
+static int server_socket = -1;
+static pid_t server_pid = -1;
+
+static bool reply_available = false;
+static struct spawn_message reply;
+static int reply_ptm = -1;
+static int reply_pidfd = -1;
+
+static void (*exit_listener)(void) = NULL;
+
+static struct server_child* children = NULL;
+static int child_count = 0;
+static int child_capacity = 0;
+
+static struct server_child* find_child(pid_t pid)
+{
+    for (int i = 0; i < child_count; i++) {
+        if (children[i].pid == pid) return &children[i];
+    }
+    return NULL;
+}
+
+/** Track a process created by the spawn server, with a duplicate of its pidfd if pidfd is not -1. */
+static int add_child(pid_t pid, int pidfd)
+{
+    if (child_count == child_capacity) {
+        int new_capacity = child_capacity == 0 ? 8 : child_capacity * 2;
+        struct server_child* new_children = realloc(children, (size_t) new_capacity * sizeof(struct server_child));
+        if (!new_children) return -1;
+        children = new_children;
+        child_capacity = new_capacity;
+    }
+    int child_pidfd = pidfd >= 0 ? fcntl(pidfd, F_DUPFD_CLOEXEC, 0) : -1;
+    children[child_count++] = (struct server_child) { .pid = pid, .pidfd = child_pidfd, .exited = false, .status = 0 };
+    return 0;
+}
+
+static void remove_child(pid_t pid)
+{
+    struct server_child* child = find_child(pid);
+    if (child) {
+        if (child->pidfd >= 0) close(child->pidfd);
+        *child = children[--child_count];
+    }
+}
+
+/**
+ * Wait for a process that is not our child to be gone, for up to timeout_millis or forever if
+ * negative. Returns true if it is gone. Without a pidfd the pid is checked every 100 ms instead,
+ * which may find another process reusing it.
+ */
+static bool wait_until_gone(pid_t pid, int pidfd, int timeout_millis)
+{
+    if (pidfd >= 0) {
+        struct pollfd poll_fd = { .fd = pidfd, .events = POLLIN };
+        int result;
+        do {
+            result = poll(&poll_fd, 1, timeout_millis);
+        } while (result < 0 && errno == EINTR);
+        if (result >= 0) return result > 0;
+    }
+    if (timeout_millis == 0) return kill(pid, 0) != 0;
+    struct timespec poll_interval = { .tv_sec = 0, .tv_nsec = 100 * 1000 * 1000 };
+    while (kill(pid, 0) == 0) nanosleep(&poll_interval, NULL);
+    return true;
+}
+
+/** Close the file descriptors received with a message. */
+static void close_received_fds(int received_fds[SPAWN_MESSAGE_MAX_FDS])
+{
+    for (int i = 0; i < SPAWN_MESSAGE_MAX_FDS; i++) {
+        if (received_fds[i] >= 0) close(received_fds[i]);
+        received_fds[i] = -1;
+    }
+}
+
+/** Receive a message and the file descriptors attached to it, if any, which are -1 otherwise. Returns -1 on error or end of file. */
+static int receive_message(int fd, struct spawn_message* message, int received_fds[SPAWN_MESSAGE_MAX_FDS])
+{
+    for (int i = 0; i < SPAWN_MESSAGE_MAX_FDS; i++) received_fds[i] = -1;
+    char control[CMSG_SPACE(SPAWN_MESSAGE_MAX_FDS * sizeof(int))];
+    struct iovec iov = { .iov_base = message, .iov_len = sizeof(*message) };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof(control) };
+
+    ssize_t bytes;
+    do {
+        bytes = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (bytes < 0 && errno == EINTR);
+    if (bytes <= 0) return -1;
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len >= CMSG_LEN(sizeof(int))) {
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            if (count > SPAWN_MESSAGE_MAX_FDS) count = SPAWN_MESSAGE_MAX_FDS;
+            memcpy(received_fds, CMSG_DATA(cmsg), count * sizeof(int));
+        }
+    }
+
+    // The stream may split a message, in which case the attached file descriptors came with its first part.
+    size_t received = (size_t) bytes;
+    while (received < sizeof(*message)) {
+        bytes = recv(fd, (char*) message + received, sizeof(*message) - received, 0);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) {
+            close_received_fds(received_fds);
+            return -1;
+        }
+        received += (size_t) bytes;
+    }
+    return 0;
+}
+
+static void* read_server_messages(void* arg)
+{
+    (void) arg;
+    struct spawn_message message;
+    int fds[SPAWN_MESSAGE_MAX_FDS];
+    while (receive_message(server_socket, &message, fds) == 0) {
+        pthread_mutex_lock(&state_lock);
+        if (message.type == SPAWN_MESSAGE_EXITED) {
+            close_received_fds(fds);
+            struct server_child* child = find_child(message.pid);
+            if (child) {
+                child->exited = true;
+                child->status = message.value;
+                if (exit_listener) exit_listener();
+            }
+        } else {
+            if (message.type != SPAWN_MESSAGE_SPAWNED) close_received_fds(fds);
+            if (message.type == SPAWN_MESSAGE_SPAWNED && (fds[0] < 0 || add_child(message.pid, fds[1]) != 0)) {
+                // The process cannot be used or tracked, so do not leave it running.
+                kill(message.pid, SIGKILL);
+                close_received_fds(fds);
+                message = (struct spawn_message) { .type = SPAWN_MESSAGE_FAILED, .pid = 0, .value = SPAWN_ERROR_FORK };
+            }
+            reply = message;
+            reply_ptm = fds[0];
+            reply_pidfd = fds[1];
+            reply_available = true;
+        }
+        pthread_cond_broadcast(&state_changed);
+        pthread_mutex_unlock(&state_lock);
+    }
+
+    pthread_mutex_lock(&state_lock);
+    server_state = SERVER_STOPPED;
+    pthread_cond_broadcast(&state_changed);
+    if (exit_listener) exit_listener();
+    pthread_mutex_unlock(&state_lock);
+
+    // The socket is not closed since a request may still be writing to it, which now fails instead.
+    shutdown(server_socket, SHUT_RDWR);
+    waitpid(server_pid, NULL, 0);
+    return NULL;
+}
+
+/** Start the spawn server and its reader thread. Leaves the server stopped on failure, which is not retried. */
+static void start_server(void)
+{
+    pthread_mutex_lock(&state_lock);
+    server_state = SERVER_STOPPED;
+    pthread_mutex_unlock(&state_lock);
+
+    // The server executable is packaged as a native library, so it is next to libtermux.so. It does
+    // not exist on disk if the app does not extract its native libraries.
+    Dl_info info;
+    if (!dladdr((void*) &spawn_server_create_subprocess, &info) || !info.dli_fname) return;
+    char const* slash = strrchr(info.dli_fname, '/');
+    if (!slash) return;
+    char path[PATH_MAX];
+    int written = snprintf(path, sizeof(path), "%.*s/%s", (int) (slash - info.dli_fname), info.dli_fname, SPAWN_SERVER_EXECUTABLE);
+    if (written < 0 || written >= (int) sizeof(path) || access(path, X_OK) != 0) return;
+
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0) return;
+    char* argv[] = { (char*) SPAWN_SERVER_EXECUTABLE, NULL };
+    pid_t pid = spawn_helper_process(path, argv, sockets[1], SPAWN_SERVER_SOCKET_FD);
+    close(sockets[1]);
+    if (pid < 0) {
+        close(sockets[0]);
+        return;
+    }
+
+    server_socket = sockets[0];
+    server_pid = pid;
+    pthread_mutex_lock(&state_lock);
+    server_state = SERVER_RUNNING;
+    pthread_mutex_unlock(&state_lock);
+
+    pthread_t reader;
+    if (pthread_create(&reader, NULL, read_server_messages, NULL) != 0) {
+        pthread_mutex_lock(&state_lock);
+        server_state = SERVER_STOPPED;
+        pthread_mutex_unlock(&state_lock);
+        // Closing the socket makes the server exit.
+        close(server_socket);
+        waitpid(server_pid, NULL, 0);
+        return;
+    }
+    pthread_detach(reader);
+}
+
+static int send_fully(int fd, void const* buffer, size_t size)
+{
+    char const* position = buffer;
+    while (size > 0) {
+        ssize_t bytes = send(fd, position, size, MSG_NOSIGNAL);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) return -1;
+        position += bytes;
+        size -= (size_t) bytes;
+    }
+    return 0;
+}
+
+/** Append the NULL terminated strings to the request buffer, or only count their size if buffer is NULL. */
+static size_t append_strings(char* buffer, char const* const strings[], uint32_t* count)
+{
+    size_t size = 0;
+    uint32_t i = 0;
+    for (; strings && strings[i]; i++) {
+        size_t length = strlen(strings[i]) + 1;
+        if (buffer) memcpy(buffer + size, strings[i], length);
+        size += length;
+    }
+    if (count) *count = i;
+    return size;
+}
+
+static int send_request(char const* cmd, char const* cwd, char* const argv[], char* const envp[], int rows, int columns, int cell_width, int cell_height)
+{
+    struct spawn_request request = { .rows = rows, .columns = columns, .cell_width = cell_width, .cell_height = cell_height };
+    char const* cmd_and_cwd[] = { cmd, cwd, NULL };
+    size_t strings_size = append_strings(NULL, cmd_and_cwd, NULL) +
+        append_strings(NULL, (char const* const*) argv, &request.argc) +
+        append_strings(NULL, (char const* const*) envp, &request.envc);
+    if (strings_size > SPAWN_SERVER_MAX_STRINGS_SIZE) return -1;
+    request.strings_size = (uint32_t) strings_size;
+
+    char* buffer = malloc(sizeof(request) + strings_size);
+    if (!buffer) return -1;
+    memcpy(buffer, &request, sizeof(request));
+    size_t offset = sizeof(request);
+    offset += append_strings(buffer + offset, cmd_and_cwd, NULL);
+    offset += append_strings(buffer + offset, (char const* const*) argv, NULL);
+    offset += append_strings(buffer + offset, (char const* const*) envp, NULL);
+
+    int result = send_fully(server_socket, buffer, offset);
+    free(buffer);
+    return result;
+}
+
+int spawn_server_create_subprocess(char const* cmd,
+        char const* cwd,
+        char* const argv[],
+        char* const envp[],
+        int rows,
+        int columns,
+        int cell_width,
+        int cell_height,
+        pid_t* pid,
+        int* pidfd,
+        char const** error)
+{
+    *error = NULL;
+    *pidfd = -1;
+    pthread_mutex_lock(&request_lock);
+
+    pthread_mutex_lock(&state_lock);
+    int state = server_state;
+    pthread_mutex_unlock(&state_lock);
+    if (state == SERVER_NOT_STARTED) {
+        start_server();
+        pthread_mutex_lock(&state_lock);
+        state = server_state;
+        pthread_mutex_unlock(&state_lock);
+    }
+
+    int ptm = -1;
+    if (state == SERVER_RUNNING && send_request(cmd, cwd, argv, envp, rows, columns, cell_width, cell_height) == 0) {
+        pthread_mutex_lock(&state_lock);
+        while (!reply_available && server_state == SERVER_RUNNING) pthread_cond_wait(&state_changed, &state_lock);
+        if (reply_available) {
+            reply_available = false;
+            if (reply.type == SPAWN_MESSAGE_SPAWNED) {
+                ptm = reply_ptm;
+                *pid = reply.pid;
+                *pidfd = reply_pidfd;
+            } else if (reply.value == SPAWN_ERROR_PTY) {
+                *error = "Cannot open pseudoterminal in spawn server";
+            } else if (reply.value == SPAWN_ERROR_FORK) {
+                *error = "Fork failed";
+            } else {
+                *error = "Invalid spawn request";
+            }
+        }
+        pthread_mutex_unlock(&state_lock);
+    }
+
+    pthread_mutex_unlock(&request_lock);
+    return ptm;
+}
+
+bool spawn_server_wait_for(pid_t pid, int* status)
+{
+    pthread_mutex_lock(&state_lock);
+    struct server_child* child = find_child(pid);
+    if (!child) {
+        pthread_mutex_unlock(&state_lock);
+        return false;
+    }
+    while (!child->exited && server_state == SERVER_RUNNING) {
+        pthread_cond_wait(&state_changed, &state_lock);
+        // The table may have been reallocated while waiting.
+        child = find_child(pid);
+    }
+    bool exited = child->exited;
+    *status = child->status;
+    // The pidfd is kept open while waiting below, so that the pid cannot be reused meanwhile.
+    int pidfd = child->pidfd;
+    child->pidfd = -1;
+    remove_child(pid);
+    pthread_mutex_unlock(&state_lock);
+
+    if (!exited) {
+        // The server died and the process has been reparented, so its exit status is lost. Wait
+        // until it is gone and report a normal exit.
+        wait_until_gone(pid, pidfd, -1);
+        *status = 0;
+    }
+    if (pidfd >= 0) close(pidfd);
+    return true;
+}
+
+int spawn_server_try_wait(pid_t pid, int* status, bool reap)
+{
+    pthread_mutex_lock(&state_lock);
+    struct server_child* child = find_child(pid);
+    int result = -1;
+    if (child) {
+        result = 0;
+        if (child->exited) {
+            *status = child->status;
+            result = 1;
+        } else if (server_state != SERVER_RUNNING && wait_until_gone(pid, child->pidfd, 0)) {
+            // The server died and the reparented process is gone, so its exit status is lost.
+            *status = 0;
+            result = 1;
+        }
+        if (result == 1 && reap) remove_child(pid);
+    }
+    pthread_mutex_unlock(&state_lock);
+    return result;
+}
+
+void spawn_server_set_exit_listener(void (*listener)(void))
+{
+    pthread_mutex_lock(&state_lock);
+    exit_listener = listener;
+    pthread_mutex_unlock(&state_lock);
+}
@@ -0,0 +1,46 @@
+#ifndef TERMUX_SPAWN_CLIENT_H
+#define TERMUX_SPAWN_CLIENT_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/**
+ * Create a subprocess through the spawn server, starting it if this is the first call. Returns the
+ * pty master on success. On failure -1 is returned, with a message in *error if the server failed to
+ * spawn the process, or with *error set to NULL if the server is not available, in which case the
+ * caller should spawn the process itself. A pidfd for the process opened by the server before it could
+ * reap the process is stored in *pidfd, or -1 if pidfds are not supported.
+ */
+int spawn_server_create_subprocess(char const* cmd,
+        char const* cwd,
+        char* const argv[],
+        char* const envp[],
+        int rows,
+        int columns,
+        int cell_width,
+        int cell_height,
+        pid_t* pid,
+        int* pidfd,
+        char const** error);
+
+/**
+ * Wait for a process created through the spawn server to exit. Returns false without waiting if
+ * pid was not created by the spawn server, and true with the wait status in *status otherwise.
+ */
+bool spawn_server_wait_for(pid_t pid, int* status);
+
+/**
+ * Check without blocking if a process created through the spawn server has exited. Returns -1 if
+ * pid was not created by the spawn server, 0 if it is still running, and 1 with the wait status in
+ * *status if it has exited. The process is forgotten after reporting its exit if reap is true, so
+ * that it can only be waited for once like with waitpid().
+ */
+int spawn_server_try_wait(pid_t pid, int* status, bool reap);
+
+/**
+ * Set a function called from the spawn server reader thread whenever a process created through the
+ * spawn server has exited or the server has stopped. It must not call back into the spawn client.
+ */
+void spawn_server_set_exit_listener(void (*listener)(void));
+
+#endif
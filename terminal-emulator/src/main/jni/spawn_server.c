@@ -0,0 +1,172 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "spawn_server.h"
+#include "subprocess.h"
+
+/**
+ * The spawn server executable. See spawn_server.h for the protocol. It only contains libc and the
+ * code in subprocess.c, so forking it is cheap regardless of the size of the app process.
+ */
+
+static int send_message(int socket_fd, int type, pid_t pid, int value, int const fds_to_send[], int fd_count)
+{
+    struct spawn_message message = { .type = type, .pid = pid, .value = value };
+    struct iovec iov = { .iov_base = &message, .iov_len = sizeof(message) };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+    char control[CMSG_SPACE(SPAWN_MESSAGE_MAX_FDS * sizeof(int))];
+    if (fd_count > 0) {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE((size_t) fd_count * sizeof(int));
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN((size_t) fd_count * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds_to_send, (size_t) fd_count * sizeof(int));
+    }
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(socket_fd, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == (ssize_t) sizeof(message) ? 0 : -1;
+}
+
+/** Read exactly size bytes. Returns 0 on success and -1 on error or end of file. */
+static int read_fully(int fd, void* buffer, size_t size)
+{
+    char* position = buffer;
+    while (size > 0) {
+        ssize_t bytes = read(fd, position, size);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) return -1;
+        position += bytes;
+        size -= (size_t) bytes;
+    }
+    return 0;
+}
+
+/** Split count NUL terminated strings into a NULL terminated array, or return NULL if they do not fit. */
+static char** split_strings(char** position, char* end, uint32_t count)
+{
+    char** strings = malloc((count + 1) * sizeof(char*));
+    if (!strings) return NULL;
+    for (uint32_t i = 0; i < count; i++) {
+        char* terminator = memchr(*position, '\0', (size_t) (end - *position));
+        if (!terminator) {
+            free(strings);
+            return NULL;
+        }
+        strings[i] = *position;
+        *position = terminator + 1;
+    }
+    strings[count] = NULL;
+    return strings;
+}
+
+/** Handle one spawn request. Returns -1 if the connection to the app is broken. */
+static int handle_spawn_request(int socket_fd)
+{
+    struct spawn_request request;
+    if (read_fully(socket_fd, &request, sizeof(request)) != 0) return -1;
+    if (request.strings_size == 0 || request.strings_size > SPAWN_SERVER_MAX_STRINGS_SIZE ||
+            request.argc > request.strings_size || request.envc > request.strings_size) return -1;
+
+    char* strings = malloc(request.strings_size);
+    if (!strings) return -1;
+    if (read_fully(socket_fd, strings, request.strings_size) != 0) {
+        free(strings);
+        return -1;
+    }
+
+    char* position = strings;
+    char* end = strings + request.strings_size;
+    char** cmd_and_cwd = split_strings(&position, end, 2);
+    char** argv = cmd_and_cwd ? split_strings(&position, end, request.argc) : NULL;
+    char** envp = argv ? split_strings(&position, end, request.envc) : NULL;
+
+    int result;
+    if (!envp) {
+        result = send_message(socket_fd, SPAWN_MESSAGE_FAILED, 0, SPAWN_ERROR_REQUEST, NULL, 0);
+    } else {
+        char devname[64];
+        char const* error;
+        int ptm = open_pty_master(request.rows, request.columns, request.cell_width, request.cell_height, devname, sizeof(devname), &error);
+        if (ptm < 0) {
+            result = send_message(socket_fd, SPAWN_MESSAGE_FAILED, 0, SPAWN_ERROR_PTY, NULL, 0);
+        } else {
+            int backend = TERMUX_SPAWN_BACKEND_VFORK;
+            struct child_fds fds = { .use_close_range = close_range_allowed(), .inherit_fds = NULL, .inherit_fd_count = 0 };
+            pid_t pid = spawn_subprocess(&backend, cmd_and_cwd[0], cmd_and_cwd[1], devname, ptm,
+                request.argc > 0 ? argv : NULL, envp, &fds);
+            if (pid < 0) {
+                result = send_message(socket_fd, SPAWN_MESSAGE_FAILED, 0, SPAWN_ERROR_FORK, NULL, 0);
+            } else {
+                // Children are only reaped by the main loop after this request, so the pid still refers
+                // to the child even if it has already exited, and the pidfd cannot refer to a reused pid.
+                int reply_fds[SPAWN_MESSAGE_MAX_FDS] = { ptm, open_pidfd(pid) };
+                result = send_message(socket_fd, SPAWN_MESSAGE_SPAWNED, pid, 0, reply_fds, reply_fds[1] >= 0 ? 2 : 1);
+                if (reply_fds[1] >= 0) close(reply_fds[1]);
+            }
+            close(ptm);
+        }
+    }
+
+    free(envp);
+    free(argv);
+    free(cmd_and_cwd);
+    free(strings);
+    return result;
+}
+
+/** Reap all exited children and report their status. Returns -1 if the connection to the app is broken. */
+static int report_exited_children(int socket_fd, int signal_fd)
+{
+    struct signalfd_siginfo info;
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info));
+
+    pid_t pid;
+    int status;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        if (send_message(socket_fd, SPAWN_MESSAGE_EXITED, pid, status, NULL, 0) != 0) return -1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int socket_fd = SPAWN_SERVER_SOCKET_FD;
+    fcntl(socket_fd, F_SETFD, FD_CLOEXEC);
+
+    sigset_t child_signal;
+    sigemptyset(&child_signal);
+    sigaddset(&child_signal, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &child_signal, NULL);
+    int signal_fd = signalfd(-1, &child_signal, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0) return 1;
+
+    struct pollfd poll_fds[] = {
+        { .fd = socket_fd, .events = POLLIN },
+        { .fd = signal_fd, .events = POLLIN },
+    };
+    while (true) {
+        if (poll(poll_fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return 1;
+        }
+        if ((poll_fds[1].revents & POLLIN) && report_exited_children(socket_fd, signal_fd) != 0) return 0;
+        if (poll_fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            if (handle_spawn_request(socket_fd) != 0) return 0;
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef TERMUX_SPAWN_SERVER_H
+#define TERMUX_SPAWN_SERVER_H
+
+#include <stdint.h>
+
+/**
+ * Protocol between libtermux and the spawn server, a small native executable which is started once
+ * by the app and forks the terminal subprocesses, so that their creation does not have to fork the
+ * large app process.
+ *
+ * The app sends spawn requests over a SOCK_STREAM socketpair. The server answers each with a
+ * SPAWN_MESSAGE_SPAWNED message carrying the pty master and, where supported, a pidfd for the
+ * process through SCM_RIGHTS, or with a SPAWN_MESSAGE_FAILED message. It reaps its children and reports their wait status with
+ * SPAWN_MESSAGE_EXITED messages. The server exits when the app closes its end of the socket.
+ */
+
+/** The file name of the spawn server executable, which is packaged next to libtermux.so. */
+#define SPAWN_SERVER_EXECUTABLE "libtermux-spawn-server.so"
+
+/** The file descriptor of the socket to the app in the spawn server process. */
+#define SPAWN_SERVER_SOCKET_FD 3
+
+/** The maximum size of the strings following a spawn request. */
+#define SPAWN_SERVER_MAX_STRINGS_SIZE (1024 * 1024)
+
+/** Header of a spawn request, followed by strings_size bytes of NUL terminated cmd, cwd, argv and envp strings. */
+struct spawn_request {
+    uint32_t strings_size;
+    uint32_t argc;
+    uint32_t envc;
+    int32_t rows;
+    int32_t columns;
+    int32_t cell_width;
+    int32_t cell_height;
+};
+
+#define SPAWN_MESSAGE_SPAWNED 1
+#define SPAWN_MESSAGE_FAILED 2
+#define SPAWN_MESSAGE_EXITED 3
+
+/** The maximum number of file descriptors attached to a message: the pty master and the pidfd. */
+#define SPAWN_MESSAGE_MAX_FDS 2
+
+#define SPAWN_ERROR_REQUEST 1
+#define SPAWN_ERROR_PTY 2
+#define SPAWN_ERROR_FORK 3
+
+/**
+ * A message from the spawn server. The value is unused for SPAWN_MESSAGE_SPAWNED, one of the
+ * SPAWN_ERROR_* values for SPAWN_MESSAGE_FAILED and the wait status for SPAWN_MESSAGE_EXITED.
+ */
+struct spawn_message {
+    int32_t type;
+    int32_t pid;
+    int32_t value;
+};
+
+#endif
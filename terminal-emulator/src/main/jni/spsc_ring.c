@@ -0,0 +1,177 @@
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "spsc_ring.h"
+
+#define CACHE_LINE_SIZE 64
+
+struct spsc_ring {
+    /** The total number of bytes consumed, only written by the consumer. */
+    alignas(CACHE_LINE_SIZE) atomic_size_t head;
+    /** The total number of bytes produced, only written by the producer. */
+    alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+    /** If the consumer has been notified since it last found the ring empty. */
+    alignas(CACHE_LINE_SIZE) atomic_bool notified;
+    atomic_bool paused;
+    atomic_bool closed;
+    size_t capacity;
+    uint8_t* data;
+};
+
+struct spsc_ring* spsc_ring_create(size_t capacity)
+{
+    size_t rounded_capacity = 4096;
+    while (rounded_capacity < capacity) rounded_capacity *= 2;
+
+    void* memory;
+    if (posix_memalign(&memory, CACHE_LINE_SIZE, sizeof(struct spsc_ring)) != 0) return NULL;
+    struct spsc_ring* ring = memory;
+    // Mapped instead of allocated, so that pages are only committed once output has reached them.
+    ring->data = mmap(NULL, rounded_capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->data == MAP_FAILED) {
+        free(ring);
+        return NULL;
+    }
+    ring->capacity = rounded_capacity;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->notified, false);
+    atomic_init(&ring->paused, false);
+    atomic_init(&ring->closed, false);
+    return ring;
+}
+
+void spsc_ring_destroy(struct spsc_ring* ring)
+{
+    if (!ring) return;
+    munmap(ring->data, ring->capacity);
+    free(ring);
+}
+
+size_t spsc_ring_capacity(struct spsc_ring const* ring)
+{
+    return ring->capacity;
+}
+
+uint8_t* spsc_ring_data(struct spsc_ring* ring)
+{
+    return ring->data;
+}
+
+int spsc_ring_free_regions(struct spsc_ring* ring, struct iovec iov[2])
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t length = ring->capacity - (tail - head);
+    if (length == 0) return 0;
+    size_t position = tail & (ring->capacity - 1);
+    size_t first_length = ring->capacity - position;
+    if (first_length > length) first_length = length;
+    iov[0] = (struct iovec) { .iov_base = ring->data + position, .iov_len = first_length };
+    if (first_length == length) return 1;
+    iov[1] = (struct iovec) { .iov_base = ring->data, .iov_len = length - first_length };
+    return 2;
+}
+
+void spsc_ring_produce(struct spsc_ring* ring, size_t count)
+{
+    // Sequentially consistent, to be ordered before the load of notified in spsc_ring_should_notify().
+    atomic_store(&ring->tail, atomic_load_explicit(&ring->tail, memory_order_relaxed) + count);
+}
+
+size_t spsc_ring_push(struct spsc_ring* ring, void const* data, size_t size)
+{
+    struct iovec iov[2];
+    int region_count = spsc_ring_free_regions(ring, iov);
+    size_t copied = 0;
+    for (int i = 0; i < region_count && copied < size; i++) {
+        size_t length = iov[i].iov_len < size - copied ? iov[i].iov_len : size - copied;
+        memcpy(iov[i].iov_base, (uint8_t const*) data + copied, length);
+        copied += length;
+    }
+    if (copied > 0) spsc_ring_produce(ring, copied);
+    return copied;
+}
+
+size_t spsc_ring_readable(struct spsc_ring* ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    return tail - atomic_load_explicit(&ring->head, memory_order_relaxed);
+}
+
+bool spsc_ring_should_notify(struct spsc_ring* ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail == atomic_load(&ring->head)) return false;
+    return !atomic_exchange(&ring->notified, true);
+}
+
+bool spsc_ring_pause_if_full(struct spsc_ring* ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - atomic_load(&ring->head) < ring->capacity) return false;
+    atomic_store(&ring->paused, true);
+    // The consumer may have made room before seeing the paused flag, in which case it will not resume us.
+    if (tail - atomic_load(&ring->head) < ring->capacity) {
+        atomic_store(&ring->paused, false);
+        return false;
+    }
+    return true;
+}
+
+bool spsc_ring_is_paused(struct spsc_ring* ring)
+{
+    return atomic_load(&ring->paused);
+}
+
+void spsc_ring_close(struct spsc_ring* ring)
+{
+    atomic_store(&ring->closed, true);
+}
+
+size_t spsc_ring_peek(struct spsc_ring* ring, size_t* offset)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t readable = atomic_load_explicit(&ring->tail, memory_order_acquire) - head;
+    if (readable == 0) {
+        // Ask to be notified, then check again for bytes produced before the producer could see that.
+        atomic_store(&ring->notified, false);
+        readable = atomic_load(&ring->tail) - head;
+        if (readable == 0) return 0;
+        // Take the notification back. The producer may already have sent one, which is then spurious.
+        atomic_store(&ring->notified, true);
+    }
+    size_t position = head & (ring->capacity - 1);
+    *offset = position;
+    return readable < ring->capacity - position ? readable : ring->capacity - position;
+}
+
+bool spsc_ring_consume(struct spsc_ring* ring, size_t count)
+{
+    // Sequentially consistent, to be ordered before the load of paused.
+    atomic_store(&ring->head, atomic_load_explicit(&ring->head, memory_order_relaxed) + count);
+    return atomic_load(&ring->paused) && atomic_exchange(&ring->paused, false);
+}
+
+size_t spsc_ring_pop(struct spsc_ring* ring, void* buffer, size_t size, bool* resume_producer)
+{
+    size_t copied = 0;
+    while (copied < size) {
+        size_t offset;
+        size_t length = spsc_ring_peek(ring, &offset);
+        if (length == 0) break;
+        if (length > size - copied) length = size - copied;
+        memcpy((uint8_t*) buffer + copied, ring->data + offset, length);
+        copied += length;
+        if (spsc_ring_consume(ring, length)) *resume_producer = true;
+    }
+    return copied;
+}
+
+bool spsc_ring_is_drained(struct spsc_ring* ring)
+{
+    return atomic_load(&ring->closed) && atomic_load(&ring->head) == atomic_load(&ring->tail);
+}
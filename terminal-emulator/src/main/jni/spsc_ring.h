@@ -0,0 +1,75 @@
+#ifndef TERMUX_SPSC_RING_H
+#define TERMUX_SPSC_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/**
+ * A lock-free single producer, single consumer byte ring. The producer and the consumer may be
+ * different threads, but each side must only be used by one thread at a time.
+ *
+ * The consumer is notified only when the ring goes from empty to non-empty: the producer functions
+ * return true when the consumer has to be woken up, after which they return false until the
+ * consumer has found the ring empty again. The producer pauses when the ring is full, and the
+ * consumer functions report when it has to be resumed.
+ */
+struct spsc_ring;
+
+/** Create a ring of at least capacity bytes, rounded up to a power of two. Returns NULL on failure. */
+struct spsc_ring* spsc_ring_create(size_t capacity);
+
+void spsc_ring_destroy(struct spsc_ring* ring);
+
+size_t spsc_ring_capacity(struct spsc_ring const* ring);
+
+/** The storage of the ring, which is spsc_ring_capacity() bytes. */
+uint8_t* spsc_ring_data(struct spsc_ring* ring);
+
+/** Producer: fill iov with the (up to two) free regions of the ring. Returns the number of regions. */
+int spsc_ring_free_regions(struct spsc_ring* ring, struct iovec iov[2]);
+
+/** Producer: publish bytes written to the free regions. */
+void spsc_ring_produce(struct spsc_ring* ring, size_t count);
+
+/** Producer: copy data into the ring. Returns the number of bytes that fitted. */
+size_t spsc_ring_push(struct spsc_ring* ring, void const* data, size_t size);
+
+/** Producer: the number of published bytes which the consumer has not consumed yet. */
+size_t spsc_ring_readable(struct spsc_ring* ring);
+
+/** Producer: if the consumer has to be notified about published bytes. */
+bool spsc_ring_should_notify(struct spsc_ring* ring);
+
+/**
+ * Producer: pause while the ring is full. Returns false, without pausing, if the consumer has made
+ * room in the meantime.
+ */
+bool spsc_ring_pause_if_full(struct spsc_ring* ring);
+
+bool spsc_ring_is_paused(struct spsc_ring* ring);
+
+/** Producer: mark that nothing more will be produced. */
+void spsc_ring_close(struct spsc_ring* ring);
+
+/**
+ * Consumer: the offset in the storage and the length of the readable bytes there, which may not be
+ * all readable bytes if they wrap around. Returns a zero length when the ring is empty, after which
+ * the producer notifies about new bytes.
+ */
+size_t spsc_ring_peek(struct spsc_ring* ring, size_t* offset);
+
+/** Consumer: release count bytes from spsc_ring_peek(). Returns true if the producer is to be resumed. */
+bool spsc_ring_consume(struct spsc_ring* ring, size_t count);
+
+/**
+ * Consumer: copy up to size bytes out of the ring. Sets resume_producer if the producer is to be
+ * resumed.
+ */
+size_t spsc_ring_pop(struct spsc_ring* ring, void* buffer, size_t size, bool* resume_producer);
+
+/** Consumer: if the producer has closed the ring and everything has been consumed. */
+bool spsc_ring_is_drained(struct spsc_ring* ring);
+
+#endif
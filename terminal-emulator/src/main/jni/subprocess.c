@@ -0,0 +1,399 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <paths.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/system_properties.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "subprocess.h"
+
+#ifdef __APPLE__
+# define LACKS_PTSNAME_R
+#endif
+
+/** Write an "prefix(\"arg\"): strerror" message to stderr without using stdio. */
+static void write_child_error(char const* prefix, char const* arg, int error)
+{
+    char const* error_string = strerror(error);
+    struct iovec iov[] = {
+        { .iov_base = (void*) prefix, .iov_len = strlen(prefix) },
+        { .iov_base = "(\"", .iov_len = 2 },
+        { .iov_base = (void*) arg, .iov_len = strlen(arg) },
+        { .iov_base = "\"): ", .iov_len = 4 },
+        { .iov_base = (void*) error_string, .iov_len = strlen(error_string) },
+        { .iov_base = "\n", .iov_len = 1 },
+    };
+    writev(STDERR_FILENO, iov, sizeof(iov) / sizeof(iov[0]));
+}
+
+/**
+ * Execute cmd with the envp environment, searching for it in the PATH of envp (not the one of the
+ * app process) if it does not contain a slash, like execvp() after clearenv() and putenv() would.
+ * Returns the errno of the last failed execve() call.
+ */
+static int exec_with_envp_path(char const* cmd, char* const argv[], char* const envp[])
+{
+    if (strchr(cmd, '/') != NULL) {
+        execve(cmd, argv, envp);
+        return errno;
+    }
+
+    char const* path = _PATH_DEFPATH;
+    for (char* const* tmp = envp; *tmp; ++tmp) {
+        if (strncmp(*tmp, "PATH=", 5) == 0) {
+            path = *tmp + 5;
+            break;
+        }
+    }
+
+    size_t cmd_length = strlen(cmd);
+    int exec_errno = ENOENT;
+    bool seen_eacces = false;
+    char file_path[PATH_MAX];
+    while (true) {
+        // strchrnul() is only available from API 24.
+        char const* separator = path;
+        while (*separator != '\0' && *separator != ':') separator++;
+        size_t dir_length = (size_t) (separator - path);
+        if (dir_length + 1 + cmd_length < sizeof(file_path)) {
+            // An empty PATH entry means the current directory.
+            size_t offset = 0;
+            if (dir_length > 0) {
+                memcpy(file_path, path, dir_length);
+                file_path[dir_length] = '/';
+                offset = dir_length + 1;
+            }
+            memcpy(file_path + offset, cmd, cmd_length + 1);
+            execve(file_path, argv, envp);
+            exec_errno = errno;
+            if (exec_errno == EACCES) seen_eacces = true;
+            else if (exec_errno != ENOENT && exec_errno != ENOTDIR) return exec_errno;
+        }
+        if (*separator == '\0') break;
+        path = separator + 1;
+    }
+    return seen_eacces ? EACCES : exec_errno;
+}
+
+#ifndef SYS_close_range
+# define SYS_close_range 436
+#endif
+#ifndef SYS_pidfd_open
+# define SYS_pidfd_open 434
+#endif
+
+/** The layout of the records returned by the getdents64() syscall. */
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+int device_api_level(void)
+{
+    static int api_level = -1;
+    if (api_level < 0) {
+        char value[PROP_VALUE_MAX] = { 0 };
+        api_level = __system_property_get("ro.build.version.sdk", value) > 0 ? atoi(value) : 0;
+    }
+    return api_level;
+}
+
+/**
+ * Older Android versions have no close_range() in their seccomp allowlist for apps, and calling a
+ * syscall missing from it kills the process with SIGSYS instead of failing with ENOSYS, so it is
+ * only used on Android 14 (API 34) and later, where bionic has it.
+ */
+bool close_range_allowed(void)
+{
+    return device_api_level() >= 34;
+}
+
+int open_pidfd(pid_t pid)
+{
+    // pidfd_open() is allowed by the seccomp filter for apps from Android 12 (API 31) and needs
+    // Linux 5.3. It also works for processes that are not our children. The pidfd is close-on-exec.
+    if (device_api_level() < 31) return -1;
+    return (int) syscall(SYS_pidfd_open, pid, 0);
+}
+
+static bool is_inherited_fd(int fd, int const* inherit_fds, int inherit_fd_count)
+{
+    for (int i = 0; i < inherit_fd_count; i++) {
+        if (inherit_fds[i] == fd) return true;
+    }
+    return false;
+}
+
+/**
+ * Close all file descriptors above stderr except the inherited ones by reading /proc/self/fd with
+ * getdents64() into a stack buffer, since opendir() allocates from the heap, which is shared with
+ * the parent when using vfork().
+ */
+static void close_fds_by_scanning(int const* inherit_fds, int inherit_fd_count)
+{
+    int self_dir_fd = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (self_dir_fd < 0) return;
+
+    char buffer[2048] __attribute__((aligned(8)));
+    long bytes;
+    while ((bytes = syscall(SYS_getdents64, self_dir_fd, buffer, sizeof(buffer))) > 0) {
+        for (long offset = 0; offset < bytes; ) {
+            struct linux_dirent64* entry = (struct linux_dirent64*) (buffer + offset);
+            offset += entry->d_reclen;
+
+            int fd = 0;
+            char const* name = entry->d_name;
+            if (*name < '0' || *name > '9') continue; // "." and ".."
+            for (; *name >= '0' && *name <= '9'; name++) fd = fd * 10 + (*name - '0');
+            if (fd > 2 && fd != self_dir_fd && !is_inherited_fd(fd, inherit_fds, inherit_fd_count)) close(fd);
+        }
+    }
+    close(self_dir_fd);
+}
+
+/**
+ * Close all file descriptors above stderr except the inherited ones, which must be sorted in
+ * ascending order and be above stderr. Uses one close_range() call per gap between inherited fds
+ * if possible, with a /proc/self/fd scan as fallback. The inherited fds have FD_CLOEXEC cleared so
+ * that they survive the execve().
+ */
+static void sanitize_child_fds(bool use_close_range, int const* inherit_fds, int inherit_fd_count)
+{
+    bool closed = false;
+    if (use_close_range) {
+        closed = true;
+        unsigned int first = 3;
+        for (int i = 0; i <= inherit_fd_count && closed; i++) {
+            unsigned int last = (i == inherit_fd_count) ? ~0U : (unsigned int) inherit_fds[i] - 1;
+            if (first <= last && syscall(SYS_close_range, first, last, 0) != 0) closed = false;
+            if (i < inherit_fd_count) first = (unsigned int) inherit_fds[i] + 1;
+        }
+    }
+    if (!closed) close_fds_by_scanning(inherit_fds, inherit_fd_count);
+
+    for (int i = 0; i < inherit_fd_count; i++) {
+        int flags = fcntl(inherit_fds[i], F_GETFD);
+        if (flags >= 0 && (flags & FD_CLOEXEC)) fcntl(inherit_fds[i], F_SETFD, flags & ~FD_CLOEXEC);
+    }
+}
+
+/**
+ * Reset handlers installed by the Android java process, so that none of them can run in a child
+ * when its signals are unblocked. The first field of the kernel sigaction struct is the handler on
+ * all supported architectures and a zeroed struct means SIG_DFL.
+ */
+static void reset_child_signal_handlers(void)
+{
+    for (int signal_number = 1; signal_number < _NSIG; signal_number++) {
+        uint64_t kernel_sigaction[4] = { 0 };
+        if (syscall(SYS_rt_sigaction, signal_number, NULL, kernel_sigaction, sizeof(uint64_t)) != 0) continue;
+        uintptr_t handler = *(uintptr_t*) kernel_sigaction;
+        if (handler != (uintptr_t) SIG_DFL && handler != (uintptr_t) SIG_IGN) {
+            uint64_t default_sigaction[4] = { 0 };
+            syscall(SYS_rt_sigaction, signal_number, default_sigaction, NULL, sizeof(uint64_t));
+        }
+    }
+}
+
+/** Clear signals which the Android java process may have blocked. */
+static void unblock_child_signals(void)
+{
+    uint64_t empty_signal_mask = 0;
+    syscall(SYS_rt_sigprocmask, SIG_SETMASK, &empty_signal_mask, NULL, sizeof(uint64_t));
+}
+
+/**
+ * Setup the session, controlling terminal, file descriptors and working directory of a newly
+ * created child and execute the command.
+ *
+ * This is shared by the fork() and vfork() backends. With vfork() the child shares the address
+ * space (including the heap, stdio and environ) with the suspended parent, so only async-signal-safe
+ * calls that do not modify process memory may be done here. Signal handlers and the signal mask are
+ * changed with raw syscalls so that the libsigchain wrappers of ART are not touched.
+ */
+static void __attribute__((noreturn)) exec_subprocess_child(char const* cmd,
+        char const* cwd,
+        char const* devname,
+        int ptm,
+        char* const argv[],
+        char* const envp[],
+        struct child_fds const* fds)
+{
+    reset_child_signal_handlers();
+
+    close(ptm);
+    setsid();
+
+    int pts = open(devname, O_RDWR);
+    if (pts < 0) _exit(-1);
+
+    dup2(pts, 0);
+    dup2(pts, 1);
+    dup2(pts, 2);
+
+    sanitize_child_fds(fds->use_close_range, fds->inherit_fds, fds->inherit_fd_count);
+
+    if (chdir(cwd) != 0) write_child_error("chdir", cwd, errno);
+
+    unblock_child_signals();
+
+    int exec_errno = exec_with_envp_path(cmd, argv, envp);
+    // Show terminal output about failing exec() call:
+    write_child_error("exec", cmd, exec_errno);
+    _exit(1);
+}
+
+/** Start the child with vfork(), which suspends the calling thread until the child calls execve() or exits. */
+static pid_t spawn_with_vfork(char const* cmd, char const* cwd, char const* devname, int ptm, char* const argv[], char* const envp[], struct child_fds const* fds)
+{
+    pid_t pid = vfork();
+    if (pid == 0) exec_subprocess_child(cmd, cwd, devname, ptm, argv, envp, fds);
+    return pid;
+}
+
+static pid_t spawn_with_fork(char const* cmd, char const* cwd, char const* devname, int ptm, char* const argv[], char* const envp[], struct child_fds const* fds)
+{
+    pid_t pid = fork();
+    if (pid == 0) exec_subprocess_child(cmd, cwd, devname, ptm, argv, envp, fds);
+    return pid;
+}
+
+int open_pty_master(int rows, int columns, int cell_width, int cell_height, char* devname, size_t devname_size, char const** error)
+{
+    int ptm = open("/dev/ptmx", O_RDWR | O_CLOEXEC);
+    if (ptm < 0) {
+        *error = "Cannot open /dev/ptmx";
+        return -1;
+    }
+
+#ifdef LACKS_PTSNAME_R
+    char* slave_name;
+#endif
+    if (grantpt(ptm) || unlockpt(ptm) ||
+#ifdef LACKS_PTSNAME_R
+            (slave_name = ptsname(ptm)) == NULL || strlcpy(devname, slave_name, devname_size) >= devname_size
+#else
+            ptsname_r(ptm, devname, devname_size)
+#endif
+       ) {
+        close(ptm);
+        *error = "Cannot grantpt()/unlockpt()/ptsname_r() on /dev/ptmx";
+        return -1;
+    }
+
+    // Enable UTF-8 mode and disable flow control to prevent Ctrl+S from locking up the display.
+    struct termios tios;
+    tcgetattr(ptm, &tios);
+    tios.c_iflag |= IUTF8;
+    tios.c_iflag &= ~(IXON | IXOFF);
+    tcsetattr(ptm, TCSANOW, &tios);
+
+    /** Set initial winsize. */
+    struct winsize sz = { .ws_row = (unsigned short) rows, .ws_col = (unsigned short) columns, .ws_xpixel = (unsigned short) (columns * cell_width), .ws_ypixel = (unsigned short) (rows * cell_height)};
+    ioctl(ptm, TIOCSWINSZ, &sz);
+
+    return ptm;
+}
+
+pid_t spawn_subprocess(int* backend,
+        char const* cmd,
+        char const* cwd,
+        char const* devname,
+        int ptm,
+        char* const argv[],
+        char* const envp[],
+        struct child_fds const* fds)
+{
+    // The child gets an empty environment if none was passed, like clearenv() would do.
+    char* empty_envp[] = { NULL };
+    if (!envp) envp = empty_envp;
+
+    // Block all signals in the calling thread so that no handler of the parent runs in the child
+    // before it has reset them. The child unblocks all signals just before execve().
+    sigset_t all_signals, old_signals;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+
+    pid_t pid = -1;
+    if (*backend == TERMUX_SPAWN_BACKEND_VFORK) {
+        pid = spawn_with_vfork(cmd, cwd, devname, ptm, argv, envp, fds);
+        // Fallback to fork() if vfork() is not usable.
+        if (pid < 0) *backend = TERMUX_SPAWN_BACKEND_FORK;
+    } else {
+        *backend = TERMUX_SPAWN_BACKEND_FORK;
+    }
+    if (*backend == TERMUX_SPAWN_BACKEND_FORK) {
+        pid = spawn_with_fork(cmd, cwd, devname, ptm, argv, envp, fds);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+    return pid;
+}
+
+/** Setup the session and file descriptors of a newly created helper process and execute it. */
+static void __attribute__((noreturn)) exec_helper_child(char const* path, char* const argv[], int fd, int target_fd)
+{
+    reset_child_signal_handlers();
+    setsid();
+
+    if (fd == target_fd) {
+        fcntl(fd, F_SETFD, 0);
+    } else if (dup2(fd, target_fd) < 0) {
+        _exit(127);
+    }
+
+    int dev_null = open("/dev/null", O_RDWR);
+    if (dev_null < 0) _exit(127);
+    dup2(dev_null, 0);
+    dup2(dev_null, 1);
+    dup2(dev_null, 2);
+
+    sanitize_child_fds(close_range_allowed(), &target_fd, 1);
+    unblock_child_signals();
+
+    char* empty_envp[] = { NULL };
+    execve(path, argv, empty_envp);
+    _exit(127);
+}
+
+pid_t spawn_helper_process(char const* path, char* const argv[], int fd, int target_fd)
+{
+    // Resolve the cached api level before vfork(), as the child may not write to memory.
+    close_range_allowed();
+
+    sigset_t all_signals, old_signals;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+
+    pid_t pid = vfork();
+    if (pid < 0) pid = fork();
+    if (pid == 0) exec_helper_child(path, argv, fd, target_fd);
+
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+    return pid;
+}
+
+int exit_code_from_wait_status(int status)
+{
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        return -WTERMSIG(status);
+    } else {
+        // Should never happen - waitpid(2) says "One of the first three macros will evaluate to a non-zero (true) value".
+        return 0;
+    }
+}
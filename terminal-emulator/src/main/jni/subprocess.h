@@ -0,0 +1,64 @@
+#ifndef TERMUX_SUBPROCESS_H
+#define TERMUX_SUBPROCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/** Spawn backends that create_subprocess() can use. Must be kept in sync with JNI.SPAWN_BACKEND_*. */
+#define TERMUX_SPAWN_BACKEND_FORK 0
+#define TERMUX_SPAWN_BACKEND_VFORK 1
+#define TERMUX_SPAWN_BACKEND_SERVER 2
+
+/** The file descriptors a child should inherit besides stdin, stdout and stderr. */
+struct child_fds {
+    bool use_close_range;
+    int const* inherit_fds;
+    int inherit_fd_count;
+};
+
+/**
+ * The API level of the device, which decides which syscalls are allowed by the seccomp filter of
+ * apps. The value is cached, so this may be called in a vfork() child after it has been called once.
+ */
+int device_api_level(void);
+
+/** Open a pidfd for the pid process, or return -1 if pidfds are not supported or the process is gone. */
+int open_pidfd(pid_t pid);
+
+/** If close_range() may be used for sanitizing the file descriptors of a child. */
+bool close_range_allowed(void);
+
+/**
+ * Open a new pseudoterminal master in UTF-8 mode without flow control and with the given window
+ * size. The name of the slave device is written to devname. Returns the master file descriptor,
+ * or -1 with a message in *error on failure.
+ */
+int open_pty_master(int rows, int columns, int cell_width, int cell_height, char* devname, size_t devname_size, char const** error);
+
+/**
+ * Start cmd as session leader with the slave of the ptm pseudoterminal as controlling terminal and
+ * stdin, stdout and stderr. Tries the *backend backend first, either TERMUX_SPAWN_BACKEND_FORK or
+ * TERMUX_SPAWN_BACKEND_VFORK, and falls back to fork(). The backend actually used is written to
+ * *backend. Returns the pid of the child, or -1 on failure.
+ */
+pid_t spawn_subprocess(int* backend,
+        char const* cmd,
+        char const* cwd,
+        char const* devname,
+        int ptm,
+        char* const argv[],
+        char* const envp[],
+        struct child_fds const* fds);
+
+/**
+ * Start the executable at path as a new session with stdin, stdout and stderr redirected to
+ * /dev/null, and with fd as its only other file descriptor, duplicated to target_fd. Returns the
+ * pid of the helper, or -1 on failure.
+ */
+pid_t spawn_helper_process(char const* path, char* const argv[], int fd, int target_fd);
+
+/** Returns the exit code for a wait status, or the negated signal number if the process was killed by a signal. */
+int exit_code_from_wait_status(int status);
+
+#endif
@@ -1,19 +1,29 @@
-#include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <jni.h>
-#include <signal.h>
+#include <poll.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <termios.h>
 #include <unistd.h>
 
+#include "cell_store.h"
+#include "pty_reactor.h"
+#include "spawn_client.h"
+#include "subprocess.h"
+#include "text_search.h"
+#include "utf8_decoder.h"
+#include "vt_scanner.h"
+
 #define TERMUX_UNUSED(x) x __attribute__((__unused__))
-#ifdef __APPLE__
-# define LACKS_PTSNAME_R
-#endif
+
+/** Must match JNI.READV_MAX_BUFFERS. */
+#define JNI_READV_MAX_BUFFERS 16
 
 static int throw_runtime_exception(JNIEnv* env, char const* message)
 {
@@ -22,96 +32,77 @@ static int throw_runtime_exception(JNIEnv* env, char const* message)
     return -1;
 }
 
+static int throw_io_exception(JNIEnv* env, char const* call, int error)
+{
+    char message[128];
+    snprintf(message, sizeof(message), "%s failed: %s", call, strerror(error));
+    jclass exClass = (*env)->FindClass(env, "java/io/IOException");
+    (*env)->ThrowNew(env, exClass, message);
+    return -1;
+}
+
+/**
+ * The backend create_subprocess() tries first. The vfork() backend does not duplicate the page
+ * tables of the (large) ART process, so its cost does not grow with the heap size. The spawn server
+ * backend avoids forking the app process at all.
+ */
+static int preferred_spawn_backend = TERMUX_SPAWN_BACKEND_VFORK;
+
 static int create_subprocess(JNIEnv* env,
         char const* cmd,
         char const* cwd,
         char* const argv[],
-        char** envp,
+        char* const envp[],
+        int const* inherit_fds,
+        int inherit_fd_count,
         int* pProcessId,
+        int* pSpawnBackend,
+        int* pPidFd,
         jint rows,
         jint columns,
         jint cell_width,
         jint cell_height)
 {
-    int ptm = open("/dev/ptmx", O_RDWR | O_CLOEXEC);
-    if (ptm < 0) return throw_runtime_exception(env, "Cannot open /dev/ptmx");
+    int spawn_backend = preferred_spawn_backend;
+    char const* error;
+    *pPidFd = -1;
 
-#ifdef LACKS_PTSNAME_R
-    char* devname;
-#else
-    char devname[64];
-#endif
-    if (grantpt(ptm) || unlockpt(ptm) ||
-#ifdef LACKS_PTSNAME_R
-            (devname = ptsname(ptm)) == NULL
-#else
-            ptsname_r(ptm, devname, sizeof(devname))
-#endif
-       ) {
-        return throw_runtime_exception(env, "Cannot grantpt()/unlockpt()/ptsname_r() on /dev/ptmx");
-    }
-
-    // Enable UTF-8 mode and disable flow control to prevent Ctrl+S from locking up the display.
-    struct termios tios;
-    tcgetattr(ptm, &tios);
-    tios.c_iflag |= IUTF8;
-    tios.c_iflag &= ~(IXON | IXOFF);
-    tcsetattr(ptm, TCSANOW, &tios);
+    // File descriptors of the app cannot be inherited from the spawn server.
+    if (spawn_backend == TERMUX_SPAWN_BACKEND_SERVER && inherit_fd_count == 0) {
+        pid_t pid;
+        int ptm = spawn_server_create_subprocess(cmd, cwd, argv, envp, rows, columns, cell_width, cell_height, &pid, pPidFd, &error);
+        if (ptm >= 0) {
+            *pProcessId = (int) pid;
+            *pSpawnBackend = spawn_backend;
+            return ptm;
+        }
+        if (error) return throw_runtime_exception(env, error);
+    }
+    // Spawn in this process if the spawn server is not used or not available.
+    if (spawn_backend == TERMUX_SPAWN_BACKEND_SERVER) spawn_backend = TERMUX_SPAWN_BACKEND_VFORK;
 
-    /** Set initial winsize. */
-    struct winsize sz = { .ws_row = (unsigned short) rows, .ws_col = (unsigned short) columns, .ws_xpixel = (unsigned short) (columns * cell_width), .ws_ypixel = (unsigned short) (rows * cell_height)};
-    ioctl(ptm, TIOCSWINSZ, &sz);
+    char devname[64];
+    int ptm = open_pty_master(rows, columns, cell_width, cell_height, devname, sizeof(devname), &error);
+    if (ptm < 0) return throw_runtime_exception(env, error);
 
-    pid_t pid = fork();
+    struct child_fds fds = { .use_close_range = close_range_allowed(), .inherit_fds = inherit_fds, .inherit_fd_count = inherit_fd_count };
+    pid_t pid = spawn_subprocess(&spawn_backend, cmd, cwd, devname, ptm, argv, envp, &fds);
     if (pid < 0) {
-        return throw_runtime_exception(env, "Fork failed");
-    } else if (pid > 0) {
-        *pProcessId = (int) pid;
-        return ptm;
-    } else {
-        // Clear signals which the Android java process may have blocked:
-        sigset_t signals_to_unblock;
-        sigfillset(&signals_to_unblock);
-        sigprocmask(SIG_UNBLOCK, &signals_to_unblock, 0);
-
         close(ptm);
-        setsid();
-
-        int pts = open(devname, O_RDWR);
-        if (pts < 0) exit(-1);
-
-        dup2(pts, 0);
-        dup2(pts, 1);
-        dup2(pts, 2);
-
-        DIR* self_dir = opendir("/proc/self/fd");
-        if (self_dir != NULL) {
-            int self_dir_fd = dirfd(self_dir);
-            struct dirent* entry;
-            while ((entry = readdir(self_dir)) != NULL) {
-                int fd = atoi(entry->d_name);
-                if (fd > 2 && fd != self_dir_fd) close(fd);
-            }
-            closedir(self_dir);
-        }
+        return throw_runtime_exception(env, "Fork failed");
+    }
 
-        clearenv();
-        if (envp) for (; *envp; ++envp) putenv(*envp);
+    // The process is our child and is not reaped before the app waits for it, so its pid cannot
+    // have been reused before opening the pidfd.
+    *pPidFd = open_pidfd(pid);
+    *pProcessId = (int) pid;
+    *pSpawnBackend = spawn_backend;
+    return ptm;
+}
 
-        if (chdir(cwd) != 0) {
-            char* error_message;
-            // No need to free asprintf()-allocated memory since doing execvp() or exit() below.
-            if (asprintf(&error_message, "chdir(\"%s\")", cwd) == -1) error_message = "chdir()";
-            perror(error_message);
-            fflush(stderr);
-        }
-        execvp(cmd, argv);
-        // Show terminal output about failing exec() call:
-        char* error_message;
-        if (asprintf(&error_message, "exec(\"%s\")", cmd) == -1) error_message = "exec()";
-        perror(error_message);
-        _exit(1);
-    }
+static int compare_fds(void const* a, void const* b)
+{
+    return *(int const*) a - *(int const*) b;
 }
 
 JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_createSubprocess(
@@ -121,49 +112,95 @@ JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_createSubprocess(
         jstring cwd,
         jobjectArray args,
         jobjectArray envVars,
+        jintArray inheritFdsArray,
         jintArray processIdArray,
         jint rows,
         jint columns,
         jint cell_width,
         jint cell_height)
 {
-    jsize size = args ? (*env)->GetArrayLength(env, args) : 0;
+    // Everything allocated is freed at cleanup, where the exception for error is thrown if set. The
+    // argv and envp arrays are NULL terminated at every point, so that they can be freed there.
+    char const* error = NULL;
+    int* inherit_fds = NULL;
     char** argv = NULL;
+    char** envp = NULL;
+    int procId = 0;
+    int spawnBackend = -1;
+    int pidfd = -1;
+    int ptm = -1;
+
+    // Validate the fds to inherit first, so that nothing else has been allocated yet if they are invalid.
+    jsize inherit_fd_count = inheritFdsArray ? (*env)->GetArrayLength(env, inheritFdsArray) : 0;
+    if (inherit_fd_count > 0) {
+        inherit_fds = (int*) malloc(inherit_fd_count * sizeof(int));
+        if (!inherit_fds) {
+            error = "malloc() for inherit fds array failed";
+            goto cleanup;
+        }
+        (*env)->GetIntArrayRegion(env, inheritFdsArray, 0, inherit_fd_count, inherit_fds);
+        qsort(inherit_fds, (size_t) inherit_fd_count, sizeof(int), compare_fds);
+        for (int i = 0; i < inherit_fd_count; ++i) {
+            if (inherit_fds[i] <= 2 || (i > 0 && inherit_fds[i] == inherit_fds[i - 1]) || fcntl(inherit_fds[i], F_GETFD) < 0) {
+                error = "Invalid file descriptor to inherit";
+                goto cleanup;
+            }
+        }
+    }
+
+    jsize size = args ? (*env)->GetArrayLength(env, args) : 0;
     if (size > 0) {
-        argv = (char**) malloc((size + 1) * sizeof(char*));
-        if (!argv) return throw_runtime_exception(env, "Couldn't allocate argv array");
+        argv = (char**) calloc((size_t) size + 1, sizeof(char*));
+        if (!argv) {
+            error = "Couldn't allocate argv array";
+            goto cleanup;
+        }
         for (int i = 0; i < size; ++i) {
             jstring arg_java_string = (jstring) (*env)->GetObjectArrayElement(env, args, i);
             char const* arg_utf8 = (*env)->GetStringUTFChars(env, arg_java_string, NULL);
-            if (!arg_utf8) return throw_runtime_exception(env, "GetStringUTFChars() failed for argv");
+            if (!arg_utf8) {
+                error = "GetStringUTFChars() failed for argv";
+                goto cleanup;
+            }
             argv[i] = strdup(arg_utf8);
             (*env)->ReleaseStringUTFChars(env, arg_java_string, arg_utf8);
+            if (!argv[i]) {
+                error = "Couldn't allocate argv array";
+                goto cleanup;
+            }
         }
-        argv[size] = NULL;
     }
 
     size = envVars ? (*env)->GetArrayLength(env, envVars) : 0;
-    char** envp = NULL;
     if (size > 0) {
-        envp = (char**) malloc((size + 1) * sizeof(char *));
-        if (!envp) return throw_runtime_exception(env, "malloc() for envp array failed");
+        envp = (char**) calloc((size_t) size + 1, sizeof(char *));
+        if (!envp) {
+            error = "malloc() for envp array failed";
+            goto cleanup;
+        }
         for (int i = 0; i < size; ++i) {
             jstring env_java_string = (jstring) (*env)->GetObjectArrayElement(env, envVars, i);
             char const* env_utf8 = (*env)->GetStringUTFChars(env, env_java_string, 0);
-            if (!env_utf8) return throw_runtime_exception(env, "GetStringUTFChars() failed for env");
+            if (!env_utf8) {
+                error = "GetStringUTFChars() failed for env";
+                goto cleanup;
+            }
             envp[i] = strdup(env_utf8);
             (*env)->ReleaseStringUTFChars(env, env_java_string, env_utf8);
+            if (!envp[i]) {
+                error = "malloc() for envp array failed";
+                goto cleanup;
+            }
         }
-        envp[size] = NULL;
     }
 
-    int procId = 0;
     char const* cmd_cwd = (*env)->GetStringUTFChars(env, cwd, NULL);
     char const* cmd_utf8 = (*env)->GetStringUTFChars(env, cmd, NULL);
-    int ptm = create_subprocess(env, cmd_utf8, cmd_cwd, argv, envp, &procId, rows, columns, cell_width, cell_height);
+    ptm = create_subprocess(env, cmd_utf8, cmd_cwd, argv, envp, inherit_fds, inherit_fd_count, &procId, &spawnBackend, &pidfd, rows, columns, cell_width, cell_height);
     (*env)->ReleaseStringUTFChars(env, cmd, cmd_utf8);
-    (*env)->ReleaseStringUTFChars(env, cmd, cmd_cwd);
+    (*env)->ReleaseStringUTFChars(env, cwd, cmd_cwd);
 
+cleanup:
     if (argv) {
         for (char** tmp = argv; *tmp; ++tmp) free(*tmp);
         free(argv);
@@ -172,16 +209,39 @@ JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_createSubprocess(
         for (char** tmp = envp; *tmp; ++tmp) free(*tmp);
         free(envp);
     }
+    free(inherit_fds);
+    if (error) return throw_runtime_exception(env, error);
+    // The exception for a failed spawn has been thrown by create_subprocess().
+    if (ptm < 0) return ptm;
 
+    jsize processIdLength = (*env)->GetArrayLength(env, processIdArray);
+    if (pidfd >= 0 && processIdLength <= 2) {
+        close(pidfd);
+        pidfd = -1;
+    }
     int* pProcId = (int*) (*env)->GetPrimitiveArrayCritical(env, processIdArray, NULL);
-    if (!pProcId) return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(processIdArray, &isCopy) failed");
+    if (!pProcId) {
+        if (pidfd >= 0) close(pidfd);
+        return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(processIdArray, &isCopy) failed");
+    }
 
     *pProcId = procId;
+    if (processIdLength > 1) pProcId[1] = spawnBackend;
+    if (processIdLength > 2) pProcId[2] = pidfd;
     (*env)->ReleasePrimitiveArrayCritical(env, processIdArray, pProcId, 0);
 
     return ptm;
 }
 
+JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_setPreferredSpawnBackend(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jint backend)
+{
+    if (backend != TERMUX_SPAWN_BACKEND_FORK && backend != TERMUX_SPAWN_BACKEND_VFORK && backend != TERMUX_SPAWN_BACKEND_SERVER) {
+        throw_runtime_exception(env, "Invalid spawn backend");
+        return;
+    }
+    preferred_spawn_backend = backend;
+}
+
 JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_setPtyWindowSize(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jint fd, jint rows, jint cols, jint cell_width, jint cell_height)
 {
     struct winsize sz = { .ws_row = (unsigned short) rows, .ws_col = (unsigned short) cols, .ws_xpixel = (unsigned short) (cols * cell_width), .ws_ypixel = (unsigned short) (rows * cell_height) };
@@ -198,21 +258,450 @@ JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_setPtyUTF8Mode(JNIEnv* TERMU
     }
 }
 
+/** Must match JNI.PROCESS_WAIT_FAILED. */
+#define PROCESS_WAIT_FAILED (INT32_MIN + 1)
+
 JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_waitFor(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jint pid)
 {
-    int status;
-    waitpid(pid, &status, 0);
-    if (WIFEXITED(status)) {
-        return WEXITSTATUS(status);
-    } else if (WIFSIGNALED(status)) {
-        return -WTERMSIG(status);
+    int status = 0;
+    if (!spawn_server_wait_for(pid, &status)) {
+        pid_t waited;
+        do {
+            waited = waitpid(pid, &status, 0);
+        } while (waited < 0 && errno == EINTR);
+        if (waited < 0) return PROCESS_WAIT_FAILED;
+    }
+    return exit_code_from_wait_status(status);
+}
+
+/** The PtyReactor class and its callback methods, resolved when the reactor is initialized. */
+static jclass reactor_class;
+static jmethodID reactor_output_available_method;
+static jmethodID reactor_process_exited_method;
+
+static void call_reactor_method(JNIEnv* env, jmethodID method, jint session_id, jint exit_code)
+{
+    if (method == reactor_output_available_method) {
+        (*env)->CallStaticVoidMethod(env, reactor_class, method, session_id);
     } else {
-        // Should never happen - waitpid(2) says "One of the first three macros will evaluate to a non-zero (true) value".
-        return 0;
+        (*env)->CallStaticVoidMethod(env, reactor_class, method, session_id, exit_code);
+    }
+    // An exception must not stop the reactor thread, which serves all sessions.
+    if ((*env)->ExceptionCheck(env)) {
+        (*env)->ExceptionDescribe(env);
+        (*env)->ExceptionClear(env);
+    }
+}
+
+static void on_reactor_output_available(void* context, int session_id)
+{
+    call_reactor_method((JNIEnv*) context, reactor_output_available_method, session_id, 0);
+}
+
+static void on_reactor_process_exited(void* context, int session_id, int exit_code)
+{
+    call_reactor_method((JNIEnv*) context, reactor_process_exited_method, session_id, exit_code);
+}
+
+JNIEXPORT jboolean JNICALL Java_com_termux_terminal_JNI_reactorInit(JNIEnv* env, jclass TERMUX_UNUSED(clazz))
+{
+    if (!reactor_class) {
+        jclass local_class = (*env)->FindClass(env, "com/termux/terminal/PtyReactor");
+        if (!local_class) return JNI_FALSE;
+        reactor_output_available_method = (*env)->GetStaticMethodID(env, local_class, "onOutputAvailable", "(I)V");
+        reactor_process_exited_method = (*env)->GetStaticMethodID(env, local_class, "onProcessExited", "(II)V");
+        if (!reactor_output_available_method || !reactor_process_exited_method) return JNI_FALSE;
+        reactor_class = (jclass) (*env)->NewGlobalRef(env, local_class);
+    }
+    return pty_reactor_init() ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_reactorRun(JNIEnv* env, jclass TERMUX_UNUSED(clazz))
+{
+    struct pty_reactor_callbacks callbacks = {
+        .output_available = on_reactor_output_available,
+        .process_exited = on_reactor_process_exited,
+        .context = env,
+    };
+    pty_reactor_run(&callbacks);
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_reactorRegister(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jint fd, jint pid, jint pidfd)
+{
+    return pty_reactor_register(fd, pid, pidfd);
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_reactorUnregister(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jint session_id)
+{
+    pty_reactor_unregister(session_id);
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_reactorSetOutputBufferSize(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jint size)
+{
+    pty_reactor_set_output_buffer_size(size > 0 ? (size_t) size : 0);
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_reactorSetReadBatching(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jint coalescingWindowMillis, jint maxBatchSize)
+{
+    pty_reactor_set_read_batching(coalescingWindowMillis, maxBatchSize < 0 ? 0 : (size_t) maxBatchSize);
+}
+
+JNIEXPORT jboolean JNICALL Java_com_termux_terminal_JNI_reactorOutputStats(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jint session_id, jlongArray statsArray)
+{
+    if ((*env)->GetArrayLength(env, statsArray) < 3) {
+        throw_runtime_exception(env, "stats array is shorter than 3");
+        return JNI_FALSE;
     }
+    struct pty_reactor_stats stats;
+    if (!pty_reactor_stats(session_id, &stats)) return JNI_FALSE;
+    jlong values[3] = { (jlong) stats.bytes, (jlong) stats.reads, (jlong) stats.notifications };
+    (*env)->SetLongArrayRegion(env, statsArray, 0, 3, values);
+    return JNI_TRUE;
+}
+
+JNIEXPORT jlong JNICALL Java_com_termux_terminal_JNI_reactorOutput(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jint session_id)
+{
+    return (jlong) (intptr_t) pty_reactor_output(session_id);
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_reactorRead(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jlong output, jbyteArray buffer)
+{
+    jsize length = (*env)->GetArrayLength(env, buffer);
+    void* elements = (*env)->GetPrimitiveArrayCritical(env, buffer, NULL);
+    if (!elements) return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(buffer, &isCopy) failed");
+    // Reading does not block, so it may be done within the critical region.
+    int bytes = pty_reactor_read((struct spsc_ring*) (intptr_t) output, elements, (size_t) length);
+    (*env)->ReleasePrimitiveArrayCritical(env, buffer, elements, bytes > 0 ? 0 : JNI_ABORT);
+    return bytes;
+}
+
+JNIEXPORT jobject JNICALL Java_com_termux_terminal_JNI_reactorOutputBuffer(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jlong output)
+{
+    struct spsc_ring* ring = (struct spsc_ring*) (intptr_t) output;
+    return (*env)->NewDirectByteBuffer(env, spsc_ring_data(ring), (jlong) spsc_ring_capacity(ring));
+}
+
+JNIEXPORT jlong JNICALL Java_com_termux_terminal_JNI_reactorPeekOutput(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jlong output)
+{
+    size_t offset = 0;
+    size_t length = spsc_ring_peek((struct spsc_ring*) (intptr_t) output, &offset);
+    return ((jlong) offset << 32) | (jlong) length;
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_reactorConsumeOutput(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jlong output, jint count)
+{
+    pty_reactor_consume((struct spsc_ring*) (intptr_t) output, (size_t) count);
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_reactorWrite(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jint session_id, jbyteArray data, jint offset, jint count)
+{
+    // Copy in chunks, since writing may block while the input buffer of the session is full.
+    jbyte chunk[4096];
+    jint written = 0;
+    while (written < count) {
+        jint chunk_length = count - written < (jint) sizeof(chunk) ? count - written : (jint) sizeof(chunk);
+        (*env)->GetByteArrayRegion(env, data, offset + written, chunk_length, chunk);
+        if ((*env)->ExceptionCheck(env)) return -1;
+        if (pty_reactor_write(session_id, chunk, (size_t) chunk_length) < 0) return -1;
+        written += chunk_length;
+    }
+    return written;
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_waitForNoHang(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jint pid)
+{
+    int status;
+    int result = spawn_server_try_wait(pid, &status, true);
+    if (result == 0) return INT32_MIN;
+    if (result < 0) {
+        pid_t waited = waitpid(pid, &status, WNOHANG);
+        if (waited == 0) return INT32_MIN;
+        if (waited < 0) return throw_runtime_exception(env, "waitpid() failed");
+    }
+    return exit_code_from_wait_status(status);
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_openPidFd(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jint pid)
+{
+    return open_pidfd(pid);
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_pollPidFds(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jintArray pidFdsArray, jbooleanArray exitedArray, jint timeoutMillis)
+{
+    jsize count = (*env)->GetArrayLength(env, pidFdsArray);
+    if ((*env)->GetArrayLength(env, exitedArray) < count) return throw_runtime_exception(env, "exited array is shorter than pidFds array");
+    if (count == 0) return 0;
+
+    jint* pidfds = (*env)->GetIntArrayElements(env, pidFdsArray, NULL);
+    if (!pidfds) return -1;
+    struct pollfd* poll_fds = malloc((size_t) count * sizeof(struct pollfd));
+    if (!poll_fds) {
+        (*env)->ReleaseIntArrayElements(env, pidFdsArray, pidfds, JNI_ABORT);
+        return throw_runtime_exception(env, "malloc() for poll fds failed");
+    }
+    // Negative fds are ignored by poll(), so unused slots may be passed as -1.
+    for (jsize i = 0; i < count; i++) poll_fds[i] = (struct pollfd) { .fd = pidfds[i], .events = POLLIN };
+    (*env)->ReleaseIntArrayElements(env, pidFdsArray, pidfds, JNI_ABORT);
+
+    int ready;
+    do {
+        ready = poll(poll_fds, (nfds_t) count, timeoutMillis);
+    } while (ready < 0 && errno == EINTR);
+
+    int exited_count = 0;
+    if (ready > 0) {
+        jboolean* exited = (*env)->GetBooleanArrayElements(env, exitedArray, NULL);
+        if (exited) {
+            for (jsize i = 0; i < count; i++) {
+                exited[i] = (poll_fds[i].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)) ? JNI_TRUE : JNI_FALSE;
+                if (exited[i]) exited_count++;
+            }
+            (*env)->ReleaseBooleanArrayElements(env, exitedArray, exited, 0);
+        }
+    }
+    free(poll_fds);
+    if (ready < 0) return throw_runtime_exception(env, "poll() failed");
+    return exited_count;
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_reactorWatch(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jint pid)
+{
+    return pty_reactor_watch(pid);
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_reactorExitEventFd(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz))
+{
+    return pty_reactor_exit_event_fd();
+}
+
+/** The address of length bytes at offset in a direct buffer, or NULL with an exception thrown. */
+static uint8_t* direct_buffer_range(JNIEnv* env, jobject buffer, jint offset, jint length)
+{
+    uint8_t* address = (*env)->GetDirectBufferAddress(env, buffer);
+    if (!address) {
+        throw_runtime_exception(env, "Not a direct buffer");
+        return NULL;
+    }
+    if (offset < 0 || length < 0 || (jlong) offset + length > (*env)->GetDirectBufferCapacity(env, buffer)) {
+        throw_runtime_exception(env, "Range outside of buffer");
+        return NULL;
+    }
+    return address + offset;
+}
+
+/**
+ * The result of a read(2) or readv(2) on a pseudoterminal master as returned to Java: the byte count,
+ * -1 at end of file, which the master reports as EIO once the slave side has been closed, and 0 when
+ * nothing is available on a non-blocking descriptor.
+ */
+static jint read_result(JNIEnv* env, char const* call, ssize_t result)
+{
+    if (result > 0) return (jint) result;
+    if (result == 0 || errno == EIO) return -1;
+    if (errno == EAGAIN) return 0;
+    return throw_io_exception(env, call, errno);
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_readInto(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jint fd, jobject buffer, jint offset, jint length)
+{
+    uint8_t* data = direct_buffer_range(env, buffer, offset, length);
+    if (!data) return -1;
+    ssize_t result;
+    do result = read(fd, data, (size_t) length); while (result < 0 && errno == EINTR);
+    return read_result(env, "read()", result);
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_readvInto(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jint fd, jobjectArray buffers, jintArray offsetsArray, jintArray lengthsArray)
+{
+    jsize count = (*env)->GetArrayLength(env, buffers);
+    if (count > JNI_READV_MAX_BUFFERS) return throw_runtime_exception(env, "Too many buffers");
+    if ((*env)->GetArrayLength(env, offsetsArray) < count || (*env)->GetArrayLength(env, lengthsArray) < count)
+        return throw_runtime_exception(env, "offsets or lengths array is shorter than buffers array");
+    jint offsets[JNI_READV_MAX_BUFFERS];
+    jint lengths[JNI_READV_MAX_BUFFERS];
+    (*env)->GetIntArrayRegion(env, offsetsArray, 0, count, offsets);
+    (*env)->GetIntArrayRegion(env, lengthsArray, 0, count, lengths);
+
+    struct iovec iov[JNI_READV_MAX_BUFFERS];
+    for (jsize i = 0; i < count; i++) {
+        jobject buffer = (*env)->GetObjectArrayElement(env, buffers, i);
+        uint8_t* data = direct_buffer_range(env, buffer, offsets[i], lengths[i]);
+        (*env)->DeleteLocalRef(env, buffer);
+        if (!data) return -1;
+        iov[i] = (struct iovec) { .iov_base = data, .iov_len = (size_t) lengths[i] };
+    }
+    ssize_t result;
+    do result = readv(fd, iov, count); while (result < 0 && errno == EINTR);
+    return read_result(env, "readv()", result);
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_JNI_writeFrom(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jint fd, jobject buffer, jint offset, jint length)
+{
+    uint8_t* data = direct_buffer_range(env, buffer, offset, length);
+    if (!data) return -1;
+    ssize_t result;
+    do result = write(fd, data, (size_t) length); while (result < 0 && errno == EINTR);
+    if (result >= 0) return (jint) result;
+    if (errno == EAGAIN) return 0;
+    return throw_io_exception(env, "write()", errno);
 }
 
 JNIEXPORT void JNICALL Java_com_termux_terminal_JNI_close(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jint fileDescriptor)
 {
     close(fileDescriptor);
 }
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_PrintableRunScanner_nativeFindRuns(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jbyteArray buffer, jint length, jint minRunLength, jintArray runsArray)
+{
+    jsize max_runs = (*env)->GetArrayLength(env, runsArray) / 2;
+    void* data = (*env)->GetPrimitiveArrayCritical(env, buffer, NULL);
+    if (!data) return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(buffer, &isCopy) failed");
+    jint* runs = (*env)->GetPrimitiveArrayCritical(env, runsArray, NULL);
+    if (!runs) {
+        (*env)->ReleasePrimitiveArrayCritical(env, buffer, data, JNI_ABORT);
+        return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(runs, &isCopy) failed");
+    }
+    size_t run_count = vt_find_printable_runs(data, (size_t) length, (size_t) minRunLength, runs, (size_t) max_runs);
+    (*env)->ReleasePrimitiveArrayCritical(env, runsArray, runs, 0);
+    (*env)->ReleasePrimitiveArrayCritical(env, buffer, data, JNI_ABORT);
+    return (jint) run_count;
+}
+
+JNIEXPORT jlong JNICALL Java_com_termux_terminal_FloodScanner_nativeFindScrolledOffOutput(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jbyteArray buffer, jint length, jint lineFeeds)
+{
+    void* data = (*env)->GetPrimitiveArrayCritical(env, buffer, NULL);
+    if (!data) return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(buffer, &isCopy) failed");
+    size_t start;
+    size_t end = vt_find_scrolled_off_output(data, (size_t) length, (size_t) lineFeeds, &start);
+    (*env)->ReleasePrimitiveArrayCritical(env, buffer, data, JNI_ABORT);
+    return ((jlong) start << 32) | (jlong) end;
+}
+
+JNIEXPORT jlong JNICALL Java_com_termux_terminal_Utf8Decoder_decode(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jbyteArray buffer, jint offset, jint length, jintArray decodedArray)
+{
+    if (offset < 0 || length < 0 || (jlong) offset + length > (*env)->GetArrayLength(env, buffer))
+        return throw_runtime_exception(env, "Range outside of buffer");
+    if ((*env)->GetArrayLength(env, decodedArray) < length) return throw_runtime_exception(env, "decoded array is shorter than length");
+    uint8_t* data = (*env)->GetPrimitiveArrayCritical(env, buffer, NULL);
+    if (!data) return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(buffer, &isCopy) failed");
+    jint* decoded = (*env)->GetPrimitiveArrayCritical(env, decodedArray, NULL);
+    if (!decoded) {
+        (*env)->ReleasePrimitiveArrayCritical(env, buffer, data, JNI_ABORT);
+        return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(decoded, &isCopy) failed");
+    }
+    size_t consumed;
+    size_t count = utf8_decode(data + offset, (size_t) length, decoded, &consumed);
+    (*env)->ReleasePrimitiveArrayCritical(env, decodedArray, decoded, 0);
+    (*env)->ReleasePrimitiveArrayCritical(env, buffer, data, JNI_ABORT);
+    return ((jlong) consumed << 32) | (jlong) count;
+}
+
+JNIEXPORT jlong JNICALL Java_com_termux_terminal_CellStore_nativeCreate(JNIEnv* env, jclass TERMUX_UNUSED(clazz))
+{
+    struct cell_store* store = cell_store_create();
+    if (!store) throw_runtime_exception(env, "Out of memory creating cell store");
+    return (jlong) (intptr_t) store;
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_CellStore_nativeDestroy(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jlong store)
+{
+    cell_store_destroy((struct cell_store*) (intptr_t) store);
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_CellStore_nativeReset(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jlong store)
+{
+    cell_store_reset((struct cell_store*) (intptr_t) store);
+}
+
+JNIEXPORT jlong JNICALL Java_com_termux_terminal_CellStore_nativePack(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jlong store, jcharArray textArray, jint textLength, jlongArray styleArray)
+{
+    jsize columns = (*env)->GetArrayLength(env, styleArray);
+    jchar* text = (*env)->GetPrimitiveArrayCritical(env, textArray, NULL);
+    if (!text) return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(text, &isCopy) failed");
+    jlong* styles = (*env)->GetPrimitiveArrayCritical(env, styleArray, NULL);
+    if (!styles) {
+        (*env)->ReleasePrimitiveArrayCritical(env, textArray, text, JNI_ABORT);
+        return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(style, &isCopy) failed");
+    }
+    uintptr_t handle = cell_store_pack((struct cell_store*) (intptr_t) store, text, (size_t) textLength, styles, (size_t) columns);
+    (*env)->ReleasePrimitiveArrayCritical(env, styleArray, styles, JNI_ABORT);
+    (*env)->ReleasePrimitiveArrayCritical(env, textArray, text, JNI_ABORT);
+    return (jlong) handle;
+}
+
+JNIEXPORT jboolean JNICALL Java_com_termux_terminal_CellStore_nativeCompress(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jlong store, jlongArray handleArray, jint count)
+{
+    if (count <= 0) return JNI_FALSE;
+    if (count > CELL_STORE_COLD_BLOCK_ROWS) return (jboolean) throw_runtime_exception(env, "Too many rows to compress into a cold block");
+    // Copied instead of accessed critically, since compressing a block takes too long to hold off the GC meanwhile.
+    jlong handles[CELL_STORE_COLD_BLOCK_ROWS];
+    (*env)->GetLongArrayRegion(env, handleArray, 0, count, handles);
+    if ((*env)->ExceptionCheck(env)) return JNI_FALSE;
+    uintptr_t native_handles[CELL_STORE_COLD_BLOCK_ROWS];
+    for (jint i = 0; i < count; i++) native_handles[i] = (uintptr_t) handles[i];
+    if (cell_store_compress((struct cell_store*) (intptr_t) store, native_handles, (size_t) count) != 0) return JNI_FALSE;
+    for (jint i = 0; i < count; i++) handles[i] = (jlong) native_handles[i];
+    (*env)->SetLongArrayRegion(env, handleArray, 0, count, handles);
+    return JNI_TRUE;
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_CellStore_nativeUnpack(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jlong store, jlong packed, jcharArray textArray, jlongArray styleArray)
+{
+    struct packed_row const* row = cell_store_row((struct cell_store*) (intptr_t) store, (uintptr_t) packed);
+    if (!row) {
+        jclass exClass = (*env)->FindClass(env, "java/lang/OutOfMemoryError");
+        (*env)->ThrowNew(env, exClass, "Out of memory decompressing transcript rows");
+        return -1;
+    }
+    if ((*env)->GetArrayLength(env, styleArray) != row->columns) return throw_runtime_exception(env, "style array does not match the columns of the row");
+    jsize text_capacity = (*env)->GetArrayLength(env, textArray);
+    jchar* text = (*env)->GetPrimitiveArrayCritical(env, textArray, NULL);
+    if (!text) return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(text, &isCopy) failed");
+    jlong* styles = (*env)->GetPrimitiveArrayCritical(env, styleArray, NULL);
+    if (!styles) {
+        (*env)->ReleasePrimitiveArrayCritical(env, textArray, text, JNI_ABORT);
+        return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(style, &isCopy) failed");
+    }
+    int non_one_width;
+    int length = cell_store_unpack(row, text, (size_t) text_capacity, styles, &non_one_width);
+    (*env)->ReleasePrimitiveArrayCritical(env, styleArray, styles, 0);
+    (*env)->ReleasePrimitiveArrayCritical(env, textArray, text, 0);
+    if (length < 0) return length;
+    return length | (non_one_width ? (1 << 30) : 0);
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_CellStore_nativeFree(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jlong store, jlong packed)
+{
+    cell_store_free((struct cell_store*) (intptr_t) store, (uintptr_t) packed);
+}
+
+JNIEXPORT jlong JNICALL Java_com_termux_terminal_TranscriptSearch_nativeCompile(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jcharArray patternArray, jint flags)
+{
+    jsize length = (*env)->GetArrayLength(env, patternArray);
+    jchar* pattern = (*env)->GetPrimitiveArrayCritical(env, patternArray, NULL);
+    if (!pattern) return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(pattern, &isCopy) failed");
+    struct text_search* search = text_search_compile(pattern, (size_t) length, flags);
+    (*env)->ReleasePrimitiveArrayCritical(env, patternArray, pattern, JNI_ABORT);
+    return (jlong) (intptr_t) search;
+}
+
+JNIEXPORT void JNICALL Java_com_termux_terminal_TranscriptSearch_nativeFree(JNIEnv* TERMUX_UNUSED(env), jclass TERMUX_UNUSED(clazz), jlong search)
+{
+    text_search_free((struct text_search*) (intptr_t) search);
+}
+
+JNIEXPORT jint JNICALL Java_com_termux_terminal_TranscriptSearch_nativeFind(JNIEnv* env, jclass TERMUX_UNUSED(clazz), jlong search, jcharArray textArray, jint length, jint start, jintArray matchesArray)
+{
+    jsize max_matches = (*env)->GetArrayLength(env, matchesArray) / 2;
+    jchar* text = (*env)->GetPrimitiveArrayCritical(env, textArray, NULL);
+    if (!text) return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(text, &isCopy) failed");
+    jint* matches = (*env)->GetPrimitiveArrayCritical(env, matchesArray, NULL);
+    if (!matches) {
+        (*env)->ReleasePrimitiveArrayCritical(env, textArray, text, JNI_ABORT);
+        return throw_runtime_exception(env, "JNI call GetPrimitiveArrayCritical(matches, &isCopy) failed");
+    }
+    size_t count = text_search_find((struct text_search const*) (intptr_t) search, text, (size_t) length, (size_t) start, matches, (size_t) max_matches);
+    (*env)->ReleasePrimitiveArrayCritical(env, matchesArray, matches, 0);
+    (*env)->ReleasePrimitiveArrayCritical(env, textArray, text, JNI_ABORT);
+    return (jint) count;
+}
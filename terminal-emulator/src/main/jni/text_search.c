@@ -0,0 +1,355 @@
+#include <stdlib.h>
+#include <wctype.h>
+
+#include "text_search.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define TEXT_SEARCH_NEON 1
+#elif defined(__SSE2__)
+# include <emmintrin.h>
+# define TEXT_SEARCH_SSE2 1
+#endif
+
+/** The number of steps a regular expression may take trying to match at a position, to bound backtracking. */
+#define TEXT_SEARCH_MAX_STEPS 100000
+
+enum node_type { NODE_CHAR, NODE_ANY, NODE_CLASS, NODE_LINE_START, NODE_LINE_END };
+enum quantifier { ONE, ZERO_OR_MORE, ONE_OR_MORE, ZERO_OR_ONE };
+
+struct range {
+    uint16_t first;
+    uint16_t last;
+};
+
+struct node {
+    uint8_t type;
+    uint8_t quantifier;
+    uint8_t negated;
+    uint16_t c;
+    /** The ranges of a class, in the ranges of the search. */
+    uint32_t first_range;
+    uint32_t range_count;
+};
+
+struct text_search {
+    int flags;
+    /** The substring, case folded if ignoring case. */
+    uint16_t* needle;
+    size_t needle_length;
+    struct node* nodes;
+    size_t node_count;
+    struct range* ranges;
+    size_t range_count;
+};
+
+static inline uint16_t fold(uint16_t c)
+{
+    if (c < 0x80) return (c >= 'A' && c <= 'Z') ? (uint16_t) (c + 32) : c;
+    if (c >= 0xD800 && c <= 0xDFFF) return c;
+    return (uint16_t) towlower(c);
+}
+
+static inline uint16_t unfold(uint16_t c)
+{
+    if (c < 0x80) return (c >= 'a' && c <= 'z') ? (uint16_t) (c - 32) : c;
+    if (c >= 0xD800 && c <= 0xDFFF) return c;
+    return (uint16_t) towupper(c);
+}
+
+static int add_range(struct text_search* search, size_t* capacity, uint16_t first, uint16_t last)
+{
+    if (search->range_count == *capacity) {
+        size_t new_capacity = *capacity ? 2 * *capacity : 16;
+        struct range* ranges = realloc(search->ranges, new_capacity * sizeof(struct range));
+        if (!ranges) return -1;
+        search->ranges = ranges;
+        *capacity = new_capacity;
+    }
+    search->ranges[search->range_count].first = first;
+    search->ranges[search->range_count].last = last;
+    search->range_count++;
+    return 0;
+}
+
+/** Add the ranges of the class escape \d, \w or \s, returning 1 if c is not one. */
+static int add_escape_ranges(struct text_search* search, size_t* capacity, uint16_t c)
+{
+    switch (c) {
+        case 'd': case 'D':
+            return add_range(search, capacity, '0', '9');
+        case 'w': case 'W':
+            return add_range(search, capacity, '0', '9') || add_range(search, capacity, 'A', 'Z')
+                || add_range(search, capacity, '_', '_') || add_range(search, capacity, 'a', 'z');
+        case 's': case 'S':
+            return add_range(search, capacity, '\t', '\t') || add_range(search, capacity, '\v', '\r')
+                || add_range(search, capacity, ' ', ' ');
+        default:
+            return 1;
+    }
+}
+
+static int compile_regex(struct text_search* search, uint16_t const* pattern, size_t length)
+{
+    size_t range_capacity = 0;
+    // No more nodes than pattern chars are needed.
+    search->nodes = calloc(length, sizeof(struct node));
+    if (!search->nodes) return -1;
+
+    for (size_t i = 0; i < length;) {
+        uint16_t c = pattern[i++];
+        if (c == '*' || c == '+' || c == '?') {
+            if (search->node_count == 0) return -1;
+            struct node* previous = &search->nodes[search->node_count - 1];
+            if (previous->quantifier != ONE || previous->type == NODE_LINE_START || previous->type == NODE_LINE_END) return -1;
+            previous->quantifier = (c == '*') ? ZERO_OR_MORE : (c == '+') ? ONE_OR_MORE : ZERO_OR_ONE;
+            continue;
+        }
+        if (c == '(' || c == ')' || c == '|' || c == '{' || c == '}') return -1;
+
+        struct node* node = &search->nodes[search->node_count++];
+        if (c == '.') {
+            node->type = NODE_ANY;
+        } else if (c == '^') {
+            node->type = NODE_LINE_START;
+        } else if (c == '$') {
+            node->type = NODE_LINE_END;
+        } else if (c == '\\') {
+            if (i == length) return -1;
+            c = pattern[i++];
+            node->first_range = (uint32_t) search->range_count;
+            int result = add_escape_ranges(search, &range_capacity, c);
+            if (result < 0) return -1;
+            if (result == 0) {
+                node->type = NODE_CLASS;
+                node->negated = (c == 'D' || c == 'W' || c == 'S');
+                node->range_count = (uint32_t) (search->range_count - node->first_range);
+            } else {
+                node->type = NODE_CHAR;
+                node->c = (c == 't') ? '\t' : c;
+            }
+        } else if (c == '[') {
+            node->type = NODE_CLASS;
+            node->first_range = (uint32_t) search->range_count;
+            if (i < length && pattern[i] == '^') {
+                node->negated = 1;
+                i++;
+            }
+            int first = 1;
+            for (;;) {
+                if (i == length) return -1;
+                uint16_t first_char = pattern[i++];
+                if (first_char == ']' && !first) break;
+                first = 0;
+                if (first_char == '\\') {
+                    if (i == length) return -1;
+                    first_char = pattern[i++];
+                    int result = add_escape_ranges(search, &range_capacity, first_char);
+                    if (result < 0) return -1;
+                    if (result == 0) continue;
+                    if (first_char == 't') first_char = '\t';
+                }
+                uint16_t last_char = first_char;
+                if (i + 1 < length && pattern[i] == '-' && pattern[i + 1] != ']') {
+                    last_char = pattern[i + 1];
+                    i += 2;
+                    if (last_char == '\\') {
+                        if (i == length) return -1;
+                        last_char = pattern[i++];
+                    }
+                    if (last_char < first_char) return -1;
+                }
+                if (add_range(search, &range_capacity, first_char, last_char)) return -1;
+            }
+            node->range_count = (uint32_t) (search->range_count - node->first_range);
+        } else {
+            node->type = NODE_CHAR;
+            node->c = c;
+        }
+        if (node->type == NODE_CHAR && (search->flags & TEXT_SEARCH_IGNORE_CASE)) node->c = fold(node->c);
+    }
+    return 0;
+}
+
+struct text_search* text_search_compile(uint16_t const* pattern, size_t length, int flags)
+{
+    if (length == 0) return NULL;
+    struct text_search* search = calloc(1, sizeof(struct text_search));
+    if (!search) return NULL;
+    search->flags = flags;
+    if (flags & TEXT_SEARCH_REGEX) {
+        if (compile_regex(search, pattern, length)) {
+            text_search_free(search);
+            return NULL;
+        }
+    } else {
+        search->needle = malloc(length * sizeof(uint16_t));
+        if (!search->needle) {
+            text_search_free(search);
+            return NULL;
+        }
+        for (size_t i = 0; i < length; i++)
+            search->needle[i] = (flags & TEXT_SEARCH_IGNORE_CASE) ? fold(pattern[i]) : pattern[i];
+        search->needle_length = length;
+    }
+    return search;
+}
+
+void text_search_free(struct text_search* search)
+{
+    free(search->needle);
+    free(search->nodes);
+    free(search->ranges);
+    free(search);
+}
+
+/** The index of the first of a or b at or after start, or length. */
+static size_t find_either(uint16_t const* text, size_t start, size_t length, uint16_t a, uint16_t b)
+{
+    size_t i = start;
+#if defined(TEXT_SEARCH_NEON)
+    uint16x8_t const va = vdupq_n_u16(a);
+    uint16x8_t const vb = vdupq_n_u16(b);
+    for (; i + 8 <= length; i += 8) {
+        uint16x8_t chars = vld1q_u16(text + i);
+        uint64x2_t found = vreinterpretq_u64_u16(vorrq_u16(vceqq_u16(chars, va), vceqq_u16(chars, vb)));
+        if ((vgetq_lane_u64(found, 0) | vgetq_lane_u64(found, 1)) != 0) break;
+    }
+#elif defined(TEXT_SEARCH_SSE2)
+    __m128i const va = _mm_set1_epi16((short) a);
+    __m128i const vb = _mm_set1_epi16((short) b);
+    for (; i + 8 <= length; i += 8) {
+        __m128i chars = _mm_loadu_si128((__m128i const*) (text + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(chars, va), _mm_cmpeq_epi16(chars, vb)));
+        if (mask != 0) return i + (size_t) __builtin_ctz((unsigned) mask) / 2;
+    }
+#endif
+    while (i < length && text[i] != a && text[i] != b) i++;
+    return i;
+}
+
+static size_t find_substring(struct text_search const* search, uint16_t const* text, size_t length, size_t start, size_t* end)
+{
+    uint16_t const* needle = search->needle;
+    size_t const needle_length = search->needle_length;
+    if (length < needle_length) return length;
+    size_t const last_start = length - needle_length;
+    int const ignore_case = search->flags & TEXT_SEARCH_IGNORE_CASE;
+    uint16_t const first = needle[0];
+    uint16_t const first_other_case = ignore_case ? unfold(first) : first;
+    // Chars without a simple upper case form are scanned for one at a time.
+    int const scan = !ignore_case || fold(first_other_case) == first;
+
+    for (size_t i = start; i <= last_start; i++) {
+        if (scan) {
+            i = find_either(text, i, last_start + 1, first, first_other_case);
+            if (i > last_start) break;
+        } else if ((ignore_case ? fold(text[i]) : text[i]) != first) {
+            continue;
+        }
+        size_t j = 1;
+        if (ignore_case) {
+            while (j < needle_length && fold(text[i + j]) == needle[j]) j++;
+        } else {
+            while (j < needle_length && text[i + j] == needle[j]) j++;
+        }
+        if (j == needle_length) {
+            *end = i + needle_length;
+            return i;
+        }
+    }
+    return length;
+}
+
+static int class_contains(struct text_search const* search, struct node const* node, uint16_t c)
+{
+    for (int pass = 0; pass < ((search->flags & TEXT_SEARCH_IGNORE_CASE) ? 3 : 1); pass++) {
+        uint16_t tested = (pass == 0) ? c : (pass == 1) ? fold(c) : unfold(c);
+        for (uint32_t r = node->first_range; r < node->first_range + node->range_count; r++)
+            if (tested >= search->ranges[r].first && tested <= search->ranges[r].last) return !node->negated;
+    }
+    return node->negated;
+}
+
+/** If the node matches the char at position i, which has to be before the end of the text. */
+static inline int node_matches_char(struct text_search const* search, struct node const* node, uint16_t c)
+{
+    if (c == '\n') return 0;
+    switch (node->type) {
+        case NODE_CHAR:
+            return ((search->flags & TEXT_SEARCH_IGNORE_CASE) ? fold(c) : c) == node->c;
+        case NODE_ANY:
+            return 1;
+        case NODE_CLASS:
+            return class_contains(search, node, c);
+        default:
+            return 0;
+    }
+}
+
+/** Match the nodes from node_index at position i, setting *end if they do. */
+static int match_here(struct text_search const* search, size_t node_index, uint16_t const* text, size_t length, size_t i, size_t* end, int* steps)
+{
+    for (; node_index < search->node_count; node_index++) {
+        if (--*steps < 0) return 0;
+        struct node const* node = &search->nodes[node_index];
+        if (node->type == NODE_LINE_START) {
+            if (i > 0 && text[i - 1] != '\n') return 0;
+            continue;
+        }
+        if (node->type == NODE_LINE_END) {
+            if (i < length && text[i] != '\n') return 0;
+            continue;
+        }
+        if (node->quantifier == ONE) {
+            if (i == length || !node_matches_char(search, node, text[i])) return 0;
+            i++;
+            continue;
+        }
+        // Greedily take as many chars as allowed, then backtrack.
+        size_t min = (node->quantifier == ONE_OR_MORE) ? 1 : 0;
+        size_t max = (node->quantifier == ZERO_OR_ONE) ? 1 : SIZE_MAX;
+        size_t count = 0;
+        while (count < max && i + count < length && node_matches_char(search, node, text[i + count])) count++;
+        for (;;) {
+            if (count < min) return 0;
+            if (match_here(search, node_index + 1, text, length, i + count, end, steps)) return 1;
+            if (count-- == 0 || *steps < 0) return 0;
+        }
+    }
+    *end = i;
+    return 1;
+}
+
+static size_t find_regex(struct text_search const* search, uint16_t const* text, size_t length, size_t start, size_t* end)
+{
+    struct node const* first = &search->nodes[0];
+    int const ignore_case = search->flags & TEXT_SEARCH_IGNORE_CASE;
+    int const scan = first->type == NODE_CHAR && (first->quantifier == ONE || first->quantifier == ONE_OR_MORE)
+        && (!ignore_case || fold(unfold(first->c)) == first->c);
+    for (size_t i = start; i < length; i++) {
+        if (scan) {
+            i = find_either(text, i, length, first->c, ignore_case ? unfold(first->c) : first->c);
+            if (i == length) break;
+        }
+        int steps = TEXT_SEARCH_MAX_STEPS;
+        if (match_here(search, 0, text, length, i, end, &steps) && *end > i) return i;
+    }
+    return length;
+}
+
+size_t text_search_find(struct text_search const* search, uint16_t const* text, size_t length, size_t start, int32_t* matches, size_t max_matches)
+{
+    size_t count = 0;
+    while (count < max_matches && start < length) {
+        size_t end;
+        size_t match = (search->flags & TEXT_SEARCH_REGEX) ? find_regex(search, text, length, start, &end)
+            : find_substring(search, text, length, start, &end);
+        if (match >= length) break;
+        matches[2 * count] = (int32_t) match;
+        matches[2 * count + 1] = (int32_t) end;
+        count++;
+        start = end;
+    }
+    return count;
+}
@@ -0,0 +1,34 @@
+#ifndef TERMUX_TEXT_SEARCH_H
+#define TERMUX_TEXT_SEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Search of UTF-16 terminal text for a substring, or a simple regular expression, optionally
+ * ignoring case. The text is lines separated by '\n', which matches never cross.
+ *
+ * Substrings are found by scanning for their first char with NEON on ARM and SSE2 on x86, and
+ * checking the rest where it is found. Regular expressions support literal chars, '.', classes
+ * like [a-z] and [^0-9], the escapes \d, \w and \s and their negations, the quantifiers '*', '+'
+ * and '?', and the anchors '^' and '$' at the start and end of lines. Groups, alternation and
+ * counted repetition are not supported.
+ */
+
+#define TEXT_SEARCH_IGNORE_CASE 1
+#define TEXT_SEARCH_REGEX 2
+
+struct text_search;
+
+/** Compile a pattern, returning NULL if it is empty, not a supported regular expression or if out of memory. */
+struct text_search* text_search_compile(uint16_t const* pattern, size_t length, int flags);
+
+void text_search_free(struct text_search* search);
+
+/**
+ * Find non-empty, non-overlapping matches from the start index of the text, storing the start and
+ * end index of each in matches, which has room for max_matches. Returns the number of matches found.
+ */
+size_t text_search_find(struct text_search const* search, uint16_t const* text, size_t length, size_t start, int32_t* matches, size_t max_matches);
+
+#endif
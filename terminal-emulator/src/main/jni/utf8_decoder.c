@@ -0,0 +1,167 @@
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "utf8_decoder.h"
+#include "wcwidth.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define UTF8_DECODER_NEON 1
+#elif defined(__SSE2__)
+# include <emmintrin.h>
+# define UTF8_DECODER_SSE2 1
+#endif
+
+#define UNICODE_REPLACEMENT_CHAR 0xFFFD
+
+static inline bool is_continuation_byte(uint8_t b)
+{
+    return (b & 0b11000000) == 0b10000000;
+}
+
+/** The number of continuation bytes following a lead byte, or -1 if not a valid lead byte. */
+static inline int continuation_bytes_to_follow(uint8_t b)
+{
+    if ((b & 0b11100000) == 0b11000000) return 1;
+    if ((b & 0b11110000) == 0b11100000) return 2;
+    if ((b & 0b11111000) == 0b11110000) return 3;
+    return -1;
+}
+
+/** The widths of the Basic Multilingual Plane at 2 bits each, to avoid the table searches of termux_wcwidth(). */
+static uint8_t bmp_widths[0x10000 / 4];
+static pthread_once_t bmp_widths_once = PTHREAD_ONCE_INIT;
+
+static void init_bmp_widths(void)
+{
+    for (int32_t c = 0; c < 0x10000; c++)
+        bmp_widths[c / 4] |= (uint8_t) (termux_wcwidth(c) << (2 * (c % 4)));
+}
+
+static inline int32_t pack(int32_t code_point, int32_t flags)
+{
+    int32_t width = code_point < 0x10000 ? (bmp_widths[code_point / 4] >> (2 * (code_point % 4))) & 0b11 : termux_wcwidth(code_point);
+    return code_point | (width << UTF8_DECODED_WIDTH_SHIFT) | flags;
+}
+
+static inline int32_t pack_ascii(uint8_t b)
+{
+    int32_t width = (b >= 0x20 && b != 0x7F) ? 1 : 0;
+    return b | (width << UTF8_DECODED_WIDTH_SHIFT);
+}
+
+/** The length of the buffer without an incomplete sequence at its end. */
+static size_t complete_length(uint8_t const* data, size_t length)
+{
+    for (size_t i = length; i > 0 && length - i < 4; i--) {
+        uint8_t b = data[i - 1];
+        if (is_continuation_byte(b)) continue;
+        int to_follow = continuation_bytes_to_follow(b);
+        return (to_follow > 0 && length - i < (size_t) to_follow) ? i - 1 : length;
+    }
+    return length;
+}
+
+/**
+ * Decode 16 bytes if they are all ASCII, returning false without decoding anything otherwise. The
+ * bytes are widened by interleaving them with a byte that is 0x20 for printable characters, which
+ * ends up as the width 1 at bit 21 of each value.
+ */
+static inline bool decode_ascii_block(uint8_t const* data, int32_t* decoded)
+{
+#if defined(UTF8_DECODER_NEON)
+    uint8x16_t bytes = vld1q_u8(data);
+    uint8x16_t high_bits = vandq_u8(bytes, vdupq_n_u8(0x80));
+    uint64x2_t high_bits_64 = vreinterpretq_u64_u8(high_bits);
+    if ((vgetq_lane_u64(high_bits_64, 0) | vgetq_lane_u64(high_bits_64, 1)) != 0) return false;
+    uint8x16_t printable = vandq_u8(vcgeq_u8(bytes, vdupq_n_u8(0x20)), vmvnq_u8(vceqq_u8(bytes, vdupq_n_u8(0x7F))));
+    uint8x16_t width_bytes = vandq_u8(printable, vdupq_n_u8(0x20));
+    uint16x8_t low = vmovl_u8(vget_low_u8(bytes)), high = vmovl_u8(vget_high_u8(bytes));
+    uint16x8_t low_widths = vmovl_u8(vget_low_u8(width_bytes)), high_widths = vmovl_u8(vget_high_u8(width_bytes));
+    uint16x8x2_t low_zipped = vzipq_u16(low, low_widths), high_zipped = vzipq_u16(high, high_widths);
+    vst1q_s32(decoded, vreinterpretq_s32_u16(low_zipped.val[0]));
+    vst1q_s32(decoded + 4, vreinterpretq_s32_u16(low_zipped.val[1]));
+    vst1q_s32(decoded + 8, vreinterpretq_s32_u16(high_zipped.val[0]));
+    vst1q_s32(decoded + 12, vreinterpretq_s32_u16(high_zipped.val[1]));
+    return true;
+#elif defined(UTF8_DECODER_SSE2)
+    __m128i bytes = _mm_loadu_si128((__m128i const*) data);
+    if (_mm_movemask_epi8(bytes) != 0) return false;
+    __m128i printable = _mm_andnot_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x7F)), _mm_cmpgt_epi8(bytes, _mm_set1_epi8(0x1F)));
+    __m128i width_bytes = _mm_and_si128(printable, _mm_set1_epi8(0x20));
+    __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_unpacklo_epi8(bytes, zero), high = _mm_unpackhi_epi8(bytes, zero);
+    __m128i low_widths = _mm_unpacklo_epi8(width_bytes, zero), high_widths = _mm_unpackhi_epi8(width_bytes, zero);
+    _mm_storeu_si128((__m128i*) decoded, _mm_unpacklo_epi16(low, low_widths));
+    _mm_storeu_si128((__m128i*) (decoded + 4), _mm_unpackhi_epi16(low, low_widths));
+    _mm_storeu_si128((__m128i*) (decoded + 8), _mm_unpacklo_epi16(high, high_widths));
+    _mm_storeu_si128((__m128i*) (decoded + 12), _mm_unpackhi_epi16(high, high_widths));
+    return true;
+#else
+    (void) data;
+    (void) decoded;
+    return false;
+#endif
+}
+
+size_t utf8_decode(uint8_t const* data, size_t length, int32_t* decoded, size_t* consumed)
+{
+    pthread_once(&bmp_widths_once, init_bmp_widths);
+    size_t const end = complete_length(data, length);
+    size_t count = 0;
+    size_t i = 0;
+    while (i < end) {
+        if (i + 16 <= end && decode_ascii_block(data + i, decoded + count)) {
+            i += 16;
+            count += 16;
+            continue;
+        }
+
+        uint8_t b = data[i];
+        if (b < 0x80) {
+            decoded[count++] = pack_ascii(b);
+            i++;
+            continue;
+        }
+
+        int to_follow = continuation_bytes_to_follow(b);
+        if (to_follow < 0) {
+            // Not a valid UTF-8 sequence start.
+            decoded[count++] = pack(UNICODE_REPLACEMENT_CHAR, 0);
+            i++;
+            continue;
+        }
+
+        int32_t code_point = b & (to_follow == 1 ? 0b00011111 : (to_follow == 2 ? 0b00001111 : 0b00000111));
+        int read = 1;
+        for (; read <= to_follow && i + read < end && is_continuation_byte(data[i + read]); read++)
+            code_point = (code_point << 6) | (data[i + read] & 0b00111111);
+        if (read <= to_follow) {
+            // Not a continuation byte, so the sequence up to now is replaced and the byte is decoded again.
+            decoded[count++] = pack(UNICODE_REPLACEMENT_CHAR, UTF8_DECODED_FLAG_EMIT);
+            i += (size_t) read;
+            continue;
+        }
+        i += (size_t) read;
+
+        // The same overlong encoding check as in Java, including its bounds.
+        int sequence_length = to_follow + 1;
+        if ((code_point <= 0b1111111 && sequence_length > 1) || (code_point < 0b11111111111 && sequence_length > 2)
+            || (code_point < 0b1111111111111111 && sequence_length > 3)) {
+            code_point = UNICODE_REPLACEMENT_CHAR;
+        }
+
+        if (code_point >= 0x80 && code_point <= 0x9F) {
+            // A C1 control character, which is ignored as in Java.
+            continue;
+        }
+        if ((code_point >= 0xD800 && code_point <= 0xDFFF) || code_point > 0x10FFFF) {
+            // Surrogates and code points above the Unicode range, for which Character.getType() returns
+            // SURROGATE and UNASSIGNED.
+            code_point = UNICODE_REPLACEMENT_CHAR;
+        }
+        decoded[count++] = pack(code_point, 0);
+    }
+    *consumed = end;
+    return count;
+}
@@ -0,0 +1,31 @@
+#ifndef TERMUX_UTF8_DECODER_H
+#define TERMUX_UTF8_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Decoding of terminal output from UTF-8 a whole buffer at a time, with runs of ASCII widened with
+ * SIMD. Malformed input is replaced exactly as by TerminalEmulator.processByte() in Java, except for
+ * the check for unassigned code points, which is left to Character.getType() in Java.
+ *
+ * Each decoded value packs the code point with its display width from termux_wcwidth().
+ */
+
+#define UTF8_DECODED_CODE_POINT_MASK 0x1FFFFF
+#define UTF8_DECODED_WIDTH_SHIFT 21
+#define UTF8_DECODED_WIDTH_MASK 0x3
+/** The value replaces a sequence interrupted by a byte that is not a continuation byte, and is to be
+ *  sent directly to the screen instead of through the escape sequence state machine. */
+#define UTF8_DECODED_FLAG_EMIT (1 << 23)
+
+/**
+ * Decode a buffer, starting with no sequence in progress. At most one value is decoded per byte, so
+ * decoded must have room for length values. An incomplete sequence at the end of the buffer is not
+ * consumed, so that it can be completed by the next buffer.
+ *
+ * Returns the number of decoded values, and stores the number of bytes consumed in consumed.
+ */
+size_t utf8_decode(uint8_t const* data, size_t length, int32_t* decoded, size_t* consumed);
+
+#endif
@@ -0,0 +1,158 @@
+#include <string.h>
+
+#include "vt_scanner.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define VT_SCANNER_NEON 1
+#elif defined(__SSE2__)
+# include <emmintrin.h>
+# define VT_SCANNER_SSE2 1
+#endif
+
+static inline int is_printable_ascii(uint8_t b)
+{
+    return b >= 0x20 && b <= 0x7E;
+}
+
+/** If any byte of the word is below 0x20 or above 0x7E. */
+static inline int word_has_non_printable(uint64_t word)
+{
+    uint64_t const ones = 0x0101010101010101ULL;
+    uint64_t const high_bits = 0x8080808080808080ULL;
+    uint64_t below_space = (word - ones * 0x20) & ~word & high_bits;
+    uint64_t above_tilde = ((word + ones * (0x7F - 0x7E)) | word) & high_bits;
+    return (below_space | above_tilde) != 0;
+}
+
+size_t vt_printable_run_end(uint8_t const* data, size_t start, size_t length)
+{
+    size_t i = start;
+#if defined(VT_SCANNER_NEON)
+    uint8x16_t const space = vdupq_n_u8(0x20);
+    uint8x16_t const tilde = vdupq_n_u8(0x7E);
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t bytes = vld1q_u8(data + i);
+        uint64x2_t printable = vreinterpretq_u64_u8(vandq_u8(vcgeq_u8(bytes, space), vcleq_u8(bytes, tilde)));
+        if ((vgetq_lane_u64(printable, 0) & vgetq_lane_u64(printable, 1)) != UINT64_MAX) break;
+    }
+#elif defined(VT_SCANNER_SSE2)
+    // Signed comparisons, under which the bytes from 0x80 are negative and so below the space.
+    __m128i const below_space = _mm_set1_epi8(0x1F);
+    __m128i const above_tilde = _mm_set1_epi8(0x7F);
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128((__m128i const*) (data + i));
+        __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(bytes, below_space), _mm_cmplt_epi8(bytes, above_tilde));
+        if (_mm_movemask_epi8(printable) != 0xFFFF) break;
+    }
+#endif
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        if (word_has_non_printable(word)) break;
+    }
+    while (i < length && is_printable_ascii(data[i])) i++;
+    return i;
+}
+
+size_t vt_find_printable_runs(uint8_t const* data, size_t length, size_t min_run_length, int32_t* runs, size_t max_runs)
+{
+    size_t run_count = 0;
+    size_t i = 0;
+    while (i < length && run_count < max_runs) {
+        if (!is_printable_ascii(data[i])) {
+            i++;
+            continue;
+        }
+        size_t end = vt_printable_run_end(data, i, length);
+        if (end - i >= min_run_length) {
+            runs[2 * run_count] = (int32_t) i;
+            runs[2 * run_count + 1] = (int32_t) end;
+            run_count++;
+        }
+        i = end;
+    }
+    return run_count;
+}
+
+static inline int is_line_feed(uint8_t b)
+{
+    return b == '\n' || b == '\v' || b == '\f';
+}
+
+/**
+ * The length of the escape sequence starting with the ESC at data[i], or 0 if it is incomplete.
+ * Sets *sgr if it is a CSI sequence setting graphic rendition.
+ */
+static size_t escape_sequence_length(uint8_t const* data, size_t i, size_t length, int* sgr)
+{
+    size_t j = i + 1;
+    *sgr = 0;
+    if (j >= length) return 0;
+    uint8_t b = data[j];
+    if (b == '[') {
+        int digits_only = 1;
+        for (j++; j < length; j++) {
+            b = data[j];
+            // Control characters are executed within the sequence, so end it at them.
+            if (b < 0x20 || b > 0x7E) return j - i;
+            if (b >= 0x40) {
+                *sgr = digits_only && b == 'm';
+                return j + 1 - i;
+            }
+            if (!((b >= '0' && b <= '9') || b == ';' || b == ':')) digits_only = 0;
+        }
+        return 0;
+    }
+    if (b == ']' || b == 'P' || b == '_' || b == '^' || b == 'X') {
+        // String terminated by BEL or ST.
+        for (j++; j < length; j++) {
+            if (data[j] == '\a') return j + 1 - i;
+            if (data[j] == 0x1B && j + 1 < length && data[j + 1] == '\\') return j + 2 - i;
+        }
+        return 0;
+    }
+    // Intermediate bytes followed by a final byte.
+    while (b >= 0x20 && b <= 0x2F) {
+        if (++j >= length) return 0;
+        b = data[j];
+    }
+    return j + 1 - i;
+}
+
+size_t vt_find_scrolled_off_output(uint8_t const* data, size_t length, size_t line_feeds, size_t* start)
+{
+    size_t safe_start = 0;
+    size_t safe_line_feeds = 0;
+    size_t i = 0;
+    while (i < length) {
+        uint8_t b = data[i];
+        if (is_printable_ascii(b)) {
+            i = vt_printable_run_end(data, i, length);
+        } else if (b >= 0x80 || b == '\a' || b == '\t' || b == '\r') {
+            i++;
+        } else if (is_line_feed(b)) {
+            safe_line_feeds++;
+            i++;
+        } else {
+            int sgr = 0;
+            size_t next = i + 1;
+            if (b == 0x1B) {
+                size_t sequence_length = escape_sequence_length(data, i, length, &sgr);
+                next = sequence_length ? i + sequence_length : length;
+            }
+            if (!sgr) {
+                safe_start = next;
+                safe_line_feeds = 0;
+            }
+            i = next;
+        }
+    }
+
+    *start = safe_start;
+    if (line_feeds == 0 || safe_line_feeds < line_feeds) return safe_start;
+    size_t line_feeds_to_skip = safe_line_feeds - line_feeds;
+    for (i = safe_start;; i++) {
+        if (is_line_feed(data[i]) && line_feeds_to_skip-- == 0) return i;
+    }
+}
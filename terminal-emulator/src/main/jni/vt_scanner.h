@@ -0,0 +1,30 @@
+#ifndef TERMUX_VT_SCANNER_H
+#define TERMUX_VT_SCANNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Scanning of terminal output for runs of printable ASCII (0x20-0x7E), which outside of escape
+ * sequences map to one cell each and can be written to the screen in bulk. Uses NEON on ARM and
+ * SSE2 on x86, with a portable word-at-a-time fallback.
+ */
+
+/** Returns the index of the first byte at or after start which is not printable ASCII, or length. */
+size_t vt_printable_run_end(uint8_t const* data, size_t start, size_t length);
+
+/**
+ * Find the runs of at least min_run_length printable ASCII bytes, storing the start and end index
+ * of each run in runs, which has room for max_runs runs. Returns the number of runs found.
+ */
+size_t vt_find_printable_runs(uint8_t const* data, size_t length, size_t min_run_length, int32_t* runs, size_t max_runs);
+
+/**
+ * Find output which only prints and scrolls, that is printable characters, tabs, carriage returns,
+ * line feeds, bells and SGR sequences, and which is followed by at least line_feeds line feeds.
+ * Sets *start to the index after the last byte of other output, and returns the index of the line
+ * feed from which the remaining output has line_feeds line feeds, or *start if there are fewer.
+ */
+size_t vt_find_scrolled_off_output(uint8_t const* data, size_t length, size_t line_feeds, size_t* start);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef TERMUX_WCWIDTH_H
+#define TERMUX_WCWIDTH_H
+
+#include <stdint.h>
+
+/** The terminal display width of a code point: 0, 1 or 2. Same as WcWidth.width() in Java. */
+int termux_wcwidth(int32_t ucs);
+
+#endif
@@ -75,4 +75,23 @@ public class DecSetTest extends TerminalTestCase {
 		enterString("\033[?7hhij").assertLinesAre("abh", "ij ", "   ");
 	}
 
+	/** DECSET 2026, synchronized output, holds back showing the screen until the application has updated it. */
+	public void testSynchronizedUpdate() {
+		withTerminalSized(3, 3);
+		assertEquals(0, mTerminal.getSynchronizedUpdateMillisLeft());
+		assertEnteringStringGivesResponse("\033[?2026$p", "\033[?2026;2$y");
+
+		enterString("\033[?2026h");
+		long millisLeft = mTerminal.getSynchronizedUpdateMillisLeft();
+		assertTrue(millisLeft > 0 && millisLeft <= TerminalEmulator.SYNCHRONIZED_UPDATE_TIMEOUT_MILLIS);
+		assertEnteringStringGivesResponse("\033[?2026$p", "\033[?2026;1$y");
+		enterString("abc").assertLinesAre("abc", "   ", "   ");
+		enterString("\033[?2026l");
+		assertEquals(0, mTerminal.getSynchronizedUpdateMillisLeft());
+
+		enterString("\033[?2026h");
+		mTerminal.reset();
+		assertEquals("Terminal reset() should end a synchronized update", 0, mTerminal.getSynchronizedUpdateMillisLeft());
+	}
+
 }
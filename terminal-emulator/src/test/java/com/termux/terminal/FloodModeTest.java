@@ -0,0 +1,79 @@
+package com.termux.terminal;
+
+import java.nio.charset.StandardCharsets;
+
+public class FloodModeTest extends TerminalTestCase {
+
+	/** Enter the output both in and out of flood mode, and check that the screen and transcript end up the same. */
+	private void assertFloodModeDoesNotChange(int columns, int rows, String... outputs) {
+		TerminalEmulator expected = referenceTerminal(columns, rows, rows * 2, outputs);
+
+		withTerminalSized(columns, rows);
+		mTerminal.setFloodMode(true);
+		for (String output : outputs)
+			enterString(output);
+
+		TerminalBuffer expectedScreen = expected.getScreen();
+		TerminalBuffer screen = mTerminal.getScreen();
+		assertEquals(expectedScreen.getActiveTranscriptRows(), screen.getActiveTranscriptRows());
+		assertEquals(expected.getCursorRow(), mTerminal.getCursorRow());
+		assertEquals(expected.getCursorCol(), mTerminal.getCursorCol());
+		assertRowsEqual(expectedScreen, screen, -expectedScreen.getActiveTranscriptRows());
+	}
+
+	private static long scan(String output, int lineFeeds) {
+		byte[] bytes = output.getBytes(StandardCharsets.UTF_8);
+		return FloodScanner.findScrolledOffOutput(bytes, bytes.length, lineFeeds);
+	}
+
+	public void testScanner() {
+		assertEquals(5, scan("a\nb\nc\nd\n", 2));
+		// SGR sequences only print.
+		assertEquals(9, scan("a\nb\033[31mc\nd\n", 2));
+		// Other sequences may write anywhere.
+		assertEquals((7L << 32) | 8, scan("a\nb\033[2Jc\nd\ne", 2));
+		assertEquals((7L << 32) | 8, scan("a\033]0;t\007b\nc\n", 2));
+		assertEquals((2L << 32) | 5, scan("a\bb\nc\n", 1));
+		// Too few line feeds.
+		assertEquals(0, scan("a\nb\n", 3));
+		// Incomplete sequence at the end.
+		assertEquals((5L << 32) | 5, scan("x\033[31", 1));
+	}
+
+	public void testPlainLines() {
+		assertFloodModeDoesNotChange(20, 5, lines(5000, "line %d\r\n") + "last");
+	}
+
+	public void testStyledLines() {
+		assertFloodModeDoesNotChange(20, 5, lines(5000, "\033[3%2$d;4%2$dmline\t%1$d\033[m\r\n") + "\033[41m\n\n");
+	}
+
+	public void testWrappedLines() {
+		assertFloodModeDoesNotChange(7, 4, lines(3000, "a wrapped line %d\n\r"));
+		assertFloodModeDoesNotChange(7, 4, "\033[?7l" + lines(3000, "not wrapping line %d\n\r"));
+	}
+
+	public void testWideCharacters() {
+		assertFloodModeDoesNotChange(5, 3, lines(3000, "一丁丂%d\r\n"));
+	}
+
+	public void testCursorNotAtBottom() {
+		assertFloodModeDoesNotChange(10, 5, "1\r\n2\r\n3\r\n4\r\n5\033[H" + lines(3000, "line %d\r\n"));
+	}
+
+	public void testOtherSequencesInBetween() {
+		assertFloodModeDoesNotChange(10, 5, lines(3000, "line %d\r\n") + "\033[2;1Hmoved" + lines(2500, "%d\r\n"));
+		assertFloodModeDoesNotChange(10, 5, lines(3000, "line %d\r\n") + "\033[3Aup");
+		assertFloodModeDoesNotChange(10, 5, "\033[2;4r" + lines(3000, "line %d\r\n"));
+		assertFloodModeDoesNotChange(10, 5, "\033[4h" + lines(3000, "line %d\r\n"));
+	}
+
+	public void testSequenceSplitBetweenBuffers() {
+		assertFloodModeDoesNotChange(10, 5, lines(10, "%d\r\n") + "\033[", "2J" + lines(3000, "%d\r\n"));
+	}
+
+	public void testAlternateBuffer() {
+		assertFloodModeDoesNotChange(10, 5, "\033[?1049h", lines(100, "line %d\r\n") + "end");
+	}
+
+}
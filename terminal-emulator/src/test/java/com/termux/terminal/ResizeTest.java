@@ -209,4 +209,28 @@ public class ResizeTest extends TerminalTestCase {
 		resize(5, rows).assertLinesAre("ＱＲ ", "     ", "     ", "     ");
 	}
 
+	public void testHistoryReflowedLazily() {
+		String output = lines(100, "line %d\r\n");
+		TerminalEmulator expected = referenceTerminal(5, 4, null, output);
+
+		withTerminalSized(10, 4).enterString(output);
+		resize(5, 4).assertLinesAre("98   ", "line ", "99   ", "     ").assertCursorAt(3, 0);
+		TerminalBuffer screen = mTerminal.getScreen();
+		assertTrue(screen.getActiveTranscriptRows() < expected.getScreen().getActiveTranscriptRows());
+
+		int reflows = 0;
+		while (mTerminal.reflowHistory(10)) reflows++;
+		assertTrue(reflows > 1);
+		assertEquals(expected.getScreen().getActiveTranscriptRows(), screen.getActiveTranscriptRows());
+		assertRowsEqual(expected.getScreen(), screen, -screen.getActiveTranscriptRows());
+	}
+
+	public void testHistoryReflowedOntoScreen() {
+		withTerminalSized(10, 4);
+		for (int i = 0; i < 20; i++) enterString("line " + i + "\r\n");
+		enterString("\033[2J\033[H$");
+		resize(5, 4).assertLinesAre("line ", "16   ", "$    ", "     ").assertCursorAt(2, 1);
+		assertEquals("line 0", mTerminal.getScreen().getTranscriptText().substring(0, 6));
+	}
+
 }
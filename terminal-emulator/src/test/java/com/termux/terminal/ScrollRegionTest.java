@@ -109,6 +109,17 @@ public class ScrollRegionTest extends TerminalTestCase {
 		enterString("\033[3r").enterString("\033[2T").assertLinesAre("1 ", "2 ", "  ", "  ", "3 ");
 	}
 
+	public void testInsertAndDeleteLinesWithScrollRegion() {
+		withTerminalSized(2, 5).enterString("1\r\n2\r\n3\r\n4\r\n5").enterString("\033[2;4r\033[2;1H\033[44m");
+		enterString("\033[L").assertLinesAre("1 ", "  ", "2 ", "3 ", "5 ");
+		assertBackgroundColorAt(1, 1, 4);
+		enterString("\033[2M").assertLinesAre("1 ", "3 ", "  ", "  ", "5 ");
+		assertBackgroundColorAt(3, 1, 4);
+		assertBackgroundColorAt(4, 1, TextStyle.COLOR_INDEX_BACKGROUND);
+		enterString("\033[3;2HX").assertLinesAre("1 ", "3 ", " X", "  ", "5 ");
+		enterString("\033[2;1H\033M\033M").assertLinesAre("1 ", "  ", "  ", "3 ", "5 ");
+	}
+
 	public void testScrollDownBelowScrollRegion() {
 		withTerminalSized(2, 5).enterString("1\r\n2\r\n3\r\n4\r\n5").assertLinesAre("1 ", "2 ", "3 ", "4 ", "5 ");
 		enterString("\033[1;3r"); // DECSTBM margins.
@@ -0,0 +1,106 @@
+package com.termux.terminal;
+
+public class TerminalSnapshotTest extends TerminalTestCase {
+
+	private static String lineText(TerminalSnapshot snapshot, int row) {
+		TerminalRow line = snapshot.getLine(row);
+		return new String(line.mText, 0, line.getSpaceUsed());
+	}
+
+	public void testCaptureIsNotChangedByLaterOutput() {
+		withTerminalSized(3, 3).enterString("abc\r\ndef\033[1m");
+		TerminalSnapshot snapshot = new TerminalSnapshot();
+		snapshot.capture(mTerminal, 0);
+		assertEquals(3, snapshot.mRows);
+		assertEquals(3, snapshot.mColumns);
+		assertEquals(1, snapshot.mCursorRow);
+		assertEquals(2, snapshot.mCursorCol);
+		assertEquals("abc", lineText(snapshot, 0));
+		assertEquals("def", lineText(snapshot, 1));
+
+		enterString("\033[Hxyz");
+		assertLinesAre("xyz", "def", "   ");
+		assertEquals("abc", lineText(snapshot, 0));
+		assertEquals(TextStyle.NORMAL, snapshot.getLine(0).getStyle(0));
+	}
+
+	public void testCaptureOfTranscriptRows() {
+		withTerminalSized(3, 2).enterString("111222333444");
+		TerminalSnapshot snapshot = new TerminalSnapshot();
+		snapshot.capture(mTerminal, -2);
+		assertTrue(snapshot.covers(-2, 2, 3));
+		assertEquals(2, snapshot.mActiveTranscriptRows);
+		assertEquals("111", lineText(snapshot, -2));
+		assertEquals("222", lineText(snapshot, -1));
+
+		// Rows before the transcript are not available.
+		snapshot.capture(mTerminal, -5);
+		assertEquals(-2, snapshot.mTopRow);
+		assertFalse(snapshot.covers(-5, 2, 3));
+	}
+
+	public void testDamagedRows() {
+		withTerminalSized(3, 4).enterString("abc\r\ndef");
+		TerminalSnapshot snapshot = new TerminalSnapshot();
+		snapshot.capture(mTerminal, 0);
+		assertTrue(snapshot.isAllDamaged());
+		snapshot.clearDamage();
+
+		// Only moving the cursor damages no rows.
+		enterString("\033[H");
+		snapshot.capture(mTerminal, 0);
+		assertFalse(snapshot.isAllDamaged());
+		for (int row = 0; row < 4; row++) assertFalse(snapshot.isRowDamaged(row));
+
+		enterString("\033[3;1Hx");
+		snapshot.capture(mTerminal, 0);
+		assertFalse(snapshot.isRowDamaged(1));
+		assertTrue(snapshot.isRowDamaged(2));
+		snapshot.clearDamage();
+
+		// Scrolling within margins damages the rows between them.
+		enterString("\033[2;3r\033[3;1H\n");
+		snapshot.capture(mTerminal, 0);
+		assertFalse(snapshot.isRowDamaged(0));
+		assertTrue(snapshot.isRowDamaged(1));
+		assertTrue(snapshot.isRowDamaged(2));
+		assertFalse(snapshot.isRowDamaged(3));
+		snapshot.clearDamage();
+
+		// Damage is kept until the snapshot is drawn.
+		enterString("\033[1;1Hy");
+		snapshot.capture(mTerminal, 0);
+		enterString("\033[4;1Hz");
+		snapshot.capture(mTerminal, 0);
+		assertTrue(snapshot.isRowDamaged(0));
+		assertTrue(snapshot.isRowDamaged(3));
+		snapshot.clearDamage();
+
+		enterString("\033[?1049h");
+		snapshot.capture(mTerminal, 0);
+		assertTrue(snapshot.isAllDamaged());
+	}
+
+	public void testScrollCounterIsTakenOnce() {
+		withTerminalSized(3, 2).enterString("111222333");
+		TerminalSnapshot snapshot = new TerminalSnapshot();
+		snapshot.capture(mTerminal, 0);
+		enterString("444");
+		snapshot.capture(mTerminal, 0);
+		assertEquals(0, mTerminal.getScrollCounter());
+		assertEquals(2, snapshot.takeScrollCounter());
+		assertEquals(0, snapshot.takeScrollCounter());
+	}
+
+	public void testCaptureAfterResize() {
+		withTerminalSized(3, 2).enterString("abc");
+		TerminalSnapshot snapshot = new TerminalSnapshot();
+		snapshot.capture(mTerminal, 0);
+		resize(5, 3);
+		assertFalse(snapshot.covers(0, 3, 5));
+		snapshot.capture(mTerminal, 0);
+		assertTrue(snapshot.covers(0, 3, 5));
+		assertEquals("abc  ", lineText(snapshot, 0));
+	}
+
+}
@@ -347,4 +347,21 @@ public class TerminalTest extends TerminalTestCase {
 		withTerminalSized(11, 2).enterString("01234567890\033[44m\r\tXX").assertLinesAre("01234567XX0", "           ");
 	}
 
+	/** Runs of printable ASCII are written in bulk, which should behave as writing them one character at a time. */
+	public void testPrintableAsciiRuns() {
+		withTerminalSized(5, 3).enterString("abcdefghijkl").assertLinesAre("abcde", "fghij", "kl   ").assertCursorAt(2, 2);
+		assertLineWraps(true, true, false);
+		withTerminalSized(5, 3).enterString("abcdefghij").assertLinesAre("abcde", "fghij", "     ").assertCursorAt(1, 4);
+		enterString("k").assertLinesAre("abcde", "fghij", "k    ").assertCursorAt(2, 1);
+		// Without autowrap the last column is overwritten.
+		withTerminalSized(5, 3).enterString("\033[?7labcdefghij").assertLinesAre("abcdj", "     ", "     ").assertCursorAt(0, 4);
+		// A run starting inside an escape sequence.
+		withTerminalSized(10, 2).enterString("\033[31mabcdefgh").assertLinesAre("abcdefgh  ", "          ").assertCursorAt(0, 8);
+		assertForegroundIndices(effectLine(1, 1, 1, 1, 1, 1, 1, 1, 256, 256), effectLine(256, 256, 256, 256, 256, 256, 256, 256, 256, 256));
+		withTerminalSized(10, 2).enterString("\033(0qqqqqqqq").assertLinesAre("────────  ", "          ");
+		withTerminalSized(16, 2).enterString("12345678\r\033[4hABCDEFGH").assertLinesAre("ABCDEFGH12345678", "                ");
+		// Wrapping within left and right margins.
+		withTerminalSized(8, 3).enterString("\033[?69h\033[3;6s\033[1;3Habcdefghij").assertLinesAre("  abcd  ", "  efgh  ", "  ij    ").assertCursorAt(2, 4);
+	}
+
 }
@@ -57,6 +57,10 @@ public abstract class TerminalTestCase extends TestCase {
 		public void onColorsChanged() {
 			colorsChanged++;
 		}
+
+		@Override
+		public void onTerminalCursorStateChange(boolean state) {
+		}
 	}
 
 	public TerminalEmulator mTerminal;
@@ -115,6 +119,50 @@ public abstract class TerminalTestCase extends TestCase {
 		return this;
 	}
 
+	/** Format count lines, each with its line number and the line number modulo 8 as arguments. */
+	protected static String lines(int count, String format) {
+		StringBuilder builder = new StringBuilder();
+		for (int i = 0; i < count; i++)
+			builder.append(String.format(format, i, i % 8));
+		return builder.toString();
+	}
+
+	/** Create an emulator with the outputs entered, to compare {@link #mTerminal} against. */
+	protected TerminalEmulator referenceTerminal(int columns, int rows, Integer transcriptRows, String... outputs) {
+		TerminalEmulator reference = new TerminalEmulator(new MockTerminalOutput(), columns, rows, INITIAL_CELL_WIDTH_PIXELS,
+			INITIAL_CELL_HEIGHT_PIXELS, transcriptRows, null);
+		for (String output : outputs) {
+			byte[] bytes = output.getBytes(StandardCharsets.UTF_8);
+			reference.append(bytes, bytes.length);
+		}
+		return reference;
+	}
+
+	/**
+	 * Assert that the rows from firstRow, which may be in the history, to the bottom of the screen have the same text,
+	 * line wraps and styles in both buffers.
+	 */
+	protected static void assertRowsEqual(TerminalBuffer expected, TerminalBuffer actual, int firstRow) {
+		assertEquals(expected.mScreenRows, actual.mScreenRows);
+		assertRowsEqual(expected, firstRow, actual, firstRow, actual.mScreenRows - firstRow);
+	}
+
+	/** Assert that count rows from expectedFirstRow and from actualFirstRow have the same text, line wraps and styles. */
+	protected static void assertRowsEqual(TerminalBuffer expected, int expectedFirstRow, TerminalBuffer actual, int actualFirstRow, int count) {
+		assertEquals(expected.mColumns, actual.mColumns);
+		int columns = actual.mColumns;
+		for (int i = 0; i < count; i++) {
+			int expectedRow = expectedFirstRow + i, row = actualFirstRow + i;
+			assertEquals("row=" + row, expected.getSelectedText(0, expectedRow, columns, expectedRow), actual.getSelectedText(0, row, columns, row));
+			TerminalRow expectedLine = expected.getHistoryRow(expectedRow);
+			TerminalRow actualLine = actual.getHistoryRow(row);
+			assertEquals("row=" + row, expectedLine.mLineWrap, actualLine.mLineWrap);
+			assertEquals("row=" + row, expectedLine.getSpaceUsed(), actualLine.getSpaceUsed());
+			for (int column = 0; column < columns; column++)
+				assertEquals("row=" + row + ", column=" + column, expectedLine.getStyle(column), actualLine.getStyle(column));
+		}
+	}
+
 	public void assertHistoryStartsWith(String... rows) {
 		assertTrue("About to check " + rows.length + " lines, but only " + mTerminal.getScreen().getActiveTranscriptRows() + " in history",
 				mTerminal.getScreen().getActiveTranscriptRows() >= rows.length);
@@ -149,6 +197,8 @@ public abstract class TerminalTestCase extends TestCase {
 		for (int i = 0; i < lines.length; i++) {
 			if (lines[i] == null) continue;
 			assertTrue("Line exists at multiple places: " + i, linesSet.add(new LineWrapper(lines[i])));
+			// The cells of rows packed into the cell store are checked when unpacked.
+			if (lines[i].mPacked != 0) continue;
 			char[] text = lines[i].mText;
 			int usedChars = lines[i].getSpaceUsed();
 			int currentColumn = 0;
@@ -0,0 +1,97 @@
+package com.termux.terminal;
+
+import java.io.File;
+import java.io.IOException;
+
+public class TranscriptFileTest extends TerminalTestCase {
+
+	private static final int TRANSCRIPT_ROWS = TerminalEmulator.TERMINAL_TRANSCRIPT_ROWS_MIN;
+
+	private TranscriptFile mTranscriptFile;
+
+	@Override
+	protected void tearDown() throws Exception {
+		if (mTranscriptFile != null) mTranscriptFile.close();
+		super.tearDown();
+	}
+
+	/** Use a terminal with the minimum transcript rows, which spills the rest to a transcript file. */
+	private void withTranscriptFile(int columns, int rows) throws IOException {
+		mTerminal = new TerminalEmulator(mOutput, columns, rows, INITIAL_CELL_WIDTH_PIXELS, INITIAL_CELL_HEIGHT_PIXELS, TRANSCRIPT_ROWS, null);
+		mTranscriptFile = TranscriptFile.create(new File(System.getProperty("java.io.tmpdir")));
+		mTerminal.setTranscriptFile(mTranscriptFile);
+	}
+
+	/** Enter the output with a transcript file and with a transcript which is large enough, and compare the history. */
+	private void assertHistoryKept(int columns, int rows, String output) throws IOException {
+		TerminalBuffer expected = referenceTerminal(columns, rows, TerminalEmulator.TERMINAL_TRANSCRIPT_ROWS_MAX, output).getScreen();
+
+		withTranscriptFile(columns, rows);
+		enterString(output);
+		TerminalBuffer screen = mTerminal.getScreen();
+
+		assertTrue(mTranscriptFile.getRowCount() > 0);
+		assertEquals(expected.getActiveTranscriptRows(), screen.getHistoryRows());
+		assertEquals(expected.getSelectedText(0, -expected.getActiveTranscriptRows(), columns, rows),
+			screen.getSelectedText(0, -screen.getHistoryRows(), columns, rows));
+		assertRowsEqual(expected, screen, -screen.getHistoryRows());
+	}
+
+	public void testPlainLines() throws IOException {
+		assertHistoryKept(20, 5, lines(1000, "line %d\r\n") + "last");
+	}
+
+	public void testStyledAndWrappedLines() throws IOException {
+		assertHistoryKept(7, 4, lines(600, "\033[3%2$d;4%2$dma wrapped line %1$d\033[m\r\n"));
+	}
+
+	public void testWideAndCombiningCharacters() throws IOException {
+		assertHistoryKept(6, 3, lines(500, "一é丂%d\r\n"));
+	}
+
+	public void testNoFloodModeDiscarding() throws IOException {
+		withTranscriptFile(10, 5);
+		mTerminal.setFloodMode(true);
+		enterString(lines(3000, "line %d\r\n"));
+		TerminalBuffer screen = mTerminal.getScreen();
+		assertEquals("line 0", screen.getSelectedText(0, -screen.getHistoryRows(), 10, -screen.getHistoryRows()));
+	}
+
+	public void testReadWithOtherColumns() throws IOException {
+		withTranscriptFile(20, 5);
+		enterString(lines(300, "\033[1mline %d\033[m\r\n"));
+		resize(4, 5);
+		TerminalBuffer screen = mTerminal.getScreen();
+		TerminalRow oldest = screen.getHistoryRow(-screen.getHistoryRows());
+		assertEquals(4, oldest.getColumns());
+		assertEquals("line", new String(oldest.mText, 0, 4));
+		assertTrue((TextStyle.decodeEffect(oldest.getStyle(0)) & TextStyle.CHARACTER_ATTRIBUTE_BOLD) != 0);
+	}
+
+	public void testReadWithMoreColumnsAndCombiningCharacterInLastColumn() throws IOException {
+		withTranscriptFile(4, 5);
+		enterString(lines(300, "\033[1mabce\u0301\033[m\r\n"));
+		resize(6, 5);
+		TerminalBuffer screen = mTerminal.getScreen();
+		assertTrue(mTranscriptFile.getRowCount() > 0);
+		// Includes the newest row in the file, which is not followed by another record.
+		for (int row = -screen.getHistoryRows(); row < -screen.getActiveTranscriptRows(); row++) {
+			TerminalRow historyRow = screen.getHistoryRow(row);
+			assertEquals(6, historyRow.getColumns());
+			assertEquals("row=" + row, "abce\u0301", screen.getSelectedText(0, row, 6, row));
+			for (int column = 0; column < 4; column++)
+				assertTrue("row=" + row + ", column=" + column, (TextStyle.decodeEffect(historyRow.getStyle(column)) & TextStyle.CHARACTER_ATTRIBUTE_BOLD) != 0);
+			assertEquals("row=" + row, TextStyle.NORMAL, historyRow.getStyle(4));
+		}
+	}
+
+	public void testClearTranscript() throws IOException {
+		withTranscriptFile(10, 5);
+		enterString(lines(300, "line %d\r\n"));
+		assertTrue(mTerminal.getScreen().getHistoryRows() > mTerminal.getScreen().getActiveTranscriptRows());
+		enterString("\033[3J");
+		assertEquals(0, mTranscriptFile.getRowCount());
+		assertEquals(0, mTerminal.getScreen().getHistoryRows());
+	}
+
+}
@@ -0,0 +1,68 @@
+package com.termux.terminal;
+
+/**
+ * Transcript rows packed into the {@link CellStore} and compressed into cold blocks, which is only done with the native
+ * library, so these tests pass trivially without it.
+ */
+public class TranscriptPackingTest extends TerminalTestCase {
+
+	private static final int COLUMNS = 12;
+	private static final int ROWS = 4;
+
+	/** Styled, wrapped lines with wide, combining and surrogate pair characters. */
+	private static final String OUTPUT = lines(500, "\033[3%2$dm%1$d 一é😀\033[1;4%2$dm wrapped\033[m\r\n");
+
+	private void withPackingTerminal() {
+		mTerminal = new TerminalEmulator(mOutput, COLUMNS, ROWS, INITIAL_CELL_WIDTH_PIXELS, INITIAL_CELL_HEIGHT_PIXELS,
+			TerminalEmulator.DEFAULT_TERMINAL_TRANSCRIPT_ROWS, null);
+	}
+
+	private TerminalBuffer screen() {
+		return mTerminal.getScreen();
+	}
+
+	private TerminalRow transcriptRow(int externalRow) {
+		return screen().mLines[screen().externalToInternalRow(externalRow)];
+	}
+
+	/**
+	 * Assert that the history and screen have the rows of a reference emulator with room for all of them on its screen,
+	 * where they are never packed.
+	 */
+	private void assertRowsKept() {
+		int historyRows = screen().getActiveTranscriptRows();
+		TerminalBuffer expected = referenceTerminal(COLUMNS, historyRows + ROWS, TerminalEmulator.TERMINAL_TRANSCRIPT_ROWS_MAX, OUTPUT).getScreen();
+		assertEquals(0, expected.getActiveTranscriptRows());
+		assertRowsEqual(expected, 0, screen(), -historyRows, historyRows + ROWS);
+	}
+
+	public void testPackedAndCompressedRowsUnpackUnchanged() {
+		if (!CellStore.AVAILABLE) return;
+		withPackingTerminal();
+		enterString(OUTPUT);
+		int historyRows = screen().getActiveTranscriptRows();
+		assertTrue(historyRows > TerminalBuffer.COLD_DELAY_ROWS + TerminalBuffer.COLD_BLOCK_ROWS);
+
+		assertEquals(0, transcriptRow(-1).mPacked);
+		assertTrue(transcriptRow(-TerminalBuffer.PACKING_DELAY_ROWS - 1).mPacked != 0);
+		// Cold rows have the lowest bit of their handle set.
+		assertEquals(1, transcriptRow(-historyRows).mPacked & 1);
+
+		assertRowsKept();
+		// The rows unpacked by reading them are packed again in turn, and compressed again if past the cold delay.
+		assertEquals(1, transcriptRow(-historyRows).mPacked & 1);
+		assertRowsKept();
+	}
+
+	public void testClearedTranscriptWithPackedRows() {
+		if (!CellStore.AVAILABLE) return;
+		withPackingTerminal();
+		enterString(OUTPUT);
+		screen().clearTranscript();
+		assertEquals(0, screen().getActiveTranscriptRows());
+		// The screen is cleared too, so that the rows are those of the output alone.
+		enterString("\033[2J\033[H" + OUTPUT);
+		assertRowsKept();
+	}
+
+}
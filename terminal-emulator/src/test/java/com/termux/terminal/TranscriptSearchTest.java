@@ -0,0 +1,142 @@
+package com.termux.terminal;
+
+import java.util.ArrayList;
+import java.util.List;
+
+public class TranscriptSearchTest extends TerminalTestCase {
+
+	/** Search all rows of the screen and transcript, returning the matches as "row:column-row:column". */
+	private List<String> search(String pattern, int flags, int rowsPerSearch) {
+		return search(pattern, flags, rowsPerSearch, null);
+	}
+
+	/** Search as {@link #search(String, int, int)}, entering outputBetween after the first rows have been searched. */
+	private List<String> search(String pattern, int flags, int rowsPerSearch, String outputBetween) {
+		TranscriptSearch search = new TranscriptSearch(pattern, flags);
+		int searches = 0;
+		if (outputBetween != null) {
+			assertFalse(search.search(mTerminal.getScreen(), rowsPerSearch));
+			enterString(outputBetween);
+		}
+		while (!search.search(mTerminal.getScreen(), rowsPerSearch)) searches++;
+		assertTrue(searches < 100000);
+		List<String> matches = new ArrayList<>();
+		int[] range = new int[4];
+		for (int i = 0; i < search.getMatchCount(); i++) {
+			search.getMatch(i, range);
+			matches.add(range[0] + ":" + range[1] + "-" + range[2] + ":" + range[3]);
+		}
+		search.close();
+		return matches;
+	}
+
+	private static List<String> matches(String... matches) {
+		List<String> list = new ArrayList<>();
+		for (String match : matches) list.add(match);
+		return list;
+	}
+
+	public void testSubstring() {
+		withTerminalSized(10, 3).enterString("abc foo\r\nfoo\r\n  foofoo");
+		assertEquals(matches("2:2-2:5", "2:5-2:8", "1:0-1:3", "0:4-0:7"), search("foo", 0, 1000));
+		assertEquals(matches(), search("Foo", 0, 1000));
+		assertEquals(matches("2:2-2:5", "2:5-2:8", "1:0-1:3", "0:4-0:7"), search("FOO", TranscriptSearch.FLAG_IGNORE_CASE, 1000));
+	}
+
+	public void testAcrossWrappedRows() {
+		withTerminalSized(5, 3).enterString("0123456789ab");
+		assertEquals(matches("0:3-1:2"), search("3456", 0, 1000));
+		assertEquals(matches("1:4-2:1"), search("9a", 0, 1000));
+		// Rows which are not wrapped are separate lines.
+		withTerminalSized(5, 3).enterString("01234\r\n56789");
+		assertEquals(matches(), search("45", 0, 1000));
+	}
+
+	public void testTrailingSpacesOnlyInWrappedRows() {
+		withTerminalSized(5, 3).enterString("ab\r\ncd");
+		assertEquals(matches(), search("b ", 0, 1000));
+		withTerminalSized(5, 3).enterString("abc  de");
+		assertEquals(matches("0:2-0:5"), search("c  ", 0, 1000));
+	}
+
+	public void testRegex() {
+		withTerminalSized(20, 3).enterString("error: 42\r\nwarning 7\r\nERROR 3");
+		assertEquals(matches("2:0-2:7", "0:0-0:9"), search("^error:? \\d+$", TranscriptSearch.FLAG_REGEX | TranscriptSearch.FLAG_IGNORE_CASE, 1000));
+		assertEquals(matches("1:0-1:7"), search("w[a-z]+g", TranscriptSearch.FLAG_REGEX, 1000));
+	}
+
+	public void testWideCharacterColumns() {
+		withTerminalSized(10, 2).enterString("一丁x丂");
+		assertEquals(matches("0:4-0:5"), search("x", 0, 1000));
+		assertEquals(matches("0:2-0:7"), search("丁x丂", 0, 1000));
+	}
+
+	public void testIncrementalOverTranscript() {
+		withTerminalSized(10, 4);
+		StringBuilder output = new StringBuilder();
+		for (int i = 0; i < 300; i++) output.append(i % 50 == 0 ? "needle\r\n" : "hay\r\n");
+		enterString(output.toString());
+		List<String> all = search("needle", 0, 100000);
+		assertEquals(6, all.size());
+		assertEquals(all, search("needle", 0, 7));
+		assertEquals(all, search("needle", 0, 1));
+		int transcriptRows = mTerminal.getScreen().getActiveTranscriptRows();
+		assertEquals((300 - 50 - transcriptRows) + ":0-" + (300 - 50 - transcriptRows) + ":6", all.get(0));
+	}
+
+	private static String haystack(int count, String needle) {
+		StringBuilder output = new StringBuilder();
+		for (int i = 0; i < count; i++) output.append(i % 50 == 49 ? needle : "hay").append("\r\n");
+		return output.toString();
+	}
+
+	public void testRowsDroppedBetweenSearches() {
+		withTerminalSized(10, 4);
+		enterString(haystack(3000, "needle"));
+		TerminalBuffer screen = mTerminal.getScreen();
+		assertEquals(screen.mTotalRows - screen.mScreenRows, screen.getActiveTranscriptRows());
+		// The output scrolls rows out of the full transcript, moving the rows which are left up.
+		List<String> found = search("needle", 0, 10, haystack(120, "hay"));
+		assertEquals(search("needle", 0, 100000), found);
+		// The last needle was found before the output, below the 120 rows of it and the row of the cursor.
+		assertEquals("-118:0--118:6", found.get(0));
+	}
+
+	public void testTranscriptClearedBetweenSearches() {
+		withTerminalSized(10, 4);
+		enterString(haystack(300, "needle") + "needle");
+		List<String> found = search("needle", 0, 10, "\033[3J");
+		assertEquals(0, mTerminal.getScreen().getActiveTranscriptRows());
+		assertEquals(matches("3:0-3:6", "2:0-2:6"), found);
+	}
+
+	public void testCancel() {
+		withTerminalSized(10, 4);
+		StringBuilder output = new StringBuilder();
+		for (int i = 0; i < 100; i++) output.append("needle\r\n");
+		enterString(output.toString());
+		TranscriptSearch search = new TranscriptSearch("needle", 0);
+		assertFalse(search.search(mTerminal.getScreen(), 10));
+		int found = search.getMatchCount();
+		search.cancel();
+		assertTrue(search.search(mTerminal.getScreen(), 10));
+		assertEquals(found, search.getMatchCount());
+		assertFalse(search.isFinished());
+	}
+
+	public void testInvalidPattern() {
+		try {
+			new TranscriptSearch("", 0);
+			fail();
+		} catch (IllegalArgumentException e) {
+			// Expected.
+		}
+		try {
+			new TranscriptSearch("[a", TranscriptSearch.FLAG_REGEX);
+			fail();
+		} catch (IllegalArgumentException e) {
+			// Expected.
+		}
+	}
+
+}
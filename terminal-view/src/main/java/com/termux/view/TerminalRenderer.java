@@ -1,18 +1,21 @@
 package com.termux.view;
 
+import android.graphics.Bitmap;
 import android.graphics.Canvas;
 import android.graphics.Paint;
 import android.graphics.PorterDuff;
 import android.graphics.Typeface;
 
-import com.termux.terminal.TerminalBuffer;
 import com.termux.terminal.TerminalEmulator;
 import com.termux.terminal.TerminalRow;
+import com.termux.terminal.TerminalSnapshot;
 import com.termux.terminal.TextStyle;
 import com.termux.terminal.WcWidth;
 
+import java.util.Arrays;
+
 /**
- * Renderer of a {@link TerminalEmulator} into a {@link Canvas}.
+ * Renderer of a {@link TerminalSnapshot} of a {@link TerminalEmulator} into a {@link Canvas}.
  * <p/>
  * Saves font metrics, so needs to be recreated each time the typeface or font size changes.
  */
@@ -33,6 +36,16 @@ public final class TerminalRenderer {
 
     private final float[] asciiMeasures = new float[127];
 
+    /** The rows drawn by {@link #render}, kept to only draw rows which changed again. */
+    private Bitmap mBitmap;
+    private Canvas mBitmapCanvas;
+    private boolean mRetainedRowsValid;
+    /** What the rows in {@link #mBitmap} were drawn with. */
+    private int mDrawnTopRow, mDrawnRows, mDrawnColumns, mDrawnCursorStyle, mDrawnCursorRow, mDrawnCursorCol;
+    private boolean mDrawnReverseVideo;
+    private final int[] mDrawnPalette = new int[TextStyle.NUM_INDEXED_COLORS];
+    private final int[] mDrawnSelection = new int[4];
+
     public TerminalRenderer(int textSize, Typeface typeface) {
         mTextSize = textSize;
         mTypeface = typeface;
@@ -53,107 +66,173 @@ public final class TerminalRenderer {
         }
     }
 
-    /** Render the terminal to a canvas with at a specified row scroll, and an optional rectangular selection. */
-    public final void render(TerminalEmulator mEmulator, Canvas canvas, int topRow,
+    /**
+     * Render a snapshot of the terminal to a canvas with at a specified row scroll, which the snapshot has to cover, and
+     * an optional rectangular selection.
+     * <p>
+     * Rows are drawn into a bitmap retained between calls, which is then drawn to the canvas. Only rows damaged since
+     * the snapshot was last drawn, see {@link TerminalSnapshot#isRowDamaged(int)}, and rows whose cursor or selection
+     * changed are redrawn into it, unless anything else which affects all rows has changed.
+     */
+    public final void render(TerminalSnapshot snapshot, Canvas canvas, int topRow,
                              int selectionY1, int selectionY2, int selectionX1, int selectionX2) {
-        final boolean reverseVideo = mEmulator.isReverseVideo();
-        final int endRow = topRow + mEmulator.mRows;
-        final int columns = mEmulator.mColumns;
-        final int cursorCol = mEmulator.getCursorCol();
-        final int cursorRow = mEmulator.getCursorRow();
-        final boolean cursorVisible = mEmulator.shouldCursorBeVisible();
-        final TerminalBuffer screen = mEmulator.getScreen();
-        final int[] palette = mEmulator.mColors.mCurrentColors;
-        final int cursorShape = mEmulator.getCursorStyle();
-
-        if (reverseVideo)
-            canvas.drawColor(palette[TextStyle.COLOR_INDEX_FOREGROUND], PorterDuff.Mode.SRC);
-
-        float heightOffset = mFontLineSpacingAndAscent;
-        for (int row = topRow; row < endRow; row++) {
-            heightOffset += mFontLineSpacing;
+        final int width = canvas.getWidth();
+        final int height = canvas.getHeight();
+        if (width <= 0 || height <= 0) return;
+        if (mBitmap == null || mBitmap.getWidth() != width || mBitmap.getHeight() != height) {
+            mBitmap = Bitmap.createBitmap(width, height, Bitmap.Config.ARGB_8888);
+            mBitmapCanvas = new Canvas(mBitmap);
+            mRetainedRowsValid = false;
+        }
 
-            final int cursorX = (row == cursorRow && cursorVisible) ? cursorCol : -1;
-            int selx1 = -1, selx2 = -1;
-            if (row >= selectionY1 && row <= selectionY2) {
-                if (row == selectionY1) selx1 = selectionX1;
-                selx2 = (row == selectionY2) ? selectionX2 : mEmulator.mColumns;
+        final boolean cursorVisible = snapshot.shouldCursorBeVisible();
+        final int cursorRow = cursorVisible ? snapshot.mCursorRow : Integer.MIN_VALUE;
+        final boolean drawAll = !mRetainedRowsValid || snapshot.isAllDamaged() || topRow != mDrawnTopRow
+            || snapshot.mRows != mDrawnRows || snapshot.mColumns != mDrawnColumns || snapshot.mReverseVideo != mDrawnReverseVideo
+            || snapshot.mCursorStyle != mDrawnCursorStyle || !Arrays.equals(snapshot.mPalette, mDrawnPalette);
+        final boolean cursorChanged = cursorRow != mDrawnCursorRow || (cursorVisible && snapshot.mCursorCol != mDrawnCursorCol);
+        final boolean selectionChanged = selectionY1 != mDrawnSelection[0] || selectionY2 != mDrawnSelection[1]
+            || selectionX1 != mDrawnSelection[2] || selectionX2 != mDrawnSelection[3];
+
+        final int[] palette = snapshot.mPalette;
+        final int background = snapshot.mReverseVideo ? palette[TextStyle.COLOR_INDEX_FOREGROUND] : palette[TextStyle.COLOR_INDEX_BACKGROUND];
+        final Canvas bitmapCanvas = mBitmapCanvas;
+        if (drawAll) bitmapCanvas.drawColor(background, PorterDuff.Mode.SRC);
+
+        final int endRow = topRow + snapshot.mRows;
+        for (int row = topRow; row < endRow; row++) {
+            if (!drawAll && !snapshot.isRowDamaged(row)
+                && !(cursorChanged && (row == cursorRow || row == mDrawnCursorRow))
+                && !(selectionChanged && (isRowInSelection(row, selectionY1, selectionY2) || isRowInSelection(row, mDrawnSelection[0], mDrawnSelection[1]))))
+                continue;
+            final float bottom = mFontLineSpacingAndAscent + (row - topRow + 1) * mFontLineSpacing;
+            if (!drawAll) {
+                bitmapCanvas.save();
+                bitmapCanvas.clipRect(0, bottom - mFontLineSpacing, width, bottom);
+                bitmapCanvas.drawColor(background, PorterDuff.Mode.SRC);
             }
+            renderRow(snapshot, bitmapCanvas, row, bottom, selectionY1, selectionY2, selectionX1, selectionX2);
+            if (!drawAll) bitmapCanvas.restore();
+        }
+
+        snapshot.clearDamage();
+        mRetainedRowsValid = true;
+        mDrawnTopRow = topRow;
+        mDrawnRows = snapshot.mRows;
+        mDrawnColumns = snapshot.mColumns;
+        mDrawnReverseVideo = snapshot.mReverseVideo;
+        mDrawnCursorStyle = snapshot.mCursorStyle;
+        mDrawnCursorRow = cursorRow;
+        mDrawnCursorCol = snapshot.mCursorCol;
+        System.arraycopy(palette, 0, mDrawnPalette, 0, mDrawnPalette.length);
+        mDrawnSelection[0] = selectionY1;
+        mDrawnSelection[1] = selectionY2;
+        mDrawnSelection[2] = selectionX1;
+        mDrawnSelection[3] = selectionX2;
+
+        canvas.drawBitmap(mBitmap, 0, 0, null);
+    }
+
+    /** Draw all rows again on the next {@link #render}, such as after another session has been attached. */
+    public void discardRetainedRows() {
+        mRetainedRowsValid = false;
+    }
+
+    private static boolean isRowInSelection(int row, int selectionY1, int selectionY2) {
+        return row >= selectionY1 && row <= selectionY2;
+    }
+
+    /** Draw a row of the snapshot whose cells end at the given y coordinate. */
+    private void renderRow(TerminalSnapshot snapshot, Canvas canvas, int row, float heightOffset,
+                           int selectionY1, int selectionY2, int selectionX1, int selectionX2) {
+        final boolean reverseVideo = snapshot.mReverseVideo;
+        final int columns = snapshot.mColumns;
+        final int cursorCol = snapshot.mCursorCol;
+        final int cursorRow = snapshot.mCursorRow;
+        final boolean cursorVisible = snapshot.shouldCursorBeVisible();
+        final int[] palette = snapshot.mPalette;
+        final int cursorShape = snapshot.mCursorStyle;
+
+        final int cursorX = (row == cursorRow && cursorVisible) ? cursorCol : -1;
+        int selx1 = -1, selx2 = -1;
+        if (row >= selectionY1 && row <= selectionY2) {
+            if (row == selectionY1) selx1 = selectionX1;
+            selx2 = (row == selectionY2) ? selectionX2 : columns;
+        }
 
-            TerminalRow lineObject = screen.allocateFullLineIfNecessary(screen.externalToInternalRow(row));
-            final char[] line = lineObject.mText;
-            final int charsUsedInLine = lineObject.getSpaceUsed();
-
-            long lastRunStyle = 0;
-            boolean lastRunInsideCursor = false;
-            boolean lastRunInsideSelection = false;
-            int lastRunStartColumn = -1;
-            int lastRunStartIndex = 0;
-            boolean lastRunFontWidthMismatch = false;
-            int currentCharIndex = 0;
-            float measuredWidthForRun = 0.f;
-
-            for (int column = 0; column < columns; ) {
-                final char charAtIndex = line[currentCharIndex];
-                final boolean charIsHighsurrogate = Character.isHighSurrogate(charAtIndex);
-                final int charsForCodePoint = charIsHighsurrogate ? 2 : 1;
-                final int codePoint = charIsHighsurrogate ? Character.toCodePoint(charAtIndex, line[currentCharIndex + 1]) : charAtIndex;
-                final int codePointWcWidth = WcWidth.width(codePoint);
-                final boolean insideCursor = (cursorX == column || (codePointWcWidth == 2 && cursorX == column + 1));
-                final boolean insideSelection = column >= selx1 && column <= selx2;
-                final long style = lineObject.getStyle(column);
-
-                // Check if the measured text width for this code point is not the same as that expected by wcwidth().
-                // This could happen for some fonts which are not truly monospace, or for more exotic characters such as
-                // smileys which android font renders as wide.
-                // If this is detected, we draw this code point scaled to match what wcwidth() expects.
-                final float measuredCodePointWidth = (codePoint < asciiMeasures.length) ? asciiMeasures[codePoint] : mTextPaint.measureText(line,
-                    currentCharIndex, charsForCodePoint);
-                final boolean fontWidthMismatch = Math.abs(measuredCodePointWidth / mFontWidth - codePointWcWidth) > 0.01;
-
-                if (style != lastRunStyle || insideCursor != lastRunInsideCursor || insideSelection != lastRunInsideSelection || fontWidthMismatch || lastRunFontWidthMismatch) {
-                    if (column == 0) {
-                        // Skip first column as there is nothing to draw, just record the current style.
-                    } else {
-                        final int columnWidthSinceLastRun = column - lastRunStartColumn;
-                        final int charsSinceLastRun = currentCharIndex - lastRunStartIndex;
-                        int cursorColor = lastRunInsideCursor ? mEmulator.mColors.mCurrentColors[TextStyle.COLOR_INDEX_CURSOR] : 0;
-                        boolean invertCursorTextColor = false;
-                        if (lastRunInsideCursor && cursorShape == TerminalEmulator.TERMINAL_CURSOR_STYLE_BLOCK) {
-                            invertCursorTextColor = true;
-                        }
-                        drawTextRun(canvas, line, palette, heightOffset, lastRunStartColumn, columnWidthSinceLastRun,
-                            lastRunStartIndex, charsSinceLastRun, measuredWidthForRun,
-                            cursorColor, cursorShape, lastRunStyle, reverseVideo || invertCursorTextColor || lastRunInsideSelection);
+        TerminalRow lineObject = snapshot.getLine(row);
+        final char[] line = lineObject.mText;
+        final int charsUsedInLine = lineObject.getSpaceUsed();
+
+        long lastRunStyle = 0;
+        boolean lastRunInsideCursor = false;
+        boolean lastRunInsideSelection = false;
+        int lastRunStartColumn = -1;
+        int lastRunStartIndex = 0;
+        boolean lastRunFontWidthMismatch = false;
+        int currentCharIndex = 0;
+        float measuredWidthForRun = 0.f;
+
+        for (int column = 0; column < columns; ) {
+            final char charAtIndex = line[currentCharIndex];
+            final boolean charIsHighsurrogate = Character.isHighSurrogate(charAtIndex);
+            final int charsForCodePoint = charIsHighsurrogate ? 2 : 1;
+            final int codePoint = charIsHighsurrogate ? Character.toCodePoint(charAtIndex, line[currentCharIndex + 1]) : charAtIndex;
+            final int codePointWcWidth = WcWidth.width(codePoint);
+            final boolean insideCursor = (cursorX == column || (codePointWcWidth == 2 && cursorX == column + 1));
+            final boolean insideSelection = column >= selx1 && column <= selx2;
+            final long style = lineObject.getStyle(column);
+
+            // Check if the measured text width for this code point is not the same as that expected by wcwidth().
+            // This could happen for some fonts which are not truly monospace, or for more exotic characters such as
+            // smileys which android font renders as wide.
+            // If this is detected, we draw this code point scaled to match what wcwidth() expects.
+            final float measuredCodePointWidth = (codePoint < asciiMeasures.length) ? asciiMeasures[codePoint] : mTextPaint.measureText(line,
+                currentCharIndex, charsForCodePoint);
+            final boolean fontWidthMismatch = Math.abs(measuredCodePointWidth / mFontWidth - codePointWcWidth) > 0.01;
+
+            if (style != lastRunStyle || insideCursor != lastRunInsideCursor || insideSelection != lastRunInsideSelection || fontWidthMismatch || lastRunFontWidthMismatch) {
+                if (column == 0) {
+                    // Skip first column as there is nothing to draw, just record the current style.
+                } else {
+                    final int columnWidthSinceLastRun = column - lastRunStartColumn;
+                    final int charsSinceLastRun = currentCharIndex - lastRunStartIndex;
+                    int cursorColor = lastRunInsideCursor ? palette[TextStyle.COLOR_INDEX_CURSOR] : 0;
+                    boolean invertCursorTextColor = false;
+                    if (lastRunInsideCursor && cursorShape == TerminalEmulator.TERMINAL_CURSOR_STYLE_BLOCK) {
+                        invertCursorTextColor = true;
                     }
-                    measuredWidthForRun = 0.f;
-                    lastRunStyle = style;
-                    lastRunInsideCursor = insideCursor;
-                    lastRunInsideSelection = insideSelection;
-                    lastRunStartColumn = column;
-                    lastRunStartIndex = currentCharIndex;
-                    lastRunFontWidthMismatch = fontWidthMismatch;
-                }
-                measuredWidthForRun += measuredCodePointWidth;
-                column += codePointWcWidth;
-                currentCharIndex += charsForCodePoint;
-                while (currentCharIndex < charsUsedInLine && WcWidth.width(line, currentCharIndex) <= 0) {
-                    // Eat combining chars so that they are treated as part of the last non-combining code point,
-                    // instead of e.g. being considered inside the cursor in the next run.
-                    currentCharIndex += Character.isHighSurrogate(line[currentCharIndex]) ? 2 : 1;
+                    drawTextRun(canvas, line, palette, heightOffset, lastRunStartColumn, columnWidthSinceLastRun,
+                        lastRunStartIndex, charsSinceLastRun, measuredWidthForRun,
+                        cursorColor, cursorShape, lastRunStyle, reverseVideo || invertCursorTextColor || lastRunInsideSelection);
                 }
+                measuredWidthForRun = 0.f;
+                lastRunStyle = style;
+                lastRunInsideCursor = insideCursor;
+                lastRunInsideSelection = insideSelection;
+                lastRunStartColumn = column;
+                lastRunStartIndex = currentCharIndex;
+                lastRunFontWidthMismatch = fontWidthMismatch;
             }
-
-            final int columnWidthSinceLastRun = columns - lastRunStartColumn;
-            final int charsSinceLastRun = currentCharIndex - lastRunStartIndex;
-            int cursorColor = lastRunInsideCursor ? mEmulator.mColors.mCurrentColors[TextStyle.COLOR_INDEX_CURSOR] : 0;
-            boolean invertCursorTextColor = false;
-            if (lastRunInsideCursor && cursorShape == TerminalEmulator.TERMINAL_CURSOR_STYLE_BLOCK) {
-                invertCursorTextColor = true;
+            measuredWidthForRun += measuredCodePointWidth;
+            column += codePointWcWidth;
+            currentCharIndex += charsForCodePoint;
+            while (currentCharIndex < charsUsedInLine && WcWidth.width(line, currentCharIndex) <= 0) {
+                // Eat combining chars so that they are treated as part of the last non-combining code point,
+                // instead of e.g. being considered inside the cursor in the next run.
+                currentCharIndex += Character.isHighSurrogate(line[currentCharIndex]) ? 2 : 1;
             }
-            drawTextRun(canvas, line, palette, heightOffset, lastRunStartColumn, columnWidthSinceLastRun, lastRunStartIndex, charsSinceLastRun,
-                measuredWidthForRun, cursorColor, cursorShape, lastRunStyle, reverseVideo || invertCursorTextColor || lastRunInsideSelection);
         }
+
+        final int columnWidthSinceLastRun = columns - lastRunStartColumn;
+        final int charsSinceLastRun = currentCharIndex - lastRunStartIndex;
+        int cursorColor = lastRunInsideCursor ? palette[TextStyle.COLOR_INDEX_CURSOR] : 0;
+        boolean invertCursorTextColor = false;
+        if (lastRunInsideCursor && cursorShape == TerminalEmulator.TERMINAL_CURSOR_STYLE_BLOCK) {
+            invertCursorTextColor = true;
+        }
+        drawTextRun(canvas, line, palette, heightOffset, lastRunStartColumn, columnWidthSinceLastRun, lastRunStartIndex, charsSinceLastRun,
+            measuredWidthForRun, cursorColor, cursorShape, lastRunStyle, reverseVideo || invertCursorTextColor || lastRunInsideSelection);
     }
 
     private void drawTextRun(Canvas canvas, char[] text, int[] palette, float y, int startColumn, int runWidthColumns,
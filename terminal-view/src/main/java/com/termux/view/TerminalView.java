@@ -40,6 +40,7 @@ import androidx.annotation.RequiresApi;
 import com.termux.terminal.KeyHandler;
 import com.termux.terminal.TerminalEmulator;
 import com.termux.terminal.TerminalSession;
+import com.termux.terminal.TerminalSnapshot;
 import com.termux.view.textselection.TextSelectionCursorController;
 
 /** View displaying and interacting with a {@link TerminalSession}. */
@@ -50,8 +51,13 @@ public final class TerminalView extends View {
 
     /** The currently displayed terminal session, whose emulator is {@link #mEmulator}. */
     public TerminalSession mTermSession;
-    /** Our terminal emulator whose session is {@link #mTermSession}. */
+    /**
+     * Our terminal emulator whose session is {@link #mTermSession}. Output is emulated on another thread, so its screen
+     * is drawn from snapshots, and its monitor has to be held when accessing its screen directly.
+     */
     public TerminalEmulator mEmulator;
+    /** The snapshot of the screen of {@link #mEmulator} last taken from {@link #mTermSession}. */
+    private TerminalSnapshot mSnapshot;
 
     public TerminalRenderer mRenderer;
 
@@ -204,7 +210,7 @@ public final class TerminalView extends View {
                 if (mouseTrackingAtStartOfFling) {
                     mScroller.fling(0, 0, 0, -(int) (velocityY * SCALE), 0, 0, -mEmulator.mRows / 2, mEmulator.mRows / 2);
                 } else {
-                    mScroller.fling(0, mTopRow, 0, -(int) (velocityY * SCALE), 0, 0, -mEmulator.getScreen().getActiveTranscriptRows(), 0);
+                    mScroller.fling(0, mTopRow, 0, -(int) (velocityY * SCALE), 0, 0, -getActiveTranscriptRows(), 0);
                 }
 
                 post(new Runnable() {
@@ -293,7 +299,9 @@ public final class TerminalView extends View {
 
         mTermSession = session;
         mEmulator = null;
+        mSnapshot = null;
         mCombiningAccent = 0;
+        if (mRenderer != null) mRenderer.discardRetainedRows();
 
         updateSize();
 
@@ -435,19 +443,27 @@ public final class TerminalView extends View {
         };
     }
 
+    /**
+     * The number of rows of the transcript above the screen as of the last drawn snapshot, which unlike the screen
+     * buffer of the emulator may be read from the main thread without holding the emulator monitor.
+     */
+    public int getActiveTranscriptRows() {
+        return mSnapshot == null ? 0 : mSnapshot.mActiveTranscriptRows;
+    }
+
     @Override
     protected int computeVerticalScrollRange() {
-        return mEmulator == null ? 1 : mEmulator.getScreen().getActiveRows();
+        return mSnapshot == null ? 1 : mSnapshot.mActiveTranscriptRows + mSnapshot.mRows;
     }
 
     @Override
     protected int computeVerticalScrollExtent() {
-        return mEmulator == null ? 1 : mEmulator.mRows;
+        return mSnapshot == null ? 1 : mSnapshot.mRows;
     }
 
     @Override
     protected int computeVerticalScrollOffset() {
-        return mEmulator == null ? 1 : mEmulator.getScreen().getActiveRows() + mTopRow - mEmulator.mRows;
+        return mSnapshot == null ? 1 : mSnapshot.mActiveTranscriptRows + mTopRow;
     }
 
     public void onScreenUpdated() {
@@ -457,20 +473,21 @@ public final class TerminalView extends View {
     public void onScreenUpdated(boolean skipScrolling) {
         if (mEmulator == null) return;
 
-        int rowsInHistory = mEmulator.getScreen().getActiveTranscriptRows();
+        mSnapshot = mTermSession.getScreenSnapshot(mTopRow);
+        int rowsInHistory = mSnapshot.mActiveTranscriptRows;
         if (mTopRow < -rowsInHistory) mTopRow = -rowsInHistory;
+        int rowShift = mSnapshot.takeScrollCounter();
 
-        if (isSelectingText() || mEmulator.isAutoScrollDisabled()) {
+        if (isSelectingText() || mSnapshot.mAutoScrollDisabled) {
 
             // Do not scroll when selecting text.
-            int rowShift = mEmulator.getScrollCounter();
             if (-mTopRow + rowShift > rowsInHistory) {
                 // .. unless we're hitting the end of history transcript, in which
                 // case we abort text selection and scroll to end.
                 if (isSelectingText())
                     stopTextSelectionMode();
 
-                if (mEmulator.isAutoScrollDisabled()) {
+                if (mSnapshot.mAutoScrollDisabled) {
                     mTopRow = -rowsInHistory;
                     skipScrolling = true;
                 }
@@ -492,8 +509,6 @@ public final class TerminalView extends View {
             mTopRow = 0;
         }
 
-        mEmulator.clearScrollCounter();
-
         invalidate();
         if (mAccessibilityEnabled) setContentDescription(getText());
     }
@@ -582,7 +597,7 @@ public final class TerminalView extends View {
                 // e.g. less, which shifts to the alt screen without mouse handling.
                 handleKeyCode(up ? KeyEvent.KEYCODE_DPAD_UP : KeyEvent.KEYCODE_DPAD_DOWN, 0);
             } else {
-                mTopRow = Math.min(0, Math.max(-(mEmulator.getScreen().getActiveTranscriptRows()), mTopRow + (up ? -1 : 1)));
+                mTopRow = Math.min(0, Math.max(-getActiveTranscriptRows(), mTopRow + (up ? -1 : 1)));
                 if (!awakenScrollBars()) invalidate();
             }
         }
@@ -1014,7 +1029,10 @@ public final class TerminalView extends View {
                 mTextSelectionCursorController.getSelectors(sel);
             }
 
-            mRenderer.render(mEmulator, canvas, mTopRow, sel[0], sel[1], sel[2], sel[3]);
+            // Drawn from a snapshot, so that the emulator can keep processing output meanwhile. It is drawn from its own
+            // top row, which is another one than mTopRow while kept during a synchronized update of the screen.
+            mSnapshot = mTermSession.getScreenSnapshot(mTopRow);
+            mRenderer.render(mSnapshot, canvas, mSnapshot.mTopRow, sel[0], sel[1], sel[2], sel[3]);
 
             // render the text selection handles
             renderTextSelection();
@@ -1026,7 +1044,9 @@ public final class TerminalView extends View {
     }
 
     private CharSequence getText() {
-        return mEmulator.getScreen().getSelectedText(0, mTopRow, mEmulator.mColumns, mTopRow + mEmulator.mRows);
+        synchronized (mEmulator) {
+            return mEmulator.getScreen().getSelectedText(0, mTopRow, mEmulator.mColumns, mTopRow + mEmulator.mRows);
+        }
     }
 
     public int getCursorX(float x) {
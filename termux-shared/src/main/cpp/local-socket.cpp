@@ -1,13 +1,23 @@
 #include <cstdio>
 #include <ctime>
 #include <cerrno>
+#include <algorithm>
+#include <climits>
+#include <deque>
+#include <fcntl.h>
 #include <jni.h>
+#include <mutex>
+#include <poll.h>
 #include <sstream>
 #include <string>
 #include <unistd.h>
+#include <unordered_map>
+#include <vector>
 
 #include <android/log.h>
 
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -128,6 +138,13 @@ int64_t timespec_to_milliseconds(const struct timespec* const time) {
     return (((int64_t)time->tv_sec) * 1000) + (((int64_t)time->tv_nsec)/1000000);
 }
 
+/* Get the monotonic time in milliseconds. */
+int64_t monotonic_milliseconds() {
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return timespec_to_milliseconds(&time);
+}
+
 /* Convert milliseconds to timeval. */
 timeval milliseconds_to_timeval(int milliseconds) {
     struct timeval tv = {};
@@ -154,6 +171,23 @@ bool checkJniException(JNIEnv *env) {
     return false;
 }
 
+/*
+ * The classes, methods and fields used for every call, looked up once by JNI_OnLoad() instead of
+ * on each call. If a lookup fails there, it is done on each call instead.
+ */
+struct JniCache {
+    jclass jniResultClass;
+    jmethodID jniResultConstructor;
+    jclass peerCredClass;
+    jfieldID peerCredPid;
+    jfieldID peerCredUid;
+    jfieldID peerCredGid;
+    jfieldID peerCredPname;
+    jfieldID peerCredCmdline;
+};
+
+static JniCache jniCache = {};
+
 string getJniResultString(const int retvalParam, const int errnoParam,
                           string errmsgParam, const int intDataParam) {
     return "retval=" + to_string(retvalParam) + ", errno=" + to_string(errnoParam) +
@@ -163,8 +197,12 @@ string getJniResultString(const int retvalParam, const int errnoParam,
 /* Get "com/termux/shared/jni/models/JniResult" object that can be returned as result for a JNI call. */
 jobject getJniResult(JNIEnv *env, jstring title, const int retvalParam, const int errnoParam,
                      string errmsgParam, const int intDataParam) {
-    jclass clazz = env->FindClass("com/termux/shared/jni/models/JniResult");
-    if (checkJniException(env)) return NULL;
+    jclass clazz = jniCache.jniResultClass;
+    jmethodID constructor = jniCache.jniResultConstructor;
+    if (!clazz || !constructor) {
+        clazz = env->FindClass("com/termux/shared/jni/models/JniResult");
+        if (checkJniException(env)) return NULL;
+    }
     if (!clazz) {
         log_error(get_title_and_message(env, title,
                                         "Failed to find JniResult class to create object for " +
@@ -172,8 +210,10 @@ jobject getJniResult(JNIEnv *env, jstring title, const int retvalParam, const in
         return NULL;
     }
 
-    jmethodID constructor = env->GetMethodID(clazz, "<init>", "(IILjava/lang/String;I)V");
-    if (checkJniException(env)) return NULL;
+    if (!constructor) {
+        constructor = env->GetMethodID(clazz, "<init>", "(IILjava/lang/String;I)V");
+        if (checkJniException(env)) return NULL;
+    }
     if (!constructor) {
         log_error(get_title_and_message(env, title,
                                         "Failed to get constructor for JniResult class to create object for " +
@@ -218,10 +258,13 @@ jobject getJniResult(JNIEnv *env, jstring title) {
 }
 
 
-/* Set int fieldName field for clazz to value. */
-string setIntField(JNIEnv *env, jobject obj, jclass clazz, const string fieldName, const int value) {
-    jfieldID field = env->GetFieldID(clazz, fieldName.c_str(), "I");
-    if (checkJniException(env)) return JNI_EXCEPTION;
+/* Set int fieldName field for clazz to value. The field is looked up if not passed. */
+string setIntField(JNIEnv *env, jobject obj, jclass clazz, const string fieldName, const int value,
+                   jfieldID field = nullptr) {
+    if (!field) {
+        field = env->GetFieldID(clazz, fieldName.c_str(), "I");
+        if (checkJniException(env)) return JNI_EXCEPTION;
+    }
     if (!field) {
         return "Failed to get int \"" + string(fieldName) + "\" field of \"" +
                get_class_name(env, clazz) + "\" class to set value \"" + to_string(value) + "\"";
@@ -233,10 +276,13 @@ string setIntField(JNIEnv *env, jobject obj, jclass clazz, const string fieldNam
     return "";
 }
 
-/* Set String fieldName field for clazz to value. */
-string setStringField(JNIEnv *env, jobject obj, jclass clazz, const string fieldName, const string value) {
-    jfieldID field = env->GetFieldID(clazz, fieldName.c_str(), "Ljava/lang/String;");
-    if (checkJniException(env)) return JNI_EXCEPTION;
+/* Set String fieldName field for clazz to value. The field is looked up if not passed. */
+string setStringField(JNIEnv *env, jobject obj, jclass clazz, const string fieldName, const string value,
+                      jfieldID field = nullptr) {
+    if (!field) {
+        field = env->GetFieldID(clazz, fieldName.c_str(), "Ljava/lang/String;");
+        if (checkJniException(env)) return JNI_EXCEPTION;
+    }
     if (!field) {
         return "Failed to get String \"" + string(fieldName) + "\" field of \"" +
                get_class_name(env, clazz) + "\" class to set value \"" + value + "\"";
@@ -249,6 +295,59 @@ string setStringField(JNIEnv *env, jobject obj, jclass clazz, const string field
 }
 
 
+/* Get a global reference to a class, or nullptr with any exception cleared if it is not found. */
+jclass find_global_class(JNIEnv *env, const char *name) {
+    jclass clazz = env->FindClass(name);
+    if (env->ExceptionCheck() || !clazz) {
+        env->ExceptionClear();
+        return nullptr;
+    }
+    jclass globalClazz = (jclass) env->NewGlobalRef(clazz);
+    env->DeleteLocalRef(clazz);
+    return globalClazz;
+}
+
+/* Get a field of clazz, or nullptr with any exception cleared if it is not found. */
+jfieldID find_field(JNIEnv *env, jclass clazz, const char *name, const char *signature) {
+    if (!clazz) return nullptr;
+    jfieldID field = env->GetFieldID(clazz, name, signature);
+    if (env->ExceptionCheck() || !field) {
+        env->ExceptionClear();
+        return nullptr;
+    }
+    return field;
+}
+
+/*
+ * Fill jniCache when the library is loaded. This runs with the class loader of the app, so
+ * the app classes can be found, unlike from threads attached later.
+ */
+extern "C"
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
+    JNIEnv *env;
+    if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) != JNI_OK)
+        return JNI_ERR;
+
+    jniCache.jniResultClass = find_global_class(env, "com/termux/shared/jni/models/JniResult");
+    if (jniCache.jniResultClass) {
+        jniCache.jniResultConstructor = env->GetMethodID(jniCache.jniResultClass, "<init>", "(IILjava/lang/String;I)V");
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+            jniCache.jniResultConstructor = nullptr;
+        }
+    }
+
+    jniCache.peerCredClass = find_global_class(env, "com/termux/shared/net/socket/local/PeerCred");
+    jniCache.peerCredPid = find_field(env, jniCache.peerCredClass, "pid", "I");
+    jniCache.peerCredUid = find_field(env, jniCache.peerCredClass, "uid", "I");
+    jniCache.peerCredGid = find_field(env, jniCache.peerCredClass, "gid", "I");
+    jniCache.peerCredPname = find_field(env, jniCache.peerCredClass, "pname", "Ljava/lang/String;");
+    jniCache.peerCredCmdline = find_field(env, jniCache.peerCredClass, "cmdline", "Ljava/lang/String;");
+
+    return JNI_VERSION_1_6;
+}
+
+
 
 extern "C"
 JNIEXPORT jobject JNICALL
@@ -348,63 +447,307 @@ Java_com_termux_shared_net_socket_local_LocalSocketManager_acceptNative(JNIEnv *
     return getJniResult(env, logTitle, clientFd);
 }
 
-extern "C"
-JNIEXPORT jobject JNICALL
-Java_com_termux_shared_net_socket_local_LocalSocketManager_readNative(JNIEnv *env, jclass clazz,
-                                                                      jstring logTitle,
-                                                                      jint fd, jbyteArray dataArray,
-                                                                      jlong deadline) {
-    if (fd < 0) {
-        return getJniResult(env, logTitle, -1, "readNative(): Invalid fd \"" + to_string(fd) + "\" passed");
-    }
+/*
+ * The error of a failed read or send. The fast path calls keep the error of their last failure on
+ * each thread, and it is only converted to a JniResult if getLastErrorNative() is called.
+ */
+struct LocalSocketError {
+    int errnoValue;
+    string errmsg;
+    /* The bytes read or sent before the failure. */
+    int bytesTransferred;
+};
+
+static thread_local LocalSocketError lastError;
+
+/* Returned by the read and send functions if a JNI exception is pending. */
+#define SOCKET_IO_JNI_EXCEPTION -2
+/* The socket timeout of an fd before it has been got with getsockopt(). */
+#define SOCKET_TIMEOUT_UNKNOWN -2
+
+/* Set error to errmsg, with the strerror() message of errnoParam appended if it is not 0, and return -1. */
+int set_error(LocalSocketError *error, const int errnoParam, const string &errmsg, const int bytesTransferred = 0) {
+    error->errnoValue = errnoParam;
+    error->errmsg = errnoParam != 0 ? errmsg + ": " + string(strerror(errnoParam)) : errmsg;
+    error->bytesTransferred = bytesTransferred;
+    return -1;
+}
 
-    jbyte* data = env->GetByteArrayElements(dataArray, nullptr);
-    if (checkJniException(env)) return NULL;
-    if (data == nullptr) {
-        return getJniResult(env, logTitle, -1, "readNative(): data passed is null");
-    }
+/* Set error for the deadline in milliseconds since epoch having passed, and return -1. */
+int set_deadline_error(LocalSocketError *error, const char *function, const int64_t deadline, const int bytesTransferred) {
+    return set_error(error, 0, string(function) + "(): Deadline \"" + to_string(deadline) + "\" timeout after " +
+                               to_string(bytesTransferred) + " bytes", bytesTransferred);
+}
+
+/*
+ * Convert a deadline in milliseconds since epoch to milliseconds on the monotonic clock, so that
+ * changes of the wall clock while reading or sending do not cause or prevent a timeout.
+ * Returns 0 for no deadline if deadline is <= 0.
+ */
+int64_t to_monotonic_deadline(JNIEnv *env, jstring logTitle, const char *function, const int64_t deadline) {
+    if (deadline <= 0)
+        return 0;
 
     struct timespec time = {};
-    jbyte* current = data;
-    int bytes = env->GetArrayLength(dataArray);
-    if (checkJniException(env)) return NULL;
-    int bytesRead = 0;
-    while (bytesRead < bytes) {
-        if (deadline > 0) {
-            if (clock_gettime(CLOCK_REALTIME, &time) != -1) {
-                // If current time is greater than the time defined in deadline
-                if (timespec_to_milliseconds(&time) > deadline) {
-                    env->ReleaseByteArrayElements(dataArray, data, 0);
-                    if (checkJniException(env)) return NULL;
-                    return getJniResult(env, logTitle, -1,
-                                        "readNative(): Deadline \"" + to_string(deadline) + "\" timeout");
-                }
-            } else {
-                log_warn(get_title_and_message(env, logTitle,
-                                               "readNative(): Deadline \"" + to_string(deadline) +
-                                               "\" timeout will not work since failed to get current time"));
-            }
-        }
+    if (clock_gettime(CLOCK_REALTIME, &time) == -1) {
+        log_warn(get_title_and_message(env, logTitle,
+                                       string(function) + "(): Deadline \"" + to_string(deadline) +
+                                       "\" timeout will not work since failed to get current time"));
+        return 0;
+    }
+
+    return max<int64_t>(1, monotonic_milliseconds() + deadline - timespec_to_milliseconds(&time));
+}
+
+/* Get the SO_RCVTIMEO or SO_SNDTIMEO timeout of fd in milliseconds, or 0 if it has none. */
+int get_socket_timeout(const int fd, const int option) {
+    struct timeval tv = {};
+    socklen_t len = sizeof(tv);
+    if (getsockopt(fd, SOL_SOCKET, option, &tv, &len) == -1)
+        return 0;
+    return (int) min<int64_t>(INT_MAX, ((int64_t) tv.tv_sec) * 1000 + tv.tv_usec / 1000);
+}
 
-        // Read data from socket
-        int ret = read(fd, current, bytes);
+/*
+ * Wait with poll() until fd can be read from or sent to without blocking. The wait is bounded by the
+ * monotonic deadline and by the SO_RCVTIMEO or SO_SNDTIMEO timeout of fd, which a blocking call
+ * would have waited for, which is got once for each read or send in socketTimeout.
+ * Returns 0 if fd is ready, or -1 with error set if waiting failed or timed out.
+ */
+int wait_socket(const char *function, const int fd, const bool reading, const int64_t monotonicDeadline,
+                const int64_t deadline, int *socketTimeout, const int bytesTransferred, LocalSocketError *error) {
+    if (*socketTimeout == SOCKET_TIMEOUT_UNKNOWN)
+        *socketTimeout = get_socket_timeout(fd, reading ? SO_RCVTIMEO : SO_SNDTIMEO);
+
+    const int64_t start = monotonic_milliseconds();
+    while (true) {
+        int64_t now = monotonic_milliseconds();
+        int64_t deadlineLeft = monotonicDeadline > 0 ? monotonicDeadline - now : INT64_MAX;
+        if (deadlineLeft <= 0)
+            return set_deadline_error(error, function, deadline, bytesTransferred);
+        int64_t socketTimeoutLeft = *socketTimeout > 0 ? start + *socketTimeout - now : INT64_MAX;
+        if (socketTimeoutLeft <= 0)
+            return set_error(error, EAGAIN, string(function) + "(): Failed to " + (reading ? "read" : "send") +
+                                            " on fd " + to_string(fd) + " after " + to_string(bytesTransferred) + " bytes",
+                             bytesTransferred);
+
+        int64_t timeout = min(deadlineLeft, socketTimeoutLeft);
+        struct pollfd pollFd = {.fd = fd, .events = (short) (reading ? POLLIN : POLLOUT)};
+        int ret = poll(&pollFd, 1, timeout == INT64_MAX ? -1 : (int) min<int64_t>(timeout, INT_MAX));
         if (ret == -1) {
-            int errnoBackup = errno;
-            env->ReleaseByteArrayElements(dataArray, data, 0);
-            if (checkJniException(env)) return NULL;
-            return getJniResult(env, logTitle, -1, errnoBackup, "readNative(): Failed to read on fd "  + to_string(fd));
+            if (errno == EINTR) continue;
+            return set_error(error, errno, string(function) + "(): Failed to wait for fd " + to_string(fd), bytesTransferred);
+        }
+        // Errors and hangups are reported by the next read or send
+        if (ret > 0)
+            return 0;
+    }
+}
+
+/*
+ * Read or send length bytes with transfer, which does a non-blocking recv() or send() of the bytes
+ * after the bytes transferred so far, and wait with wait_socket() whenever fd would block.
+ * Reading stops early at EOF.
+ * Returns the bytes transferred, -1 with error set if transferring failed or the deadline passed,
+ * or SOCKET_IO_JNI_EXCEPTION.
+ */
+template <typename Transfer>
+int transfer_socket(JNIEnv *env, jstring logTitle, const char *function, const int fd, const bool reading,
+                    const int length, const int64_t deadline, LocalSocketError *error, Transfer transfer) {
+    const int64_t monotonicDeadline = to_monotonic_deadline(env, logTitle, function, deadline);
+    int socketTimeout = SOCKET_TIMEOUT_UNKNOWN;
+    int bytesTransferred = 0;
+    while (bytesTransferred < length) {
+        if (monotonicDeadline > 0 && monotonic_milliseconds() >= monotonicDeadline)
+            return set_deadline_error(error, function, deadline, bytesTransferred);
+
+        int ret = transfer(bytesTransferred);
+        if (ret == SOCKET_IO_JNI_EXCEPTION) return ret;
+        if (ret > 0) {
+            bytesTransferred += ret;
+            continue;
         }
         // EOF, peer closed writing end
         if (ret == 0) {
-            break;
+            if (reading) break;
+            continue;
         }
 
-        bytesRead += ret;
-        current += ret;
+        if (errno == EINTR)
+            continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            return set_error(error, errno, string(function) + "(): Failed to " + (reading ? "read" : "send") +
+                                           " on fd " + to_string(fd) + " after " + to_string(bytesTransferred) + " bytes",
+                             bytesTransferred);
+
+        ret = wait_socket(function, fd, reading, monotonicDeadline, deadline, &socketTimeout, bytesTransferred, error);
+        if (ret != 0) return ret;
     }
 
-    env->ReleaseByteArrayElements(dataArray, data, 0);
+    return bytesTransferred;
+}
+
+/* Check that fd is valid and that offset and length are within data of dataLength bytes. */
+int check_socket_io_args(const char *function, const int fd, const bool hasData, const int64_t dataLength,
+                         const int offset, const int length, LocalSocketError *error) {
+    if (fd < 0)
+        return set_error(error, 0, string(function) + "(): Invalid fd \"" + to_string(fd) + "\" passed");
+
+    if (!hasData)
+        return set_error(error, 0, string(function) + "(): data passed is null");
+
+    if (offset < 0 || length < 0 || offset > dataLength - length)
+        return set_error(error, 0, string(function) + "(): Offset \"" + to_string(offset) + "\" and length \"" +
+                                   to_string(length) + "\" passed are not within data of length \"" + to_string(dataLength) + "\"");
+
+    return 0;
+}
+
+/* Check that fd and dataArray are valid and that offset and length are within dataArray. */
+int check_socket_io_array_args(JNIEnv *env, const char *function, const int fd, jbyteArray dataArray,
+                               const int offset, const int length, LocalSocketError *error) {
+    int arrayLength = 0;
+    if (dataArray != nullptr) {
+        arrayLength = env->GetArrayLength(dataArray);
+        if (checkJniException(env)) return SOCKET_IO_JNI_EXCEPTION;
+    }
+    return check_socket_io_args(function, fd, dataArray != nullptr, arrayLength, offset, length, error);
+}
+
+/*
+ * Make sure an exception is pending after GetPrimitiveArrayCritical() returned null, which it may
+ * do without throwing one, and return SOCKET_IO_JNI_EXCEPTION.
+ */
+int throw_array_critical_failed(JNIEnv *env, const char *function) {
+    if (!checkJniException(env)) {
+        jclass outOfMemoryErrorClass = env->FindClass("java/lang/OutOfMemoryError");
+        if (outOfMemoryErrorClass != nullptr)
+            env->ThrowNew(outOfMemoryErrorClass, (string(function) + "(): Failed to get elements of data passed").c_str());
+    }
+    return SOCKET_IO_JNI_EXCEPTION;
+}
+
+/*
+ * Read from fd into length bytes of dataArray starting at offset until they are full or EOF.
+ * Returns the bytes read, -1 with error set if reading failed or the deadline passed, or
+ * SOCKET_IO_JNI_EXCEPTION.
+ *
+ * Data is read straight into the array while it is held with GetPrimitiveArrayCritical(), which
+ * does not copy it on ART. Since the GC may be held off while in a critical region, only
+ * non-blocking reads are done there, and waiting for data is done outside of it.
+ */
+int read_socket(JNIEnv *env, jstring logTitle, const char *function, const int fd, jbyteArray dataArray,
+                const int offset, const int length, const int64_t deadline, LocalSocketError *error) {
+    int ret = check_socket_io_array_args(env, function, fd, dataArray, offset, length, error);
+    if (ret != 0) return ret;
+
+    return transfer_socket(env, logTitle, function, fd, true, length, deadline, error, [&](int bytesRead) {
+        jbyte *data = (jbyte *) env->GetPrimitiveArrayCritical(dataArray, nullptr);
+        if (data == nullptr)
+            return throw_array_critical_failed(env, function);
+        int bytes = recv(fd, data + offset + bytesRead, length - bytesRead, MSG_DONTWAIT);
+        int errnoBackup = errno;
+        env->ReleasePrimitiveArrayCritical(dataArray, data, bytes > 0 ? 0 : JNI_ABORT);
+        errno = errnoBackup;
+        return bytes;
+    });
+}
+
+/*
+ * Send length bytes of dataArray starting at offset to fd.
+ * Returns 0, -1 with error set if sending failed or the deadline passed, or SOCKET_IO_JNI_EXCEPTION.
+ *
+ * Like read_socket(), data is sent straight from the array with non-blocking sends while it is
+ * held with GetPrimitiveArrayCritical().
+ */
+int send_socket(JNIEnv *env, jstring logTitle, const char *function, const int fd, jbyteArray dataArray,
+                const int offset, const int length, const int64_t deadline, LocalSocketError *error) {
+    int ret = check_socket_io_array_args(env, function, fd, dataArray, offset, length, error);
+    if (ret != 0) return ret;
+
+    ret = transfer_socket(env, logTitle, function, fd, false, length, deadline, error, [&](int bytesSent) {
+        jbyte *data = (jbyte *) env->GetPrimitiveArrayCritical(dataArray, nullptr);
+        if (data == nullptr)
+            return throw_array_critical_failed(env, function);
+        int bytes = send(fd, data + offset + bytesSent, length - bytesSent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        int errnoBackup = errno;
+        env->ReleasePrimitiveArrayCritical(dataArray, data, JNI_ABORT);
+        errno = errnoBackup;
+        return bytes;
+    });
+    return ret < 0 ? ret : 0;
+}
+
+/* Get the address of direct buffer, or nullptr if it is not a direct buffer, and set capacity to its capacity. */
+jbyte *get_direct_buffer(JNIEnv *env, jobject buffer, int64_t *capacity) {
+    *capacity = 0;
+    if (buffer == nullptr) return nullptr;
+    jbyte *address = (jbyte *) env->GetDirectBufferAddress(buffer);
+    if (address != nullptr)
+        *capacity = env->GetDirectBufferCapacity(buffer);
+    return address;
+}
+
+/*
+ * Read from fd into length bytes of the direct buffer starting at offset until they are full or
+ * EOF, with no copies. Returns the bytes read, or -1 with error set if reading failed or the
+ * deadline passed.
+ */
+int read_socket_direct(JNIEnv *env, const char *function, const int fd, jobject buffer,
+                       const int offset, const int length, const int64_t deadline, LocalSocketError *error) {
+    int64_t capacity;
+    jbyte *data = get_direct_buffer(env, buffer, &capacity);
+    int ret = check_socket_io_args(function, fd, data != nullptr, capacity, offset, length, error);
+    if (ret != 0) return ret;
+
+    return transfer_socket(env, nullptr, function, fd, true, length, deadline, error, [&](int bytesRead) {
+        return (int) recv(fd, data + offset + bytesRead, length - bytesRead, MSG_DONTWAIT);
+    });
+}
+
+/*
+ * Send length bytes of the direct buffer starting at offset to fd, with no copies.
+ * Returns 0, or -1 with error set if sending failed or the deadline passed.
+ */
+int send_socket_direct(JNIEnv *env, const char *function, const int fd, jobject buffer,
+                       const int offset, const int length, const int64_t deadline, LocalSocketError *error) {
+    int64_t capacity;
+    jbyte *data = get_direct_buffer(env, buffer, &capacity);
+    int ret = check_socket_io_args(function, fd, data != nullptr, capacity, offset, length, error);
+    if (ret != 0) return ret;
+
+    ret = transfer_socket(env, nullptr, function, fd, false, length, deadline, error, [&](int bytesSent) {
+        return (int) send(fd, data + offset + bytesSent, length - bytesSent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    });
+    return ret < 0 ? ret : 0;
+}
+
+/* Get the number of unread bytes in the receive buffer of fd, or -1 with error set. */
+int available_socket(const char *function, const int fd, LocalSocketError *error) {
+    if (fd < 0)
+        return set_error(error, 0, string(function) + "(): Invalid fd \"" + to_string(fd) + "\" passed");
+
+    int available = 0;
+    if (ioctl(fd, SIOCINQ, &available) == -1)
+        return set_error(error, errno, string(function) + "(): Failed to get number of unread bytes in the receive buffer of fd " + to_string(fd));
+
+    return available;
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_readNative(JNIEnv *env, jclass clazz,
+                                                                      jstring logTitle,
+                                                                      jint fd, jbyteArray dataArray,
+                                                                      jlong deadline) {
+    LocalSocketError error = {};
+    int length = dataArray != nullptr ? env->GetArrayLength(dataArray) : 0;
     if (checkJniException(env)) return NULL;
+    int bytesRead = read_socket(env, logTitle, "readNative", fd, dataArray, 0, length, deadline, &error);
+    if (bytesRead == SOCKET_IO_JNI_EXCEPTION) return NULL;
+    if (bytesRead == -1) {
+        return getJniResult(env, logTitle, -1, error.errnoValue, error.errmsg, error.bytesTransferred);
+    }
 
     // Return success and bytes read in JniResult.intData field
     return getJniResult(env, logTitle, bytesRead);
@@ -417,73 +760,266 @@ Java_com_termux_shared_net_socket_local_LocalSocketManager_sendNative(JNIEnv *en
                                                                       jstring logTitle,
                                                                       jint fd, jbyteArray dataArray,
                                                                       jlong deadline) {
-    if (fd < 0) {
-        return getJniResult(env, logTitle, -1, "sendNative(): Invalid fd \"" + to_string(fd) + "\" passed");
+    LocalSocketError error = {};
+    int length = dataArray != nullptr ? env->GetArrayLength(dataArray) : 0;
+    if (checkJniException(env)) return NULL;
+    int ret = send_socket(env, logTitle, "sendNative", fd, dataArray, 0, length, deadline, &error);
+    if (ret == SOCKET_IO_JNI_EXCEPTION) return NULL;
+    if (ret == -1) {
+        return getJniResult(env, logTitle, -1, error.errnoValue, error.errmsg, error.bytesTransferred);
     }
 
-    jbyte* data = env->GetByteArrayElements(dataArray, nullptr);
-    if (checkJniException(env)) return NULL;
-    if (data == nullptr) {
-        return getJniResult(env, logTitle, -1, "sendNative(): data passed is null");
+    // Return success
+    return getJniResult(env, logTitle);
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_availableNative(JNIEnv *env, jclass clazz,
+                                                                           jstring logTitle, jint fd) {
+    LocalSocketError error = {};
+    int available = available_socket("availableNative", fd, &error);
+    if (available == -1) {
+        return getJniResult(env, logTitle, -1, error.errnoValue, error.errmsg, 0);
     }
 
-    struct timespec time = {};
-    jbyte* current = data;
-    int bytes = env->GetArrayLength(dataArray);
-    if (checkJniException(env)) return NULL;
-    while (bytes > 0) {
-        if (deadline > 0) {
-            if (clock_gettime(CLOCK_REALTIME, &time) != -1) {
-                // If current time is greater than the time defined in deadline
-                if (timespec_to_milliseconds(&time) > deadline) {
-                    env->ReleaseByteArrayElements(dataArray, data, JNI_ABORT);
-                    if (checkJniException(env)) return NULL;
-                    return getJniResult(env, logTitle, -1,
-                                        "sendNative(): Deadline \"" + to_string(deadline) + "\" timeout");
-                }
-            } else {
-                log_warn(get_title_and_message(env, logTitle,
-                                               "sendNative(): Deadline \"" + to_string(deadline) +
-                                               "\" timeout will not work since failed to get current time"));
-            }
-        }
+    // Return success and bytes available in JniResult.intData field
+    return getJniResult(env, logTitle, available);
+}
 
-        // Send data to socket
-        int ret = send(fd, current, bytes, MSG_NOSIGNAL);
-        if (ret == -1) {
-            int errnoBackup = errno;
-            env->ReleaseByteArrayElements(dataArray, data, JNI_ABORT);
-            if (checkJniException(env)) return NULL;
-            return getJniResult(env, logTitle, -1, errnoBackup, "sendNative(): Failed to send on fd " + to_string(fd));
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_readFastNative(JNIEnv *env, jclass clazz,
+                                                                          jint fd, jbyteArray dataArray,
+                                                                          jint offset, jint length,
+                                                                          jlong deadline) {
+    return read_socket(env, nullptr, "readFastNative", fd, dataArray, offset, length, deadline, &lastError);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_sendFastNative(JNIEnv *env, jclass clazz,
+                                                                          jint fd, jbyteArray dataArray,
+                                                                          jint offset, jint length,
+                                                                          jlong deadline) {
+    return send_socket(env, nullptr, "sendFastNative", fd, dataArray, offset, length, deadline, &lastError);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_availableFastNative(JNIEnv *env, jclass clazz,
+                                                                               jint fd) {
+    return available_socket("availableFastNative", fd, &lastError);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_readDirectNative(JNIEnv *env, jclass clazz,
+                                                                            jint fd, jobject buffer,
+                                                                            jint offset, jint length,
+                                                                            jlong deadline) {
+    return read_socket_direct(env, "readDirectNative", fd, buffer, offset, length, deadline, &lastError);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_sendDirectNative(JNIEnv *env, jclass clazz,
+                                                                            jint fd, jobject buffer,
+                                                                            jint offset, jint length,
+                                                                            jlong deadline) {
+    return send_socket_direct(env, "sendDirectNative", fd, buffer, offset, length, deadline, &lastError);
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_getLastErrorNative(JNIEnv *env, jclass clazz,
+                                                                              jstring logTitle) {
+    return getJniResult(env, logTitle, -1, lastError.errnoValue, lastError.errmsg, lastError.bytesTransferred);
+}
+
+/* The max number of fds that can be passed in one message, SCM_MAX_FD of the kernel. */
+#define MAX_PASSED_FDS 253
+
+/* Check that fd is valid and that fdsArray has 1 to MAX_PASSED_FDS fds, and set fdCount to their number. */
+int check_fds_args(JNIEnv *env, const char *function, const int fd, jintArray fdsArray, int *fdCount,
+                   LocalSocketError *error) {
+    if (fd < 0)
+        return set_error(error, 0, string(function) + "(): Invalid fd \"" + to_string(fd) + "\" passed");
+
+    if (fdsArray == nullptr)
+        return set_error(error, 0, string(function) + "(): fds passed is null");
+
+    *fdCount = env->GetArrayLength(fdsArray);
+    if (checkJniException(env)) return SOCKET_IO_JNI_EXCEPTION;
+    if (*fdCount < 1 || *fdCount > MAX_PASSED_FDS)
+        return set_error(error, 0, string(function) + "(): Number of fds \"" + to_string(*fdCount) +
+                                   "\" passed is not between 1-" + to_string(MAX_PASSED_FDS));
+
+    return 0;
+}
+
+/*
+ * Send the fds in fdsArray with SCM_RIGHTS along with the bytes of dataArray, or a single null byte
+ * if it is null or empty, since fds can only be passed along with data. The fds are sent with the
+ * first sendmsg() and any bytes left are sent after them like send_socket() does.
+ * Returns 0, -1 with error set if sending failed or the deadline passed, or SOCKET_IO_JNI_EXCEPTION.
+ */
+int send_fds(JNIEnv *env, jstring logTitle, const char *function, const int fd, jintArray fdsArray,
+             jbyteArray dataArray, const int64_t deadline, LocalSocketError *error) {
+    int fdCount;
+    int ret = check_fds_args(env, function, fd, fdsArray, &fdCount, error);
+    if (ret != 0) return ret;
+
+    vector<int> fds(fdCount);
+    env->GetIntArrayRegion(fdsArray, 0, fdCount, fds.data());
+    if (checkJniException(env)) return SOCKET_IO_JNI_EXCEPTION;
+    for (int passedFd : fds) {
+        if (passedFd < 0)
+            return set_error(error, 0, string(function) + "(): Invalid fd \"" + to_string(passedFd) + "\" passed in fds");
+    }
+
+    vector<jbyte> data(1, 0);
+    int dataLength = dataArray != nullptr ? env->GetArrayLength(dataArray) : 0;
+    if (checkJniException(env)) return SOCKET_IO_JNI_EXCEPTION;
+    if (dataLength > 0) {
+        data.resize(dataLength);
+        env->GetByteArrayRegion(dataArray, 0, dataLength, data.data());
+        if (checkJniException(env)) return SOCKET_IO_JNI_EXCEPTION;
+    }
+
+    vector<char> control(CMSG_SPACE(sizeof(int) * fdCount), 0);
+    struct iovec iov = {.iov_base = data.data(), .iov_len = data.size()};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fdCount);
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fdCount);
+
+    ret = transfer_socket(env, logTitle, function, fd, false, data.size(), deadline, error, [&](int bytesSent) {
+        if (bytesSent == 0)
+            return (int) sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        return (int) send(fd, data.data() + bytesSent, data.size() - bytesSent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    });
+    return ret < 0 ? ret : 0;
+}
+
+/*
+ * Receive up to the length of dataArray bytes with one recvmsg() into dataArray and any fds sent
+ * with them with SCM_RIGHTS into fdsArray, with the rest of fdsArray set to -1. The fds are
+ * received with MSG_CMSG_CLOEXEC so that they are not leaked to processes started later.
+ * If more fds were sent than fit in fdsArray, the ones received are closed and this fails.
+ * Returns the bytes read, -1 with error set if receiving failed or the deadline passed, or
+ * SOCKET_IO_JNI_EXCEPTION.
+ */
+int receive_fds(JNIEnv *env, jstring logTitle, const char *function, const int fd, jintArray fdsArray,
+                jbyteArray dataArray, const int64_t deadline, LocalSocketError *error) {
+    int fdCount;
+    int ret = check_fds_args(env, function, fd, fdsArray, &fdCount, error);
+    if (ret != 0) return ret;
+
+    int dataLength = dataArray != nullptr ? env->GetArrayLength(dataArray) : 0;
+    if (checkJniException(env)) return SOCKET_IO_JNI_EXCEPTION;
+    if (dataLength < 1)
+        return set_error(error, 0, string(function) + "(): data passed is null or empty");
+
+    vector<jbyte> data(dataLength);
+    vector<char> control(CMSG_SPACE(sizeof(int) * fdCount), 0);
+    struct iovec iov = {.iov_base = data.data(), .iov_len = data.size()};
+    struct msghdr msg = {};
+
+    const int64_t monotonicDeadline = to_monotonic_deadline(env, logTitle, function, deadline);
+    int socketTimeout = SOCKET_TIMEOUT_UNKNOWN;
+    while (true) {
+        if (monotonicDeadline > 0 && monotonic_milliseconds() >= monotonicDeadline)
+            return set_deadline_error(error, function, deadline, 0);
+
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.data();
+        msg.msg_controllen = control.size();
+        ret = recvmsg(fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (ret >= 0)
+            break;
+
+        if (errno == EINTR)
+            continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            return set_error(error, errno, string(function) + "(): Failed to receive on fd " + to_string(fd));
+
+        if (wait_socket(function, fd, true, monotonicDeadline, deadline, &socketTimeout, 0, error) != 0)
+            return -1;
+    }
+    const int bytesRead = ret;
+
+    vector<int> fds;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const unsigned char *cmsgData = CMSG_DATA(cmsg);
+        for (size_t i = 0; i < count; i++) {
+            int receivedFd;
+            memcpy(&receivedFd, cmsgData + i * sizeof(int), sizeof(int));
+            fds.push_back(receivedFd);
         }
+    }
 
-        bytes -= ret;
-        current += ret;
+    if ((msg.msg_flags & MSG_CTRUNC) || (int) fds.size() > fdCount) {
+        for (int receivedFd : fds) close(receivedFd);
+        return set_error(error, 0, string(function) + "(): More fds were sent on fd " + to_string(fd) +
+                                   " than the " + to_string(fdCount) + " that fit in fds passed", bytesRead);
     }
 
-    env->ReleaseByteArrayElements(dataArray, data, JNI_ABORT);
-    if (checkJniException(env)) return NULL;
+    const int receivedCount = fds.size();
+    fds.resize(fdCount, -1);
+    env->SetIntArrayRegion(fdsArray, 0, fdCount, fds.data());
+    if (!checkJniException(env) && bytesRead > 0)
+        env->SetByteArrayRegion(dataArray, 0, bytesRead, data.data());
+    if (checkJniException(env)) {
+        for (int i = 0; i < receivedCount; i++) close(fds[i]);
+        return SOCKET_IO_JNI_EXCEPTION;
+    }
 
-    // Return success
-    return getJniResult(env, logTitle);
+    return bytesRead;
 }
 
 extern "C"
 JNIEXPORT jobject JNICALL
-Java_com_termux_shared_net_socket_local_LocalSocketManager_availableNative(JNIEnv *env, jclass clazz,
-                                                                           jstring logTitle, jint fd) {
-    if (fd < 0) {
-        return getJniResult(env, logTitle, -1, "availableNative(): Invalid fd \"" + to_string(fd) + "\" passed");
+Java_com_termux_shared_net_socket_local_LocalSocketManager_sendFdsNative(JNIEnv *env, jclass clazz,
+                                                                         jstring logTitle, jint fd,
+                                                                         jintArray fdsArray, jbyteArray dataArray,
+                                                                         jlong deadline) {
+    LocalSocketError error = {};
+    int ret = send_fds(env, logTitle, "sendFdsNative", fd, fdsArray, dataArray, deadline, &error);
+    if (ret == SOCKET_IO_JNI_EXCEPTION) return NULL;
+    if (ret == -1) {
+        return getJniResult(env, logTitle, -1, error.errnoValue, error.errmsg, error.bytesTransferred);
     }
 
-    int available = 0;
-    if (ioctl(fd, SIOCINQ, &available) == -1) {
-        return getJniResult(env, logTitle, -1, errno,
-                            "availableNative(): Failed to get number of unread bytes in the receive buffer of fd " + to_string(fd));
+    // Return success
+    return getJniResult(env, logTitle);
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_receiveFdsNative(JNIEnv *env, jclass clazz,
+                                                                            jstring logTitle, jint fd,
+                                                                            jintArray fdsArray, jbyteArray dataArray,
+                                                                            jlong deadline) {
+    LocalSocketError error = {};
+    int bytesRead = receive_fds(env, logTitle, "receiveFdsNative", fd, fdsArray, dataArray, deadline, &error);
+    if (bytesRead == SOCKET_IO_JNI_EXCEPTION) return NULL;
+    if (bytesRead == -1) {
+        return getJniResult(env, logTitle, -1, error.errnoValue, error.errmsg, error.bytesTransferred);
     }
 
-    // Return success and bytes available in JniResult.intData field
-    return getJniResult(env, logTitle, available);
+    // Return success and bytes read in JniResult.intData field
+    return getJniResult(env, logTitle, bytesRead);
 }
 
 /* Sets socket option timeout in milliseconds. */
@@ -563,21 +1099,27 @@ Java_com_termux_shared_net_socket_local_LocalSocketManager_getPeerCredNative(JNI
         return getJniResult(env, logTitle, -1, errno, "getPeerCredNative(): Failed to get PeerCred class");
     }
 
+    // The cached fields are valid for subclasses too
+    const bool cached = jniCache.peerCredClass && env->IsInstanceOf(peerCred, jniCache.peerCredClass);
+
     string error;
 
-    error = setIntField(env, peerCred, peerCredClazz, "pid", cred.pid);
+    error = setIntField(env, peerCred, peerCredClazz, "pid", cred.pid,
+                        cached ? jniCache.peerCredPid : nullptr);
     if (!error.empty()) {
         if (error == JNI_EXCEPTION) return NULL;
         return getJniResult(env, logTitle, -1, "getPeerCredNative(): " + error);
     }
 
-    error = setIntField(env, peerCred, peerCredClazz, "uid", cred.uid);
+    error = setIntField(env, peerCred, peerCredClazz, "uid", cred.uid,
+                        cached ? jniCache.peerCredUid : nullptr);
     if (!error.empty()) {
         if (error == JNI_EXCEPTION) return NULL;
         return getJniResult(env, logTitle, -1, "getPeerCredNative(): " + error);
     }
 
-    error = setIntField(env, peerCred, peerCredClazz, "gid", cred.gid);
+    error = setIntField(env, peerCred, peerCredClazz, "gid", cred.gid,
+                        cached ? jniCache.peerCredGid : nullptr);
     if (!error.empty()) {
         if (error == JNI_EXCEPTION) return NULL;
         return getJniResult(env, logTitle, -1, "getPeerCredNative(): " + error);
@@ -585,13 +1127,15 @@ Java_com_termux_shared_net_socket_local_LocalSocketManager_getPeerCredNative(JNI
 
     string cmdline = get_process_cmdline(cred.pid);
     if (!cmdline.empty()) {
-        error = setStringField(env, peerCred, peerCredClazz, "pname", get_process_name_from_cmdline(cmdline));
+        error = setStringField(env, peerCred, peerCredClazz, "pname", get_process_name_from_cmdline(cmdline),
+                               cached ? jniCache.peerCredPname : nullptr);
         if (!error.empty()) {
             if (error == JNI_EXCEPTION) return NULL;
             return getJniResult(env, logTitle, -1, "getPeerCredNative(): " + error);
         }
 
-        error = setStringField(env, peerCred, peerCredClazz, "cmdline", get_process_cmdline_spaced(cmdline));
+        error = setStringField(env, peerCred, peerCredClazz, "cmdline", get_process_cmdline_spaced(cmdline),
+                               cached ? jniCache.peerCredCmdline : nullptr);
         if (!error.empty()) {
             if (error == JNI_EXCEPTION) return NULL;
             return getJniResult(env, logTitle, -1, "getPeerCredNative(): " + error);
@@ -601,3 +1145,538 @@ Java_com_termux_shared_net_socket_local_LocalSocketManager_getPeerCredNative(JNI
     // Return success since PeerCred was filled successfully
     return getJniResult(env, logTitle);
 }
+
+
+
+
+/*
+ * The server reactor, which owns the server socket and all its client sockets with epoll, so that
+ * one thread serves all clients of a server. A request is everything a client sends until it shuts
+ * down its writing end. Completed requests are returned to the java listener thread by
+ * waitServerReactorNative() and the responses to them are posted back by respondServerReactorNative()
+ * from any thread, after which they are sent and the client socket is closed. Clients whose peer
+ * uid is not allowed are returned right after being accepted without reading from them.
+ *
+ * Reactor ids are the slot of the reactor in serverReactors with a generation in the high bits,
+ * so that responses posted for a destroyed reactor are not delivered to one reusing its slot.
+ */
+
+/* The max number of clients accepted for each wakeup by the server socket. */
+#define SERVER_REACTOR_ACCEPT_BATCH 32
+/* The max number of client sockets, after which clients wait in the backlog of the server socket. */
+#define SERVER_REACTOR_MAX_CONNECTIONS 1024
+#define SERVER_REACTOR_MAX_EVENTS 64
+/* The max number of reactors at a time, the slot of a reactor is the low bits of its id. */
+#define SERVER_REACTOR_MAX_SLOTS 0x10000
+/* The epoll data of the server socket and of the wakeup eventfd. Connections are numbered after them. */
+#define SERVER_REACTOR_SERVER_ID 0
+#define SERVER_REACTOR_WAKEUP_ID 1
+
+struct ServerReactorConnection {
+    int fd;
+    string request;
+    string response;
+    size_t responseSent;
+    /* If the request has been returned to java and no response has been posted yet. */
+    bool dispatched;
+    /* If the peer uid of the client is allowed, the request of a client which is not is never read. */
+    bool allowed;
+    /* The monotonic milliseconds when the connection times out, or 0 for never. */
+    int64_t deadline;
+};
+
+struct ServerReactorResponse {
+    int connectionId;
+    /* If the client socket should be closed without a response. */
+    bool close;
+    string data;
+};
+
+struct ServerReactor {
+    int id;
+    int serverFd;
+    int epollFd;
+    int wakeupFd;
+    int maxRequestSize;
+    int readTimeout;
+    int sendTimeout;
+    vector<uid_t> allowedPeerUids;
+    bool accepting;
+    int nextConnectionId;
+    unordered_map<int, ServerReactorConnection> connections;
+    /* The connections whose requests have been completed and are still to be returned to java. */
+    deque<int> completed;
+
+    /* Guarded by serverReactorsLock, since posted from other threads. */
+    vector<ServerReactorResponse> responses;
+    bool stopping;
+    /*
+     * If a thread is in waitServerReactorNative(), which destroys the reactor once it has stopped.
+     * Otherwise it is destroyed by stopServerReactorNative().
+     */
+    bool running;
+};
+
+static mutex serverReactorsLock;
+/* The reactors by the slot in their id. Slots of destroyed reactors are null until reused. */
+static vector<ServerReactor*> serverReactors;
+/* The generation of the next reactor created, kept within 15 bits so that ids stay positive. */
+static int nextServerReactorGeneration = 1;
+
+/* Get the reactor for an id, or null if it has been destroyed. Must be called with serverReactorsLock held. */
+static ServerReactor* server_reactor_get(int reactorId) {
+    if (reactorId < 0) return nullptr;
+    int slot = reactorId % SERVER_REACTOR_MAX_SLOTS;
+    if (slot >= (int) serverReactors.size() || serverReactors[slot] == nullptr || serverReactors[slot]->id != reactorId)
+        return nullptr;
+    return serverReactors[slot];
+}
+
+/* Get the deadline for a timeout in milliseconds from now, or 0 if there is no timeout. */
+static int64_t server_reactor_deadline(int timeout) {
+    return timeout > 0 ? monotonic_milliseconds() + timeout : 0;
+}
+
+static void server_reactor_set_events(ServerReactor *reactor, int fd, int id, uint32_t events) {
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.u64 = id;
+    epoll_ctl(reactor->epollFd, EPOLL_CTL_MOD, fd, &event);
+}
+
+static void server_reactor_close_connection(ServerReactor *reactor, int id) {
+    auto it = reactor->connections.find(id);
+    if (it == reactor->connections.end()) return;
+    epoll_ctl(reactor->epollFd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    close(it->second.fd);
+    reactor->connections.erase(it);
+
+    // Accept clients again which were left waiting in the backlog.
+    if (!reactor->accepting && reactor->connections.size() < SERVER_REACTOR_MAX_CONNECTIONS) {
+        reactor->accepting = true;
+        server_reactor_set_events(reactor, reactor->serverFd, SERVER_REACTOR_SERVER_ID, EPOLLIN);
+    }
+}
+
+static void server_reactor_accept(ServerReactor *reactor) {
+    for (int i = 0; i < SERVER_REACTOR_ACCEPT_BATCH; i++) {
+        if (reactor->connections.size() >= SERVER_REACTOR_MAX_CONNECTIONS) {
+            reactor->accepting = false;
+            server_reactor_set_events(reactor, reactor->serverFd, SERVER_REACTOR_SERVER_ID, 0);
+            return;
+        }
+
+        int clientFd = accept4(reactor->serverFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (clientFd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                log_warn("Server reactor failed to accept client on fd " + to_string(reactor->serverFd) + ": " + strerror(errno));
+            return;
+        }
+
+        // The request of a client whose peer uid is not allowed is not read, so that it cannot make the
+        // reactor buffer requests, but it is still returned to java to report it.
+        struct ucred cred = {};
+        socklen_t credLength = sizeof(cred);
+        bool allowed = getsockopt(clientFd, SOL_SOCKET, SO_PEERCRED, &cred, &credLength) == 0 &&
+                       find(reactor->allowedPeerUids.begin(), reactor->allowedPeerUids.end(), cred.uid) != reactor->allowedPeerUids.end();
+
+        int id = reactor->nextConnectionId;
+        do {
+            id = (id == INT_MAX) ? SERVER_REACTOR_WAKEUP_ID + 1 : id + 1;
+        } while (reactor->connections.count(id));
+        reactor->nextConnectionId = id;
+
+        struct epoll_event event = {};
+        event.events = allowed ? EPOLLIN | EPOLLRDHUP : 0;
+        event.data.u64 = id;
+        if (epoll_ctl(reactor->epollFd, EPOLL_CTL_ADD, clientFd, &event) == -1) {
+            close(clientFd);
+            continue;
+        }
+
+        ServerReactorConnection &connection = reactor->connections[id];
+        connection.fd = clientFd;
+        connection.responseSent = 0;
+        connection.allowed = allowed;
+        connection.dispatched = !allowed;
+        connection.deadline = allowed ? server_reactor_deadline(reactor->readTimeout) : 0;
+        if (!allowed) reactor->completed.push_back(id);
+    }
+}
+
+static void server_reactor_read(ServerReactor *reactor, int id, ServerReactorConnection &connection) {
+    char buffer[16 * 1024];
+    while (true) {
+        ssize_t ret = read(connection.fd, buffer, sizeof(buffer));
+        if (ret > 0) {
+            if (connection.request.size() + ret > (size_t) reactor->maxRequestSize) {
+                log_warn("Server reactor closing client fd " + to_string(connection.fd) + " since its request is larger than " +
+                         to_string(reactor->maxRequestSize) + " bytes");
+                server_reactor_close_connection(reactor, id);
+                return;
+            }
+            connection.request.append(buffer, ret);
+        } else if (ret == 0) {
+            // EOF, the client has sent its whole request.
+            connection.dispatched = true;
+            connection.deadline = 0;
+            server_reactor_set_events(reactor, connection.fd, id, 0);
+            reactor->completed.push_back(id);
+            return;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            connection.deadline = server_reactor_deadline(reactor->readTimeout);
+            return;
+        } else {
+            server_reactor_close_connection(reactor, id);
+            return;
+        }
+    }
+}
+
+/* Send as much of the response as possible, and close the connection once it has been sent. */
+static void server_reactor_write(ServerReactor *reactor, int id, ServerReactorConnection &connection) {
+    while (connection.responseSent < connection.response.size()) {
+        ssize_t ret = send(connection.fd, connection.response.data() + connection.responseSent,
+                           connection.response.size() - connection.responseSent, MSG_NOSIGNAL);
+        if (ret >= 0) {
+            connection.responseSent += ret;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            connection.deadline = server_reactor_deadline(reactor->sendTimeout);
+            server_reactor_set_events(reactor, connection.fd, id, EPOLLOUT);
+            return;
+        } else {
+            break;
+        }
+    }
+    server_reactor_close_connection(reactor, id);
+}
+
+/* Handle the responses posted from other threads, returning false if the reactor is stopping. */
+static bool server_reactor_take_responses(ServerReactor *reactor) {
+    vector<ServerReactorResponse> responses;
+    {
+        lock_guard<mutex> guard(serverReactorsLock);
+        if (reactor->stopping) return false;
+        responses.swap(reactor->responses);
+    }
+
+    for (ServerReactorResponse &response : responses) {
+        auto it = reactor->connections.find(response.connectionId);
+        // The client may have hung up in the meantime.
+        if (it == reactor->connections.end() || !it->second.dispatched) continue;
+        if (response.close) {
+            server_reactor_close_connection(reactor, response.connectionId);
+        } else {
+            it->second.dispatched = false;
+            it->second.response.swap(response.data);
+            server_reactor_write(reactor, response.connectionId, it->second);
+        }
+    }
+    return true;
+}
+
+/* Close the connections which have timed out and get the epoll_wait() timeout until the next one does. */
+static int server_reactor_expire(ServerReactor *reactor) {
+    int64_t now = monotonic_milliseconds();
+    int64_t next = -1;
+    vector<int> expired;
+    for (auto &entry : reactor->connections) {
+        int64_t deadline = entry.second.deadline;
+        if (deadline == 0) continue;
+        if (deadline <= now) expired.push_back(entry.first);
+        else if (next == -1 || deadline - now < next) next = deadline - now;
+    }
+    for (int id : expired)
+        server_reactor_close_connection(reactor, id);
+    return (int) min(next, (int64_t) INT_MAX);
+}
+
+/*
+ * Close all fds of a reactor already removed from serverReactors except the server socket, which is
+ * closed by java, and free it.
+ */
+static void server_reactor_free(ServerReactor *reactor) {
+    for (auto &entry : reactor->connections)
+        close(entry.second.fd);
+    close(reactor->epollFd);
+    close(reactor->wakeupFd);
+    delete reactor;
+}
+
+/* Remove the reactor from serverReactors and free it. */
+static void server_reactor_destroy(ServerReactor *reactor) {
+    {
+        lock_guard<mutex> guard(serverReactorsLock);
+        serverReactors[reactor->id % SERVER_REACTOR_MAX_SLOTS] = nullptr;
+    }
+    server_reactor_free(reactor);
+}
+
+/*
+ * Mark that no thread is running the reactor any more, and destroy it if it was stopped in the
+ * meantime, since stopServerReactorNative() leaves that to the running thread.
+ */
+static void server_reactor_stop_running(ServerReactor *reactor) {
+    {
+        lock_guard<mutex> guard(serverReactorsLock);
+        reactor->running = false;
+        if (!reactor->stopping) return;
+        serverReactors[reactor->id % SERVER_REACTOR_MAX_SLOTS] = nullptr;
+    }
+    server_reactor_free(reactor);
+}
+
+/* Run the reactor until a request has been completed, returning the id of its connection, or -1 if stopping. */
+static int server_reactor_run(ServerReactor *reactor, int *errnoResult) {
+    struct epoll_event events[SERVER_REACTOR_MAX_EVENTS];
+    while (true) {
+        if (!server_reactor_take_responses(reactor)) return -1;
+        while (!reactor->completed.empty()) {
+            int id = reactor->completed.front();
+            reactor->completed.pop_front();
+            auto it = reactor->connections.find(id);
+            if (it != reactor->connections.end() && it->second.dispatched) return id;
+        }
+
+        int count = epoll_wait(reactor->epollFd, events, SERVER_REACTOR_MAX_EVENTS, server_reactor_expire(reactor));
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            *errnoResult = errno;
+            return -2;
+        }
+
+        for (int i = 0; i < count; i++) {
+            int id = (int) events[i].data.u64;
+            if (id == SERVER_REACTOR_SERVER_ID) {
+                server_reactor_accept(reactor);
+            } else if (id == SERVER_REACTOR_WAKEUP_ID) {
+                uint64_t value;
+                while (read(reactor->wakeupFd, &value, sizeof(value)) == -1 && errno == EINTR);
+            } else {
+                auto it = reactor->connections.find(id);
+                if (it == reactor->connections.end()) continue;
+                ServerReactorConnection &connection = it->second;
+                if (!connection.response.empty()) {
+                    server_reactor_write(reactor, id, connection);
+                } else if (!connection.dispatched) {
+                    server_reactor_read(reactor, id, connection);
+                } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                    // The client hung up while its request is being handled, nothing can be sent to it.
+                    server_reactor_close_connection(reactor, id);
+                }
+            }
+        }
+    }
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_createServerReactorNative(JNIEnv *env, jclass clazz,
+                                                                                     jstring logTitle, jint fd,
+                                                                                     jint maxRequestSize,
+                                                                                     jint readTimeout,
+                                                                                     jint sendTimeout,
+                                                                                     jintArray allowedPeerUidsArray) {
+    if (fd < 0) {
+        return getJniResult(env, logTitle, -1, "createServerReactorNative(): Invalid fd \"" + to_string(fd) + "\" passed");
+    }
+
+    if (maxRequestSize < 1) {
+        return getJniResult(env, logTitle, -1, "createServerReactorNative(): Max request size \"" +
+                                               to_string(maxRequestSize) + "\" is not greater than 0");
+    }
+
+    vector<uid_t> allowedPeerUids;
+    if (allowedPeerUidsArray != nullptr) {
+        vector<jint> uids(env->GetArrayLength(allowedPeerUidsArray));
+        env->GetIntArrayRegion(allowedPeerUidsArray, 0, (jsize) uids.size(), uids.data());
+        if (checkJniException(env)) return NULL;
+        for (jint uid : uids)
+            if (uid >= 0) allowedPeerUids.push_back((uid_t) uid);
+    }
+
+    // The server socket is only accepted on when epoll reports it readable, and clients may give up in between
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        return getJniResult(env, logTitle, -1, errno, "createServerReactorNative(): Failed to set fd " + to_string(fd) + " non-blocking");
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        return getJniResult(env, logTitle, -1, errno, "createServerReactorNative(): Create epoll instance failed");
+    }
+
+    int wakeupFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeupFd == -1) {
+        int errnoBackup = errno;
+        close(epollFd);
+        return getJniResult(env, logTitle, -1, errnoBackup, "createServerReactorNative(): Create eventfd failed");
+    }
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = SERVER_REACTOR_SERVER_ID;
+    int ret = epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    if (ret != -1) {
+        event.data.u64 = SERVER_REACTOR_WAKEUP_ID;
+        ret = epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeupFd, &event);
+    }
+    if (ret == -1) {
+        int errnoBackup = errno;
+        close(wakeupFd);
+        close(epollFd);
+        return getJniResult(env, logTitle, -1, errnoBackup, "createServerReactorNative(): Failed to add fds to epoll instance");
+    }
+
+    ServerReactor *reactor = new ServerReactor();
+    reactor->serverFd = fd;
+    reactor->epollFd = epollFd;
+    reactor->wakeupFd = wakeupFd;
+    reactor->maxRequestSize = maxRequestSize;
+    reactor->readTimeout = readTimeout;
+    reactor->sendTimeout = sendTimeout;
+    reactor->allowedPeerUids.swap(allowedPeerUids);
+    reactor->accepting = true;
+    reactor->nextConnectionId = SERVER_REACTOR_WAKEUP_ID;
+    reactor->stopping = false;
+    reactor->running = false;
+
+    int reactorId;
+    {
+        lock_guard<mutex> guard(serverReactorsLock);
+        int slot;
+        for (slot = 0; slot < (int) serverReactors.size(); slot++)
+            if (serverReactors[slot] == nullptr) break;
+        if (slot == SERVER_REACTOR_MAX_SLOTS) {
+            close(wakeupFd);
+            close(epollFd);
+            delete reactor;
+            return getJniResult(env, logTitle, -1, "createServerReactorNative(): Too many server reactors");
+        }
+        if (slot == (int) serverReactors.size())
+            serverReactors.push_back(reactor);
+        else
+            serverReactors[slot] = reactor;
+
+        int generation = nextServerReactorGeneration;
+        nextServerReactorGeneration = (generation == SHRT_MAX) ? 1 : generation + 1;
+        reactorId = generation * SERVER_REACTOR_MAX_SLOTS + slot;
+        reactor->id = reactorId;
+    }
+
+    // Return success and reactor id in JniResult.intData field
+    return getJniResult(env, logTitle, reactorId);
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_waitServerReactorNative(JNIEnv *env, jclass clazz,
+                                                                                   jstring logTitle, jint reactorId,
+                                                                                   jintArray connectionArray,
+                                                                                   jbyteArray requestArray) {
+    ServerReactor *reactor;
+    {
+        lock_guard<mutex> guard(serverReactorsLock);
+        reactor = server_reactor_get(reactorId);
+        if (reactor != nullptr) reactor->running = true;
+    }
+    if (reactor == nullptr) {
+        return getJniResult(env, logTitle, -1, "waitServerReactorNative(): Invalid reactor \"" + to_string(reactorId) + "\" passed");
+    }
+
+    if (env->GetArrayLength(connectionArray) < 3 || env->GetArrayLength(requestArray) < reactor->maxRequestSize) {
+        server_reactor_stop_running(reactor);
+        return getJniResult(env, logTitle, -1, "waitServerReactorNative(): Arrays passed are too small");
+    }
+
+    int errnoResult = 0;
+    int id = server_reactor_run(reactor, &errnoResult);
+    if (id < 0) {
+        server_reactor_destroy(reactor);
+        if (id == -1) {
+            // Return success and -1 in JniResult.intData field since the reactor was stopped
+            return getJniResult(env, logTitle, -1);
+        }
+        return getJniResult(env, logTitle, -1, errnoResult, "waitServerReactorNative(): Wait on epoll instance failed");
+    }
+
+    ServerReactorConnection &connection = reactor->connections[id];
+    jint connectionData[3] = {id, connection.fd, connection.allowed ? 1 : 0};
+    env->SetIntArrayRegion(connectionArray, 0, 3, connectionData);
+    int length = (int) connection.request.size();
+    if (!checkJniException(env))
+        env->SetByteArrayRegion(requestArray, 0, length, reinterpret_cast<const jbyte *>(connection.request.data()));
+    string().swap(connection.request);
+    server_reactor_stop_running(reactor);
+    if (checkJniException(env)) return NULL;
+
+    // Return success and request length in JniResult.intData field
+    return getJniResult(env, logTitle, length);
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_respondServerReactorNative(JNIEnv *env, jclass clazz,
+                                                                                      jstring logTitle, jint reactorId,
+                                                                                      jint connectionId,
+                                                                                      jbyteArray responseArray) {
+    ServerReactorResponse response;
+    response.connectionId = connectionId;
+    response.close = responseArray == nullptr;
+    if (responseArray != nullptr) {
+        int length = env->GetArrayLength(responseArray);
+        response.data.resize(length);
+        env->GetByteArrayRegion(responseArray, 0, length, reinterpret_cast<jbyte *>(&response.data[0]));
+        if (checkJniException(env)) return NULL;
+    }
+
+    lock_guard<mutex> guard(serverReactorsLock);
+    ServerReactor *reactor = server_reactor_get(reactorId);
+    if (reactor == nullptr) {
+        return getJniResult(env, logTitle, -1, "respondServerReactorNative(): Invalid reactor \"" + to_string(reactorId) + "\" passed");
+    }
+
+    reactor->responses.push_back(std::move(response));
+    uint64_t value = 1;
+    if (write(reactor->wakeupFd, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+        return getJniResult(env, logTitle, -1, errno, "respondServerReactorNative(): Failed to wake up reactor");
+    }
+
+    // Return success
+    return getJniResult(env, logTitle);
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_com_termux_shared_net_socket_local_LocalSocketManager_stopServerReactorNative(JNIEnv *env, jclass clazz,
+                                                                                   jstring logTitle, jint reactorId) {
+    unique_lock<mutex> guard(serverReactorsLock);
+    ServerReactor *reactor = server_reactor_get(reactorId);
+    if (reactor == nullptr) {
+        return getJniResult(env, logTitle, -1, "stopServerReactorNative(): Invalid reactor \"" + to_string(reactorId) + "\" passed");
+    }
+
+    reactor->stopping = true;
+    // Nothing is waiting on the reactor to destroy it once it has stopped, like if the listener
+    // thread never started or is between requests, so destroy it now.
+    if (!reactor->running) {
+        serverReactors[reactor->id % SERVER_REACTOR_MAX_SLOTS] = nullptr;
+        guard.unlock();
+        server_reactor_free(reactor);
+        // Return success
+        return getJniResult(env, logTitle);
+    }
+
+    uint64_t value = 1;
+    if (write(reactor->wakeupFd, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+        return getJniResult(env, logTitle, -1, errno, "stopServerReactorNative(): Failed to wake up reactor");
+    }
+
+    // Return success
+    return getJniResult(env, logTitle);
+}
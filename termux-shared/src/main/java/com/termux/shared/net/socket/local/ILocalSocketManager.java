@@ -69,4 +69,25 @@ public interface ILocalSocketManager {
     void onClientAccepted(@NonNull LocalSocketManager localSocketManager,
                           @NonNull LocalClientSocket clientSocket);
 
+    /**
+     * This is called instead of {@link #onClientAccepted(LocalSocketManager, LocalClientSocket)} if
+     * {@link LocalSocketRunConfig#isEventLoopEnabled()}, once a client that has the server app's user
+     * id or root user id has sent its whole request and shut down its writing end. It is called on a
+     * worker thread of the server, and the response returned is sent to the client by the server,
+     * which then closes the client socket.
+     *
+     * The connection is owned by the server, so the {@link LocalClientSocket} has no fd and cannot
+     * be read from, written to or closed. The {@link LocalClientSocket#getPeerCred()} can be used to
+     * get the {@link PeerCred} object containing info for the connected client/peer.
+     *
+     * @param localSocketManager The {@link LocalSocketManager} for the server.
+     * @param clientSocket The {@link LocalClientSocket} that connected.
+     * @param request The request the client sent.
+     * @return Should return the response to send to the client, or {@code null} to close the client
+     * socket without one.
+     */
+    @Nullable
+    byte[] onClientRequest(@NonNull LocalSocketManager localSocketManager,
+                           @NonNull LocalClientSocket clientSocket, @NonNull byte[] request);
+
 }
@@ -1,6 +1,7 @@
 package com.termux.shared.net.socket.local;
 
 import androidx.annotation.NonNull;
+import androidx.annotation.Nullable;
 
 import com.termux.shared.data.DataUtils;
 import com.termux.shared.errors.Error;
@@ -15,6 +16,8 @@ import java.io.InputStream;
 import java.io.InputStreamReader;
 import java.io.OutputStream;
 import java.io.OutputStreamWriter;
+import java.nio.ByteBuffer;
+import java.nio.ReadOnlyBufferException;
 
 /** The client socket for {@link LocalSocketManager}. */
 public class LocalClientSocket implements Closeable {
@@ -36,6 +39,12 @@ public class LocalClientSocket implements Closeable {
     /** The creation time of {@link LocalClientSocket}. This is also used for deadline. */
     protected final long mCreationTime;
 
+    /**
+     * The {@link System#nanoTime()} at creation of {@link LocalClientSocket}, so that the time left
+     * until the deadline is not changed by changes of the wall clock.
+     */
+    protected final long mCreationNanoTime;
+
     /** The {@link PeerCred} of the {@link LocalClientSocket} containing info of client/peer. */
     @NonNull protected final PeerCred mPeerCred;
 
@@ -56,6 +65,7 @@ public class LocalClientSocket implements Closeable {
         mLocalSocketManager = localSocketManager;
         mLocalSocketRunConfig = localSocketManager.getLocalSocketRunConfig();
         mCreationTime = System.currentTimeMillis();
+        mCreationNanoTime = System.nanoTime();
         mOutputStream = new SocketOutputStream();
         mInputStream = new SocketInputStream();
         mPeerCred = peerCred;
@@ -111,9 +121,9 @@ public class LocalClientSocket implements Closeable {
      * {@link LocalSocketRunConfig#getDeadline()} elapses but all the data has not been read, an
      * error would be returned.
      *
-     * This is a wrapper for {@link LocalSocketManager#read(String, int, byte[], long)}, which can
-     * be called instead if you want to get access to errno int value instead of {@link JniResult}
-     * error {@link String}.
+     * This is a wrapper for {@link #read(byte[], int, int, MutableInt)}. The
+     * {@link LocalSocketManager#read(String, int, byte[], long)} can be called instead if you want to
+     * get access to errno int value instead of {@link JniResult} error {@link String}.
      *
      * @param data The data buffer to read bytes into.
      * @param bytesRead The actual bytes read.
@@ -121,6 +131,22 @@ public class LocalClientSocket implements Closeable {
      * error {@link String}, otherwise {@code null}.
      */
     public Error read(@NonNull byte[] data, MutableInt bytesRead) {
+        return read(data, 0, data.length, bytesRead);
+    }
+
+    /**
+     * Same as {@link #read(byte[], MutableInt)}, but reads up to length bytes into the data buffer
+     * starting at offset. This uses {@link LocalSocketManager#readFast(int, byte[], int, int, long)},
+     * which does not allocate anything unless reading fails.
+     *
+     * @param data The data buffer to read bytes into.
+     * @param offset The offset in data to read bytes into.
+     * @param length The max number of bytes to read.
+     * @param bytesRead The actual bytes read.
+     * @return Returns the {@code error} if reading was not successful containing {@link JniResult}
+     * error {@link String}, otherwise {@code null}.
+     */
+    public Error read(@NonNull byte[] data, int offset, int length, MutableInt bytesRead) {
         bytesRead.value = 0;
 
         if (mFD < 0) {
@@ -128,15 +154,13 @@ public class LocalClientSocket implements Closeable {
                 mLocalSocketRunConfig.getTitle());
         }
 
-        JniResult result = LocalSocketManager.read(mLocalSocketRunConfig.getLogTitle() + " (client)",
-            mFD, data,
-            mLocalSocketRunConfig.getDeadline() > 0 ? mCreationTime + mLocalSocketRunConfig.getDeadline() : 0);
-        if (result == null || result.retval != 0) {
+        int ret = LocalSocketManager.readFast(mFD, data, offset, length, getDeadline());
+        if (ret < 0) {
             return LocalSocketErrno.ERRNO_READ_DATA_FROM_CLIENT_SOCKET_FAILED.getError(
-                mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(result));
+                mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(getLastError()));
         }
 
-        bytesRead.value = result.intData;
+        bytesRead.value = ret;
         return null;
     }
 
@@ -147,31 +171,203 @@ public class LocalClientSocket implements Closeable {
      * {@link LocalSocketRunConfig#getDeadline()} elapses but all the data has not been sent, an
      * error would be returned.
      *
-     * This is a wrapper for {@link LocalSocketManager#send(String, int, byte[], long)}, which can
-     * be called instead if you want to get access to errno int value instead of {@link JniResult}
-     * error {@link String}.
+     * This is a wrapper for {@link #send(byte[], int, int)}. The
+     * {@link LocalSocketManager#send(String, int, byte[], long)} can be called instead if you want to
+     * get access to errno int value instead of {@link JniResult} error {@link String}.
      *
      * @param data The data buffer containing bytes to send.
      * @return Returns the {@code error} if sending was not successful containing {@link JniResult}
      * error {@link String}, otherwise {@code null}.
      */
     public Error send(@NonNull byte[] data) {
+        return send(data, 0, data.length);
+    }
+
+    /**
+     * Same as {@link #send(byte[])}, but sends length bytes of the data buffer starting at offset.
+     * This uses {@link LocalSocketManager#sendFast(int, byte[], int, int, long)}, which does not
+     * allocate anything unless sending fails.
+     *
+     * @param data The data buffer containing bytes to send.
+     * @param offset The offset in data of the bytes to send.
+     * @param length The number of bytes to send.
+     * @return Returns the {@code error} if sending was not successful containing {@link JniResult}
+     * error {@link String}, otherwise {@code null}.
+     */
+    public Error send(@NonNull byte[] data, int offset, int length) {
         if (mFD < 0) {
             return LocalSocketErrno.ERRNO_USING_CLIENT_SOCKET_WITH_INVALID_FD.getError(mFD,
                 mLocalSocketRunConfig.getTitle());
         }
 
-        JniResult result = LocalSocketManager.send(mLocalSocketRunConfig.getLogTitle() + " (client)",
-            mFD, data,
-            mLocalSocketRunConfig.getDeadline() > 0 ? mCreationTime + mLocalSocketRunConfig.getDeadline() : 0);
-        if (result == null || result.retval != 0) {
+        if (LocalSocketManager.sendFast(mFD, data, offset, length, getDeadline()) < 0) {
             return LocalSocketErrno.ERRNO_SEND_DATA_TO_CLIENT_SOCKET_FAILED.getError(
+                mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(getLastError()));
+        }
+
+        return null;
+    }
+
+    /**
+     * Attempts to send file descriptors to the peer, so that it can use the same open files, pipes
+     * or sockets, like a memfd or a pipe to exchange data through without copying it through this
+     * socket. The fds stay open in this process.
+     *
+     * This is a wrapper for {@link LocalSocketManager#sendFds(String, int, int[], byte[], long)}.
+     *
+     * @param fds The fds to send, at most 253.
+     * @param data The optional data buffer containing bytes to send with the fds.
+     * @return Returns the {@code error} if sending was not successful containing {@link JniResult}
+     * error {@link String}, otherwise {@code null}.
+     */
+    public Error sendFds(@NonNull int[] fds, @Nullable byte[] data) {
+        if (mFD < 0) {
+            return LocalSocketErrno.ERRNO_USING_CLIENT_SOCKET_WITH_INVALID_FD.getError(mFD,
+                mLocalSocketRunConfig.getTitle());
+        }
+
+        JniResult result = LocalSocketManager.sendFds(mLocalSocketRunConfig.getLogTitle() + " (client)",
+            mFD, fds, data, getDeadline());
+        if (result == null || result.retval != 0) {
+            return LocalSocketErrno.ERRNO_SEND_FDS_TO_CLIENT_SOCKET_FAILED.getError(
+                mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(result));
+        }
+
+        return null;
+    }
+
+    /**
+     * Attempts to receive up to data buffer length bytes and any file descriptors the peer sent
+     * with them. The fds received are set at the start of fds and the rest of it is set to -1.
+     * The caller owns the fds received and must close them.
+     *
+     * This is a wrapper for {@link LocalSocketManager#receiveFds(String, int, int[], byte[], long)}.
+     *
+     * @param fds The array to set the fds received in, of length 1 to 253.
+     * @param data The data buffer to read bytes into.
+     * @param bytesRead The actual bytes read, which is 0 at end of file.
+     * @return Returns the {@code error} if receiving was not successful containing {@link JniResult}
+     * error {@link String}, otherwise {@code null}.
+     */
+    public Error receiveFds(@NonNull int[] fds, @NonNull byte[] data, MutableInt bytesRead) {
+        bytesRead.value = 0;
+
+        if (mFD < 0) {
+            return LocalSocketErrno.ERRNO_USING_CLIENT_SOCKET_WITH_INVALID_FD.getError(mFD,
+                mLocalSocketRunConfig.getTitle());
+        }
+
+        JniResult result = LocalSocketManager.receiveFds(mLocalSocketRunConfig.getLogTitle() + " (client)",
+            mFD, fds, data, getDeadline());
+        if (result == null || result.retval != 0) {
+            return LocalSocketErrno.ERRNO_RECEIVE_FDS_FROM_CLIENT_SOCKET_FAILED.getError(
                 mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(result));
         }
 
+        bytesRead.value = result.intData;
+        return null;
+    }
+
+    /**
+     * Attempts to read bytes into the remaining bytes of the buffer until it is full or the peer
+     * closes its writing end, and advances the buffer position past them. Direct buffers are read
+     * into without any copies, so a reused direct buffer can be filled a slice at a time.
+     *
+     * @param buffer The buffer to read bytes into.
+     * @param bytesRead The actual bytes read.
+     * @return Returns the {@code error} if reading was not successful containing {@link JniResult}
+     * error {@link String}, otherwise {@code null}.
+     * @throws ReadOnlyBufferException If the buffer is read-only.
+     */
+    public Error read(@NonNull ByteBuffer buffer, MutableInt bytesRead) {
+        if (buffer.isReadOnly()) {
+            throw new ReadOnlyBufferException();
+        }
+
+        if (!buffer.isDirect()) {
+            Error error = read(buffer.array(), buffer.arrayOffset() + buffer.position(), buffer.remaining(), bytesRead);
+            if (error == null)
+                buffer.position(buffer.position() + bytesRead.value);
+            return error;
+        }
+
+        bytesRead.value = 0;
+
+        if (mFD < 0) {
+            return LocalSocketErrno.ERRNO_USING_CLIENT_SOCKET_WITH_INVALID_FD.getError(mFD,
+                mLocalSocketRunConfig.getTitle());
+        }
+
+        int ret = LocalSocketManager.readDirect(mFD, buffer, buffer.position(), buffer.remaining(), getDeadline());
+        if (ret < 0) {
+            return LocalSocketErrno.ERRNO_READ_DATA_FROM_CLIENT_SOCKET_FAILED.getError(
+                mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(getLastError()));
+        }
+
+        buffer.position(buffer.position() + ret);
+        bytesRead.value = ret;
         return null;
     }
 
+    /**
+     * Attempts to send the remaining bytes of the buffer, and advances the buffer position past
+     * them. Direct buffers are sent from without any copies.
+     *
+     * @param buffer The buffer containing bytes to send.
+     * @return Returns the {@code error} if sending was not successful containing {@link JniResult}
+     * error {@link String}, otherwise {@code null}.
+     */
+    public Error send(@NonNull ByteBuffer buffer) {
+        Error error;
+        if (!buffer.isDirect()) {
+            if (buffer.hasArray()) {
+                error = send(buffer.array(), buffer.arrayOffset() + buffer.position(), buffer.remaining());
+            } else {
+                // Read-only heap buffers do not expose their array
+                byte[] data = new byte[buffer.remaining()];
+                buffer.duplicate().get(data);
+                error = send(data);
+            }
+        } else if (mFD < 0) {
+            error = LocalSocketErrno.ERRNO_USING_CLIENT_SOCKET_WITH_INVALID_FD.getError(mFD,
+                mLocalSocketRunConfig.getTitle());
+        } else if (LocalSocketManager.sendDirect(mFD, buffer, buffer.position(), buffer.remaining(), getDeadline()) < 0) {
+            error = LocalSocketErrno.ERRNO_SEND_DATA_TO_CLIENT_SOCKET_FAILED.getError(
+                mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(getLastError()));
+        } else {
+            error = null;
+        }
+
+        if (error == null)
+            buffer.position(buffer.limit());
+        return error;
+    }
+
+    /**
+     * Get the deadline milliseconds since epoch for reading and sending, or 0 if there is none. The
+     * time left is measured with {@link System#nanoTime()} since creation, and the native calls
+     * measure it on the monotonic clock too, so changes of the wall clock do not matter.
+     */
+    private long getDeadline() {
+        long deadline = mLocalSocketRunConfig.getDeadline();
+        return deadline > 0 ? System.currentTimeMillis() + getMillisUntilDeadline(deadline) : 0;
+    }
+
+    /** Check if the {@link LocalSocketRunConfig#getDeadline()} has passed since creation. */
+    private boolean isDeadlinePassed() {
+        long deadline = mLocalSocketRunConfig.getDeadline();
+        return deadline > 0 && getMillisUntilDeadline(deadline) < 0;
+    }
+
+    private long getMillisUntilDeadline(long deadline) {
+        return deadline - (System.nanoTime() - mCreationNanoTime) / 1000000;
+    }
+
+    /** Get the error of the last failed fast path call of the current thread. */
+    private JniResult getLastError() {
+        return LocalSocketManager.getLastError(mLocalSocketRunConfig.getLogTitle() + " (client)");
+    }
+
     /**
      * Attempts to read all the bytes available on {@link SocketInputStream} and appends them to
      * {@code data} {@link StringBuilder}.
@@ -270,17 +466,17 @@ public class LocalClientSocket implements Closeable {
                 mLocalSocketRunConfig.getTitle());
         }
 
-        if (checkDeadline && mLocalSocketRunConfig.getDeadline() > 0 && System.currentTimeMillis() > (mCreationTime + mLocalSocketRunConfig.getDeadline())) {
+        if (checkDeadline && isDeadlinePassed()) {
             return null;
         }
 
-        JniResult result = LocalSocketManager.available(mLocalSocketRunConfig.getLogTitle() + " (client)", mLocalSocketRunConfig.getFD());
-        if (result == null || result.retval != 0) {
+        int ret = LocalSocketManager.availableFast(mFD);
+        if (ret < 0) {
             return LocalSocketErrno.ERRNO_CHECK_AVAILABLE_DATA_ON_CLIENT_SOCKET_FAILED.getError(
-                mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(result));
+                mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(getLastError()));
         }
 
-        available.value = result.intData;
+        available.value = ret;
         return null;
     }
 
@@ -409,20 +605,15 @@ public class LocalClientSocket implements Closeable {
     /** The {@link InputStream} implementation for the {@link LocalClientSocket}. */
     protected class SocketInputStream extends InputStream {
         private final byte[] mBytes = new byte[1];
+        private final MutableInt mBytesRead = new MutableInt(0);
 
         @Override
         public int read() throws IOException {
-            MutableInt bytesRead = new MutableInt(0);
-            Error error = LocalClientSocket.this.read(mBytes, bytesRead);
-            if (error != null) {
-                throw new IOException(error.getErrorMarkdownString());
-            }
-
-            if (bytesRead.value == 0) {
+            if (read(mBytes, 0, 1) == -1) {
                 return -1;
             }
 
-            return mBytes[0];
+            return mBytes[0] & 0xFF;
         }
 
         @Override
@@ -431,17 +622,31 @@ public class LocalClientSocket implements Closeable {
                 throw new NullPointerException("Read buffer can't be null");
             }
 
-            MutableInt bytesRead = new MutableInt(0);
-            Error error = LocalClientSocket.this.read(bytes, bytesRead);
+            return read(bytes, 0, bytes.length);
+        }
+
+        @Override
+        public int read(byte[] bytes, int offset, int length) throws IOException {
+            if (bytes == null) {
+                throw new NullPointerException("Read buffer can't be null");
+            }
+            if (offset < 0 || length < 0 || length > bytes.length - offset) {
+                throw new IndexOutOfBoundsException("offset=" + offset + ", length=" + length + ", bytes.length=" + bytes.length);
+            }
+            if (length == 0) {
+                return 0;
+            }
+
+            Error error = LocalClientSocket.this.read(bytes, offset, length, mBytesRead);
             if (error != null) {
                 throw new IOException(error.getErrorMarkdownString());
             }
 
-            if (bytesRead.value == 0) {
+            if (mBytesRead.value == 0) {
                 return -1;
             }
 
-            return bytesRead.value;
+            return mBytesRead.value;
         }
 
         @Override
@@ -478,6 +683,18 @@ public class LocalClientSocket implements Closeable {
                 throw new IOException(error.getErrorMarkdownString());
             }
         }
+
+        @Override
+        public void write(byte[] bytes, int offset, int length) throws IOException {
+            if (offset < 0 || length < 0 || length > bytes.length - offset) {
+                throw new IndexOutOfBoundsException("offset=" + offset + ", length=" + length + ", bytes.length=" + bytes.length);
+            }
+
+            Error error = LocalClientSocket.this.send(bytes, offset, length);
+            if (error != null) {
+                throw new IOException(error.getErrorMarkdownString());
+            }
+        }
     }
 
 }
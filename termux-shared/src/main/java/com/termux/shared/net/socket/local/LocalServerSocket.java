@@ -11,6 +11,11 @@ import java.io.Closeable;
 import java.io.File;
 import java.io.IOException;
 import java.nio.charset.StandardCharsets;
+import java.util.Arrays;
+import java.util.concurrent.ArrayBlockingQueue;
+import java.util.concurrent.RejectedExecutionException;
+import java.util.concurrent.ThreadPoolExecutor;
+import java.util.concurrent.TimeUnit;
 
 /** The server socket for {@link LocalSocketManager}. */
 public class LocalServerSocket implements Closeable {
@@ -26,9 +31,27 @@ public class LocalServerSocket implements Closeable {
     /** The {@link ILocalSocketManager} client for the {@link LocalSocketManager}. */
     @NonNull protected final ILocalSocketManager mLocalSocketManagerClient;
 
-    /** The {@link ClientSocketListener} {@link Thread} for the {@link LocalServerSocket}. */
+    /**
+     * The {@link ClientSocketListener} {@link Thread} for the {@link LocalServerSocket}, or the
+     * {@link ServerReactorListener} {@link Thread} if {@link LocalSocketRunConfig#isEventLoopEnabled()}.
+     */
     @NonNull protected final Thread mClientSocketListener;
 
+    /** The id of the native server reactor if {@link LocalSocketRunConfig#isEventLoopEnabled()}, otherwise `-1`. */
+    protected int mServerReactor = -1;
+
+    /**
+     * Whether the native server reactor has been stopped, after which it may have been destroyed,
+     * so the {@link ServerReactorListener} and its workers must not use it anymore.
+     */
+    protected volatile boolean mServerReactorStopped;
+
+    /** The worker threads that run client requests received by the {@link ServerReactorListener}. */
+    protected ThreadPoolExecutor mRequestWorkers;
+
+    /** The time in milliseconds after which idle worker threads are stopped. */
+    public static final int REQUEST_WORKER_KEEP_ALIVE_TIME = 30000;
+
     /**
      * The required permissions for server socket file parent directory.
      * Creation of a new socket will fail if the server starter app process does not have
@@ -45,7 +68,8 @@ public class LocalServerSocket implements Closeable {
         mLocalSocketManager = localSocketManager;
         mLocalSocketRunConfig = localSocketManager.getLocalSocketRunConfig();
         mLocalSocketManagerClient = mLocalSocketRunConfig.getLocalSocketManagerClient();
-        mClientSocketListener = new Thread(new ClientSocketListener());
+        mClientSocketListener = new Thread(mLocalSocketRunConfig.isEventLoopEnabled() ?
+            new ServerReactorListener() : new ClientSocketListener());
     }
 
     /** Start server by creating server socket. */
@@ -111,6 +135,14 @@ public class LocalServerSocket implements Closeable {
         // Update fd to signify that server socket has been created successfully
         mLocalSocketRunConfig.setFD(fd);
 
+        if (mLocalSocketRunConfig.isEventLoopEnabled()) {
+            error = startServerReactor(fd, backlog);
+            if (error != null) {
+                closeServerSocket(true);
+                return error;
+            }
+        }
+
         mClientSocketListener.setUncaughtExceptionHandler(mLocalSocketManager.getLocalSocketManagerClientThreadUEH());
 
         try {
@@ -132,6 +164,8 @@ public class LocalServerSocket implements Closeable {
             mClientSocketListener.interrupt();
         } catch (Exception ignored) {}
 
+        stopServerReactor();
+
         Error error = closeServerSocket(false);
         if (error != null)
             return error;
@@ -172,6 +206,71 @@ public class LocalServerSocket implements Closeable {
         }
     }
 
+    /**
+     * Create the native server reactor for the server socket and the worker threads for the client
+     * requests it receives. At most {@link LocalSocketRunConfig#getMaxWorkerThreads()} requests are
+     * run at a time and at most `backlog` more are queued, after which requests are rejected.
+     */
+    private Error startServerReactor(int fd, int backlog) {
+        JniResult result = LocalSocketManager.createServerReactor(mLocalSocketRunConfig.getLogTitle() + " (server)",
+            fd, mLocalSocketRunConfig.getMaxRequestSize(), mLocalSocketRunConfig.getReceiveTimeout(), mLocalSocketRunConfig.getSendTimeout(),
+            getAllowedPeerUids());
+        if (result == null || result.retval != 0) {
+            return LocalSocketErrno.ERRNO_CREATE_SERVER_REACTOR_FAILED.getError(mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(result));
+        }
+        mServerReactor = result.intData;
+
+        int workers = Math.max(1, mLocalSocketRunConfig.getMaxWorkerThreads());
+        mRequestWorkers = new ThreadPoolExecutor(workers, workers, REQUEST_WORKER_KEEP_ALIVE_TIME, TimeUnit.MILLISECONDS,
+            new ArrayBlockingQueue<>(backlog), runnable -> {
+                Thread thread = new Thread(runnable);
+                thread.setUncaughtExceptionHandler(mLocalSocketManager.getLocalSocketManagerClientThreadUEH());
+                return thread;
+            });
+        mRequestWorkers.allowCoreThreadTimeOut(true);
+        return null;
+    }
+
+    /**
+     * Stop the native server reactor, which closes its client sockets, and the worker threads. The
+     * reactor is destroyed by the {@link ServerReactorListener} once it has stopped, or right away
+     * if the listener is not waiting on it.
+     */
+    private void stopServerReactor() {
+        if (mServerReactor >= 0 && !mServerReactorStopped) {
+            mServerReactorStopped = true;
+            JniResult result = LocalSocketManager.stopServerReactor(mLocalSocketRunConfig.getLogTitle() + " (server)", mServerReactor);
+            if (result == null || result.retval != 0)
+                Logger.logErrorExtended(LOG_TAG, LocalSocketErrno.ERRNO_SERVER_REACTOR_FAILED.getError(
+                    mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(result)).getErrorLogString());
+        }
+
+        if (mRequestWorkers != null)
+            mRequestWorkers.shutdownNow();
+    }
+
+    /** Send the response to a request received by the {@link ServerReactorListener}, or close the client socket if `null`. */
+    private void respond(int reactor, int connectionId, byte[] response) {
+        // The client sockets were closed when the reactor was stopped
+        if (mServerReactorStopped) return;
+
+        JniResult result = LocalSocketManager.respondServerReactor(mLocalSocketRunConfig.getLogTitle() + " (client)",
+            reactor, connectionId, response);
+        if (result == null || result.retval != 0)
+            Logger.logErrorExtended(LOG_TAG, LocalSocketErrno.ERRNO_SERVER_REACTOR_FAILED.getError(
+                mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(result)).getErrorLogString());
+    }
+
+    /** Only allow connection if the peer has the same uid as server app's user id or root user id. */
+    private boolean isAllowedPeerUid(int peerUid) {
+        return peerUid == mLocalSocketManager.getContext().getApplicationInfo().uid || peerUid == 0;
+    }
+
+    /** The peer uids allowed by {@link #isAllowedPeerUid(int)}, which the server reactor checks natively. */
+    private int[] getAllowedPeerUids() {
+        return new int[]{mLocalSocketManager.getContext().getApplicationInfo().uid, 0};
+    }
+
     /**
      * Delete server socket file if not an abstract namespace socket. This will cause any existing
      * running server to stop.
@@ -230,7 +329,7 @@ public class LocalServerSocket implements Closeable {
             Logger.logVerbose(LOG_TAG, "Client socket accept for \"" + mLocalSocketRunConfig.getTitle() + "\" server\n" + clientSocket.getLogString());
 
             // Only allow connection if the peer has the same uid as server app's user id or root user id
-            if (peerUid != mLocalSocketManager.getContext().getApplicationInfo().uid && peerUid != 0) {
+            if (!isAllowedPeerUid(peerUid)) {
                 mLocalSocketManager.onDisallowedClientConnected(clientSocket,
                     LocalSocketErrno.ERRNO_CLIENT_SOCKET_PEER_UID_DISALLOWED.getError(clientSocket.getPeerCred().getMinimalString(),
                         mLocalSocketManager.getLocalSocketRunConfig().getTitle()));
@@ -300,4 +399,113 @@ public class LocalServerSocket implements Closeable {
 
     }
 
+
+
+    /**
+     * The native server reactor listener {@link java.lang.Runnable} for {@link LocalServerSocket},
+     * used instead of {@link ClientSocketListener} if {@link LocalSocketRunConfig#isEventLoopEnabled()}.
+     *
+     * A single thread accepts all clients and reads their requests and sends the responses to them
+     * with non-blocking sockets, so slow clients do not each hold a thread. Only whole requests are
+     * passed to {@link ILocalSocketManager#onClientRequest(LocalSocketManager, LocalClientSocket, byte[])}
+     * on the {@link #mRequestWorkers}.
+     */
+    protected class ServerReactorListener implements Runnable {
+
+        @Override
+        public void run() {
+            final int reactor = mServerReactor;
+            try {
+                Logger.logVerbose(LOG_TAG, "ServerReactorListener start");
+
+                final int[] connection = new int[3];
+                final byte[] buffer = new byte[mLocalSocketRunConfig.getMaxRequestSize()];
+                while (true) {
+                    // Run the reactor until a client has sent its whole request
+                    JniResult result = LocalSocketManager.waitServerReactor(mLocalSocketRunConfig.getLogTitle() + " (server)",
+                        reactor, connection, buffer);
+                    // If server reactor is stopped, then stop listener thread.
+                    if (mServerReactorStopped)
+                        break;
+
+                    if (result == null || result.retval != 0) {
+                        mLocalSocketManager.onError(
+                            LocalSocketErrno.ERRNO_SERVER_REACTOR_FAILED.getError(mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(result)));
+                        break;
+                    }
+
+                    if (result.intData < 0)
+                        break;
+
+                    final int connectionId = connection[0];
+                    final byte[] request = Arrays.copyOf(buffer, result.intData);
+
+                    // The client fd is only valid until the request has been responded to
+                    PeerCred peerCred = new PeerCred();
+                    result = LocalSocketManager.getPeerCred(mLocalSocketRunConfig.getLogTitle() + " (client)", connection[1], peerCred);
+                    if (result == null || result.retval != 0) {
+                        respond(reactor, connectionId, null);
+                        mLocalSocketManager.onError(
+                            LocalSocketErrno.ERRNO_GET_CLIENT_SOCKET_PEER_UID_FAILED.getError(mLocalSocketRunConfig.getTitle(), JniResult.getErrorString(result)));
+                        continue;
+                    }
+
+                    // The request of a client whose peer uid is not allowed has not been read by the reactor
+                    if (connection[2] == 0) {
+                        int peerUid = peerCred.uid;
+                        if (peerUid < 0) {
+                            mLocalSocketManager.onError(
+                                LocalSocketErrno.ERRNO_CLIENT_SOCKET_PEER_UID_INVALID.getError(peerUid, mLocalSocketRunConfig.getTitle()));
+                        } else {
+                            mLocalSocketManager.onDisallowedClientConnected(new LocalClientSocket(mLocalSocketManager, -1, peerCred),
+                                LocalSocketErrno.ERRNO_CLIENT_SOCKET_PEER_UID_DISALLOWED.getError(peerCred.getMinimalString(),
+                                    mLocalSocketRunConfig.getTitle()));
+                        }
+                        respond(reactor, connectionId, null);
+                        continue;
+                    }
+
+                    try {
+                        mRequestWorkers.execute(() -> runClientRequest(reactor, connectionId, peerCred, request));
+                    } catch (RejectedExecutionException e) {
+                        // The workers are shut down after the reactor is stopped
+                        if (mServerReactorStopped)
+                            break;
+                        respond(reactor, connectionId, null);
+                        mLocalSocketManager.onError(
+                            LocalSocketErrno.ERRNO_CLIENT_REQUEST_REJECTED.getError(mLocalSocketRunConfig.getTitle(), mRequestWorkers.getMaximumPoolSize()));
+                    }
+                }
+            } catch (Exception ignored) {
+            } finally {
+                try {
+                    close();
+                } catch (Exception ignored) {}
+            }
+
+            Logger.logVerbose(LOG_TAG, "ServerReactorListener end");
+        }
+
+        /** Run a client request on a worker thread and post its response. */
+        private void runClientRequest(int reactor, int connectionId, @NonNull PeerCred peerCred, @NonNull byte[] request) {
+            byte[] response = null;
+            LocalClientSocket clientSocket = null;
+            try {
+                // The client socket is owned by the reactor, so it is not passed on
+                clientSocket = new LocalClientSocket(mLocalSocketManager, -1, peerCred);
+                Logger.logVerbose(LOG_TAG, "Client request for \"" + mLocalSocketRunConfig.getTitle() + "\" server\n" + clientSocket.getLogString());
+
+                // The peer uid was already checked when the reactor accepted the client
+                response = mLocalSocketManager.onClientRequest(clientSocket, request);
+            } catch (Throwable t) {
+                mLocalSocketManager.onError(clientSocket,
+                    LocalSocketErrno.ERRNO_CLIENT_REQUEST_FAILED_WITH_EXCEPTION.getError(t, mLocalSocketRunConfig.getTitle(), t.getMessage()));
+                response = null;
+            } finally {
+                respond(reactor, connectionId, response);
+            }
+        }
+
+    }
+
 }
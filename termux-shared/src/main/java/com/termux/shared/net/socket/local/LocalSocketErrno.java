@@ -24,6 +24,10 @@ public class LocalSocketErrno extends Errno {
     public static final Errno ERRNO_CLIENT_SOCKET_PEER_UID_DISALLOWED = new Errno(TYPE, 160, "Disallowed peer %1$s tried to connect with \"%2$s\" server.");
     public static final Errno ERRNO_CLOSE_SERVER_SOCKET_FAILED_WITH_EXCEPTION = new Errno(TYPE, 161, "Close \"%1$s\" server socket failed.\nException: %2$s");
     public static final Errno ERRNO_CLIENT_SOCKET_LISTENER_FAILED_WITH_EXCEPTION = new Errno(TYPE, 162, "Exception in client socket listener for \"%1$s\" server.\nException: %2$s");
+    public static final Errno ERRNO_CREATE_SERVER_REACTOR_FAILED = new Errno(TYPE, 163, "Create \"%1$s\" server reactor failed.\n%2$s");
+    public static final Errno ERRNO_SERVER_REACTOR_FAILED = new Errno(TYPE, 164, "The \"%1$s\" server reactor failed.\n%2$s");
+    public static final Errno ERRNO_CLIENT_REQUEST_REJECTED = new Errno(TYPE, 165, "Request of client for \"%1$s\" server rejected since all %2$s workers are busy.");
+    public static final Errno ERRNO_CLIENT_REQUEST_FAILED_WITH_EXCEPTION = new Errno(TYPE, 166, "Exception while handling request of client for \"%1$s\" server.\nException: %2$s");
 
     /** Errors for {@link LocalClientSocket} (200-250) */
     public static final Errno ERRNO_SET_CLIENT_SOCKET_READ_TIMEOUT_FAILED = new Errno(TYPE, 200, "Set \"%1$s\" client socket read (SO_RCVTIMEO) timeout to \"%2$s\" failed.\n%3$s");
@@ -35,6 +39,8 @@ public class LocalSocketErrno extends Errno {
     public static final Errno ERRNO_CHECK_AVAILABLE_DATA_ON_CLIENT_SOCKET_FAILED = new Errno(TYPE, 206, "Check available data on \"%1$s\" client socket failed.\n%2$s");
     public static final Errno ERRNO_CLOSE_CLIENT_SOCKET_FAILED_WITH_EXCEPTION = new Errno(TYPE, 207, "Close \"%1$s\" client socket failed.\n%2$s");
     public static final Errno ERRNO_USING_CLIENT_SOCKET_WITH_INVALID_FD = new Errno(TYPE, 208, "Trying to use client socket with invalid file descriptor \"%1$s\" for \"%2$s\" server.");
+    public static final Errno ERRNO_SEND_FDS_TO_CLIENT_SOCKET_FAILED = new Errno(TYPE, 209, "Send file descriptors to \"%1$s\" client socket failed.\n%2$s");
+    public static final Errno ERRNO_RECEIVE_FDS_FROM_CLIENT_SOCKET_FAILED = new Errno(TYPE, 210, "Receive file descriptors from \"%1$s\" client socket failed.\n%2$s");
 
     LocalSocketErrno(final String type, final int code, final String message) {
         super(type, code, message);
@@ -9,6 +9,8 @@ import com.termux.shared.errors.Error;
 import com.termux.shared.jni.models.JniResult;
 import com.termux.shared.logger.Logger;
 
+import java.nio.ByteBuffer;
+
 /**
  * Manager for an AF_UNIX/SOCK_STREAM local server.
  *
@@ -48,6 +50,12 @@ public class LocalSocketManager {
     /** Whether the {@link LocalServerSocket} managed by {@link LocalSocketManager} in running or not. */
     protected boolean mIsRunning;
 
+    /**
+     * The {@link JniResult} for an exception thrown by the last failed fast path call on each thread,
+     * returned by {@link #getLastError(String)} instead of the native error.
+     */
+    private static final ThreadLocal<JniResult> lastFastPathException = new ThreadLocal<>();
+
 
     /**
      * Create an new instance of {@link LocalSocketManager}.
@@ -180,13 +188,16 @@ public class LocalSocketManager {
      * a signal. On error, the {@link JniResult#errno} and {@link JniResult#errmsg} will be set.
      *
      * If while reading the deadline elapses but all the data has not been read, the call will fail.
+     * The deadline is measured on the monotonic clock from the start of the call, and waiting for
+     * data is bounded by it even if no receiving timeout is set for the socket.
      *
      * @param serverTitle The server title used for logging and errors.
      * @param fd The socket fd.
      * @param data The data buffer to read bytes into.
      * @param deadline The deadline milliseconds since epoch.
      * @return Returns the {@link JniResult}. If reading was successful, then {@link JniResult#retval}
-     * will be 0 and {@link JniResult#intData} will contain the bytes read.
+     * will be 0 and {@link JniResult#intData} will contain the bytes read. If it failed, then
+     * {@link JniResult#intData} will contain the bytes read before the failure.
      */
     @Nullable
     public static JniResult read(@NonNull String serverTitle, int fd, @NonNull byte[] data, long deadline) {
@@ -204,13 +215,16 @@ public class LocalSocketManager {
      * {@link JniResult#errmsg} will be set.
      *
      * If while sending the deadline elapses but all the data has not been sent, the call will fail.
+     * The deadline is measured on the monotonic clock from the start of the call, and waiting for
+     * space in the send buffer is bounded by it even if no sending timeout is set for the socket.
      *
      * @param serverTitle The server title used for logging and errors.
      * @param fd The socket fd.
      * @param data The data buffer containing bytes to send.
      * @param deadline The deadline milliseconds since epoch.
      * @return Returns the {@link JniResult}. If sending was successful, then {@link JniResult#retval}
-     * will be 0.
+     * will be 0. If it failed, then {@link JniResult#intData} will contain the bytes sent before
+     * the failure.
      */
     @Nullable
     public static JniResult send(@NonNull String serverTitle, int fd, @NonNull byte[] data, long deadline) {
@@ -242,6 +256,185 @@ public class LocalSocketManager {
         }
     }
 
+    /**
+     * Sends file descriptors to the peer of the socket with SCM_RIGHTS, so that it can use the same
+     * open files, pipes or sockets without the data being copied through the socket. The fds are
+     * sent along with the data buffer, or a single null byte if it is {@code null} or empty, since
+     * they can only be sent along with data. The fds stay open in this process.
+     *
+     * @param serverTitle The server title used for logging and errors.
+     * @param fd The socket fd.
+     * @param fds The fds to send, at most 253.
+     * @param data The optional data buffer containing bytes to send with the fds.
+     * @param deadline The deadline milliseconds since epoch.
+     * @return Returns the {@link JniResult}. If sending was successful, then {@link JniResult#retval}
+     * will be 0.
+     */
+    @Nullable
+    public static JniResult sendFds(@NonNull String serverTitle, int fd, @NonNull int[] fds, @Nullable byte[] data, long deadline) {
+        try {
+            return sendFdsNative(serverTitle, fd, fds, data, deadline);
+        } catch (Throwable t) {
+            String message = "Exception in sendFdsNative()";
+            Logger.logStackTraceWithMessage(LOG_TAG, message, t);
+            return new JniResult(message, t);
+        }
+    }
+
+    /**
+     * Receives up to data buffer length bytes from the socket with one call, along with any file
+     * descriptors sent with them by {@link #sendFds(String, int, int[], byte[], long)}. The fds
+     * received are set at the start of the fds array and the rest of it is set to -1. They are
+     * close-on-exec, and the caller owns them and must close them, like by adopting them with
+     * {@link android.os.ParcelFileDescriptor#adoptFd(int)}. If more fds were sent than fit in the
+     * fds array, they are closed and the call fails.
+     *
+     * @param serverTitle The server title used for logging and errors.
+     * @param fd The socket fd.
+     * @param fds The array to set the fds received in, of length 1 to 253.
+     * @param data The data buffer to read bytes into.
+     * @param deadline The deadline milliseconds since epoch.
+     * @return Returns the {@link JniResult}. If receiving was successful, then {@link JniResult#retval}
+     * will be 0 and {@link JniResult#intData} will contain the bytes read, which is 0 at end of file.
+     */
+    @Nullable
+    public static JniResult receiveFds(@NonNull String serverTitle, int fd, @NonNull int[] fds, @NonNull byte[] data, long deadline) {
+        try {
+            return receiveFdsNative(serverTitle, fd, fds, data, deadline);
+        } catch (Throwable t) {
+            String message = "Exception in receiveFdsNative()";
+            Logger.logStackTraceWithMessage(LOG_TAG, message, t);
+            return new JniResult(message, t);
+        }
+    }
+
+    /**
+     * Fast path for {@link #read(String, int, byte[], long)} that reads into length bytes of the
+     * data buffer starting at offset, without allocating anything on success.
+     *
+     * @param fd The socket fd.
+     * @param data The data buffer to read bytes into.
+     * @param offset The offset in data to read bytes into.
+     * @param length The max number of bytes to read.
+     * @param deadline The deadline milliseconds since epoch.
+     * @return Returns the bytes read, or -1 if reading failed, in which case
+     * {@link #getLastError(String)} must be called on the same thread to get the error.
+     */
+    public static int readFast(int fd, @NonNull byte[] data, int offset, int length, long deadline) {
+        try {
+            return readFastNative(fd, data, offset, length, deadline);
+        } catch (Throwable t) {
+            return onFastPathException("Exception in readFastNative()", t);
+        }
+    }
+
+    /**
+     * Fast path for {@link #send(String, int, byte[], long)} that sends length bytes of the data
+     * buffer starting at offset, without allocating anything on success.
+     *
+     * @param fd The socket fd.
+     * @param data The data buffer containing bytes to send.
+     * @param offset The offset in data of the bytes to send.
+     * @param length The number of bytes to send.
+     * @param deadline The deadline milliseconds since epoch.
+     * @return Returns 0, or -1 if sending failed, in which case {@link #getLastError(String)} must
+     * be called on the same thread to get the error.
+     */
+    public static int sendFast(int fd, @NonNull byte[] data, int offset, int length, long deadline) {
+        try {
+            return sendFastNative(fd, data, offset, length, deadline);
+        } catch (Throwable t) {
+            return onFastPathException("Exception in sendFastNative()", t);
+        }
+    }
+
+    /**
+     * Same as {@link #readFast(int, byte[], int, int, long)}, but reads straight into length bytes of
+     * the direct buffer starting at offset, without any copies. The position and limit of the
+     * buffer are ignored and not changed.
+     *
+     * @param fd The socket fd.
+     * @param buffer The direct buffer to read bytes into.
+     * @param offset The offset in buffer to read bytes into.
+     * @param length The max number of bytes to read.
+     * @param deadline The deadline milliseconds since epoch.
+     * @return Returns the bytes read, or -1 if reading failed, in which case
+     * {@link #getLastError(String)} must be called on the same thread to get the error.
+     */
+    public static int readDirect(int fd, @NonNull ByteBuffer buffer, int offset, int length, long deadline) {
+        try {
+            return readDirectNative(fd, buffer, offset, length, deadline);
+        } catch (Throwable t) {
+            return onFastPathException("Exception in readDirectNative()", t);
+        }
+    }
+
+    /**
+     * Same as {@link #sendFast(int, byte[], int, int, long)}, but sends straight from length bytes of
+     * the direct buffer starting at offset, without any copies. The position and limit of the
+     * buffer are ignored and not changed.
+     *
+     * @param fd The socket fd.
+     * @param buffer The direct buffer containing bytes to send.
+     * @param offset The offset in buffer of the bytes to send.
+     * @param length The number of bytes to send.
+     * @param deadline The deadline milliseconds since epoch.
+     * @return Returns 0, or -1 if sending failed, in which case {@link #getLastError(String)} must
+     * be called on the same thread to get the error.
+     */
+    public static int sendDirect(int fd, @NonNull ByteBuffer buffer, int offset, int length, long deadline) {
+        try {
+            return sendDirectNative(fd, buffer, offset, length, deadline);
+        } catch (Throwable t) {
+            return onFastPathException("Exception in sendDirectNative()", t);
+        }
+    }
+
+    /**
+     * Fast path for {@link #available(String, int)}, without allocating anything on success.
+     *
+     * @param fd The socket fd.
+     * @return Returns the bytes available, or -1 if checking availability failed, in which case
+     * {@link #getLastError(String)} must be called on the same thread to get the error.
+     */
+    public static int availableFast(int fd) {
+        try {
+            return availableFastNative(fd);
+        } catch (Throwable t) {
+            return onFastPathException("Exception in availableFastNative()", t);
+        }
+    }
+
+    /**
+     * Get the error of the last fast path call that failed on the current thread. The
+     * {@link JniResult#intData} will contain the bytes read or sent before the failure.
+     *
+     * @param serverTitle The server title used for logging and errors.
+     * @return Returns the {@link JniResult} for the error.
+     */
+    @Nullable
+    public static JniResult getLastError(@NonNull String serverTitle) {
+        JniResult result = lastFastPathException.get();
+        if (result != null) {
+            lastFastPathException.remove();
+            return result;
+        }
+
+        try {
+            return getLastErrorNative(serverTitle);
+        } catch (Throwable t) {
+            String message = "Exception in getLastErrorNative()";
+            Logger.logStackTraceWithMessage(LOG_TAG, message, t);
+            return new JniResult(message, t);
+        }
+    }
+
+    private static int onFastPathException(@NonNull String message, @NonNull Throwable t) {
+        Logger.logStackTraceWithMessage(LOG_TAG, message, t);
+        lastFastPathException.set(new JniResult(message, t));
+        return -1;
+    }
+
     /**
      * Set receiving (SO_RCVTIMEO) timeout in milliseconds for socket.
      *
@@ -304,6 +497,107 @@ public class LocalSocketManager {
 
 
 
+    /**
+     * Creates a server reactor for the server socket fd, which accepts its clients and reads their
+     * requests and sends the responses to them with epoll on the thread calling
+     * {@link #waitServerReactor(String, int, int[], byte[])}. The server socket is made non-blocking.
+     *
+     * @param serverTitle The server title used for logging and errors.
+     * @param fd The server socket fd.
+     * @param maxRequestSize The max size of a request, clients sending larger ones are closed.
+     * @param readTimeout The timeout in milliseconds for a client to send more of its request, or 0 for none.
+     * @param sendTimeout The timeout in milliseconds for a client to receive more of its response, or 0 for none.
+     * @param allowedPeerUids The peer uids of the clients whose requests are read. The requests of
+     *                        other clients are not read and they are returned as soon as they are
+     *                        accepted. If {@code null}, then no client is allowed.
+     * @return Returns the {@link JniResult}. If creating the reactor was successful, then
+     * {@link JniResult#retval} will be 0 and {@link JniResult#intData} will contain the reactor id.
+     */
+    @Nullable
+    public static JniResult createServerReactor(@NonNull String serverTitle, int fd, int maxRequestSize, int readTimeout, int sendTimeout,
+                                                @Nullable int[] allowedPeerUids) {
+        try {
+            return createServerReactorNative(serverTitle, fd, maxRequestSize, readTimeout, sendTimeout, allowedPeerUids);
+        } catch (Throwable t) {
+            String message = "Exception in createServerReactorNative()";
+            Logger.logStackTraceWithMessage(LOG_TAG, message, t);
+            return new JniResult(message, t);
+        }
+    }
+
+    /**
+     * Runs the server reactor until a client has sent its whole request by shutting down its
+     * writing end, or until the reactor is stopped by {@link #stopServerReactor(String, int)}, after
+     * which the reactor is destroyed. The reactor is also destroyed if this fails. Must only be
+     * called from one thread.
+     *
+     * @param serverTitle The server title used for logging and errors.
+     * @param reactor The reactor id.
+     * @param connection The array of at least 3 to set the connection id, the client socket fd and
+     *                   1 if the peer uid of the client is allowed or else 0 of the request in. The
+     *                   fd is only valid until the request has been responded to. The request of a
+     *                   client which is not allowed is always empty.
+     * @param request The buffer to read the request into, of at least the max request size.
+     * @return Returns the {@link JniResult}. If waiting was successful, then {@link JniResult#retval}
+     * will be 0 and {@link JniResult#intData} will contain the request size, or -1 if the reactor
+     * was stopped.
+     */
+    @Nullable
+    public static JniResult waitServerReactor(@NonNull String serverTitle, int reactor, @NonNull int[] connection, @NonNull byte[] request) {
+        try {
+            return waitServerReactorNative(serverTitle, reactor, connection, request);
+        } catch (Throwable t) {
+            String message = "Exception in waitServerReactorNative()";
+            Logger.logStackTraceWithMessage(LOG_TAG, message, t);
+            return new JniResult(message, t);
+        }
+    }
+
+    /**
+     * Posts the response to a request returned by {@link #waitServerReactor(String, int, int[], byte[])},
+     * which the reactor sends to the client before closing its client socket. Can be called from any thread.
+     *
+     * @param serverTitle The server title used for logging and errors.
+     * @param reactor The reactor id.
+     * @param connectionId The connection id of the request.
+     * @param response The response, or {@code null} to close the client socket without one.
+     * @return Returns the {@link JniResult}. If posting was successful, then {@link JniResult#retval}
+     * will be 0.
+     */
+    @Nullable
+    public static JniResult respondServerReactor(@NonNull String serverTitle, int reactor, int connectionId, @Nullable byte[] response) {
+        try {
+            return respondServerReactorNative(serverTitle, reactor, connectionId, response);
+        } catch (Throwable t) {
+            String message = "Exception in respondServerReactorNative()";
+            Logger.logStackTraceWithMessage(LOG_TAG, message, t);
+            return new JniResult(message, t);
+        }
+    }
+
+    /**
+     * Stops the server reactor, which closes all its client sockets but not the server socket.
+     * If no thread is in {@link #waitServerReactor(String, int, int[], byte[])}, then the reactor is
+     * destroyed right away, otherwise by that call. Can be called from any thread.
+     *
+     * @param serverTitle The server title used for logging and errors.
+     * @param reactor The reactor id.
+     * @return Returns the {@link JniResult}. If stopping was successful, then {@link JniResult#retval}
+     * will be 0.
+     */
+    @Nullable
+    public static JniResult stopServerReactor(@NonNull String serverTitle, int reactor) {
+        try {
+            return stopServerReactorNative(serverTitle, reactor);
+        } catch (Throwable t) {
+            String message = "Exception in stopServerReactorNative()";
+            Logger.logStackTraceWithMessage(LOG_TAG, message, t);
+            return new JniResult(message, t);
+        }
+    }
+
+
+
     /** Wrapper for {@link #onError(LocalClientSocket, Error)} for {@code null} {@link LocalClientSocket}. */
     public void onError(@NonNull Error error) {
         onError(null, error);
@@ -321,6 +615,15 @@ public class LocalSocketManager {
             mLocalSocketManagerClient.onDisallowedClientConnected(this, clientSocket, error));
     }
 
+    /**
+     * Call {@link ILocalSocketManager#onClientRequest(LocalSocketManager, LocalClientSocket, byte[])}
+     * on the current thread, which is a worker thread of the {@link LocalServerSocket}.
+     */
+    @Nullable
+    public byte[] onClientRequest(@NonNull LocalClientSocket clientSocket, @NonNull byte[] request) {
+        return mLocalSocketManagerClient.onClientRequest(this, clientSocket, request);
+    }
+
     /** Wrapper to call {@link ILocalSocketManager#onClientAccepted(LocalSocketManager, LocalClientSocket)} in a new thread. */
     public void onClientAccepted(@NonNull LocalClientSocket clientSocket) {
         startLocalSocketManagerClientThread(() ->
@@ -441,10 +744,34 @@ public class LocalSocketManager {
 
     @Nullable private static native JniResult availableNative(@NonNull String serverTitle, int fd);
 
+    private static native int readFastNative(int fd, @NonNull byte[] data, int offset, int length, long deadline);
+
+    private static native int sendFastNative(int fd, @NonNull byte[] data, int offset, int length, long deadline);
+
+    private static native int availableFastNative(int fd);
+
+    private static native int readDirectNative(int fd, @NonNull ByteBuffer buffer, int offset, int length, long deadline);
+
+    private static native int sendDirectNative(int fd, @NonNull ByteBuffer buffer, int offset, int length, long deadline);
+
+    @Nullable private static native JniResult getLastErrorNative(@NonNull String serverTitle);
+
+    @Nullable private static native JniResult sendFdsNative(@NonNull String serverTitle, int fd, @NonNull int[] fds, @Nullable byte[] data, long deadline);
+
+    @Nullable private static native JniResult receiveFdsNative(@NonNull String serverTitle, int fd, @NonNull int[] fds, @NonNull byte[] data, long deadline);
+
     private static native JniResult setSocketReadTimeoutNative(@NonNull String serverTitle, int fd, int timeout);
 
     @Nullable private static native JniResult setSocketSendTimeoutNative(@NonNull String serverTitle, int fd, int timeout);
 
     @Nullable private static native JniResult getPeerCredNative(@NonNull String serverTitle, int fd, PeerCred peerCred);
 
+    @Nullable private static native JniResult createServerReactorNative(@NonNull String serverTitle, int fd, int maxRequestSize, int readTimeout, int sendTimeout, @Nullable int[] allowedPeerUids);
+
+    @Nullable private static native JniResult waitServerReactorNative(@NonNull String serverTitle, int reactor, @NonNull int[] connection, @NonNull byte[] request);
+
+    @Nullable private static native JniResult respondServerReactorNative(@NonNull String serverTitle, int reactor, int connectionId, @Nullable byte[] response);
+
+    @Nullable private static native JniResult stopServerReactorNative(@NonNull String serverTitle, int reactor);
+
 }
@@ -40,6 +40,14 @@ public abstract class LocalSocketManagerClientBase implements ILocalSocketManage
         clientSocket.closeClientSocket(true);
     }
 
+    @Nullable
+    @Override
+    public byte[] onClientRequest(@NonNull LocalSocketManager localSocketManager,
+                                  @NonNull LocalClientSocket clientSocket, @NonNull byte[] request) {
+        // Just close socket without a response and let child class handle any required communication
+        return null;
+    }
+
 
 
     protected abstract String getLogTag();
@@ -94,6 +94,38 @@ public class LocalSocketRunConfig implements Serializable {
     protected Integer mBacklog;
     public static final int DEFAULT_BACKLOG = 50;
 
+    /**
+     * Whether the {@link LocalServerSocket} serves its clients with a native epoll event loop on a
+     * single thread instead of handing each accepted {@link LocalClientSocket} to a new thread. The
+     * event loop reads a request from each client until the client shuts down its writing end, and
+     * dispatches it to a bounded pool of worker threads calling
+     * {@link ILocalSocketManager#onClientRequest(LocalSocketManager, LocalClientSocket, byte[])},
+     * so that slow clients do not hold up other clients.
+     *
+     * The {@link #mReceiveTimeout} and {@link #mSendTimeout} are the timeouts for a client to send
+     * more of its request and receive more of its response, and {@link #mDeadline} is not used.
+     * Defaults to {@link #DEFAULT_EVENT_LOOP_ENABLED}.
+     */
+    protected Boolean mEventLoopEnabled;
+    public static final boolean DEFAULT_EVENT_LOOP_ENABLED = false;
+
+    /**
+     * The max size in bytes of a request read by the event loop, see {@link #mEventLoopEnabled}.
+     * Clients sending larger requests are closed.
+     * Defaults to {@link #DEFAULT_MAX_REQUEST_SIZE}.
+     */
+    protected Integer mMaxRequestSize;
+    public static final int DEFAULT_MAX_REQUEST_SIZE = 1024 * 1024;
+
+    /**
+     * The max number of worker threads that requests read by the event loop are dispatched to, see
+     * {@link #mEventLoopEnabled}. At most {@link #mBacklog} more requests wait for a worker, after
+     * which clients are closed without a response.
+     * Defaults to {@link #DEFAULT_MAX_WORKER_THREADS}.
+     */
+    protected Integer mMaxWorkerThreads;
+    public static final int DEFAULT_MAX_WORKER_THREADS = 4;
+
 
     /**
      * Create an new instance of {@link LocalSocketRunConfig}.
@@ -194,6 +226,38 @@ public class LocalSocketRunConfig implements Serializable {
             mBacklog = backlog;
     }
 
+    /** Get {@link #mEventLoopEnabled} if set, otherwise {@link #DEFAULT_EVENT_LOOP_ENABLED}. */
+    public boolean isEventLoopEnabled() {
+        return mEventLoopEnabled != null ? mEventLoopEnabled : DEFAULT_EVENT_LOOP_ENABLED;
+    }
+
+    /** Set {@link #mEventLoopEnabled}. */
+    public void setEventLoopEnabled(Boolean eventLoopEnabled) {
+        mEventLoopEnabled = eventLoopEnabled;
+    }
+
+    /** Get {@link #mMaxRequestSize} if set, otherwise {@link #DEFAULT_MAX_REQUEST_SIZE}. */
+    public Integer getMaxRequestSize() {
+        return mMaxRequestSize != null ? mMaxRequestSize : DEFAULT_MAX_REQUEST_SIZE;
+    }
+
+    /** Set {@link #mMaxRequestSize}. Value must be greater than 0. */
+    public void setMaxRequestSize(Integer maxRequestSize) {
+        if (maxRequestSize > 0)
+            mMaxRequestSize = maxRequestSize;
+    }
+
+    /** Get {@link #mMaxWorkerThreads} if set, otherwise {@link #DEFAULT_MAX_WORKER_THREADS}. */
+    public Integer getMaxWorkerThreads() {
+        return mMaxWorkerThreads != null ? mMaxWorkerThreads : DEFAULT_MAX_WORKER_THREADS;
+    }
+
+    /** Set {@link #mMaxWorkerThreads}. Value must be greater than 0. */
+    public void setMaxWorkerThreads(Integer maxWorkerThreads) {
+        if (maxWorkerThreads > 0)
+            mMaxWorkerThreads = maxWorkerThreads;
+    }
+
 
     /**
      * Get a log {@link String} for {@link LocalSocketRunConfig}.
@@ -221,6 +285,9 @@ public class LocalSocketRunConfig implements Serializable {
         logString.append("\n").append(Logger.getSingleLineLogStringEntry("SendTimeout", getSendTimeout(), "-"));
         logString.append("\n").append(Logger.getSingleLineLogStringEntry("Deadline", getDeadline(), "-"));
         logString.append("\n").append(Logger.getSingleLineLogStringEntry("Backlog", getBacklog(), "-"));
+        logString.append("\n").append(Logger.getSingleLineLogStringEntry("EventLoopEnabled", isEventLoopEnabled(), "-"));
+        logString.append("\n").append(Logger.getSingleLineLogStringEntry("MaxRequestSize", getMaxRequestSize(), "-"));
+        logString.append("\n").append(Logger.getSingleLineLogStringEntry("MaxWorkerThreads", getMaxWorkerThreads(), "-"));
 
         return logString.toString();
     }
@@ -250,6 +317,9 @@ public class LocalSocketRunConfig implements Serializable {
         markdownString.append("\n").append(MarkdownUtils.getSingleLineMarkdownStringEntry("SendTimeout", getSendTimeout(), "-"));
         markdownString.append("\n").append(MarkdownUtils.getSingleLineMarkdownStringEntry("Deadline", getDeadline(), "-"));
         markdownString.append("\n").append(MarkdownUtils.getSingleLineMarkdownStringEntry("Backlog", getBacklog(), "-"));
+        markdownString.append("\n").append(MarkdownUtils.getSingleLineMarkdownStringEntry("EventLoopEnabled", isEventLoopEnabled(), "-"));
+        markdownString.append("\n").append(MarkdownUtils.getSingleLineMarkdownStringEntry("MaxRequestSize", getMaxRequestSize(), "-"));
+        markdownString.append("\n").append(MarkdownUtils.getSingleLineMarkdownStringEntry("MaxWorkerThreads", getMaxWorkerThreads(), "-"));
 
         return markdownString.toString();
     }
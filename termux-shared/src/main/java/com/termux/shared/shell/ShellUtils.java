@@ -55,15 +55,18 @@ public class ShellUtils {
         TerminalEmulator terminalEmulator = terminalSession.getEmulator();
         if (terminalEmulator == null) return null;
 
-        TerminalBuffer terminalBuffer = terminalEmulator.getScreen();
-        if (terminalBuffer == null) return null;
-
         String transcriptText;
 
-        if (linesJoined)
-            transcriptText = terminalBuffer.getTranscriptTextWithFullLinesJoined();
-        else
-            transcriptText = terminalBuffer.getTranscriptTextWithoutJoinedLines();
+        // The emulator is changed by the emulation thread of the session while holding its monitor.
+        synchronized (terminalEmulator) {
+            TerminalBuffer terminalBuffer = terminalEmulator.getScreen();
+            if (terminalBuffer == null) return null;
+
+            if (linesJoined)
+                transcriptText = terminalBuffer.getTranscriptTextWithFullLinesJoined();
+            else
+                transcriptText = terminalBuffer.getTranscriptTextWithoutJoinedLines();
+        }
 
         if (transcriptText == null) return null;
 
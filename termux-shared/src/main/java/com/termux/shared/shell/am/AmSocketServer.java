@@ -91,7 +91,41 @@ public class AmSocketServer {
             return;
         }
 
-        String amCommandString = data.toString();
+        // Run am command and send its result to the client and close output stream
+        error = clientSocket.sendDataToOutputStream(processAmCommand(localSocketManager, clientSocket, data.toString()), true);
+        if (error != null) {
+            localSocketManager.onError(clientSocket, error);
+        }
+    }
+
+    /**
+     * Process the am command of a client request received by a server with
+     * {@link LocalSocketRunConfig#isEventLoopEnabled()}.
+     *
+     * @param localSocketManager The {@link LocalSocketManager} instance for the local socket.
+     * @param clientSocket The {@link LocalClientSocket} that requested the am command to be run.
+     * @param request The am command string in UTF-8.
+     * @return Returns the result to send to the client.
+     */
+    public static byte[] processAmRequest(@NonNull LocalSocketManager localSocketManager,
+                                          @NonNull LocalClientSocket clientSocket,
+                                          @NonNull byte[] request) {
+        return processAmCommand(localSocketManager, clientSocket, new String(request, StandardCharsets.UTF_8))
+            .getBytes(StandardCharsets.UTF_8);
+    }
+
+    /**
+     * Parse and run the am command sent by a client.
+     *
+     * @param localSocketManager The {@link LocalSocketManager} instance for the local socket.
+     * @param clientSocket The {@link LocalClientSocket} that requested the am command to be run.
+     * @param amCommandString The am command string the client sent.
+     * @return Returns the result to send to the client.
+     */
+    public static String processAmCommand(@NonNull LocalSocketManager localSocketManager,
+                                          @NonNull LocalClientSocket clientSocket,
+                                          String amCommandString) {
+        Error error;
 
         Logger.logVerbose(LOG_TAG, "am command received from peer " + clientSocket.getPeerCred().getMinimalString() +
             "\nam command: `" + amCommandString + "`");
@@ -100,8 +134,7 @@ public class AmSocketServer {
         List<String> amCommandList = new ArrayList<>();
         error = parseAmCommand(amCommandString, amCommandList);
         if (error != null) {
-            sendResultToClient(localSocketManager, clientSocket, 1, null, error.toString());
-            return;
+            return getResultString(clientSocket, 1, null, error.toString());
         }
 
         String[] amCommandArray = amCommandList.toArray(new String[0]);
@@ -111,17 +144,17 @@ public class AmSocketServer {
 
         AmSocketServerRunConfig amSocketServerRunConfig = (AmSocketServerRunConfig) localSocketManager.getLocalSocketRunConfig();
 
-        // Run am command and send its result to the client
+        // Run am command and return its result
         StringBuilder stdout = new StringBuilder();
         StringBuilder stderr = new StringBuilder();
         error = runAmCommand(localSocketManager.getContext(), amCommandArray, stdout, stderr,
             amSocketServerRunConfig.shouldCheckDisplayOverAppsPermission());
         if (error != null) {
-            sendResultToClient(localSocketManager, clientSocket, 1, stdout.toString(),
+            return getResultString(clientSocket, 1, stdout.toString(),
                 !stderr.toString().isEmpty() ? stderr + "\n\n" + error : error.toString());
         }
 
-        sendResultToClient(localSocketManager, clientSocket, 0, stdout.toString(), stderr.toString());
+        return getResultString(clientSocket, 0, stdout.toString(), stderr.toString());
     }
 
     /**
@@ -137,18 +170,32 @@ public class AmSocketServer {
                                           @NonNull LocalClientSocket clientSocket,
                                           int exitCode,
                                           @Nullable String stdout, @Nullable String stderr) {
+        // Send result to client and close output stream
+        Error error = clientSocket.sendDataToOutputStream(getResultString(clientSocket, exitCode, stdout, stderr), true);
+        if (error != null) {
+            localSocketManager.onError(clientSocket, error);
+        }
+    }
+
+    /**
+     * Get result in the format `exit_code\0stdout\0stderr` to send to {@link LocalClientSocket}.
+     *
+     * @param clientSocket The {@link LocalClientSocket} to which the result is to be sent.
+     * @param exitCode The exit code value to send.
+     * @param stdout The stdout value to send.
+     * @param stderr The stderr value to send.
+     * @return Returns the result.
+     */
+    public static String getResultString(@NonNull LocalClientSocket clientSocket,
+                                         int exitCode,
+                                         @Nullable String stdout, @Nullable String stderr) {
         StringBuilder result = new StringBuilder();
         result.append(sanitizeExitCode(clientSocket, exitCode));
         result.append('\0');
         result.append(stdout != null ? stdout : "");
         result.append('\0');
         result.append(stderr != null ? stderr : "");
-
-        // Send result to client and close output stream
-        Error error = clientSocket.sendDataToOutputStream(result.toString(), true);
-        if (error != null) {
-            localSocketManager.onError(clientSocket, error);
-        }
+        return result.toString();
     }
 
     /**
@@ -253,6 +300,13 @@ public class AmSocketServer {
             super.onClientAccepted(localSocketManager, clientSocket);
         }
 
+        @Nullable
+        @Override
+        public byte[] onClientRequest(@NonNull LocalSocketManager localSocketManager,
+                                      @NonNull LocalClientSocket clientSocket, @NonNull byte[] request) {
+            return AmSocketServer.processAmRequest(localSocketManager, clientSocket, request);
+        }
+
     }
 
 }
@@ -167,6 +167,8 @@ public class ExecutionCommand {
 
     /** The terminal transcript rows for the {@link ExecutionCommand}. */
     public Integer terminalTranscriptRows;
+    /** The directory of the terminal transcript file for the {@link ExecutionCommand}, or null for none. */
+    public String terminalTranscriptFileDirectory;
 
 
     /** The {@link Runner} for the {@link ExecutionCommand}. */
@@ -65,6 +65,10 @@ public class TermuxAppSharedProperties {
         return 2000; // Default transcript rows
     }
     
+    public boolean shouldUseTerminalTranscriptFile() {
+        return false; // Default transcript file setting
+    }
+    
     public boolean shouldOpenTerminalTranscriptURLOnClick() {
         return true; // Default URL click behavior
     }
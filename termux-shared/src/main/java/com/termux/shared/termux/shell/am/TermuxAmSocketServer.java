@@ -104,6 +104,8 @@ public class TermuxAmSocketServer {
 
         AmSocketServerRunConfig amSocketServerRunConfig = new AmSocketServerRunConfig(TITLE,
             TermuxConstants.TERMUX_APP.TERMUX_AM_SOCKET_FILE_PATH, new TermuxAmSocketServerClient());
+        // Serve clients from a single event loop thread instead of a thread per client
+        amSocketServerRunConfig.setEventLoopEnabled(true);
 
         termuxAmSocketServer = AmSocketServer.start(context, amSocketServerRunConfig);
     }
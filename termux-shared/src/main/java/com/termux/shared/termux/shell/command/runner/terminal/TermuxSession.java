@@ -181,6 +181,9 @@ public class TermuxSession {
         if (executionCommand.shellName != null) {
             terminalSession.mSessionName = executionCommand.shellName;
         }
+        if (executionCommand.terminalTranscriptFileDirectory != null) {
+            terminalSession.setTranscriptFileDirectory(executionCommand.terminalTranscriptFileDirectory);
+        }
 
         return new TermuxSession(terminalSession, executionCommand, termuxSessionClient, setStdoutOnExit);
     }